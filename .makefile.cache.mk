@@ -0,0 +1,21 @@
+
+CC = g++ -I/tmp/shim
+LD = /usr/bin/g++
+SED = /usr/bin/sed
+LDCONFIG = /sbin/ldconfig
+HEADERCRYPTO = /usr/include/openssl/crypto.h
+LIBCRYPTO = libcrypto.so.3 libcrypto.so
+HEADERSSL = /usr/include/openssl/ssl3.h
+LIBSSL = libssl.so.3 libssl.so
+HEADERJPEG = /usr/include/jpeglib.h
+LIBJPEG = libjpeg.so.62 libjpeg.so
+HEADERPNG = /usr/include/png.h
+LIBPNG = libpng16.so.16 libpng16.so
+HEADERZLIB = /usr/include/zlib.h
+LIBZLIB = libz.so.1 libz.so
+AS_OPT = /usr/bin/g++
+GDB_OPT =
+MTRACE_OPT = /usr/bin/mtrace
+CTAGS_OPT =
+ETAGS_OPT =
+EBROWSE_OPT =
@@ -0,0 +1,749 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "../src/Image.hpp"
+#include "../src/SignedData.hpp"
+#include "../src/BufferPool.hpp"
+#include "../src/QrCache.hpp"
+#include "../src/Crypto.hpp"
+#include "../src/Platforms.hpp"
+#include "../src/Ident.hpp"
+
+#include "bench.hpp"
+
+#include <jpeglib.h>
+#include <png.h>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+
+/* ***************************************************************  */
+
+/**
+ * End-to-end benchmark of class Image, of the ustr transcoding in
+ * bench_ustr.cpp, of the case mapping in bench_ucase.cpp, of the
+ * heap allocations in bench_alloc.cpp, of the failure handling in
+ * bench_result.cpp and of the asynchronous Log in bench_log.cpp.
+ *
+ * Generates a deterministic synthetic corpus of photo like images
+ * with a QR signature, covering sizes from 256x256 up to 8K, several
+ * JPEG qualities and PNG, rotated and scaled QR codes.  Then every
+ * Image stage runs on every file and the results are printed as JSON
+ * for regression tracking.
+ *
+ * ```shell
+ *   $> make -C bench run ARGS='--max-side=2048 --repeat=3'
+ *   $> make -C bench run ARGS='--suite=ustr'
+ *   $> make -C bench run ARGS='--suite=result'
+ *   $> make -C bench run ARGS='--suite=log'
+ * ```
+ */
+
+namespace socialmedia_signer {
+
+#define BENCH_PAYLOAD \
+  u8"https://example.org/@socialmedia-signer/posts/112233445566778899"
+
+struct bench_size {
+  unsigned width, height;
+};
+
+struct bench_transform {
+  const char* name;
+  double rotation;                 /* degrees  */
+  double scale;                    /* times the base module size  */
+};
+
+static const bench_size _bench_sizes[] = {
+  {256, 256}, {512, 512}, {1024, 1024}, {1920, 1080}, {3840, 2160},
+  {7680, 4320}
+};
+
+/** JPEG qualities, 0 is PNG.  */
+static const int _bench_qualities[] = {95, 75, 50, 30, 0};
+
+static const bench_transform _bench_transforms[] = {
+  {"r0",     0.0, 1.0}, {"r10",   10.0, 1.0}, {"r45", 45.0, 1.0},
+  {"r90",   90.0, 1.0}, {"s0.5",   0.0, 0.5}, {"s2",   0.0, 2.0}
+};
+
+struct bench_file {
+  std::string path;
+  bench_size size;
+  int quality;
+  const bench_transform* transform;
+};
+
+struct bench_sample {
+  const bench_file* file;
+
+  /**
+   * Latency, measured around bench_stage::run if it is still negative
+   * afterwards.  Stages which need a decoded Image as input measure
+   * just their own part.
+   */
+  double ms;
+  std::size_t pixels;
+
+  /** Raw pixel bytes processed, only set by the encode stages.  */
+  std::size_t bytes;
+  bool is_success;
+};
+
+struct bench_stage {
+  const char* name;
+  std::function<void(const bench_file& file, bench_sample& sample)> run;
+
+  std::vector<bench_sample> samples;
+};
+
+template<typename F>
+static double
+_bench_ms(F&& function)
+{
+  const auto start = std::chrono::steady_clock::now();
+  function();
+
+  return std::chrono::duration<double, std::milli>(
+    std::chrono::steady_clock::now() - start).count();
+}
+
+/* -------------------------------------------------------------------
+ * Corpus generation.
+ */
+
+/** XORSHIFT64*, the corpus needs to be the same on every host.  */
+struct bench_rng {
+  std::uint64_t state;
+
+  std::uint32_t next()
+  {
+    this->state ^= this->state >> 12;
+    this->state ^= this->state << 25;
+    this->state ^= this->state >> 27;
+    return static_cast<std::uint32_t>(
+      (this->state * 0x2545f4914f6cdd1dull) >> 32);
+  }
+};
+
+/**
+ * Smooth gradients, a few soft blobs and sensor noise, so that JPEG
+ * and DEFLATE do not work on trivial data.
+ */
+static void
+_bench_background(std::vector<std::uint8_t>& rgb, const bench_size& size,
+                  bench_rng& rng)
+{
+  struct blob { double x, y, r; int color[3]; } blobs[8];
+
+  for (blob& b: blobs) {
+    b.x = rng.next() % size.width;
+    b.y = rng.next() % size.height;
+    b.r = std::max(8u, rng.next() % (std::min(size.width, size.height)
+                                      / 2 + 1));
+    for (int& c: b.color) c = static_cast<int>(rng.next() % 120) - 60;
+  }
+
+  rgb.resize((std::size_t) size.width * size.height * 3);
+
+  for (unsigned y=0; y < size.height; y++) {
+    std::uint8_t* row = &rgb[(std::size_t) y * size.width * 3];
+
+    for (unsigned x=0; x < size.width; x++) {
+      int color[3] = {
+        static_cast<int>(60 + 120 * x / size.width),
+        static_cast<int>(90 + 80 * y / size.height),
+        static_cast<int>(150 - 60 * x / size.width)};
+
+      for (const blob& b: blobs) {
+        const double d2 = ((x - b.x) * (x - b.x) + (y - b.y) * (y - b.y))
+          / (b.r * b.r);
+        if (d2 >= 1.0) continue;
+        for (int c=0; c < 3; c++) color[c] += b.color[c] * (1.0 - d2);
+      }
+
+      const int noise = static_cast<int>(rng.next() % 17) - 8;
+      for (int c=0; c < 3; c++)
+        row[x * 3 + c] = std::clamp(color[c] + noise, 0, 255);
+    }
+  }
+}
+
+/**
+ * Draws the QR code of BENCH_PAYLOAD rotated by `transform` into the
+ * bottom right corner, where SignedData places signatures.
+ */
+static void
+_bench_draw_qr(std::vector<std::uint8_t>& rgb, const bench_size& size,
+               const bench_transform& transform)
+{
+  static const Image::QrStyle MODULES = {
+    QrCode::Ecc::MEDIUM, 1, 4, 0x000000, 0xffffff};
+
+  const Image qr(QrCode(BENCH_PAYLOAD, MODULES.ecc), MODULES);
+  const unsigned modules = qr.get_width();
+
+  /* About a quarter of the shorter side, at least 2 pixels.  */
+  const double module = transform.scale * std::max(2.0,
+    std::floor(std::min(size.width, size.height) / 4.0 / modules));
+
+  const double rad = transform.rotation * M_PI / 180.0;
+  const double cos_r = std::cos(rad), sin_r = std::sin(rad);
+  const double half = modules * module / 2.0;
+  const double extent = half * (std::abs(cos_r) + std::abs(sin_r));
+
+  const double cx = size.width - 16.0 - extent;
+  const double cy = size.height - 16.0 - extent;
+
+  const int x0 = std::max(0, static_cast<int>(cx - extent));
+  const int y0 = std::max(0, static_cast<int>(cy - extent));
+  const int x1 = std::min<int>(size.width, cx + extent + 1);
+  const int y1 = std::min<int>(size.height, cy + extent + 1);
+
+  for (int y=y0; y < y1; y++) {
+    for (int x=x0; x < x1; x++) {
+      const double dx = x + 0.5 - cx, dy = y + 0.5 - cy;
+      const double u = (cos_r * dx + sin_r * dy + half) / module;
+      const double v = (-sin_r * dx + cos_r * dy + half) / module;
+
+      if (u < 0.0 || v < 0.0 || u >= modules || v >= modules) continue;
+
+      const std::uint8_t value = qr.get_buffer().get_row(
+        static_cast<unsigned>(v))[static_cast<unsigned>(u) * 3];
+      std::memset(&rgb[((std::size_t) y * size.width + x) * 3], value, 3);
+    }
+  }
+}
+
+static bool
+_bench_write_jpeg(const std::string& path,
+                  const std::vector<std::uint8_t>& rgb,
+                  const bench_size& size, int quality)
+{
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  if (file == nullptr) return false;
+
+  struct jpeg_compress_struct cinfo;
+  struct jpeg_error_mgr jerr;
+
+  cinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_compress(&cinfo);
+  jpeg_stdio_dest(&cinfo, file);
+
+  cinfo.image_width      = size.width;
+  cinfo.image_height     = size.height;
+  cinfo.input_components = 3;
+  cinfo.in_color_space   = JCS_RGB;
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, quality, TRUE);
+  jpeg_start_compress(&cinfo, TRUE);
+
+  while (cinfo.next_scanline < cinfo.image_height) {
+    JSAMPROW row = const_cast<JSAMPROW>(
+      &rgb[(std::size_t) cinfo.next_scanline * size.width * 3]);
+    jpeg_write_scanlines(&cinfo, &row, 1);
+  }
+
+  jpeg_finish_compress(&cinfo);
+  jpeg_destroy_compress(&cinfo);
+
+  return std::fclose(file) == 0;
+}
+
+static bool
+_bench_write_png(const std::string& path,
+                 const std::vector<std::uint8_t>& rgb,
+                 const bench_size& size)
+{
+  png_image image;
+  std::memset(&image, 0, sizeof(image));
+
+  image.version = PNG_IMAGE_VERSION;
+  image.width   = size.width;
+  image.height  = size.height;
+  image.format  = PNG_FORMAT_RGB;
+
+  return png_image_write_to_file(&image, path.c_str(), 0, rgb.data(), 0,
+                                 nullptr) != 0;
+}
+
+/**
+ * Files already in `dir` are reused, as the corpus is deterministic.
+ */
+static std::vector<bench_file>
+_bench_corpus(const std::string& dir, unsigned max_side)
+{
+  std::vector<bench_file> result;
+  std::vector<std::uint8_t> rgb;
+
+  ::mkdir(dir.c_str(), 0755);
+
+  for (const bench_size& size: _bench_sizes) {
+    if (std::max(size.width, size.height) > max_side) continue;
+
+    for (const bench_transform& transform: _bench_transforms) {
+      bool is_drawn = false;
+
+      for (int quality: _bench_qualities) {
+        char name[64];
+        if (quality == 0) {
+          std::snprintf(name, sizeof(name), "/%ux%u_%s.png",
+                        size.width, size.height, transform.name);
+        } else {
+          std::snprintf(name, sizeof(name), "/%ux%u_%s_q%d.jpg",
+                        size.width, size.height, transform.name, quality);
+        }
+
+        bench_file file = {dir + name, size, quality, &transform};
+        result.push_back(file);
+
+        struct stat st;
+        if (::stat(file.path.c_str(), &st) == 0) continue;
+
+        if (!is_drawn) {
+          /* Seeded by size only, same background for every variant.  */
+          bench_rng rng = {0x9e3779b97f4a7c15ull
+                           ^ ((std::uint64_t) size.width << 32)
+                           ^ size.height};
+          _bench_background(rgb, size, rng);
+          _bench_draw_qr(rgb, size, transform);
+          is_drawn = true;
+        }
+
+        const bool is_ok = quality == 0
+          ? _bench_write_png(file.path, rgb, size)
+          : _bench_write_jpeg(file.path, rgb, size, quality);
+        if (!is_ok) {
+          Log::fatal(ustr::format("Could not write corpus file '{}'!",
+            reinterpret_cast<const char8_t*>(file.path.c_str())));
+        }
+      }
+    }
+  }
+
+  return result;
+}
+
+/* -------------------------------------------------------------------
+ * Statistics and JSON output.
+ */
+
+static double
+_bench_percentile(std::vector<double>& sorted, double p)
+{
+  if (sorted.empty()) return 0.0;
+
+  const std::size_t i = std::min(sorted.size() - 1,
+    static_cast<std::size_t>(std::ceil(p * sorted.size())) - (p > 0.0));
+  return sorted[i];
+}
+
+static void
+_bench_print_stats(std::FILE* out, const char* indent,
+                   const std::vector<const bench_sample*>& samples)
+{
+  std::vector<double> ms;
+  double ms_total = 0.0;
+  std::size_t pixels = 0, bytes = 0, successes = 0;
+
+  for (const bench_sample* sample: samples) {
+    ms.push_back(sample->ms);
+    ms_total += sample->ms;
+    pixels += sample->pixels;
+    bytes += sample->bytes;
+    successes += sample->is_success;
+  }
+  std::sort(ms.begin(), ms.end());
+
+  std::fprintf(out,
+    "%s\"runs\": %zu, \"success_rate\": %.4f, \"mpix_per_s\": %.2f,"
+    " \"mb_per_s\": %.2f,\n"
+    "%s\"latency_ms\": {\"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f,"
+    " \"max\": %.3f}",
+    indent, samples.size(),
+    samples.empty()? 0.0: (double) successes / samples.size(),
+    ms_total > 0.0? pixels / ms_total / 1000.0: 0.0,
+    ms_total > 0.0? bytes / ms_total / 1000.0: 0.0,
+    indent, _bench_percentile(ms, 0.50), _bench_percentile(ms, 0.90),
+    _bench_percentile(ms, 0.99), ms.empty()? 0.0: ms.back());
+}
+
+static void
+_bench_print_group(std::FILE* out, const char* key,
+  const bench_stage& stage,
+  const std::function<std::string(const bench_file&)>& group_of)
+{
+  std::vector<std::string> groups;
+  for (const bench_sample& sample: stage.samples) {
+    const std::string group = group_of(*sample.file);
+    if (std::find(groups.begin(), groups.end(), group) == groups.end())
+      groups.push_back(group);
+  }
+
+  std::fprintf(out, ",\n      \"%s\": {", key);
+  for (std::size_t g=0; g < groups.size(); g++) {
+    std::vector<const bench_sample*> samples;
+    for (const bench_sample& sample: stage.samples)
+      if (group_of(*sample.file) == groups[g]) samples.push_back(&sample);
+
+    std::fprintf(out, "%s\n        \"%s\": {\n", g? ",": "",
+                 groups[g].c_str());
+    _bench_print_stats(out, "          ", samples);
+    std::fprintf(out, "}");
+  }
+  std::fprintf(out, "\n      }");
+}
+
+static void
+_bench_print(std::FILE* out, const std::vector<bench_stage>& stages,
+             std::size_t files, double corpus_ms, unsigned repeat)
+{
+  struct rusage usage;
+  ::getrusage(RUSAGE_SELF, &usage);
+
+  std::fprintf(out, "  \"corpus\": {\"files\": %zu, \"generate_ms\":"
+               " %.1f},\n  \"repeat\": %u,\n  \"peak_rss_kib\": %ld,\n"
+               "  \"stages\": {", files, corpus_ms, repeat,
+               usage.ru_maxrss);
+
+  for (std::size_t i=0; i < stages.size(); i++) {
+    const bench_stage& stage = stages[i];
+
+    std::vector<const bench_sample*> samples;
+    for (const bench_sample& sample: stage.samples)
+      samples.push_back(&sample);
+
+    std::fprintf(out, "%s\n    \"%s\": {\n", i? ",": "", stage.name);
+    _bench_print_stats(out, "      ", samples);
+
+    _bench_print_group(out, "by_size", stage, [](const bench_file& f) {
+      char group[32];
+      std::snprintf(group, sizeof(group), "%ux%u", f.size.width,
+                    f.size.height);
+      return std::string(group);
+    });
+    _bench_print_group(out, "by_quality", stage, [](const bench_file& f) {
+      char group[32];
+      std::snprintf(group, sizeof(group), f.quality == 0? "png": "q%d",
+                    f.quality);
+      return std::string(group);
+    });
+    _bench_print_group(out, "by_transform", stage,
+      [](const bench_file& f) { return std::string(f.transform->name); });
+
+    std::fprintf(out, "\n    }");
+  }
+
+  std::fprintf(out, "\n  }");
+}
+
+/* -------------------------------------------------------------------
+ * Image stages.
+ */
+
+static std::size_t
+_bench_pixels(const Image& image)
+{
+  return (std::size_t) image.get_region().width
+    * image.get_region().height;
+}
+
+static std::size_t
+_bench_bytes(const Image& image)
+{
+  return _bench_pixels(image) * image.get_channels();
+}
+
+static const char8_t*
+_bench_path(const std::string& path)
+{
+  return reinterpret_cast<const char8_t*>(path.c_str());
+}
+
+/**
+ * Plain single-threaded libpng encoder with its default filter
+ * heuristic, as reference for Image::save_png() at the same zlib
+ * `level`.
+ */
+static bool
+_bench_write_png_libpng(const std::string& path, const Image& image,
+                        int level)
+{
+  static const int color_types[] = {
+    PNG_COLOR_TYPE_GRAY, PNG_COLOR_TYPE_GRAY_ALPHA,
+    PNG_COLOR_TYPE_RGB, PNG_COLOR_TYPE_RGB_ALPHA};
+
+  const unsigned channels = image.get_channels();
+  if (channels < 1 || channels > 4) return false;
+
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  if (file == nullptr) return false;
+
+  png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING,
+                                            nullptr, nullptr, nullptr);
+  png_infop info = png == nullptr? nullptr: png_create_info_struct(png);
+  if (info == nullptr || setjmp(png_jmpbuf(png))) {
+    png_destroy_write_struct(&png, &info);
+    std::fclose(file);
+    return false;
+  }
+
+  const Image::Region& region = image.get_region();
+  const PixelBuffer& buffer = image.get_buffer();
+
+  png_init_io(png, file);
+  png_set_compression_level(png, level);
+  png_set_IHDR(png, info, region.width, region.height, 8,
+               color_types[channels - 1], PNG_INTERLACE_NONE,
+               PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  png_write_info(png, info);
+
+  for (unsigned y=0; y < region.height; y++)
+    png_write_row(png, buffer.get_row(y));
+
+  png_write_end(png, nullptr);
+  png_destroy_write_struct(&png, &info);
+
+  return std::fclose(file) == 0;
+}
+
+static std::vector<bench_stage>
+_bench_stages(const std::string& tmp_png)
+{
+  const Image::Region& placement = SignedData::DEFAULT_PLACEMENT;
+
+  return {
+    {"decode", [](const bench_file& file, bench_sample& sample) {
+      const Image image(_bench_path(file.path));
+      sample.pixels = _bench_pixels(image);
+    }, {}},
+    {"decode_roi", [&placement](const bench_file& file,
+                                bench_sample& sample) {
+      const Image image(_bench_path(file.path), placement);
+      sample.pixels = _bench_pixels(image);
+    }, {}},
+    {"decode_verify", [](const bench_file& file, bench_sample& sample) {
+      const std::unique_ptr<Image> image
+        = Image::open_for_verify(_bench_path(file.path)).value();
+      sample.pixels = (std::size_t) file.size.width * file.size.height;
+      sample.is_success = image->estimate_qr_module() > 0.0f;
+    }, {}},
+    {"detect", [](const bench_file& file, bench_sample& sample) {
+      const Image image(_bench_path(file.path));
+      sample.pixels = _bench_pixels(image);
+      sample.ms = _bench_ms([&image, &sample]() {
+        sample.is_success = image.estimate_qr_module() > 0.0f;
+      });
+    }, {}},
+    {"compose", [&placement](const bench_file& file,
+                             bench_sample& sample) {
+      Image image(_bench_path(file.path));
+      const std::shared_ptr<const Image> qr
+        = Image::render_qr(BENCH_PAYLOAD);
+      sample.pixels = _bench_pixels(*qr);
+      sample.ms = _bench_ms([&image, &qr, &placement]() {
+        image.compose(*qr, placement);
+      });
+    }, {}},
+    {"encode_png_fast", [tmp_png](const bench_file& file,
+                                  bench_sample& sample) {
+      const Image image(_bench_path(file.path));
+      sample.pixels = _bench_pixels(image);
+      sample.bytes = _bench_bytes(image);
+      sample.ms = _bench_ms([&image, &tmp_png]() {
+        image.save_png(_bench_path(tmp_png), Image::PNG_FAST);
+      });
+    }, {}},
+    {"encode_png", [tmp_png](const bench_file& file,
+                             bench_sample& sample) {
+      const Image image(_bench_path(file.path));
+      sample.pixels = _bench_pixels(image);
+      sample.bytes = _bench_bytes(image);
+      sample.ms = _bench_ms([&image, &tmp_png]() {
+        image.save_png(_bench_path(tmp_png), Image::PNG_DEFAULT);
+      });
+    }, {}},
+    {"encode_png_libpng", [tmp_png](const bench_file& file,
+                                    bench_sample& sample) {
+      const Image image(_bench_path(file.path));
+      sample.pixels = _bench_pixels(image);
+      sample.bytes = _bench_bytes(image);
+      sample.ms = _bench_ms([&image, &tmp_png, &sample]() {
+        sample.is_success = _bench_write_png_libpng(
+          tmp_png, image, Image::PNG_DEFAULT.level);
+      });
+    }, {}},
+  };
+}
+
+} /* namespace socialmedia_signer  */
+
+/* ***************************************************************  */
+
+using namespace socialmedia_signer;
+
+static const char*
+_bench_arg(const char* arg, const char* name)
+{
+  const std::size_t len = std::strlen(name);
+  return std::strncmp(arg, name, len) == 0 && arg[len] == '='
+    ? arg + len + 1: nullptr;
+}
+
+int
+main(int argc, const char** argv)
+{
+  std::string corpus_dir = "corpus";
+  const char* output = nullptr;
+  const char* suite = "all";
+  unsigned max_side = 7680;
+  unsigned repeat = 1;
+
+  for (int i=1; i < argc; i++) {
+    const char* value;
+
+    if ((value = _bench_arg(argv[i], "--corpus")) != nullptr) {
+      corpus_dir = value;
+    } else if ((value = _bench_arg(argv[i], "--output")) != nullptr) {
+      output = value;
+    } else if ((value = _bench_arg(argv[i], "--suite")) != nullptr
+               && (std::strcmp(value, "all") == 0
+                   || std::strcmp(value, "image") == 0
+                   || std::strcmp(value, "ustr") == 0
+                   || std::strcmp(value, "ucase") == 0
+                   || std::strcmp(value, "alloc") == 0
+                   || std::strcmp(value, "result") == 0
+                   || std::strcmp(value, "log") == 0)) {
+      suite = value;
+    } else if ((value = _bench_arg(argv[i], "--max-side")) != nullptr) {
+      max_side = std::strtoul(value, nullptr, 10);
+    } else if ((value = _bench_arg(argv[i], "--repeat")) != nullptr) {
+      repeat = std::max(1ul, std::strtoul(value, nullptr, 10));
+    } else {
+      std::fprintf(stderr, "usage: %s [--corpus=<dir>] [--output=<file>]"
+                   " [--suite=all|image|ustr|ucase|alloc|result|log]"
+                   " [--max-side=<pixels>] [--repeat=<count>]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  const bool is_all = std::strcmp(suite, "all") == 0;
+  const bool is_image = is_all || std::strcmp(suite, "image") == 0;
+  const bool is_ustr = is_all || std::strcmp(suite, "ustr") == 0;
+  const bool is_ucase = is_all || std::strcmp(suite, "ucase") == 0;
+  const bool is_alloc = is_all || std::strcmp(suite, "alloc") == 0;
+  const bool is_result = is_all || std::strcmp(suite, "result") == 0;
+  const bool is_log = is_all || std::strcmp(suite, "log") == 0;
+
+  std::FILE* out = output != nullptr? std::fopen(output, "w"): stdout;
+  if (out == nullptr) {
+    std::fprintf(stderr, "could not open '%s'\n", output);
+    return EXIT_FAILURE;
+  }
+  std::fprintf(out, "{\n");
+
+  Platforms::init();
+  Crypto::init();
+  BufferPool::init();
+  QrCache::init();
+
+  if (is_image) {
+    const auto corpus_start = std::chrono::steady_clock::now();
+    const std::vector<bench_file> corpus
+      = _bench_corpus(corpus_dir, max_side);
+    const double corpus_ms = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - corpus_start).count();
+
+    const std::string tmp_png = corpus_dir + "/.encode.png";
+    std::vector<bench_stage> stages = _bench_stages(tmp_png);
+
+    for (bench_stage& stage: stages) {
+      for (unsigned r=0; r < repeat; r++) {
+        for (const bench_file& file: corpus) {
+          bench_sample sample = {&file, -1.0, 0, 0, true};
+
+          const double ms = _bench_ms([&stage, &file, &sample]() {
+            try {
+              stage.run(file, sample);
+            } catch (Error& e) {
+              Log::warn(e.uwhat());
+              sample.is_success = false;
+            }
+          });
+          if (sample.ms < 0.0) sample.ms = ms;
+
+          stage.samples.push_back(sample);
+        }
+      }
+    }
+    std::remove(tmp_png.c_str());
+
+    _bench_print(out, stages, corpus.size(), corpus_ms, repeat);
+  }
+
+  if (is_ustr) {
+    if (is_image) std::fprintf(out, ",\n");
+    bench_ustr(out, repeat);
+  }
+
+  if (is_ucase) {
+    if (is_image || is_ustr) std::fprintf(out, ",\n");
+    bench_ucase(out, repeat);
+  }
+
+  if (is_alloc) {
+    if (is_image || is_ustr || is_ucase) std::fprintf(out, ",\n");
+    bench_alloc(out);
+  }
+
+  if (is_result) {
+    if (is_image || is_ustr || is_ucase || is_alloc)
+      std::fprintf(out, ",\n");
+    ::mkdir(corpus_dir.c_str(), 0755);
+    bench_result(out, corpus_dir, repeat);
+  }
+
+  if (is_log) {
+    if (is_image || is_ustr || is_ucase || is_alloc || is_result)
+      std::fprintf(out, ",\n");
+    bench_log(out, repeat);
+  }
+
+  QrCache::release();
+  BufferPool::release();
+  Crypto::release();
+  Platforms::release();
+  Ident::release();
+
+  std::fprintf(out, "\n}\n");
+  if (out != stdout) std::fclose(out);
+
+  return EXIT_SUCCESS;
+}
+
+/* ***************************************************************  */
@@ -0,0 +1,72 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef BENCH_HPP__
+#define BENCH_HPP__
+
+#include <string>
+#include <cstdio>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/**
+ * Transcoding benchmark of ustr, compares socialmedia_signer::Utf8
+ * against std::codecvt on ASCII, Latin, CJK and emoji text.  Prints
+ * the members of its JSON object to `out`.
+ */
+void bench_ustr(std::FILE* out, unsigned repeat);
+
+/**
+ * Case mapping benchmark of ustr, compares socialmedia_signer::Ucase
+ * against `std::tolower()` per character on ASCII, Latin, Greek and
+ * Cyrillic, CJK and mixed text.  Prints the members of its JSON
+ * object to `out`.
+ */
+void bench_ucase(std::FILE* out, unsigned repeat);
+
+/**
+ * Counts the heap allocations of the help, sign and verify paths of
+ * App, replacing the global `operator new` of the benchmark.  Prints
+ * the members of its JSON object to `out`.
+ */
+void bench_alloc(std::FILE* out);
+
+/**
+ * Opens a workload of which 50% of the files are invalid for
+ * verification, once handling the failures as thrown Error and once
+ * as returned socialmedia_signer::Failure.  The files are written to
+ * `corpus_dir`.  Prints the members of its JSON object to `out`.
+ */
+void bench_result(std::FILE* out, const std::string& corpus_dir,
+                  unsigned repeat);
+
+/**
+ * Counts the lines lost by the asynchronous Log, while many short
+ * lived threads log a few lines each and exit.  STDOUT is redirected
+ * to a temporary file meanwhile.  Prints the members of its JSON
+ * object to `out`.
+ */
+void bench_log(std::FILE* out, unsigned repeat);
+
+}
+
+/* ***************************************************************  */
+
+#endif /* BENCH_HPP__  */
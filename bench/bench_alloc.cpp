@@ -0,0 +1,212 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "bench.hpp"
+
+#include "../src/App.hpp"
+#include "../src/Params.hpp"
+#include "../src/Platforms.hpp"
+
+#include <malloc.h>
+
+#include <streambuf>
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/** Runs per path, the first one warms up QrCache etc. and is skipped.  */
+static constexpr unsigned BENCH_ALLOC_RUNS = 100;
+
+/** Report lines of a bulk verification, kept as ustr and as ustr8.  */
+static constexpr unsigned BENCH_ALLOC_RECORDS = 10000;
+
+static std::atomic<std::size_t> _bench_allocs {0};
+static std::atomic<std::size_t> _bench_alloc_bytes {0};
+
+/** Swallows Log output of the benchmarked paths.  */
+class bench_null_buf: public std::streambuf
+{
+protected:
+  virtual int_type overflow(int_type ch) override { return ch; }
+};
+
+struct bench_alloc_path {
+  const char* name;
+  std::vector<const char*> argv;
+};
+
+static const bench_alloc_path _bench_alloc_paths[] = {
+  {"help",   {"socialmedia-signer", "--help"}},
+  {"sign",   {"socialmedia-signer", "--sign=xcom", "-m",
+              "💗 😀 Hello World! 😀 💗"}},
+  {"verify", {"socialmedia-signer",
+              "--verify=https://example.org/@signer/112233"}},
+};
+
+/**
+ * Parses the command-line and runs the App as main() does, but
+ * without Log output.  Returns if an Error was thrown.
+ */
+static bool
+_bench_alloc_run(const bench_alloc_path& path)
+{
+  bool is_error = false;
+  App* app = nullptr;
+
+  try {
+    Params::init(static_cast<int>(path.argv.size()),
+                 const_cast<const char**>(path.argv.data()));
+
+    app = new App();
+    app->run();
+  } catch (Success&) {
+  } catch (Error&) {
+    is_error = true;
+  }
+
+  delete app;
+  Params::release();
+
+  return is_error;
+}
+
+/**
+ * Heap bytes kept by BENCH_ALLOC_RECORDS lines of `--archive` output
+ * stored as STR, every 8th file name is not ASCII.  Counts all heap
+ * blocks in use, with the index of ustr8 and the vector included.
+ */
+template<typename STR> static std::size_t
+_bench_alloc_records()
+{
+  const std::size_t live = ::mallinfo2().uordblks;
+
+  std::vector<STR> records;
+  records.reserve(BENCH_ALLOC_RECORDS);
+
+  for (unsigned i=0; i < BENCH_ALLOC_RECORDS; i++) {
+    records.emplace_back(STR::format(
+      "QR\t/archive/{}/post-{:05}{}.jpg\t"
+      "QR code, module {:.1f} px at 1/{}",
+      2020 + i % 5, i, i % 8 == 0? "-grüße-💗": "", 4.0f + i % 3,
+      1 << i % 4));
+  }
+
+  return ::mallinfo2().uordblks - live;
+}
+
+/** Allocations of BENCH_ALLOC_RUNS platform lookups by `id`.  */
+template<typename ID> static std::size_t
+_bench_alloc_lookup(const ID& id)
+{
+  const Platforms* platforms = Platforms::get();
+
+  const std::size_t allocs = _bench_allocs.load();
+  for (unsigned r=0; r < BENCH_ALLOC_RUNS; r++) {
+    if (platforms->get_by_id(id) == nullptr)
+      Log::fatal(u8"bench: platform not found!");
+  }
+
+  return _bench_allocs.load() - allocs;
+}
+
+} /* namespace socialmedia_signer  */
+
+/* ***************************************************************  */
+
+void*
+operator new(std::size_t size)
+{
+  socialmedia_signer::_bench_allocs.fetch_add(1, std::memory_order_relaxed);
+  socialmedia_signer::_bench_alloc_bytes.fetch_add(
+    size, std::memory_order_relaxed);
+
+  void* result = std::malloc(size != 0? size: 1);
+  if (result == nullptr) throw std::bad_alloc();
+
+  return result;
+}
+
+void
+operator delete(void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void
+operator delete(void* ptr, [[maybe_unused]] std::size_t size) noexcept
+{
+  std::free(ptr);
+}
+
+/* ***************************************************************  */
+
+void
+socialmedia_signer::bench_alloc(std::FILE* out)
+{
+  bench_null_buf null_buf;
+  std::streambuf* cout_buf = std::cout.rdbuf(&null_buf);
+
+  std::fprintf(out, "  \"alloc\": {");
+
+  bool is_first = true;
+  for (const bench_alloc_path& path: _bench_alloc_paths) {
+    _bench_alloc_run(path);
+
+    const std::size_t allocs = _bench_allocs.load();
+    const std::size_t bytes = _bench_alloc_bytes.load();
+    bool is_error = false;
+    for (unsigned r=1; r < BENCH_ALLOC_RUNS; r++)
+      is_error = _bench_alloc_run(path);
+
+    const unsigned runs = BENCH_ALLOC_RUNS - 1;
+    std::fprintf(out, "%s\n    \"%s\": {\"runs\": %u, \"error\": %s,"
+                 " \"allocs_per_run\": %.1f, \"bytes_per_run\": %.1f}",
+                 is_first? "": ",", path.name, runs,
+                 is_error? "true": "false",
+                 (double) (_bench_allocs.load() - allocs) / runs,
+                 (double) (_bench_alloc_bytes.load() - bytes) / runs);
+
+    is_first = false;
+  }
+
+  const std::size_t bytes_ustr = _bench_alloc_records<ustr>();
+  const std::size_t bytes_ustr8 = _bench_alloc_records<ustr8>();
+  std::fprintf(out, ",\n    \"archive_records\": {\"records\": %u,"
+               " \"ustr_bytes\": %zu, \"ustr8_bytes\": %zu,"
+               " \"ratio\": %.2f}",
+               BENCH_ALLOC_RECORDS, bytes_ustr, bytes_ustr8,
+               (double) bytes_ustr / bytes_ustr8);
+
+  const ustr id_ustr = u8"xcom";
+  const ustr8 id_ustr8 = u8"xcom";
+  std::fprintf(out, ",\n    \"lookup\": {\"runs\": %u,"
+               " \"literal_allocs\": %zu, \"ustr_allocs\": %zu,"
+               " \"ustr8_allocs\": %zu}", BENCH_ALLOC_RUNS,
+               _bench_alloc_lookup(U"xcom"),
+               _bench_alloc_lookup(id_ustr),
+               _bench_alloc_lookup(id_ustr8));
+
+  std::fprintf(out, "\n  }");
+  std::cout.rdbuf(cout_buf);
+}
@@ -0,0 +1,117 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "bench.hpp"
+
+#include "../src/Log.hpp"
+#include "../src/ustr8.hpp"
+
+#include <unistd.h>
+
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/** Threads per round, each logs a few lines and exits at once.  */
+static constexpr unsigned BENCH_LOG_THREADS = 16;
+static constexpr unsigned BENCH_LOG_LINES = 4;
+
+/** Rounds per `--repeat`, each with its own Log::init().  */
+static constexpr unsigned BENCH_LOG_ROUNDS = 500;
+
+/** Newlines written to `fd` from its start.  */
+static std::size_t
+_bench_log_count(int fd)
+{
+  std::size_t result = 0;
+  char buffer[4096];
+
+  ssize_t length;
+  for (off_t offset = 0;
+       (length = ::pread(fd, buffer, sizeof(buffer), offset)) > 0;
+       offset += length) {
+    for (ssize_t i=0; i < length; i++) result += buffer[i] == '\n';
+  }
+
+  return result;
+}
+
+/**
+ * BENCH_LOG_THREADS threads are started, log BENCH_LOG_LINES lines
+ * each and exit while the background thread of Log drains their
+ * rings.
+ */
+static void
+_bench_log_round()
+{
+  Log::init();
+
+  std::vector<std::thread> threads;
+  for (unsigned t=0; t < BENCH_LOG_THREADS; t++) {
+    threads.emplace_back([t]() {
+      /* Yields, so the rings are drained between the lines.  */
+      for (unsigned l=0; l < BENCH_LOG_LINES; l++) {
+        Log::println(ustr8::format("thread {} line {}", t, l));
+        std::this_thread::yield();
+      }
+    });
+  }
+  for (std::thread& thread: threads) thread.join();
+
+  Log::release();
+}
+
+} /* namespace socialmedia_signer  */
+
+/* ***************************************************************  */
+
+void
+socialmedia_signer::bench_log(std::FILE* out, unsigned repeat)
+{
+  const unsigned rounds = BENCH_LOG_ROUNDS * repeat;
+
+  std::FILE* tmp = std::tmpfile();
+  if (tmp == nullptr) Log::fatal(u8"bench: could not create tmpfile!");
+
+  std::fflush(stdout);
+  const int stdout_fd = ::dup(STDOUT_FILENO);
+  ::dup2(::fileno(tmp), STDOUT_FILENO);
+
+  const auto start = std::chrono::steady_clock::now();
+  for (unsigned r=0; r < rounds; r++) _bench_log_round();
+  const double ms = std::chrono::duration<double, std::milli>(
+    std::chrono::steady_clock::now() - start).count();
+
+  ::dup2(stdout_fd, STDOUT_FILENO);
+  ::close(stdout_fd);
+
+  const std::size_t lines
+    = (std::size_t) rounds * BENCH_LOG_THREADS * BENCH_LOG_LINES;
+  const std::size_t written = _bench_log_count(::fileno(tmp));
+  std::fclose(tmp);
+
+  std::fprintf(out, "  \"log\": {\"rounds\": %u, \"threads\": %u,"
+               " \"lines\": %zu, \"lost\": %zu, \"ms_per_round\": %.3f}",
+               rounds, BENCH_LOG_THREADS, lines, lines - written,
+               ms / rounds);
+}
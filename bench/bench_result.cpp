@@ -0,0 +1,224 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "bench.hpp"
+
+#include "../src/Image.hpp"
+
+#include <sys/stat.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <cstring>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/** Files of the workload, every second one is invalid.  */
+static constexpr unsigned BENCH_RESULT_FILES = 64;
+
+/** Runs per measurement and `--repeat`, the fastest one counts.  */
+static constexpr unsigned BENCH_RESULT_RUNS = 5;
+
+/**
+ * Kinds of invalid files, like they are found in archives: missing,
+ * empty, text and truncated PNG.
+ */
+static constexpr unsigned BENCH_RESULT_INVALID_KINDS = 4;
+
+struct bench_result_count {
+  unsigned valid;
+  unsigned invalid;
+  /** Bytes of all failure reasons, so they are not optimized out.  */
+  std::size_t reason_bytes;
+};
+
+static void
+_bench_result_write(const std::string& path, const std::string& data)
+{
+  std::ofstream(path, std::ios::binary | std::ios::trunc) << data;
+}
+
+static std::string
+_bench_result_read(const std::string& path)
+{
+  std::ifstream file(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+}
+
+/**
+ * Writes the workload into `dir` and returns its file names, the
+ * valid ones are PNGs with a rendered QR code.
+ */
+static std::vector<std::string>
+_bench_result_corpus(const std::string& dir)
+{
+  ::mkdir(dir.c_str(), 0755);
+
+  std::vector<std::string> result;
+  for (unsigned i=0; i < BENCH_RESULT_FILES; i++) {
+    const std::string path = dir + "/" + std::to_string(i);
+
+    if (i % 2 == 0) {
+      const std::u8string payload = reinterpret_cast<const char8_t*>(
+        ("https://example.org/@signer/" + std::to_string(i)).c_str());
+      Image::render_qr(payload)->save_png(
+        reinterpret_cast<const char8_t*>((path + ".png").c_str()),
+        Image::PNG_FAST);
+      result.push_back(path + ".png");
+      continue;
+    }
+
+    const std::string valid = dir + "/" + std::to_string(i - 1) + ".png";
+    switch (i / 2 % BENCH_RESULT_INVALID_KINDS) {
+    case 0:
+      result.push_back(path + ".missing.png");
+      break;
+    case 1:
+      _bench_result_write(path + ".txt.png", "not an image\n");
+      result.push_back(path + ".txt.png");
+      break;
+    case 2:
+      _bench_result_write(path + ".truncated.png",
+                          _bench_result_read(valid).substr(0, 128));
+      result.push_back(path + ".truncated.png");
+      break;
+    default:
+      _bench_result_write(path + ".empty.jpg", "");
+      result.push_back(path + ".empty.jpg");
+      break;
+    }
+  }
+
+  return result;
+}
+
+/** Former path, every invalid file throws an Error.  */
+static bench_result_count
+_bench_result_exception(const std::vector<ustr>& files)
+{
+  bench_result_count result = {0, 0, 0};
+
+  for (const ustr& file: files) {
+    try {
+      const std::unique_ptr<Image> image
+        = Image::open_for_verify(file).value();
+      result.valid++;
+    } catch (Error& e) {
+      result.invalid++;
+      result.reason_bytes += std::strlen(e.what());
+    }
+  }
+
+  return result;
+}
+
+/** Exception-free path of ArchiveScanner::scan().  */
+static bench_result_count
+_bench_result_result(const std::vector<ustr>& files)
+{
+  bench_result_count result = {0, 0, 0};
+
+  for (const ustr& file: files) {
+    const Result<std::unique_ptr<Image>> image
+      = Image::open_for_verify(file);
+
+    if (image) {
+      result.valid++;
+    } else {
+      result.invalid++;
+      result.reason_bytes += image.error().get_reason().size_bytes();
+    }
+  }
+
+  return result;
+}
+
+template<typename F>
+static double
+_bench_result_ms(unsigned repeat, bench_result_count& count, F&& function)
+{
+  double best = 0.0;
+
+  for (unsigned r=0; r < BENCH_RESULT_RUNS * repeat; r++) {
+    const auto start = std::chrono::steady_clock::now();
+    count = function();
+    const double ms = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+
+    if (r == 0 || ms < best) best = ms;
+  }
+
+  return best;
+}
+
+/** Measures both paths on `files` and prints them as `key`.  */
+static void
+_bench_result_run(std::FILE* out, const char* key,
+                  const std::vector<ustr>& files, unsigned repeat)
+{
+  bench_result_count count = {0, 0, 0};
+  const double exception_ms = _bench_result_ms(repeat, count, [&]() {
+    return _bench_result_exception(files);
+  });
+  const double result_ms = _bench_result_ms(repeat, count, [&]() {
+    return _bench_result_result(files);
+  });
+
+  std::fprintf(out, "\n    \"%s\": {\"files\": %zu, \"valid\": %u,"
+               " \"invalid\": %u,\n      \"files_s\": {\"exception\":"
+               " %.1f, \"result\": %.1f, \"speedup\": %.2f}}", key,
+               files.size(), count.valid, count.invalid,
+               files.size() / exception_ms * 1000.0,
+               files.size() / result_ms * 1000.0,
+               exception_ms / result_ms);
+}
+
+} /* namespace socialmedia_signer  */
+
+/* ***************************************************************  */
+
+void
+socialmedia_signer::bench_result(std::FILE* out,
+  const std::string& corpus_dir, unsigned repeat)
+{
+  const std::vector<std::string> paths
+    = _bench_result_corpus(corpus_dir + "/result");
+
+  std::vector<ustr> mixed, invalid;
+  for (std::size_t i=0; i < paths.size(); i++) {
+    const ustr file = reinterpret_cast<const char8_t*>(paths[i].c_str());
+
+    mixed.push_back(file);
+    if (i % 2 != 0) invalid.push_back(file);
+  }
+
+  std::fprintf(out, "  \"result\": {");
+  _bench_result_run(out, "mixed_50", mixed, repeat);
+  std::fprintf(out, ",");
+  _bench_result_run(out, "invalid", invalid, repeat);
+  std::fprintf(out, "\n  }");
+}
+
+/* ***************************************************************  */
@@ -0,0 +1,151 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "bench.hpp"
+
+#include "../src/Ucase.hpp"
+#include "../src/Utf8.hpp"
+#include "../src/ustr.hpp"
+
+#include <string>
+#include <chrono>
+#include <cwctype>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/** Code points of each text, repeated from its sample.  */
+static constexpr std::size_t BENCH_UCASE_LENGTH = 1 << 20;
+
+/** Runs per measurement and `--repeat`, the fastest one counts.  */
+static constexpr unsigned BENCH_UCASE_RUNS = 5;
+
+struct bench_ucase_text {
+  const char* name;
+  const char8_t* sample;
+};
+
+static const bench_ucase_text _bench_ucase_texts[] = {
+  {"ascii",    u8"The Quick Brown Fox Jumps Over The Lazy Dog, "
+               u8"Signed With HTTPS://Example.ORG/@Signer/112233. "},
+  {"latin",    u8"Zwölf Boxkämpfer Jagen Viktor Quer Über Den Großen "
+               u8"Sylter Deich, FAÇADE, Naïve, SEÑOR. "},
+  {"greek_cyrillic", u8"Ξεσκεπάζω Την Ψυχοφθόρα Βδελυγμία. "
+                     u8"Съешь Же Ещё Этих Мягких Французских Булок. "},
+  {"cjk",      u8"社交媒体签名者对帖子进行签名并验证其他帖子。"
+               u8"ソーシャルメディアの投稿に署名する。"},
+  {"mixed",    u8"Post VERIFIED ✅ Пост Подписан, 帖子已签名, "
+               u8"Ψηφιακή Υπογραφή, Grüße 💗 "},
+};
+
+template<typename F>
+static double
+_bench_ucase_ms(unsigned repeat, F&& function)
+{
+  double best = 0.0;
+
+  for (unsigned r=0; r < BENCH_UCASE_RUNS * repeat; r++) {
+    const auto start = std::chrono::steady_clock::now();
+    function();
+    const double ms = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+
+    if (r == 0 || ms < best) best = ms;
+  }
+
+  return best;
+}
+
+static void
+_bench_ucase_print(std::FILE* out, const char* key, std::size_t length,
+                   double ctype_ms, double ucase_ms)
+{
+  std::fprintf(out, ",\n        \"%s_mcp_s\": {\"ctype\": %.1f,"
+               " \"ucase\": %.1f, \"speedup\": %.2f}", key,
+               length / ctype_ms / 1000.0, length / ucase_ms / 1000.0,
+               ctype_ms / ucase_ms);
+}
+
+} /* namespace socialmedia_signer  */
+
+/* ***************************************************************  */
+
+void
+socialmedia_signer::bench_ucase(std::FILE* out, unsigned repeat)
+{
+  std::fprintf(out, "  \"ucase\": {\n    \"unicode\": \"%s\","
+               " \"simd\": \"%s\",\n    \"texts\": {",
+               Ucase::get_unicode_version(), Utf8::get_simd());
+
+  bool is_first = true;
+  for (const bench_ucase_text& text: _bench_ucase_texts) {
+    const ustr sample = text.sample;
+
+    ustr source;
+    while (source.length() + sample.length() <= BENCH_UCASE_LENGTH)
+      source += sample;
+
+    /* The former ustr::tolower(), which is right for ASCII only.  */
+    ustr ctype;
+    const double ctype_lower = _bench_ucase_ms(repeat, [&]() {
+      ctype = source;
+      for (char32_t& ch: ctype) ch = std::tolower(ch);
+    });
+    const double ctype_upper = _bench_ucase_ms(repeat, [&]() {
+      ctype = source;
+      for (char32_t& ch: ctype) ch = std::toupper(ch);
+    });
+
+    ustr ucase;
+    const double ucase_lower = _bench_ucase_ms(repeat, [&]() {
+      ucase = source;
+      ucase.tolower();
+    });
+    const double ucase_upper = _bench_ucase_ms(repeat, [&]() {
+      ucase = source;
+      ucase.toupper();
+    });
+    const double ucase_fold = _bench_ucase_ms(repeat, [&]() {
+      ucase = source;
+      ucase.casefold();
+    });
+
+    /* Folding an upper cased text gives the folded text again.  */
+    ustr folded = source;
+    folded.casefold();
+    ustr upper_folded = source;
+    upper_folded.toupper();
+    upper_folded.casefold();
+
+    std::fprintf(out, "%s\n      \"%s\": {\n        \"code_points\": %zu,"
+                 " \"fold_stable\": %s", is_first? "": ",", text.name,
+                 source.length(), folded == upper_folded? "true": "false");
+    _bench_ucase_print(out, "lower", source.length(), ctype_lower,
+                       ucase_lower);
+    _bench_ucase_print(out, "upper", source.length(), ctype_upper,
+                       ucase_upper);
+    std::fprintf(out, ",\n        \"fold_mcp_s\": %.1f",
+                 source.length() / ucase_fold / 1000.0);
+    std::fprintf(out, "\n      }");
+
+    is_first = false;
+  }
+
+  std::fprintf(out, "\n    }\n  }");
+}
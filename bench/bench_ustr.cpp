@@ -0,0 +1,160 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "bench.hpp"
+
+#include "../src/Utf8.hpp"
+#include "../src/ustr.hpp"
+
+#include <locale>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <cwchar>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/** Size of each text, repeated from its sample.  */
+static constexpr std::size_t BENCH_USTR_BYTES = 4 << 20;
+
+/** Runs per measurement and `--repeat`, the fastest one counts.  */
+static constexpr unsigned BENCH_USTR_RUNS = 5;
+
+struct bench_text {
+  const char* name;
+  const char8_t* sample;
+};
+
+static const bench_text _bench_texts[] = {
+  {"ascii", u8"The quick brown fox jumps over the lazy dog, "
+            u8"signed with https://example.org/@signer/112233. "},
+  {"latin", u8"Zwölf Boxkämpfer jagen Viktor quer über den großen "
+            u8"Sylter Deich, façade, naïve, señor. "},
+  {"cjk",   u8"社交媒体签名者对帖子进行签名并验证其他帖子。"
+            u8"ソーシャルメディアの投稿に署名する。"},
+  {"emoji", u8"💗 😀 Hello World! 😀 💗 🔏✅📷🧾 "},
+};
+
+using bench_ustr_cvt = std::codecvt<char32_t, char8_t, std::mbstate_t>;
+
+template<typename F>
+static double
+_bench_ustr_ms(unsigned repeat, F&& function)
+{
+  double best = 0.0;
+
+  for (unsigned r=0; r < BENCH_USTR_RUNS * repeat; r++) {
+    const auto start = std::chrono::steady_clock::now();
+    function();
+    const double ms = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+
+    if (r == 0 || ms < best) best = ms;
+  }
+
+  return best;
+}
+
+static void
+_bench_ustr_print(std::FILE* out, const char* key, std::size_t bytes,
+                  double codecvt_ms, double ustr_ms)
+{
+  std::fprintf(out, ",\n        \"%s_mb_s\": {\"codecvt\": %.1f,"
+               " \"ustr\": %.1f, \"speedup\": %.2f}", key,
+               bytes / codecvt_ms / 1000.0, bytes / ustr_ms / 1000.0,
+               codecvt_ms / ustr_ms);
+}
+
+} /* namespace socialmedia_signer  */
+
+/* ***************************************************************  */
+
+void
+socialmedia_signer::bench_ustr(std::FILE* out, unsigned repeat)
+{
+  /* The UTF-8 <-> UTF-32 facet is part of every locale.  */
+  const bench_ustr_cvt& cvt
+    = std::use_facet<bench_ustr_cvt>(std::locale::classic());
+
+  std::fprintf(out, "  \"ustr\": {\n    \"simd\": \"%s\",\n"
+               "    \"texts\": {", Utf8::get_simd());
+
+  bool is_first = true;
+  for (const bench_text& text: _bench_texts) {
+    const std::u8string sample = text.sample;
+
+    std::u8string utf8;
+    while (utf8.length() + sample.length() <= BENCH_USTR_BYTES)
+      utf8 += sample;
+
+    ustr utf32;
+    std::u8string encoded;
+    std::u32string cvt_utf32;
+    std::u8string cvt_encoded;
+
+    const double codecvt_in
+      = _bench_ustr_ms(repeat, [&cvt, &utf8, &cvt_utf32]() {
+        std::mbstate_t mb {};
+        const char8_t* in_next;
+        char32_t* out_next;
+
+        cvt_utf32.resize(utf8.length());
+        cvt.in(mb, utf8.data(), utf8.data() + utf8.length(), in_next,
+               cvt_utf32.data(), cvt_utf32.data() + cvt_utf32.length(),
+               out_next);
+        cvt_utf32.resize(out_next - cvt_utf32.data());
+      });
+    const double ustr_in = _bench_ustr_ms(repeat, [&utf8, &utf32]() {
+      utf32.in_utf8(utf8);
+    });
+
+    const double codecvt_out
+      = _bench_ustr_ms(repeat, [&cvt, &cvt_utf32, &cvt_encoded]() {
+        std::mbstate_t mb {};
+        const char32_t* in_next;
+        char8_t* out_next;
+
+        cvt_encoded.resize(cvt_utf32.length() * cvt.max_length());
+        cvt.out(mb, cvt_utf32.data(),
+                cvt_utf32.data() + cvt_utf32.length(), in_next,
+                cvt_encoded.data(),
+                cvt_encoded.data() + cvt_encoded.length(), out_next);
+        cvt_encoded.resize(out_next - cvt_encoded.data());
+      });
+    const double ustr_out = _bench_ustr_ms(repeat, [&utf32, &encoded]() {
+      utf32.out_utf8(encoded);
+    });
+
+    std::fprintf(out, "%s\n      \"%s\": {\n        \"bytes\": %zu,"
+                 " \"code_points\": %zu, \"matches_codecvt\": %s",
+                 is_first? "": ",", text.name, utf8.length(),
+                 utf32.length(),
+                 utf32 == cvt_utf32 && encoded == utf8
+                 && cvt_encoded == utf8? "true": "false");
+    _bench_ustr_print(out, "decode", utf8.length(), codecvt_in, ustr_in);
+    _bench_ustr_print(out, "encode", utf8.length(), codecvt_out,
+                      ustr_out);
+    std::fprintf(out, "\n      }");
+
+    is_first = false;
+  }
+
+  std::fprintf(out, "\n    }\n  }");
+}
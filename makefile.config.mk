@@ -53,6 +53,13 @@ CONFIG_VERSION                   := 0.1.0-dev
 # Possible values: [1, 0], default: 1
 CONFIG_GUI                       := 0
 
+# Back large pixel buffers by huge pages (MAP_HUGETLB)?  Needs
+# reserved huge pages, i.e. `$> sysctl vm.nr_hugepages=64`, otherwise
+# regular pages are used.
+#
+# Possible values: [1, 0], default: 0
+CONFIG_HUGETLB                   := 0
+
 # ********************************************************************
 # To check which libraries will be loaded dynamically during runtime,
 # after `$> make -j`, try:
@@ -64,6 +71,11 @@ CONFIG_GUI                       := 0
 # Possible values: [1, 0], default: 0
 CONFIG_STATIC_CRYPTO             := 0
 
+# Link LIBJPEG, LIBPNG and ZLIB static into executable.
+#
+# Possible values: [1, 0], default: 0
+CONFIG_STATIC_IMAGE              := 0
+
 # Link LIBSTDC++ static into executable.
 #
 # Possible values: [1, 0], default: 1
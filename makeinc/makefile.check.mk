@@ -92,6 +92,60 @@ else
   $(shell echo 'LIBSSL = $(LIBSSL)' >> $(MAKE_CACHEFILE))
 endif
 
+HEADERJPEG := $(call _HEADER_TEST,jpeglib.h)
+ifeq (,$(HEADERJPEG))
+  $(shell rm -f $(MAKE_CACHEFILE))
+  $(call _CMD_TEST_RESNO_ERR,libjpeg62-turbo-dev,jpeglib.h)
+else
+  $(call _CMD_TEST_RESULT,$(HEADERJPEG))
+  $(shell echo 'HEADERJPEG = $(HEADERJPEG)' >> $(MAKE_CACHEFILE))
+endif
+
+LIBJPEG := $(call _LIB_TEST,jpeg)
+ifeq (,$(LIBJPEG))
+  $(shell rm -f $(MAKE_CACHEFILE))
+  $(call _CMD_TEST_RESNO_ERR,libjpeg62-turbo,LIBJPEG library)
+else
+  $(call _CMD_TEST_RESULT,$(LIBJPEG))
+  $(shell echo 'LIBJPEG = $(LIBJPEG)' >> $(MAKE_CACHEFILE))
+endif
+
+HEADERPNG := $(call _HEADER_TEST,png.h)
+ifeq (,$(HEADERPNG))
+  $(shell rm -f $(MAKE_CACHEFILE))
+  $(call _CMD_TEST_RESNO_ERR,libpng-dev,png.h)
+else
+  $(call _CMD_TEST_RESULT,$(HEADERPNG))
+  $(shell echo 'HEADERPNG = $(HEADERPNG)' >> $(MAKE_CACHEFILE))
+endif
+
+LIBPNG := $(call _LIB_TEST,png16)
+ifeq (,$(LIBPNG))
+  $(shell rm -f $(MAKE_CACHEFILE))
+  $(call _CMD_TEST_RESNO_ERR,libpng16-16,LIBPNG library)
+else
+  $(call _CMD_TEST_RESULT,$(LIBPNG))
+  $(shell echo 'LIBPNG = $(LIBPNG)' >> $(MAKE_CACHEFILE))
+endif
+
+HEADERZLIB := $(call _HEADER_TEST,zlib.h)
+ifeq (,$(HEADERZLIB))
+  $(shell rm -f $(MAKE_CACHEFILE))
+  $(call _CMD_TEST_RESNO_ERR,zlib1g-dev,zlib.h)
+else
+  $(call _CMD_TEST_RESULT,$(HEADERZLIB))
+  $(shell echo 'HEADERZLIB = $(HEADERZLIB)' >> $(MAKE_CACHEFILE))
+endif
+
+LIBZLIB := $(call _LIB_TEST,z)
+ifeq (,$(LIBZLIB))
+  $(shell rm -f $(MAKE_CACHEFILE))
+  $(call _CMD_TEST_RESNO_ERR,zlib1g,LIBZ library)
+else
+  $(call _CMD_TEST_RESULT,$(LIBZLIB))
+  $(shell echo 'LIBZLIB = $(LIBZLIB)' >> $(MAKE_CACHEFILE))
+endif
+
 # --------------------------------------------------------------------
 # optional features
 
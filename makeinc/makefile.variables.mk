@@ -15,7 +15,7 @@
 # along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 
-SUBDIRS := src
+SUBDIRS := src bench tools
 
 # ********************************************************************
 # Feature check stuff.
@@ -90,6 +90,10 @@ ifneq (0,$(CONFIG_GUI))
   DFLAGS         += -DCONFIG_GUI
 endif
 
+ifneq (0,$(CONFIG_HUGETLB))
+  DFLAGS         += -DCONFIG_HUGETLB
+endif
+
 # ********************************************************************
 
 ifneq (0,$(CONFIG_STATIC_ALL))
@@ -115,6 +119,12 @@ else
   LIBS           += -lssl -lcrypto
 endif
 
+ifneq (0,$(CONFIG_STATIC_IMAGE))
+  LIBS           += -l:libjpeg.a -l:libpng16.a -l:libz.a
+else
+  LIBS           += -ljpeg -lpng16 -lz
+endif
+
 # ********************************************************************
 
 MTRACEFILE     := mtrace.log
@@ -134,7 +144,8 @@ LOGEXT         := log
 OBJFILES       := $(OBJ:=.$(OEXT))
 DEPFILES       := $(OBJ:=.$(DEPEXT))
 
-FLAGS := $(DEBUGFLAGS) -Wall -Wextra -Wformat-security $(OPTFLAG)
+FLAGS := $(DEBUGFLAGS) -Wall -Wextra -Wformat-security -pthread \
+  $(OPTFLAG)
 CCFLAGS := \
   $(FLAGS) $(CCSTDFLAG) $(DFLAGS) $(addprefix -I,$(INCLUDE_PATHS))
 ASFLAGS := $(CCFLAGS)
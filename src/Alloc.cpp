@@ -0,0 +1,242 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "Alloc.hpp"
+
+#include "common.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+static constexpr unsigned _ALLOC_TAGS
+  = static_cast<unsigned>(Alloc::Tag::COUNT);
+
+static const char* const _alloc_tag_names[_ALLOC_TAGS] = {
+  "other", "Params", "Crypto", "Image", "Platforms", "ustr",
+};
+
+/** In front of each allocation, keeps it aligned as `malloc()`.  */
+struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) alloc_header {
+  std::size_t size;
+  Alloc::Tag tag;
+};
+
+struct alloc_counts {
+  std::atomic<std::uint64_t> allocs;
+  std::atomic<std::uint64_t> frees;
+  std::atomic<std::uint64_t> bytes;
+};
+
+/**
+ * Counts of one thread, written by this thread only.  Allocated by
+ * `std::calloc()` to not recurse into `operator new`, and kept after
+ * the thread exited.
+ */
+struct alloc_thread {
+  alloc_counts counts[_ALLOC_TAGS];
+  alloc_thread* next;
+};
+
+/** Shared by all threads, one cache line per tag.  */
+struct alignas(64) alloc_live {
+  std::atomic<std::int64_t> bytes;
+  std::atomic<std::int64_t> peak;
+};
+
+static std::atomic<alloc_thread*> _alloc_threads(nullptr);
+static alloc_live _alloc_live[_ALLOC_TAGS];
+
+static thread_local alloc_thread* _alloc_thread = nullptr;
+static thread_local Alloc::Tag _alloc_tag = Alloc::Tag::OTHER;
+
+template<typename T> static inline void
+_alloc_inc(std::atomic<T>& value, T delta)
+{
+  value.store(value.load(std::memory_order_relaxed) + delta,
+              std::memory_order_relaxed);
+}
+
+/** Counts of the calling thread, nullptr if out of memory.  */
+static inline alloc_thread*
+_alloc_get_thread()
+{
+  if (_alloc_thread == nullptr) {
+    _alloc_thread = static_cast<alloc_thread*>(
+      std::calloc(1, sizeof(alloc_thread)));
+    if (_alloc_thread == nullptr) return nullptr;
+
+    _alloc_thread->next = _alloc_threads.load();
+    while (!_alloc_threads.compare_exchange_weak(_alloc_thread->next,
+                                                 _alloc_thread));
+  }
+
+  return _alloc_thread;
+}
+
+/** Accounts `header` to the tag of the calling thread.  */
+static void
+_alloc_account(alloc_header* header, std::size_t size)
+{
+  const Alloc::Tag tag = _alloc_tag;
+  const unsigned t = static_cast<unsigned>(tag);
+  header->size = size;
+  header->tag  = tag;
+
+  alloc_thread* thread = _alloc_get_thread();
+  if (thread != nullptr) {
+    _alloc_inc<std::uint64_t>(thread->counts[t].allocs, 1);
+    _alloc_inc<std::uint64_t>(thread->counts[t].bytes, size);
+  }
+
+  alloc_live& live = _alloc_live[t];
+  const std::int64_t bytes = live.bytes.fetch_add(
+    size, std::memory_order_relaxed) + size;
+  std::int64_t peak = live.peak.load(std::memory_order_relaxed);
+  while (bytes > peak
+         && !live.peak.compare_exchange_weak(peak, bytes,
+                                             std::memory_order_relaxed));
+}
+
+static void
+_alloc_unaccount(Alloc::Tag tag, std::size_t size)
+{
+  const unsigned t = static_cast<unsigned>(tag);
+
+  alloc_thread* thread = _alloc_get_thread();
+  if (thread != nullptr)
+    _alloc_inc<std::uint64_t>(thread->counts[t].frees, 1);
+
+  _alloc_live[t].bytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+} /* namespace socialmedia_signer  */
+
+/* ***************************************************************  */
+
+socialmedia_signer::Alloc::Scope::Scope(Tag tag) noexcept
+  :previous(_alloc_tag)
+{
+  _alloc_tag = tag;
+}
+
+socialmedia_signer::Alloc::Scope::~Scope()
+{
+  _alloc_tag = this->previous;
+}
+
+/* ***************************************************************  */
+
+void
+socialmedia_signer::Alloc::release()
+{
+  if (!Alloc::is_enabled()) return;
+
+  /* Snapshot first, the output allocates by itself.  */
+  std::uint64_t allocs[_ALLOC_TAGS] = {}, frees[_ALLOC_TAGS] = {},
+    bytes[_ALLOC_TAGS] = {};
+  std::int64_t live[_ALLOC_TAGS], peak[_ALLOC_TAGS];
+
+  for (const alloc_thread* thread = _alloc_threads.load();
+       thread != nullptr; thread = thread->next) {
+    for (unsigned t=0; t < _ALLOC_TAGS; t++) {
+      allocs[t] += thread->counts[t].allocs.load();
+      frees[t]  += thread->counts[t].frees.load();
+      bytes[t]  += thread->counts[t].bytes.load();
+    }
+  }
+  for (unsigned t=0; t < _ALLOC_TAGS; t++) {
+    live[t] = _alloc_live[t].bytes.load();
+    peak[t] = _alloc_live[t].peak.load();
+  }
+
+  Log::note("{}: heap allocations per tag", COMMON_ALLOC_ENV);
+  Log::note("{:<10}{:>10}{:>10}{:>12}{:>12}{:>12}", "tag", "allocs",
+            "frees", "KiB", "peak KiB", "live KiB");
+
+  for (unsigned t=0; t < _ALLOC_TAGS; t++) {
+    Log::note("{:<10}{:>10}{:>10}{:>12.1f}{:>12.1f}{:>12.1f}",
+              _alloc_tag_names[t], allocs[t], frees[t],
+              bytes[t] / 1024.0, peak[t] / 1024.0, live[t] / 1024.0);
+  }
+}
+
+bool
+socialmedia_signer::Alloc::is_enabled() noexcept
+{
+  /* Before main(), but the environment is set up already.  */
+  static const bool enabled = std::getenv(COMMON_ALLOC_ENV) != nullptr;
+
+  return enabled;
+}
+
+/* ---------------------------------------------------------------  */
+
+void*
+socialmedia_signer::Alloc::allocate(std::size_t size) noexcept
+{
+  if (!Alloc::is_enabled()) return std::malloc(size != 0? size: 1);
+
+  alloc_header* header = static_cast<alloc_header*>(
+    std::malloc(sizeof(alloc_header) + size));
+  if (header == nullptr) return nullptr;
+
+  _alloc_account(header, size);
+  return header + 1;
+}
+
+void*
+socialmedia_signer::Alloc::reallocate(void* ptr, std::size_t size)
+  noexcept
+{
+  if (!Alloc::is_enabled()) return std::realloc(ptr, size);
+  if (ptr == nullptr) return Alloc::allocate(size);
+
+  alloc_header* header = static_cast<alloc_header*>(ptr) - 1;
+  const std::size_t old_size = header->size;
+  const Tag old_tag = header->tag;
+
+  header = static_cast<alloc_header*>(
+    std::realloc(header, sizeof(alloc_header) + size));
+  if (header == nullptr) return nullptr;
+
+  /* Accounted like a free and a new allocation.  */
+  _alloc_unaccount(old_tag, old_size);
+  _alloc_account(header, size);
+  return header + 1;
+}
+
+void
+socialmedia_signer::Alloc::deallocate(void* ptr) noexcept
+{
+  if (!Alloc::is_enabled() || ptr == nullptr) {
+    std::free(ptr);
+    return;
+  }
+
+  alloc_header* header = static_cast<alloc_header*>(ptr) - 1;
+
+  _alloc_unaccount(header->tag, header->size);
+  std::free(header);
+}
+
+/* ***************************************************************  */
@@ -0,0 +1,100 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef ALLOC_HPP__
+#define ALLOC_HPP__
+
+#include <cstddef>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/**
+ * Abstract class which includes static methods for accounting heap
+ * allocations per subsystem, enabled by the environment variable
+ * COMMON_ALLOC_ENV.  Unlike MTRACE() nothing is logged per
+ * allocation, just counted.
+ *
+ * The global `operator new` and `operator delete` of main.cpp call
+ * Alloc::allocate() and Alloc::deallocate(), so do the memory
+ * functions of OpenSSL, set by Crypto.  Allocations are
+ * accounted to the tag of the innermost Alloc::Scope of the calling
+ * thread, or to Tag::OTHER:
+ * ```cpp
+ *   Alloc::Scope scope(Alloc::Tag::IMAGE);
+ * ```
+ * If enabled, each allocation carries a header with its size and
+ * tag, so it is freed from the right tag, even by another thread.
+ * Counts are per thread, just the live bytes of a tag and their peak
+ * are shared atomics.  Whether it is enabled is decided on the first
+ * allocation and never changes, so headers are always consistent.
+ * Disabled it costs a branch per allocation and a thread local store
+ * per Alloc::Scope.
+ *
+ * Pixels are allocated by BufferPool, which has its own statistics.
+ */
+class Alloc
+{
+public:
+  /* Abstract class  */
+  Alloc()             = delete;
+  Alloc(Alloc& other) = delete;
+  virtual ~Alloc()    = 0;
+
+  enum class Tag: unsigned char {
+    OTHER, PARAMS, CRYPTO, IMAGE, PLATFORMS,
+    /** Transcoding and formatting of ustr and ustr8.  */
+    USTR,
+
+    COUNT
+  };
+
+  /** Accounts the allocations of its lifetime to a Tag.  */
+  class Scope
+  {
+  public:
+    explicit Scope(Tag tag) noexcept;
+    ~Scope();
+
+    Scope(Scope& other) = delete;
+
+  private:
+    const Tag previous;
+  };
+
+  /* -------------------------------------------------------------  */
+
+  /** Prints the table of all tags, if enabled.  */
+  static void release();
+
+  static bool is_enabled() noexcept;
+
+  /** `std::malloc()` with accounting, nullptr if out of memory.  */
+  static void* allocate(std::size_t size) noexcept;
+  /** `std::realloc()` of a result of Alloc::allocate().  */
+  static void* reallocate(void* ptr, std::size_t size) noexcept;
+  /** Frees a result of Alloc::allocate(), `ptr` may be nullptr.  */
+  static void deallocate(void* ptr) noexcept;
+};
+
+}
+
+/* ***************************************************************  */
+
+#endif /* ALLOC_HPP__  */
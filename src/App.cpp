@@ -20,6 +20,12 @@
 
 #include "Platforms.hpp"
 #include "Params.hpp"
+#include "ArchiveScanner.hpp"
+#include "BatchSigner.hpp"
+
+#include <cstdlib>
+
+#include <unistd.h>
 
 /* ***************************************************************  */
 
@@ -52,7 +58,7 @@ socialmedia_signer::App::run() noexcept(false)
     const ustr& cmd_name = params->get_command_name();
 
     params->print_version();
-    Log::println(ustr::format("\n  Usage: {} --help\n", cmd_name));
+    Log::println("\n  Usage: {} --help\n", cmd_name);
 #endif
 
     /* Regularly control-flow:  run GUI if compiled.  */
@@ -64,8 +70,27 @@ socialmedia_signer::App::run() noexcept(false)
    */
   const Params::Subargument& sarg_message = params->get_subargument(U'm');
   const Params::Subargument& sarg_image = params->get_subargument(U'i');
+  const Params::Subargument& sarg_jobs = params->get_subargument(U'j');
   Platform* platform = nullptr;
+  unsigned long jobs = 0;
   const Image* image = nullptr;
+
+  if (sarg_jobs.set) {
+    std::u8string jobs_utf8;
+    sarg_jobs.set_value.out_utf8(jobs_utf8);
+
+    char* jobs_end = nullptr;
+    const char* jobs_str = reinterpret_cast<const char*>(
+      jobs_utf8.c_str());
+    jobs = std::strtoul(jobs_str, &jobs_end, 10);
+
+    if (*jobs_end != '\0' || jobs < 1 || jobs > 1024) {
+      throw Params::CmdErr(ustr::format(
+        "--jobs '{}' needs to be a number from 1 to 1024!",
+        sarg_jobs.set_value));
+    }
+  }
+
   switch (scmd->abbr) {
   case U's':
     platform = platforms->get_by_id(scmd->set_value);
@@ -85,6 +110,12 @@ socialmedia_signer::App::run() noexcept(false)
   case U'v':
     this->verify(scmd->set_value);
     break;
+  case U'a':
+    this->scan_archive(scmd->set_value, jobs);
+    break;
+  case U'b':
+    this->sign_batch(jobs);
+    break;
   default: break;
   }
 
@@ -100,6 +131,10 @@ void
 socialmedia_signer::App::sign(const Platform& platform,
   const ustr& message, const Image* image) noexcept(false)
 {
+  Trace::Span span("sign", "app");
+  Metrics::Timer timer(Metrics::Histogram::SIGN);
+  Metrics::add(Metrics::Counter::SIGNS);
+
   std::u8string message_utf8;
   message.out_utf8(message_utf8);
 
@@ -108,14 +143,18 @@ socialmedia_signer::App::sign(const Platform& platform,
 
   // TODO: post this->signed_data to Platform& platform;
 
-  Log::debug(ustr::format("SIGN: {}, message='{}', image={}",
-             platform.get_name(), message, image->to_string()));
+  LOG_DEBUG(APP, "SIGN: {}, message='{}', image={}",
+            platform.get_name(), message, image->to_string());
 }
 
 void
 socialmedia_signer::App::verify(const ustr& url) noexcept(false)
 {
-  Log::debug(ustr::format("VERIFY: post_url={}", url));
+  Trace::Span span("verify", "app");
+  Metrics::Timer timer(Metrics::Histogram::VERIFY);
+  Metrics::add(Metrics::Counter::VERIFICATIONS);
+
+  LOG_DEBUG(APP, "VERIFY: post_url={}", url);
 
   // TODO: find Platform* by <url>
   // TODO: download post from platform and set this->signed_data
@@ -123,7 +162,42 @@ socialmedia_signer::App::verify(const ustr& url) noexcept(false)
   if (this->signed_data == nullptr)
     throw Error(u8"App::verify(): Not implemented!");
 
-  this->signed_data->verify();
+  /* The CLI reports an invalid signature as Error.  */
+  this->signed_data->verify().value();
+}
+
+void
+socialmedia_signer::App::scan_archive(const ustr& directory,
+  unsigned jobs) noexcept(false)
+{
+  Trace::Span span("archive", "app");
+
+  ArchiveScanner scanner(directory, jobs);
+  scanner.run();
+
+  const ArchiveScanner::Stats& stats = scanner.get_stats();
+  if (stats.qr_found < stats.files) {
+    Log::flush();
+    throw Error(ustr::format(
+      "--archive: {} of {} files without QR code, {} errors!",
+      stats.no_qr, stats.files, stats.errors));
+  }
+}
+
+void
+socialmedia_signer::App::sign_batch(unsigned jobs) noexcept(false)
+{
+  Trace::Span span("batch", "app");
+
+  BatchSigner signer(STDIN_FILENO, jobs);
+  signer.run();
+
+  const BatchSigner::Stats& stats = signer.get_stats();
+  if (stats.errors > 0) {
+    Log::flush();
+    throw Error(ustr::format("--batch: {} of {} requests failed!",
+                             stats.errors, stats.requests));
+  }
 }
 
 /* ***************************************************************  */
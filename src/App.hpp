@@ -55,6 +55,20 @@ protected:
 
   virtual void verify(const ustr& url) noexcept(false);
 
+  /**
+   * Scans all images below `directory` for a QR code without
+   * network access, see ArchiveScanner.  Throws an Error if not all
+   * images carry a QR code.
+   */
+  virtual void scan_archive(const ustr& directory, unsigned jobs)
+    noexcept(false);
+
+  /**
+   * Signs the NDJSON requests read from stdin, see BatchSigner.
+   * Throws an Error if not all requests could be signed.
+   */
+  virtual void sign_batch(unsigned jobs) noexcept(false);
+
   /* -------------------------------------------------------------  */
 
 private:
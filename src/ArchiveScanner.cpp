@@ -0,0 +1,278 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "ArchiveScanner.hpp"
+
+#include "Image.hpp"
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+static const char* const _archive_status[] = {
+  "QR", "NO_QR", "ERROR"
+};
+static const Metrics::Counter _archive_counters[] = {
+  Metrics::Counter::ARCHIVE_QR_FOUND, Metrics::Counter::ARCHIVE_NO_QR,
+  Metrics::Counter::ARCHIVE_ERRORS
+};
+
+/** Lower case file extensions which are scanned.  */
+static const char* const _archive_extensions[] = {
+  ".jpg", ".jpeg", ".jpe", ".png", nullptr
+};
+
+static bool
+_archive_is_image(const std::filesystem::path& path)
+{
+  std::string ext = path.extension().string();
+  std::transform(ext.begin(), ext.end(), ext.begin(),
+    [](unsigned char ch) { return std::tolower(ch); });
+
+  for (const char* const* cur = _archive_extensions; *cur != nullptr;
+       cur++)
+    if (ext == *cur) return true;
+
+  return false;
+}
+
+/**
+ * POSIX_FADV_WILLNEED starts asynchronous readahead of the whole file
+ * into the page cache, POSIX_FADV_DONTNEED drops it after the file
+ * was scanned, so a large archive does not evict everything else.
+ */
+static void
+_archive_advise(const std::filesystem::path& path, int advice)
+{
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return;
+
+  ::posix_fadvise(fd, 0, 0, advice);
+  ::close(fd);
+}
+
+/**
+ * Appends the raw bytes of a file name, which are not UTF-8 in all
+ * cases, so it can be matched back to the file.  Only backslash and
+ * the TSV separators are escaped, to keep one result per line.  The
+ * details are escaped the same, they may quote the file name.
+ */
+static void
+_archive_escape(std::string& out, const std::string& bytes)
+{
+  for (const char ch: bytes) {
+    switch (ch) {
+    case '\\': out += "\\\\"; break;
+    case '\t': out += "\\t"; break;
+    case '\n': out += "\\n"; break;
+    case '\r': out += "\\r"; break;
+    default:   out += ch; break;
+    }
+  }
+}
+
+} /* namespace socialmedia_signer  */
+
+/* ***************************************************************  */
+
+socialmedia_signer::ArchiveScanner::ArchiveErr::ArchiveErr(
+  const ustr& directory, const ustr& reason)
+  :Error(ustr::format("archive '{}': {}", directory, reason))
+{}
+
+/* ***************************************************************  */
+
+socialmedia_signer::ArchiveScanner::ArchiveScanner(
+  const ustr& directory, unsigned jobs)
+  :directory(directory),
+   jobs(jobs != 0
+        ? jobs: std::max(1u, std::thread::hardware_concurrency())),
+   mutex(), cond_queued(), cond_taken(), queue(), is_walked(false),
+   mutex_report(), stats({0, 0, 0, 0})
+{
+}
+
+socialmedia_signer::ArchiveScanner::~ArchiveScanner()
+{
+}
+
+/* ***************************************************************  */
+
+void
+socialmedia_signer::ArchiveScanner::run() noexcept(false)
+{
+  std::u8string directory_utf8;
+  this->directory.out_utf8(directory_utf8);
+  const std::filesystem::path root(directory_utf8);
+
+  std::error_code err;
+  std::filesystem::recursive_directory_iterator it(root,
+    std::filesystem::directory_options::skip_permission_denied, err);
+  if (err) {
+    throw ArchiveErr(this->directory,
+      reinterpret_cast<const char8_t*>(err.message().c_str()));
+  }
+
+  std::vector<std::thread> workers;
+  for (unsigned i=0; i < this->jobs; i++)
+    workers.emplace_back(&ArchiveScanner::work, this);
+
+  const std::size_t queue_max = ArchiveScanner::QUEUE_PER_JOB * this->jobs;
+
+  const std::filesystem::recursive_directory_iterator end;
+  for (; it != end; it.increment(err)) {
+    if (!it->is_regular_file(err) || !_archive_is_image(it->path()))
+      continue;
+
+    /* Readahead is issued while the file waits in the queue.  */
+    _archive_advise(it->path(), POSIX_FADV_WILLNEED);
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->cond_taken.wait(lock, [this, queue_max]() {
+      return this->queue.size() < queue_max;
+    });
+    this->queue.push_back(it->path());
+    lock.unlock();
+
+    Metrics::add(Metrics::Gauge::ARCHIVE_QUEUED, 1);
+
+    this->cond_queued.notify_one();
+  }
+
+  /* INCREMENT() sets IT to END on errors.  */
+  if (err) {
+    this->report(Status::ERROR, root,
+      reinterpret_cast<const char8_t*>(err.message().c_str()));
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->is_walked = true;
+  }
+  this->cond_queued.notify_all();
+
+  for (std::thread& worker: workers) worker.join();
+
+  LOG_DEBUG(ARCHIVE,
+    "ARCHIVE: {} files, {} with QR code, {} without, {} errors"
+    " on {} jobs", this->stats.files, this->stats.qr_found,
+    this->stats.no_qr, this->stats.errors, this->jobs);
+}
+
+const socialmedia_signer::ArchiveScanner::Stats&
+socialmedia_signer::ArchiveScanner::get_stats() const
+{
+  return this->stats;
+}
+
+/* ***************************************************************  */
+
+void
+socialmedia_signer::ArchiveScanner::work()
+{
+  Trace::name_thread("archive worker");
+
+  for (;;) {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->cond_queued.wait(lock, [this]() {
+      return !this->queue.empty() || this->is_walked;
+    });
+    if (this->queue.empty()) return;
+
+    const std::filesystem::path path = std::move(this->queue.front());
+    this->queue.pop_front();
+    lock.unlock();
+
+    this->cond_taken.notify_one();
+
+    Metrics::add(Metrics::Gauge::ARCHIVE_QUEUED, -1);
+    Metrics::add(Metrics::Gauge::ARCHIVE_BUSY, 1);
+    try {
+      this->scan(path);
+    } catch (std::exception& e) {
+      /* Also std::bad_alloc etc., the other files go on.  */
+      this->report(Status::ERROR, path,
+        reinterpret_cast<const char8_t*>(e.what()));
+    }
+    Metrics::add(Metrics::Gauge::ARCHIVE_BUSY, -1);
+
+    _archive_advise(path, POSIX_FADV_DONTNEED);
+  }
+}
+
+void
+socialmedia_signer::ArchiveScanner::scan(
+  const std::filesystem::path& path)
+{
+  Trace::Span span("scan file", "archive", path.native());
+  Metrics::Timer timer(Metrics::Histogram::ARCHIVE_FILE);
+
+  /* Broken files are common in archives, so their Failure is just
+   * reported without throwing.  */
+  const Result<std::unique_ptr<Image>> image
+    = Image::open_for_verify(path.u8string());
+  if (!image) {
+    this->report(Status::ERROR, path, image.error().get_reason());
+    return;
+  }
+
+  const float module = (*image)->estimate_qr_module();
+  if (module <= 0.0f) {
+    this->report(Status::NO_QR, path, u8"no QR code");
+    return;
+  }
+
+  this->report(Status::QR_FOUND, path, ustr8::format(
+    "QR code, module {:.1f} px at 1/{}", module, (*image)->get_scale()));
+}
+
+void
+socialmedia_signer::ArchiveScanner::report(Status status,
+  const std::filesystem::path& path, const ustr8& details)
+{
+  std::lock_guard<std::mutex> lock(this->mutex_report);
+
+  this->stats.files++;
+  switch (status) {
+  case Status::QR_FOUND: this->stats.qr_found++; break;
+  case Status::NO_QR:    this->stats.no_qr++;    break;
+  case Status::ERROR:    this->stats.errors++;   break;
+  }
+  Metrics::add(_archive_counters[static_cast<int>(status)]);
+
+  std::string line = _archive_status[static_cast<int>(status)];
+  line += '\t';
+  _archive_escape(line, path.native());
+  line += '\t';
+  _archive_escape(line, reinterpret_cast<const char*>(details.c_str()));
+
+  /* Not through the ring buffers of Log, so no line is lost and all
+   * are written before the summary error of App::scan_archive().  */
+  Log::println_sync(line);
+}
+
+/* ***************************************************************  */
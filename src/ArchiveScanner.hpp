@@ -0,0 +1,114 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef ARCHIVESCANNER_HPP__
+#define ARCHIVESCANNER_HPP__
+
+#include "common.hpp"
+
+#include <filesystem>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/**
+ * Offline scan of all images below a local directory, for example
+ * archived screenshots, for a QR code.
+ *
+ * The directory tree is walked by the calling thread, which asks the
+ * kernel to read ahead every file it queues.  A bounded pool of
+ * workers decodes the queued files and looks for QR finder patterns.
+ * One line per file is printed as soon as it is finished,
+ *
+ * ```
+ *   <status>\t<path>\t<details>
+ * ```
+ *
+ * where `<status>` is `QR`, `NO_QR` or `ERROR`.
+ *
+ * No signature is verified, there is no decoder of the QR payload
+ * yet.  `QR` just means that an image carries a QR code.
+ */
+class ArchiveScanner
+{
+public:
+
+  class ArchiveErr: public Error {
+  public:
+    ArchiveErr(const ustr& directory, const ustr& reason);
+  };
+
+  enum class Status { QR_FOUND, NO_QR, ERROR };
+
+  struct Stats {
+    std::size_t files;
+    std::size_t qr_found;
+    std::size_t no_qr;
+    std::size_t errors;
+  };
+
+  /**
+   * `jobs` is the number of worker threads, 0 uses all hardware
+   * threads.
+   */
+  explicit ArchiveScanner(const ustr& directory, unsigned jobs = 0);
+  virtual ~ArchiveScanner();
+
+  /**
+   * Scans all files and blocks until the last line was printed.
+   * Throws ArchiveErr if `directory` can not be walked at all.
+   */
+  virtual void run() noexcept(false);
+
+  virtual const Stats& get_stats() const;
+
+private:
+  /** Files which are queued, but not yet taken by a worker.  */
+  static constexpr std::size_t QUEUE_PER_JOB = 8;
+
+  void work();
+  void scan(const std::filesystem::path& path);
+  void report(Status status, const std::filesystem::path& path,
+              const ustr8& details);
+
+  const ustr directory;
+  const unsigned jobs;
+
+  /** Guards the queue.  */
+  std::mutex mutex;
+  std::condition_variable cond_queued;
+  std::condition_variable cond_taken;
+
+  std::deque<std::filesystem::path> queue;
+  bool is_walked;
+
+  /** Guards the output and Stats.  */
+  std::mutex mutex_report;
+  Stats stats;
+};
+
+}
+
+/* ***************************************************************  */
+
+#endif /* ARCHIVESCANNER_HPP__  */
@@ -0,0 +1,602 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "BatchSigner.hpp"
+
+#include "Platforms.hpp"
+#include "SignedData.hpp"
+#include "Image.hpp"
+#include "Utf8.hpp"
+
+#include <thread>
+#include <vector>
+#include <memory>
+#include <format>
+#include <charconv>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/** Bytes per read(2) of the requests.  */
+static constexpr std::size_t _BATCH_READ_SIZE = 64 * 1024;
+
+/** Fields of a request, see BatchSigner.  */
+struct batch_request {
+  /** As JSON, empty if not given.  */
+  std::string id;
+
+  std::u8string message;
+  std::u8string platform;
+  std::u8string image;
+
+  bool has_message;
+  bool has_platform;
+  bool has_image;
+};
+
+static void
+_batch_json(std::string& out, std::string_view str)
+{
+  out += '"';
+  for (const char c: str) {
+    switch (c) {
+    case '"':  out += "\\\""; break;
+    case '\\': out += "\\\\"; break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20)
+        std::format_to(std::back_inserter(out), "\\u{:04x}",
+                       static_cast<unsigned>(c));
+      else
+        out += c;
+    }
+  }
+  out += '"';
+}
+
+static inline std::string_view
+_batch_view(const std::u8string& str)
+{
+  return std::string_view(reinterpret_cast<const char*>(str.data()),
+                          str.length());
+}
+
+static inline std::string_view
+_batch_view(const ustr8& str)
+{
+  return std::string_view(reinterpret_cast<const char*>(str.c_str()),
+                          str.size_bytes());
+}
+
+static inline bool
+_batch_is_blank(std::string_view str)
+{
+  return str.find_first_not_of(" \t\r") == std::string_view::npos;
+}
+
+/* -------------------------------------------------------------------
+ * A JSON parser, just for objects of strings, numbers, `true`,
+ * `false` and `null`.  Each rule consumes its input from `in`.
+ */
+
+static inline void
+_batch_skip_space(std::string_view& in)
+{
+  const std::size_t pos = in.find_first_not_of(" \t\r\n");
+  in.remove_prefix(pos == std::string_view::npos? in.length(): pos);
+}
+
+static bool
+_batch_parse_hex4(std::string_view& in, char32_t& out)
+{
+  if (in.length() < 4) return false;
+
+  unsigned value = 0;
+  const std::from_chars_result result
+    = std::from_chars(in.data(), in.data() + 4, value, 16);
+  if (result.ec != std::errc() || result.ptr != in.data() + 4)
+    return false;
+
+  in.remove_prefix(4);
+  out = value;
+  return true;
+}
+
+/** `\uXXXX` with the backslash consumed, maybe a surrogate pair.  */
+static Result<void>
+_batch_parse_unicode(std::string_view& in, std::u8string& out)
+{
+  char32_t ch;
+  if (!_batch_parse_hex4(in, ch))
+    return Failure(u8"invalid \\u escape");
+
+  if (ch >= 0xd800 && ch < 0xdc00) {
+    char32_t low;
+    if (in.substr(0, 2) != "\\u") return Failure(u8"lone surrogate");
+    in.remove_prefix(2);
+    if (!_batch_parse_hex4(in, low) || low < 0xdc00 || low >= 0xe000)
+      return Failure(u8"lone surrogate");
+
+    ch = 0x10000 + ((ch - 0xd800) << 10) + (low - 0xdc00);
+  }
+
+  /* Surrogates left are malformed.  */
+  char8_t utf8[Utf8::MAX_LENGTH];
+  const Utf8::Result result = Utf8::encode(utf8, &ch, 1);
+  if (result.errors > 0) return Failure(u8"lone surrogate");
+
+  out.append(utf8, result.written);
+  return Result<void>();
+}
+
+static Result<std::u8string>
+_batch_parse_string(std::string_view& in)
+{
+  if (in.empty() || in.front() != '"')
+    return Failure(u8"string expected");
+  in.remove_prefix(1);
+
+  std::u8string result;
+  for (;;) {
+    const std::size_t special = in.find_first_of("\"\\");
+    if (special == std::string_view::npos)
+      return Failure(u8"unterminated string");
+
+    const std::string_view plain = in.substr(0, special);
+    if (std::any_of(plain.begin(), plain.end(), [](unsigned char c) {
+          return c < 0x20; }))
+      return Failure(u8"control character in string");
+
+    result.append(reinterpret_cast<const char8_t*>(plain.data()),
+                  plain.length());
+    const char c = in[special];
+    in.remove_prefix(special + 1);
+
+    if (c == '"') return result;
+
+    if (in.empty()) return Failure(u8"unterminated string");
+    const char escape = in.front();
+    in.remove_prefix(1);
+
+    switch (escape) {
+    case '"': case '\\': case '/':
+      result += static_cast<char8_t>(escape); break;
+    case 'b': result += u8'\b'; break;
+    case 'f': result += u8'\f'; break;
+    case 'n': result += u8'\n'; break;
+    case 'r': result += u8'\r'; break;
+    case 't': result += u8'\t'; break;
+    case 'u': {
+      Result<void> unicode = _batch_parse_unicode(in, result);
+      if (!unicode) return std::move(unicode).error();
+      break;
+    }
+    default: return Failure(u8"invalid escape in string");
+    }
+  }
+}
+
+/** Number, `true`, `false` or `null`, returned as it is.  */
+static Result<std::string>
+_batch_parse_scalar(std::string_view& in)
+{
+  if (!in.empty() && (in.front() == '{' || in.front() == '['))
+    return Failure(u8"nested values are not supported");
+
+  const std::size_t length = std::min(in.length(),
+    in.find_first_not_of("+-.0123456789Eaeflnrstu"));
+  const std::string_view token = in.substr(0, length);
+  if (token.empty()) return Failure(u8"value expected");
+
+  if (token != "true" && token != "false" && token != "null") {
+    /* Not `inf` or `nan`, which std::from_chars() accepts.  */
+    const std::size_t digit = token.front() == '-'? 1: 0;
+    if (token.length() <= digit || token[digit] < '0' || token[digit] > '9')
+      return Failure(u8"invalid value");
+
+    double number;
+    const std::from_chars_result result
+      = std::from_chars(token.data(), token.data() + length, number);
+    if (result.ec != std::errc() || result.ptr != token.data() + length)
+      return Failure(u8"invalid value");
+  }
+
+  in.remove_prefix(length);
+  return std::string(token);
+}
+
+/** Parses the field `key` of the request, or skips its value.  */
+static Result<void>
+_batch_parse_field(std::string_view& in, std::u8string_view key,
+                   batch_request& request)
+{
+  std::u8string* field = nullptr;
+  bool* has_field = nullptr;
+
+  if (key == u8"message") {
+    field = &request.message;
+    has_field = &request.has_message;
+  } else if (key == u8"platform") {
+    field = &request.platform;
+    has_field = &request.has_platform;
+  } else if (key == u8"image") {
+    field = &request.image;
+    has_field = &request.has_image;
+  }
+
+  const bool is_string = !in.empty() && in.front() == '"';
+
+  if (field != nullptr) {
+    if (!is_string) {
+      return Failure(ustr8::format("\"{}\" needs to be a string",
+                                   ustr8(std::u8string(key))));
+    }
+
+    Result<std::u8string> value = _batch_parse_string(in);
+    if (!value) return std::move(value).error();
+
+    *field = std::move(*value);
+    *has_field = true;
+    return Result<void>();
+  }
+
+  if (is_string) {
+    Result<std::u8string> value = _batch_parse_string(in);
+    if (!value) return std::move(value).error();
+
+    if (key == u8"id") {
+      request.id.clear();
+      _batch_json(request.id, _batch_view(*value));
+    }
+    return Result<void>();
+  }
+
+  Result<std::string> value = _batch_parse_scalar(in);
+  if (!value) return std::move(value).error();
+
+  if (key == u8"id") request.id = std::move(*value);
+  return Result<void>();
+}
+
+static Result<void>
+_batch_parse_object(std::string_view& in, batch_request& request)
+{
+  _batch_skip_space(in);
+  if (in.empty() || in.front() != '{') return Failure(u8"'{' expected");
+  in.remove_prefix(1);
+
+  _batch_skip_space(in);
+  if (!in.empty() && in.front() == '}') {
+    in.remove_prefix(1);
+    return Result<void>();
+  }
+
+  for (;;) {
+    _batch_skip_space(in);
+    Result<std::u8string> key = _batch_parse_string(in);
+    if (!key) return std::move(key).error();
+
+    _batch_skip_space(in);
+    if (in.empty() || in.front() != ':') return Failure(u8"':' expected");
+    in.remove_prefix(1);
+
+    _batch_skip_space(in);
+    Result<void> field = _batch_parse_field(in, *key, request);
+    if (!field) return std::move(field).error();
+
+    _batch_skip_space(in);
+    if (in.empty()) return Failure(u8"'}' expected");
+
+    const char c = in.front();
+    in.remove_prefix(1);
+    if (c == '}') return Result<void>();
+    if (c != ',') return Failure(u8"',' or '}' expected");
+  }
+}
+
+/** Parses one line of JSON, which is an object.  */
+static Result<batch_request>
+_batch_parse(std::string_view line)
+{
+  const Utf8::Result utf8 = Utf8::validate(
+    reinterpret_cast<const char8_t*>(line.data()), line.length());
+  if (utf8.error_offset != Utf8::npos) {
+    return Failure(ustr8::format("invalid UTF-8 at byte {}",
+                                 utf8.error_offset));
+  }
+
+  batch_request request = {};
+  std::string_view in = line;
+
+  Result<void> object = _batch_parse_object(in, request);
+  if (object) {
+    _batch_skip_space(in);
+    if (!in.empty()) object = Failure(u8"characters after the object");
+  }
+
+  if (!object) {
+    return Failure(ustr8::format("invalid JSON at byte {}: {}",
+      line.length() - in.length(), object.error().get_reason()));
+  }
+
+  if (!request.has_message) return Failure(u8"\"message\" is missing");
+  if (!request.has_platform) return Failure(u8"\"platform\" is missing");
+
+  return request;
+}
+
+static std::string
+_batch_error_fields(std::string_view reason)
+{
+  std::string result = ",\"error\":";
+  _batch_json(result, reason);
+  return result;
+}
+
+} /* namespace socialmedia_signer  */
+
+/* ***************************************************************  */
+
+socialmedia_signer::BatchSigner::BatchErr::BatchErr(const ustr& reason)
+  :Error(ustr::format("batch: {}", reason))
+{}
+
+/* ***************************************************************  */
+
+socialmedia_signer::BatchSigner::BatchSigner(int fd, unsigned jobs)
+  :fd(fd),
+   jobs(jobs != 0
+        ? jobs: std::max(1u, std::thread::hardware_concurrency())),
+   queue_max(BatchSigner::QUEUE_PER_JOB * this->jobs),
+   mutex(), cond_queued(), cond_taken(), queue(), is_read(false),
+   mutex_report(), stats({0, 0, 0})
+{
+}
+
+socialmedia_signer::BatchSigner::~BatchSigner()
+{
+}
+
+/* ***************************************************************  */
+
+void
+socialmedia_signer::BatchSigner::run() noexcept(false)
+{
+  std::vector<std::thread> workers;
+  for (unsigned i=0; i < this->jobs; i++)
+    workers.emplace_back(&BatchSigner::work, this);
+
+  const std::unique_ptr<char[]> buffer(new char[_BATCH_READ_SIZE]);
+
+  /* The line which is read, skipped if it is too long.  */
+  Request request = {1, std::string()};
+  bool is_too_long = false;
+
+  const auto finish_line = [this, &request, &is_too_long]() {
+    if (is_too_long) {
+      this->report(Status::ERROR, request.line, std::string(),
+        _batch_error_fields(std::format("line longer than {} bytes",
+                                        BatchSigner::LINE_LENGTH_MAX)));
+    } else if (!_batch_is_blank(request.json)) {
+      this->enqueue(std::move(request));
+    }
+
+    request = {request.line + 1, std::string()};
+    is_too_long = false;
+  };
+
+  int read_errno = 0;
+  for (;;) {
+    const ssize_t got = ::read(this->fd, buffer.get(), _BATCH_READ_SIZE);
+    if (got < 0 && errno == EINTR) continue;
+    if (got < 0) read_errno = errno;
+    if (got <= 0) break;
+
+    std::string_view chunk(buffer.get(), got);
+    while (!chunk.empty()) {
+      const std::size_t newline = chunk.find('\n');
+      const std::string_view part = chunk.substr(0, newline);
+
+      if (request.json.length() + part.length()
+          > BatchSigner::LINE_LENGTH_MAX) {
+        is_too_long = true;
+        request.json.clear();
+      }
+      if (!is_too_long) request.json += part;
+
+      if (newline == std::string_view::npos) break;
+      chunk.remove_prefix(newline + 1);
+
+      finish_line();
+    }
+  }
+
+  /* Last line without newline.  */
+  if (is_too_long || !request.json.empty()) finish_line();
+
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->is_read = true;
+  }
+  this->cond_queued.notify_all();
+
+  for (std::thread& worker: workers) worker.join();
+
+  LOG_DEBUG(APP, "BATCH: {} requests, {} ok, {} errors on {} jobs",
+    this->stats.requests, this->stats.ok, this->stats.errors,
+    this->jobs);
+
+  if (read_errno != 0) {
+    throw BatchErr(ustr::format("could not read requests: {}",
+                                std::strerror(read_errno)));
+  }
+}
+
+const socialmedia_signer::BatchSigner::Stats&
+socialmedia_signer::BatchSigner::get_stats() const
+{
+  return this->stats;
+}
+
+/* ***************************************************************  */
+
+void
+socialmedia_signer::BatchSigner::enqueue(Request&& request)
+{
+  /* Backpressure:  while all workers are busy, nothing is read.  */
+  std::unique_lock<std::mutex> lock(this->mutex);
+  this->cond_taken.wait(lock, [this]() {
+    return this->queue.size() < this->queue_max;
+  });
+  this->queue.push_back(std::move(request));
+  lock.unlock();
+
+  Metrics::add(Metrics::Gauge::BATCH_QUEUED, 1);
+
+  this->cond_queued.notify_one();
+}
+
+void
+socialmedia_signer::BatchSigner::work()
+{
+  Trace::name_thread("batch worker");
+
+  for (;;) {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->cond_queued.wait(lock, [this]() {
+      return !this->queue.empty() || this->is_read;
+    });
+    if (this->queue.empty()) return;
+
+    const Request request = std::move(this->queue.front());
+    this->queue.pop_front();
+    lock.unlock();
+
+    this->cond_taken.notify_one();
+
+    Metrics::add(Metrics::Gauge::BATCH_QUEUED, -1);
+    Metrics::add(Metrics::Gauge::BATCH_BUSY, 1);
+    try {
+      this->sign(request);
+    } catch (std::exception& e) {
+      /* Thrown before the `id` is known, i.e. while parsing.  */
+      this->report(Status::ERROR, request.line, std::string(),
+                   _batch_error_fields(e.what()));
+    }
+    Metrics::add(Metrics::Gauge::BATCH_BUSY, -1);
+  }
+}
+
+void
+socialmedia_signer::BatchSigner::sign(const Request& request)
+{
+  Trace::Span span("sign request", "batch");
+  FlightRecorder::record(FlightRecorder::Kind::EVENT, "batch line",
+                         request.line);
+
+  /* Malformed requests are expected from a stream, so their Failure
+   * is just reported without throwing.  */
+  Result<batch_request> fields = _batch_parse(request.json);
+  if (!fields) {
+    this->report(Status::ERROR, request.line, std::string(),
+      _batch_error_fields(_batch_view(fields.error().get_reason())));
+    return;
+  }
+
+  try {
+    const Platform* platform
+      = Platforms::get()->get_by_id(ustr8(fields->platform));
+    if (platform == nullptr) {
+      this->report(Status::ERROR, request.line, fields->id,
+        _batch_error_fields(_batch_view(ustr8::format(
+          "social media platform '{}' not supported",
+          ustr8(fields->platform)))));
+      return;
+    }
+
+    const Image* image = nullptr;
+    if (fields->has_image) {
+      Result<std::unique_ptr<Image>> opened
+        = Image::open(ustr(fields->image));
+      if (!opened) {
+        this->report(Status::ERROR, request.line, fields->id,
+          _batch_error_fields(_batch_view(opened.error().get_reason())));
+        return;
+      }
+      image = opened->release();
+    } else {
+      image = new Image();
+    }
+
+    Metrics::Timer timer(Metrics::Histogram::SIGN);
+    Metrics::add(Metrics::Counter::SIGNS);
+
+    SignedData signed_data(fields->message, image);
+    signed_data.sign();
+
+    // TODO: post signed_data to *platform, like App::sign()
+
+    std::string result = ",\"platform\":";
+    _batch_json(result, _batch_view(ustr8(platform->get_name())));
+    std::format_to(std::back_inserter(result), ",\"qr\":\"{}x{}\"",
+                   signed_data.get_qr()->get_width(),
+                   signed_data.get_qr()->get_height());
+
+    this->report(Status::OK, request.line, fields->id, result);
+  } catch (std::exception& e) {
+    /* Also std::bad_alloc etc., the other requests go on.  */
+    this->report(Status::ERROR, request.line, fields->id,
+                 _batch_error_fields(e.what()));
+  }
+}
+
+void
+socialmedia_signer::BatchSigner::report(Status status, std::size_t line,
+  const std::string& id, const std::string& fields)
+{
+  std::string out = std::format("{{\"line\":{}", line);
+  if (!id.empty()) {
+    out += ",\"id\":";
+    out += id;
+  }
+  out += status == Status::OK
+    ? ",\"status\":\"ok\"": ",\"status\":\"error\"";
+  out += fields;
+  out += '}';
+
+  std::lock_guard<std::mutex> lock(this->mutex_report);
+
+  this->stats.requests++;
+  switch (status) {
+  case Status::OK:    this->stats.ok++;     break;
+  case Status::ERROR: this->stats.errors++; break;
+  }
+  Metrics::add(status == Status::OK
+    ? Metrics::Counter::BATCH_OK: Metrics::Counter::BATCH_ERRORS);
+
+  /* Not through the ring buffers of Log, so no response is lost and
+   * all are written before the summary error of App::sign_batch().  */
+  Log::println_sync(out);
+}
+
+/* ***************************************************************  */
@@ -0,0 +1,138 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef BATCHSIGNER_HPP__
+#define BATCHSIGNER_HPP__
+
+#include "common.hpp"
+
+#include <string>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/**
+ * Signs a stream of requests, one JSON object per line (NDJSON), in a
+ * single process, so Crypto::init() and the caches are shared by all
+ * messages.
+ *
+ * ```
+ *   {"id": 1, "message": "Hello", "platform": "x", "image": "a.png"}
+ * ```
+ *
+ * `message` and `platform` are required, `image` and `id` are
+ * optional.  `id` is a string or number, which is returned as it is.
+ * Other keys are ignored, if their values are no objects or arrays.
+ *
+ * The calling thread reads the lines and queues them for a bounded
+ * pool of workers.  If the queue is full, it stops reading, so a fast
+ * producer is blocked by the pipe.  One line per request is printed
+ * in the order the requests are finished,
+ *
+ * ```
+ *   {"line":1,"id":1,"status":"ok","platform":"X","qr":"41x41"}
+ *   {"line":2,"status":"error","error":"..."}
+ * ```
+ *
+ * where `line` is the line number of the request.
+ */
+class BatchSigner
+{
+public:
+
+  class BatchErr: public Error {
+  public:
+    BatchErr(const ustr& reason);
+  };
+
+  enum class Status { OK, ERROR };
+
+  struct Stats {
+    std::size_t requests;
+    std::size_t ok;
+    std::size_t errors;
+  };
+
+  /**
+   * Reads requests from the file descriptor `fd`.  `jobs` is the
+   * number of worker threads, 0 uses all hardware threads.
+   */
+  explicit BatchSigner(int fd, unsigned jobs = 0);
+  virtual ~BatchSigner();
+
+  /**
+   * Signs all requests until end of file and blocks until the last
+   * line was printed.  Throws BatchErr if `fd` could not be read, after
+   * the requests read so far are finished.
+   */
+  virtual void run() noexcept(false);
+
+  virtual const Stats& get_stats() const;
+
+private:
+  /** Requests which are queued, but not yet taken by a worker.  */
+  static constexpr std::size_t QUEUE_PER_JOB = 8;
+
+  /**
+   * Longer lines are answered with an error and skipped, so the
+   * memory in flight is at most about
+   * `(QUEUE_PER_JOB + 1) * jobs * LINE_LENGTH_MAX`.
+   */
+  static constexpr std::size_t LINE_LENGTH_MAX = 64 * 1024;
+
+  struct Request {
+    std::size_t line;
+    std::string json;
+  };
+
+  /** Queues `request`, blocks while the queue is full.  */
+  void enqueue(Request&& request);
+
+  void work();
+  void sign(const Request& request);
+  /** `fields` are appended to the JSON object of the output line.  */
+  void report(Status status, std::size_t line, const std::string& id,
+              const std::string& fields);
+
+  const int fd;
+  const unsigned jobs;
+  const std::size_t queue_max;
+
+  /** Guards the queue.  */
+  std::mutex mutex;
+  std::condition_variable cond_queued;
+  std::condition_variable cond_taken;
+
+  std::deque<Request> queue;
+  bool is_read;
+
+  /** Guards the output and Stats.  */
+  std::mutex mutex_report;
+  Stats stats;
+};
+
+}
+
+/* ***************************************************************  */
+
+#endif /* BATCHSIGNER_HPP__  */
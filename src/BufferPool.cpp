@@ -0,0 +1,217 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "BufferPool.hpp"
+
+#include <bit>
+#include <cstdlib>
+#include <sys/mman.h>
+
+/* ***************************************************************  */
+
+socialmedia_signer::BufferPool*
+socialmedia_signer::BufferPool::instance = nullptr;
+
+/* ***************************************************************  */
+
+socialmedia_signer::BufferPool::BufferPool(bool use_hugetlb,
+                                           std::size_t max_cached)
+  :use_hugetlb(use_hugetlb), max_cached(max_cached), mutex(),
+   free_lists(), stats()
+{
+}
+
+socialmedia_signer::BufferPool::~BufferPool()
+{
+  for (unsigned index=0; index < this->free_lists.size(); index++) {
+    const std::size_t capacity = BufferPool::class_capacity(index);
+
+    for (void* buffer: this->free_lists[index])
+      this->deallocate(buffer, capacity);
+  }
+
+  LOG_DEBUG(BUFFERPOOL,
+    "BUFFERPOOL: {} allocations, {} reuses, {} huge pages",
+    this->stats.allocations, this->stats.reuses, this->stats.hugetlb);
+}
+
+/* ***************************************************************  */
+
+void
+socialmedia_signer::BufferPool::init(bool use_hugetlb,
+                                     std::size_t max_cached)
+{
+  if (BufferPool::instance != nullptr)
+    Log::fatal(u8"BufferPool::init(): double call!");
+
+  BufferPool::instance = new BufferPool(use_hugetlb, max_cached);
+}
+
+void
+socialmedia_signer::BufferPool::release()
+{
+  delete BufferPool::instance;
+}
+
+socialmedia_signer::BufferPool*
+socialmedia_signer::BufferPool::get()
+{
+  if (BufferPool::instance == nullptr)
+    Log::fatal(u8"BufferPool::init() not called!");
+
+  return BufferPool::instance;
+}
+
+/* ***************************************************************  */
+
+std::size_t
+socialmedia_signer::BufferPool::size_class(std::size_t bytes,
+                                           unsigned& index)
+{
+  if (bytes <= MIN_CAPACITY) {
+    index = 0;
+    return MIN_CAPACITY;
+  }
+
+  /* 2^e < BYTES <= 2^(e+1), rounded up to a quarter of 2^e.  */
+  const unsigned e = std::bit_width(bytes - 1) - 1;
+  const std::size_t quarter = (std::size_t) 1 << (e - 2);
+  const unsigned m = (bytes - ((std::size_t) 1 << e) + quarter - 1)
+    / quarter;
+
+  index = (e - std::countr_zero(MIN_CAPACITY)) * 4 + m;
+  return ((std::size_t) 1 << e) + m * quarter;
+}
+
+std::size_t
+socialmedia_signer::BufferPool::class_capacity(unsigned index)
+{
+  if (index == 0) return MIN_CAPACITY;
+
+  const unsigned e = (index - 1) / 4 + std::countr_zero(MIN_CAPACITY);
+  const unsigned m = (index - 1) % 4 + 1;
+
+  return ((std::size_t) 4 + m) << (e - 2);
+}
+
+void*
+socialmedia_signer::BufferPool::allocate(std::size_t capacity)
+{
+  this->stats.allocations++;
+
+  if (capacity < MMAP_THRESHOLD) {
+    void* result = std::aligned_alloc(ALIGNMENT, capacity);
+    if (result == nullptr)
+      Log::fatal(ustr::format("Could not allocate {} bytes!", capacity));
+
+    return result;
+  }
+
+  void* result = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+  if (this->use_hugetlb && capacity % MMAP_THRESHOLD == 0) {
+    result = mmap(nullptr, capacity, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (result != MAP_FAILED) this->stats.hugetlb++;
+  }
+#endif
+
+  /* No huge pages reserved by the kernel?  Fallback.  */
+  if (result == MAP_FAILED) {
+    result = mmap(nullptr, capacity, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  }
+  if (result == MAP_FAILED)
+    Log::fatal(ustr::format("Could not map {} bytes!", capacity));
+
+  return result;
+}
+
+void
+socialmedia_signer::BufferPool::deallocate(void* buffer,
+                                           std::size_t capacity)
+{
+  if (capacity < MMAP_THRESHOLD)
+    std::free(buffer);
+  else
+    munmap(buffer, capacity);
+}
+
+/* ***************************************************************  */
+
+void*
+socialmedia_signer::BufferPool::acquire(std::size_t bytes,
+                                        std::size_t& capacity)
+{
+  unsigned index;
+  capacity = BufferPool::size_class(bytes, index);
+
+  std::lock_guard<std::mutex> lock(this->mutex);
+
+  if (index < this->free_lists.size()
+      && !this->free_lists[index].empty()) {
+    void* result = this->free_lists[index].back();
+    this->free_lists[index].pop_back();
+
+    this->stats.reuses++;
+    this->stats.cached_bytes -= capacity;
+    Metrics::set(Metrics::Gauge::BUFFERPOOL_CACHED_BYTES,
+                 this->stats.cached_bytes);
+
+    return result;
+  }
+
+  return this->allocate(capacity);
+}
+
+void
+socialmedia_signer::BufferPool::recycle(void* buffer,
+                                        std::size_t capacity)
+{
+  if (buffer == nullptr) return;
+
+  unsigned index;
+  if (BufferPool::size_class(capacity, index) != capacity)
+    Log::fatal(u8"BufferPool::recycle(): foreign buffer!");
+
+  std::lock_guard<std::mutex> lock(this->mutex);
+
+  if (this->stats.cached_bytes + capacity > this->max_cached) {
+    this->deallocate(buffer, capacity);
+    return;
+  }
+
+  if (index >= this->free_lists.size())
+    this->free_lists.resize(index + 1);
+
+  this->free_lists[index].push_back(buffer);
+  this->stats.cached_bytes += capacity;
+  Metrics::set(Metrics::Gauge::BUFFERPOOL_CACHED_BYTES,
+               this->stats.cached_bytes);
+}
+
+socialmedia_signer::BufferPool::Stats
+socialmedia_signer::BufferPool::get_stats() const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+
+  return this->stats;
+}
+
+/* ***************************************************************  */
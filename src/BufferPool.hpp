@@ -0,0 +1,115 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef BUFFERPOOL_HPP__
+#define BUFFERPOOL_HPP__
+
+#include "common.hpp"
+
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/**
+ * Singleton class which can be accessed via BufferPool::get().  It
+ * recycles large, aligned memory buffers, i.e. for ::PixelBuffer´s,
+ * instead of returning them to the allocator.
+ *
+ * Requested sizes are rounded up to size classes with 4 steps per
+ * power of two, so the waste is at most 25%.  Buffers of at least
+ * BufferPool::MMAP_THRESHOLD bytes are mapped via MMAP(), optionally
+ * backed by huge pages (MAP_HUGETLB) if available.
+ */
+class BufferPool
+{
+public:
+
+  struct Stats {
+    unsigned long allocations;
+    unsigned long reuses;
+    unsigned long hugetlb;
+
+    std::size_t cached_bytes;
+  };
+
+  /** Alignment of all buffers, a cache line and AVX-512 vector.  */
+  static constexpr std::size_t ALIGNMENT = 64;
+
+  /** Smallest size class.  */
+  static constexpr std::size_t MIN_CAPACITY = 4096;
+  /** Size of a huge page on x86_64, MMAP() from here.  */
+  static constexpr std::size_t MMAP_THRESHOLD = 2UL << 20;
+
+  /** Default maximum of unused bytes kept by BufferPool::init().  */
+  static constexpr std::size_t DEFAULT_MAX_CACHED = 256UL << 20;
+
+  /* -------------------------------------------------------------  */
+
+  /* Singleton class  */
+  static void init(bool use_hugetlb = false,
+                   std::size_t max_cached = DEFAULT_MAX_CACHED);
+  static void release();
+
+  /* Get instance of singleton  */
+  static BufferPool* get();
+
+  /* -------------------------------------------------------------  */
+
+  /**
+   * Returns a buffer of at least `bytes`, aligned to
+   * BufferPool::ALIGNMENT.  The real size is returned in `capacity`
+   * and needs to be passed to BufferPool::recycle().
+   */
+  virtual void* acquire(std::size_t bytes, std::size_t& capacity);
+  virtual void recycle(void* buffer, std::size_t capacity);
+
+  virtual Stats get_stats() const;
+
+  /* -------------------------------------------------------------  */
+private:
+  explicit BufferPool(bool use_hugetlb, std::size_t max_cached);
+  virtual ~BufferPool();
+
+  static BufferPool* instance;
+
+  static std::size_t size_class(std::size_t bytes, unsigned& index);
+  static std::size_t class_capacity(unsigned index);
+
+  void* allocate(std::size_t capacity);
+  void deallocate(void* buffer, std::size_t capacity);
+
+  const bool use_hugetlb;
+  const std::size_t max_cached;
+
+  mutable std::mutex mutex;
+
+  /** Unused buffers, indexed by size class.  */
+  std::vector<std::vector<void*>> free_lists;
+
+  Stats stats;
+};
+
+}
+
+/* ***************************************************************  */
+
+#endif /* BUFFERPOOL_HPP__  */
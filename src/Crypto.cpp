@@ -30,6 +30,7 @@
 #include <openssl/provider.h>
 
 #define CRYPTO_PKEY_NAME           "RSA-PSS"
+#define CRYPTO_DIGEST_NAME         "SHA2-256"
 
 /* ***************************************************************  */
 
@@ -50,6 +51,33 @@ socialmedia_signer::Crypto::instance = nullptr;
 
 static OSSL_LIB_CTX* this_ossl_libctx        = nullptr;
 static const char*   this_ossl_pkeyctx_propq = nullptr;
+static EVP_MD*       this_ossl_digest        = nullptr;
+
+/* -------------------------------------------------------------------
+ * OpenSSL allocates by its own, accounted by Alloc if enabled.
+ */
+
+static void*
+_crypto_malloc(std::size_t size, [[maybe_unused]] const char* file,
+               [[maybe_unused]] int line)
+{
+  return socialmedia_signer::Alloc::allocate(size);
+}
+
+static void*
+_crypto_realloc(void* ptr, std::size_t size,
+                [[maybe_unused]] const char* file,
+                [[maybe_unused]] int line)
+{
+  return socialmedia_signer::Alloc::reallocate(ptr, size);
+}
+
+static void
+_crypto_free(void* ptr, [[maybe_unused]] const char* file,
+             [[maybe_unused]] int line)
+{
+  socialmedia_signer::Alloc::deallocate(ptr);
+}
 
 /* ***************************************************************  */
 
@@ -116,12 +144,22 @@ socialmedia_signer::Crypto::CryptoErr::set_reason(const ustr& reason)
     this->data = u8"-> " + this->data;
 
   // TODO
-  Log::debug(ustr::format("******* {}:{}: [{}]::{}() {} {} (flags 0x{:08x})", this->file_name, this->file_line, this->lib_name, this->func_name, this->lib_reason, this->data, (unsigned) this->flags));
-
-  Error::set_reason(ustr::format(
-    "Crypto:{}(code 0x{:08x}, {:+} others): {} ({})",
-    this->lib_name, this->error_code, this->count_others, reason,
-    this->lib_reason));
+  LOG_DEBUG(CRYPTO, "******* {}:{}: [{}]::{}() {} {} (flags 0x{:08x})",
+    this->file_name, this->file_line, this->lib_name, this->func_name,
+    this->lib_reason, this->data, (unsigned) this->flags);
+
+  ustr_builder out(this->lib_name.length() + reason.length()
+                   + this->lib_reason.length() + 48);
+  out += U"Crypto:";
+  out += this->lib_name;
+  out.append_format("(code 0x{:08x}, {:+} others): ",
+                    this->error_code, this->count_others);
+  out += reason;
+  out += U" (";
+  out += this->lib_reason;
+  out += U')';
+
+  Error::set_reason(out.finish());
 }
 
 /* ***************************************************************  */
@@ -140,6 +178,13 @@ socialmedia_signer::Crypto::Crypto()
 
   this_ossl_pkeyctx_propq = nullptr;
 
+  /* Fails if OpenSSL allocated already, then it is just not counted.  */
+  if (Alloc::is_enabled()
+      && CRYPTO_set_mem_functions(_crypto_malloc, _crypto_realloc,
+                                  _crypto_free) == 0) {
+    Log::warn(u8"Could not account OpenSSL allocations to Crypto!");
+  }
+
   /* Optimizable, i.e. do not load all ciphers and digests.  Config
    * load needed, for CA?
    *
@@ -158,6 +203,14 @@ socialmedia_signer::Crypto::Crypto()
     Log::fatal(CryptoErr(u8"Could not OPENSSL_init_ssl()!").uwhat());
   }
 
+  /* Fetch once, explicit fetching per call is expensive.  */
+  this_ossl_digest = EVP_MD_fetch(this_ossl_libctx, CRYPTO_DIGEST_NAME,
+                                  this_ossl_pkeyctx_propq);
+  if (this_ossl_digest == nullptr) {
+    Log::fatal(CryptoErr(u8"Could not fetch OpenSSL "
+                         CRYPTO_DIGEST_NAME u8" digest!").uwhat());
+  }
+
   // TODO
 #if 0
   if (OSSL_PROVIDER_available(this_ossl_libctx, "fips") == 0) {
@@ -186,6 +239,9 @@ socialmedia_signer::Crypto::Crypto()
 
 socialmedia_signer::Crypto::~Crypto()
 {
+  EVP_MD_free(this_ossl_digest);
+  this_ossl_digest = nullptr;
+
   OPENSSL_cleanup();
 }
 
@@ -197,6 +253,8 @@ socialmedia_signer::Crypto::init()
   if (Crypto::instance != nullptr)
     Log::fatal(u8"Crypto::init(): double call!");
 
+  Trace::Span span("crypto init", "crypto");
+  Alloc::Scope scope(Alloc::Tag::CRYPTO);
   Crypto::instance = new Crypto();
 }
 
@@ -220,6 +278,12 @@ socialmedia_signer::Crypto::get()
 struct socialmedia_signer::Crypto::private_key*
 socialmedia_signer::Crypto::priv_generate_new() const
 {
+  Trace::Span span("keygen", "crypto");
+  Metrics::Timer timer(Metrics::Histogram::KEYGEN);
+  Profile::Scope scope(Profile::Stage::CRYPTO);
+  Metrics::add(Metrics::Counter::KEYS_GENERATED);
+  Alloc::Scope alloc_scope(Alloc::Tag::CRYPTO);
+
   EVP_PKEY_CTX* pkey_ctx
     = EVP_PKEY_CTX_new_from_name(this_ossl_libctx, CRYPTO_PKEY_NAME,
                                  this_ossl_pkeyctx_propq);
@@ -242,3 +306,26 @@ socialmedia_signer::Crypto::priv_delete(struct private_key* priv_key)
 }
 
 /* ***************************************************************  */
+
+socialmedia_signer::Result<void>
+socialmedia_signer::Crypto::digest(std::uint8_t (&md)[DIGEST_LEN],
+  const void* data, std::size_t len) const
+{
+  Metrics::Timer timer(Metrics::Histogram::DIGEST);
+  Profile::Scope scope(Profile::Stage::CRYPTO);
+  Alloc::Scope alloc_scope(Alloc::Tag::CRYPTO);
+  Metrics::add(Metrics::Counter::DIGEST_BYTES, len);
+
+  unsigned int md_len = 0;
+
+  if (EVP_Digest(data, len, md, &md_len, this_ossl_digest, nullptr) == 0
+      || md_len != DIGEST_LEN) {
+    /* Not thrown, just collects the OpenSSL error queue.  */
+    return Failure(
+      CryptoErr(u8"Could not calculate " CRYPTO_DIGEST_NAME u8"!"));
+  }
+
+  return Result<void>();
+}
+
+/* ***************************************************************  */
@@ -21,6 +21,8 @@
 
 #include "common.hpp"
 
+#include <cstdint>
+
 /* ***************************************************************  */
 
 namespace socialmedia_signer {
@@ -61,6 +63,9 @@ public:
 
   struct private_key;
 
+  /** Length of Crypto::digest() in bytes.  */
+  static constexpr std::size_t DIGEST_LEN = 32;
+
   /* -------------------------------------------------------------  */
 
   /* Singleton class  */
@@ -76,6 +81,15 @@ public:
   virtual void priv_delete(struct private_key* priv_key) const;
 
   /* -------------------------------------------------------------  */
+
+  /**
+   * SHA-256 of `data`, used to address cached data by content.
+   * Returns the OpenSSL error as Failure.
+   */
+  virtual Result<void> digest(std::uint8_t (&md)[DIGEST_LEN],
+    const void* data, std::size_t len) const;
+
+  /* -------------------------------------------------------------  */
 private:
   explicit Crypto();
   virtual ~Crypto();
@@ -26,6 +26,13 @@ socialmedia_signer::Error::Error(const ustr& reason, int exit_code)
   this->set_reason(reason);
 }
 
+socialmedia_signer::Error::Error(ustr&& reason, int exit_code)
+  :std::runtime_error(""), reason(std::move(reason)), _reason_buf(),
+   exit_code(exit_code)
+{
+  this->reason.out_utf8(this->_reason_buf);
+}
+
 socialmedia_signer::Error::~Error()
 {}
 
@@ -42,6 +49,13 @@ socialmedia_signer::Error::set_reason(const ustr& reason)
   this->reason.out_utf8(this->_reason_buf);
 }
 
+void
+socialmedia_signer::Error::set_reason(ustr&& reason)
+{
+  this->reason = std::move(reason);
+  this->reason.out_utf8(this->_reason_buf);
+}
+
 /* ***************************************************************  */
 
 const char*
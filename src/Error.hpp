@@ -32,8 +32,13 @@ class Error: public std::runtime_error
 {
 public:
   explicit Error(const ustr& reason, int exit_code = 1);
+  explicit Error(ustr&& reason, int exit_code = 1);
   virtual ~Error();
 
+  /* The virtual destructor would suppress the implicit moves.  */
+  Error(const Error& other) = default;
+  Error(Error&& other) noexcept = default;
+
   virtual const char* what() const noexcept override;
   virtual const ustr& uwhat() const noexcept;
 
@@ -43,6 +48,8 @@ protected:
   explicit Error(int exit_code = 1);
 
   virtual void set_reason(const ustr& reason);
+  /** Takes a reason which was built already, without copying it.  */
+  void set_reason(ustr&& reason);
 
 private:
   ustr reason;
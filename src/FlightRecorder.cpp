@@ -0,0 +1,422 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "FlightRecorder.hpp"
+
+#include "common.hpp"
+
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <new>
+#include <ctime>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/** One cache line.  */
+struct flight_entry {
+  std::int64_t time_ns;
+  const char* name;
+  std::uint64_t value;
+  FlightRecorder::Kind kind;
+  std::uint8_t detail_len;
+  char detail[FlightRecorder::DETAIL_LEN];
+};
+
+static_assert(sizeof(flight_entry) == 64, "flight_entry: 64 bytes");
+
+/**
+ * Ring of one thread, written by this thread only.  Rings are never
+ * freed, a ring of an exited thread is taken over by the next new
+ * thread.
+ */
+struct flight_ring {
+  std::atomic<bool> in_use;
+  /** Number of recorded events, the next one is at `next % ENTRIES`.  */
+  std::atomic<std::uint32_t> next;
+  pid_t tid;
+  std::atomic<const char*> name;
+
+  flight_ring* list_next;
+
+  flight_entry entries[FlightRecorder::ENTRIES];
+};
+
+static std::atomic<flight_ring*> _flight_rings(nullptr);
+
+/** Set by FlightRecorder::init(), read by the signal handlers.  */
+static char _flight_path[PATH_MAX] = "";
+static std::atomic<bool> _flight_dumped(false);
+
+static const int _flight_signals[] = {
+  SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT,
+};
+static const char* const _flight_signal_names[] = {
+  "SIGSEGV", "SIGBUS", "SIGILL", "SIGFPE", "SIGABRT",
+};
+static struct sigaction _flight_old_actions[std::size(_flight_signals)];
+
+/** Per thread, so the handlers run even on a stack overflow.  */
+static constexpr std::size_t _FLIGHT_ALTSTACK_SIZE = 64 * 1024;
+
+static flight_ring*
+_flight_acquire()
+{
+  const pid_t tid = static_cast<pid_t>(::syscall(SYS_gettid));
+
+  for (flight_ring* ring = _flight_rings.load(); ring != nullptr;
+       ring = ring->list_next) {
+    bool expected = false;
+    if (ring->in_use.compare_exchange_strong(expected, true)) {
+      ring->name.store(nullptr, std::memory_order_relaxed);
+      ring->tid = tid;
+      ring->next.store(0, std::memory_order_release);
+      return ring;
+    }
+  }
+
+  /* Not by `operator new`, which is accounted by Alloc.  */
+  void* memory = std::calloc(1, sizeof(flight_ring));
+  if (memory == nullptr) return nullptr;
+
+  flight_ring* ring = new (memory) flight_ring();
+  ring->in_use.store(true);
+  ring->tid = tid;
+
+  ring->list_next = _flight_rings.load();
+  while (!_flight_rings.compare_exchange_weak(ring->list_next, ring));
+
+  return ring;
+}
+
+/**
+ * Installs an alternate signal stack for the calling thread, the
+ * caller frees it after disabling it by _flight_altstack_release().
+ */
+static void*
+_flight_altstack_acquire()
+{
+  /* Not by `operator new`, which is accounted by Alloc.  */
+  void* memory = std::malloc(_FLIGHT_ALTSTACK_SIZE);
+  if (memory == nullptr) return nullptr;
+
+  stack_t altstack = {};
+  altstack.ss_sp   = memory;
+  altstack.ss_size = _FLIGHT_ALTSTACK_SIZE;
+  if (::sigaltstack(&altstack, nullptr) != 0) {
+    std::free(memory);
+    return nullptr;
+  }
+
+  return memory;
+}
+
+static void
+_flight_altstack_release(void* memory)
+{
+  if (memory == nullptr) return;
+
+  stack_t altstack = {};
+  altstack.ss_flags = SS_DISABLE;
+  if (::sigaltstack(&altstack, nullptr) == 0) std::free(memory);
+}
+
+/**
+ * Releases the ring and the alternate signal stack of the calling
+ * thread on its exit.
+ */
+struct flight_handle {
+  flight_ring* ring = nullptr;
+  void* altstack = nullptr;
+
+  ~flight_handle()
+  {
+    _flight_altstack_release(this->altstack);
+
+    if (this->ring != nullptr)
+      this->ring->in_use.store(false, std::memory_order_release);
+  }
+};
+
+static thread_local flight_handle _flight_handle;
+
+static inline flight_ring*
+_flight_get_ring()
+{
+  if (_flight_handle.ring == nullptr) {
+    _flight_handle.ring = _flight_acquire();
+    if (_flight_handle.altstack == nullptr)
+      _flight_handle.altstack = _flight_altstack_acquire();
+  }
+
+  return _flight_handle.ring;
+}
+
+/* -------------------------------------------------------------------
+ * Output of FlightRecorder::dump(), async signal safe, so without
+ * allocation and without stdio.
+ */
+
+struct flight_out {
+  int fd;
+  std::size_t len;
+  char buf[4096];
+};
+
+static void
+_flight_flush(flight_out& out)
+{
+  const char* data = out.buf;
+  while (out.len > 0) {
+    const ssize_t written = ::write(out.fd, data, out.len);
+    if (written < 0 && errno == EINTR) continue;
+    if (written <= 0) break;
+
+    data += written;
+    out.len -= written;
+  }
+  out.len = 0;
+}
+
+static void
+_flight_put(flight_out& out, const char* str, std::size_t len)
+{
+  for (std::size_t i=0; i < len; i++) {
+    if (out.len == sizeof(out.buf)) _flight_flush(out);
+    out.buf[out.len++] = str[i];
+  }
+}
+
+static void
+_flight_put(flight_out& out, const char* str)
+{
+  _flight_put(out, str, std::strlen(str));
+}
+
+static void
+_flight_put_uint(flight_out& out, std::uint64_t value,
+                 unsigned min_digits = 1)
+{
+  char digits[20];
+  unsigned count = 0;
+
+  do {
+    digits[sizeof(digits) - ++count] = '0' + value % 10;
+    value /= 10;
+  } while (value > 0 || count < min_digits);
+
+  _flight_put(out, digits + sizeof(digits) - count, count);
+}
+
+/** Nanoseconds as milliseconds with 3 decimals.  */
+static void
+_flight_put_ms(flight_out& out, std::int64_t ns)
+{
+  if (ns < 0) {
+    _flight_put(out, "-", 1);
+    ns = -ns;
+  }
+
+  _flight_put_uint(out, ns / 1000000);
+  _flight_put(out, ".", 1);
+  _flight_put_uint(out, ns / 1000 % 1000, 3);
+  _flight_put(out, " ms");
+}
+
+static void
+_flight_put_entry(flight_out& out, const flight_entry& entry,
+                  std::int64_t now_ns)
+{
+  static const char* const KINDS[] = {"begin ", "end   ", "event "};
+
+  _flight_put(out, "  ");
+  _flight_put_ms(out, entry.time_ns - now_ns);
+  _flight_put(out, "  ");
+  _flight_put(out, KINDS[static_cast<unsigned>(entry.kind)]);
+  _flight_put(out, entry.name != nullptr? entry.name: "?");
+
+  if (entry.kind == FlightRecorder::Kind::END) {
+    _flight_put(out, "  ");
+    _flight_put_ms(out, static_cast<std::int64_t>(entry.value));
+  } else if (entry.kind == FlightRecorder::Kind::EVENT) {
+    _flight_put(out, "  ");
+    _flight_put_uint(out, entry.value);
+  }
+
+  if (entry.detail_len > 0) {
+    _flight_put(out, "  ");
+    _flight_put(out, entry.detail,
+      std::min<std::size_t>(entry.detail_len, sizeof(entry.detail)));
+  }
+  _flight_put(out, "\n", 1);
+}
+
+static void
+_flight_signal(int sig)
+{
+  const char* reason = "signal";
+  for (std::size_t i=0; i < std::size(_flight_signals); i++) {
+    if (_flight_signals[i] == sig) reason = _flight_signal_names[i];
+  }
+
+  FlightRecorder::dump(reason);
+
+  /* SA_RESETHAND restored the default action, which terminates as
+   * soon as the handler returns.  */
+  ::raise(sig);
+}
+
+} /* namespace socialmedia_signer  */
+
+/* ***************************************************************  */
+
+void
+socialmedia_signer::FlightRecorder::init(const char* path)
+{
+  /* Not in /tmp, where others could plant a symlink at a predictable
+   * name.  */
+  const char* dir = std::getenv("XDG_RUNTIME_DIR");
+  if (dir == nullptr || dir[0] == '\0') dir = ".";
+
+  if (path != nullptr) {
+    std::snprintf(_flight_path, sizeof(_flight_path), "%s", path);
+  } else {
+    std::snprintf(_flight_path, sizeof(_flight_path),
+                  "%s/socialmedia-signer.%d.flight", dir,
+                  static_cast<int>(::getpid()));
+  }
+
+  struct sigaction action = {};
+  action.sa_handler = _flight_signal;
+  action.sa_flags   = SA_RESETHAND | SA_ONSTACK;
+  sigemptyset(&action.sa_mask);
+
+  for (std::size_t i=0; i < std::size(_flight_signals); i++)
+    ::sigaction(_flight_signals[i], &action, &_flight_old_actions[i]);
+
+  FlightRecorder::name_thread("main");
+}
+
+void
+socialmedia_signer::FlightRecorder::release()
+{
+  for (std::size_t i=0; i < std::size(_flight_signals); i++)
+    ::sigaction(_flight_signals[i], &_flight_old_actions[i], nullptr);
+}
+
+/* ---------------------------------------------------------------  */
+
+void
+socialmedia_signer::FlightRecorder::record(Kind kind, const char* name,
+  std::uint64_t value, std::string_view detail, clock::time_point time)
+  noexcept
+{
+  flight_ring* ring = _flight_get_ring();
+  if (ring == nullptr) return;
+
+  const std::uint32_t next = ring->next.load(std::memory_order_relaxed);
+  flight_entry& entry = ring->entries[next % FlightRecorder::ENTRIES];
+
+  if (detail.length() > FlightRecorder::DETAIL_LEN)
+    detail.remove_prefix(detail.length() - FlightRecorder::DETAIL_LEN);
+
+  entry.time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    time.time_since_epoch()).count();
+  entry.name       = name;
+  entry.value      = value;
+  entry.kind       = kind;
+  entry.detail_len = static_cast<std::uint8_t>(detail.length());
+  std::memcpy(entry.detail, detail.data(), detail.length());
+
+  ring->next.store(next + 1, std::memory_order_release);
+}
+
+void
+socialmedia_signer::FlightRecorder::name_thread(const char* name)
+  noexcept
+{
+  flight_ring* ring = _flight_get_ring();
+  if (ring != nullptr) ring->name.store(name, std::memory_order_relaxed);
+}
+
+void
+socialmedia_signer::FlightRecorder::dump(const char* reason) noexcept
+{
+  if (_flight_path[0] == '\0' || _flight_dumped.exchange(true)) return;
+
+  /* CLOCK_MONOTONIC is the steady_clock of LIBSTDC++.  */
+  struct timespec now;
+  ::clock_gettime(CLOCK_MONOTONIC, &now);
+  const std::int64_t now_ns = now.tv_sec * 1000000000LL + now.tv_nsec;
+
+  flight_out out;
+  out.len = 0;
+  out.fd = ::open(_flight_path,
+    O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+  if (out.fd < 0) return;
+
+  _flight_put(out, "socialmedia-signer flight recorder, pid ");
+  _flight_put_uint(out, static_cast<std::uint64_t>(::getpid()));
+  _flight_put(out, ": ");
+  _flight_put(out, reason);
+  _flight_put(out, "\n");
+
+  for (const flight_ring* ring = _flight_rings.load(); ring != nullptr;
+       ring = ring->list_next) {
+    const std::uint32_t next = ring->next.load(std::memory_order_acquire);
+    const char* name = ring->name.load(std::memory_order_relaxed);
+
+    _flight_put(out, "\nthread ");
+    _flight_put_uint(out, static_cast<std::uint64_t>(ring->tid));
+    if (name != nullptr) {
+      _flight_put(out, " \"");
+      _flight_put(out, name);
+      _flight_put(out, "\"");
+    }
+    if (!ring->in_use.load(std::memory_order_relaxed))
+      _flight_put(out, " (exited)");
+    _flight_put(out, "\n");
+
+    const std::uint32_t first
+      = next > FlightRecorder::ENTRIES? next - FlightRecorder::ENTRIES: 0;
+    for (std::uint32_t i=first; i < next; i++) {
+      _flight_put_entry(out, ring->entries[i % FlightRecorder::ENTRIES],
+                        now_ns);
+    }
+  }
+
+  _flight_flush(out);
+  ::close(out.fd);
+
+  out.fd = STDERR_FILENO;
+  _flight_put(out, "flight recorder: ");
+  _flight_put(out, _flight_path);
+  _flight_put(out, "\n");
+  _flight_flush(out);
+}
+
+/* ***************************************************************  */
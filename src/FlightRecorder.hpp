@@ -0,0 +1,107 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef FLIGHTRECORDER_HPP__
+#define FLIGHTRECORDER_HPP__
+
+#include <chrono>
+#include <string_view>
+#include <cstdint>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/**
+ * Abstract class which includes static methods for recording the
+ * recent events of each thread, to diagnose crashes.
+ *
+ * Always on: every thread writes into its own ring of the last
+ * FlightRecorder::ENTRIES events, without locking or allocation after
+ * its first event.  Each Trace::Span records its begin and its end
+ * with duration, a `detail` like a file name is kept with its last
+ * FlightRecorder::DETAIL_LEN bytes.  Other events are recorded
+ * explicitly:
+ * ```cpp
+ *   FlightRecorder::record(FlightRecorder::Kind::EVENT, "request", id);
+ * ```
+ * The rings of all threads are written to a file by
+ * FlightRecorder::dump(), which is called by Log::fatal() and by the
+ * handlers of SIGSEGV, SIGBUS, SIGILL, SIGFPE and SIGABRT, installed
+ * by FlightRecorder::init().  The handlers run on an alternate stack
+ * of each thread, installed with its ring by its first event.
+ */
+class FlightRecorder
+{
+public:
+  /* Abstract class  */
+  FlightRecorder()                      = delete;
+  FlightRecorder(FlightRecorder& other) = delete;
+  virtual ~FlightRecorder()             = 0;
+
+  using clock = std::chrono::steady_clock;
+
+  /** Events per thread, the oldest ones are overwritten.  */
+  static constexpr unsigned ENTRIES = 256;
+  /** Bytes of a `detail`, the end is kept.  */
+  static constexpr unsigned DETAIL_LEN = 38;
+
+  enum class Kind: unsigned char {
+    /** `value` is unused.  */
+    BEGIN,
+    /** `value` is the duration in nanoseconds.  */
+    END,
+    /** `value` is an identifier or a count.  */
+    EVENT
+  };
+
+  /* -------------------------------------------------------------  */
+
+  /**
+   * Installs the signal handlers.  The rings are dumped to `path`, or
+   * to `socialmedia-signer.<pid>.flight` in `$XDG_RUNTIME_DIR` or in
+   * the working directory if `path` is nullptr.  An existing file or
+   * symlink is never overwritten, the dump is skipped then.
+   */
+  static void init(const char* path);
+  /** Restores the former signal handlers.  */
+  static void release();
+
+  /**
+   * Records an event of the calling thread at `time`.  `name` needs
+   * to be a string literal.
+   */
+  static void record(Kind kind, const char* name, std::uint64_t value,
+                     std::string_view detail = {},
+                     clock::time_point time = clock::now()) noexcept;
+
+  /** Names the calling thread in the dump, `name` is a literal.  */
+  static void name_thread(const char* name) noexcept;
+
+  /**
+   * Writes the rings of all threads, `reason` first.  Async signal
+   * safe, just the first call writes.
+   */
+  static void dump(const char* reason) noexcept;
+};
+
+}
+
+/* ***************************************************************  */
+
+#endif /* FLIGHTRECORDER_HPP__  */
@@ -0,0 +1,117 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "Ident.hpp"
+
+/* ***************************************************************  */
+
+std::atomic<const socialmedia_signer::Ident::Entry*>
+socialmedia_signer::Ident::buckets[Ident::BUCKETS] = {};
+
+std::mutex
+socialmedia_signer::Ident::mutex_intern;
+
+std::uint32_t
+socialmedia_signer::Ident::last_id = 0;
+
+/* ***************************************************************  */
+
+const socialmedia_signer::Ident::Entry*
+socialmedia_signer::Ident::find_entry(ustr_view name, std::size_t hash)
+  noexcept
+{
+  /* Entries are complete before they are published with release
+   * semantic, and never change afterwards.
+   */
+  const Entry* cur
+    = Ident::buckets[hash & (BUCKETS-1)].load(std::memory_order_acquire);
+
+  for (; cur != nullptr; cur = cur->next)
+    if (cur->hash == hash && ustr_view(cur->name) == name) return cur;
+
+  return nullptr;
+}
+
+socialmedia_signer::Ident
+socialmedia_signer::Ident::intern(ustr_view name)
+{
+  const std::size_t hash = ustr_hash()(name);
+
+  const Entry* found = Ident::find_entry(name, hash);
+  if (found != nullptr) return Ident(found);
+
+  std::lock_guard<std::mutex> lock(Ident::mutex_intern);
+
+  /* Another thread may have interned it meanwhile.  */
+  found = Ident::find_entry(name, hash);
+  if (found != nullptr) return Ident(found);
+
+  std::atomic<const Entry*>& bucket = Ident::buckets[hash & (BUCKETS-1)];
+  ustr entry_name(name);
+  ustr8 entry_name_utf8(entry_name);
+
+  const Entry* entry = new Entry {
+    bucket.load(std::memory_order_relaxed), hash, ++Ident::last_id,
+    std::move(entry_name), std::move(entry_name_utf8)};
+  bucket.store(entry, std::memory_order_release);
+
+  return Ident(entry);
+}
+
+socialmedia_signer::Ident
+socialmedia_signer::Ident::find(ustr_view name) noexcept
+{
+  return Ident(Ident::find_entry(name, ustr_hash()(name)));
+}
+
+void
+socialmedia_signer::Ident::release()
+{
+  std::lock_guard<std::mutex> lock(Ident::mutex_intern);
+
+  for (std::atomic<const Entry*>& bucket: Ident::buckets) {
+    const Entry* cur = bucket.exchange(nullptr);
+
+    while (cur != nullptr) {
+      const Entry* next = cur->next;
+      delete cur;
+      cur = next;
+    }
+  }
+  Ident::last_id = 0;
+}
+
+/* ---------------------------------------------------------------  */
+
+const socialmedia_signer::ustr&
+socialmedia_signer::Ident::get_name() const
+{
+  if (this->entry == nullptr)
+    Log::fatal(u8"Ident::get_name(): empty identifier!");
+
+  return this->entry->name;
+}
+
+const socialmedia_signer::ustr8&
+socialmedia_signer::Ident::get_name_utf8() const
+{
+  if (this->entry == nullptr)
+    Log::fatal(u8"Ident::get_name_utf8(): empty identifier!");
+
+  return this->entry->name_utf8;
+}
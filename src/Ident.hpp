@@ -0,0 +1,146 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef IDENT_HPP__
+#define IDENT_HPP__
+
+#include "common.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <format>
+#include <cstdint>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/**
+ * Interned identifier, such as a platform id or a parameter name.
+ * Every name is stored once per process, so comparing and hashing
+ * identifiers compares pointers and small integers instead of
+ * strings:
+ *
+ * ```cpp
+ *   const Ident xcom = Ident::intern(U"xcom");
+ *
+ *   Ident::find(U"xcom") == xcom;     // true, lock-free
+ *   xcom.get_id();                    // 1, 2, ... in order of interning
+ * ```
+ *
+ * Ident::find() does not lock, so worker threads may look up
+ * identifiers while others are interned.  Ident::intern() locks, but
+ * only if the name is new.  The names live until Ident::release(),
+ * which is called once at exit, after all users are released.
+ *
+ * Intern identifiers known to the program and what the user passes
+ * in the command-line.  Do not intern untrusted input in bulk, the
+ * table does not shrink.
+ */
+class Ident
+{
+public:
+  /** Empty identifier, see Ident::is_valid().  */
+  constexpr Ident() noexcept: entry(nullptr) {}
+
+  /** Returns the identifier of `name`, interns it if needed.  */
+  static Ident intern(ustr_view name);
+
+  /** Returns an empty identifier if `name` is not interned.  */
+  static Ident find(ustr_view name) noexcept;
+
+  /** Frees all names, no ::Ident may be used afterwards.  */
+  static void release();
+
+  /* -------------------------------------------------------------  */
+
+  bool is_valid() const noexcept { return this->entry != nullptr; }
+
+  /** 1, 2, ... in order of interning, 0 if empty.  */
+  std::uint32_t get_id() const noexcept
+  {
+    return this->entry != nullptr? this->entry->id: 0;
+  }
+
+  /** Must not be empty.  */
+  const ustr& get_name() const;
+  const ustr8& get_name_utf8() const;
+
+  /* Ordered by Ident::get_id(), not alphabetically.  */
+  bool operator==(const Ident& other) const noexcept = default;
+  std::strong_ordering operator<=>(const Ident& other) const noexcept
+  {
+    return this->get_id() <=> other.get_id();
+  }
+
+  /** For unordered containers.  */
+  struct Hash {
+    std::size_t operator()(const Ident& ident) const noexcept
+    {
+      return ident.get_id();
+    }
+  };
+
+private:
+  struct Entry {
+    /** Next entry of the same bucket, immutable once published.  */
+    const Entry* next;
+
+    std::size_t hash;
+    std::uint32_t id;
+
+    ustr name;
+    ustr8 name_utf8;
+  };
+
+  /** Power of 2.  */
+  static constexpr std::size_t BUCKETS = 256;
+
+  explicit Ident(const Entry* entry) noexcept: entry(entry) {}
+
+  static const Entry* find_entry(ustr_view name, std::size_t hash)
+    noexcept;
+
+  /** Heads of the chains, written under Ident::mutex_intern only.  */
+  static std::atomic<const Entry*> buckets[BUCKETS];
+  static std::mutex mutex_intern;
+  static std::uint32_t last_id;
+
+  const Entry* entry;
+};
+
+/* ***************************************************************  */
+} /* namespace socialmedia_signer  */
+
+/*
+ * std::formatter() for socialmedia_signer::Ident, writes its name.
+ */
+
+template<>
+struct std::formatter<socialmedia_signer::Ident, char>
+  : public std::formatter<socialmedia_signer::ustr8, char>
+{
+  auto format(const socialmedia_signer::Ident& ident,
+              std::format_context& ctx) const
+  {
+    return std::formatter<socialmedia_signer::ustr8, char>::format(
+      ident.get_name_utf8(), ctx);
+  }
+};
+
+#endif /* IDENT_HPP__  */
@@ -18,26 +18,663 @@
 
 #include "Image.hpp"
 
+#include "QrCache.hpp"
+
+#include <jpeglib.h>
+#include <png.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <csetjmp>
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#if defined(__x86_64__)
+#  include <emmintrin.h>
+#  define IMAGE_X86
+#endif
+
 /* ***************************************************************  */
 
 const socialmedia_signer::ustr
 socialmedia_signer::Image::EMPTY_IMAGE_STR = u8"<empty>";
 
+const socialmedia_signer::Image::Region
+socialmedia_signer::Image::FULL = {Image::Corner::TOP_LEFT, 0, 0, 0, 0};
+
+const socialmedia_signer::Image::QrStyle
+socialmedia_signer::Image::QR_STYLE_DEFAULT = {
+  QrCode::Ecc::MEDIUM, 4, 4, 0x000000, 0xffffff};
+
+const socialmedia_signer::Image::PngOptions
+socialmedia_signer::Image::PNG_FAST = {1, 0};
+
+const socialmedia_signer::Image::PngOptions
+socialmedia_signer::Image::PNG_SMALL = {9, 0};
+
+const socialmedia_signer::Image::PngOptions
+socialmedia_signer::Image::PNG_DEFAULT = {6, 0};
+
+/* -------------------------------------------------------------------
+ * LIBJPEG and LIBPNG are reporting errors via LONGJMP().  Keep all
+ * objects with non-trivial destructors outside of the SETJMP() scope.
+ */
+
+namespace socialmedia_signer {
+
+struct image_jpeg_err {
+  struct jpeg_error_mgr pub;
+  std::jmp_buf jmp;
+  char msg[JMSG_LENGTH_MAX];
+};
+
+static void _jpeg_error_exit(j_common_ptr cinfo)
+{
+  image_jpeg_err* err = reinterpret_cast<image_jpeg_err*>(cinfo->err);
+
+  (*cinfo->err->format_message)(cinfo, err->msg);
+  std::longjmp(err->jmp, 1);
+}
+
+static void _jpeg_output_message([[maybe_unused]] j_common_ptr cinfo)
+{
+  /* Do not print corrupt data warnings to STDERR.  */
+}
+
+struct image_png_err {
+  char msg[256];
+};
+
+static void _png_error(png_structp png, png_const_charp msg)
+{
+  image_png_err* err
+    = reinterpret_cast<image_png_err*>(png_get_error_ptr(png));
+
+  std::strncpy(err->msg, msg, sizeof(err->msg) - 1);
+  err->msg[sizeof(err->msg) - 1] = '\0';
+  png_longjmp(png, 1);
+}
+
+static void _png_warning([[maybe_unused]] png_structp png,
+                         [[maybe_unused]] png_const_charp msg)
+{
+}
+
+/** Microseconds since `start`, for the debug output.  */
+static inline long long
+_image_us_since(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - start).count();
+}
+
+/* -------------------------------------------------------------------
+ * PNG encoder of Image::save_png().  The filters read the unfiltered
+ * rows only, so there is no loop carried dependency and they run on
+ * 16 bytes at once with SSE2, the baseline of x86-64.  The scalar
+ * loops do the remainder and all on other architectures.
+ */
+
+/** Uncompressed bytes per DEFLATE block, same as PIGZ.  */
+#define IMAGE_PNG_BLOCK_SIZE       (128 * 1024)
+/** DEFLATE window, used as dictionary of the next block.  */
+#define IMAGE_PNG_DICT_SIZE        (32 * 1024)
+
+enum image_png_filter: std::uint8_t {
+  IMAGE_PNG_FILTER_NONE = 0,
+  IMAGE_PNG_FILTER_SUB,
+  IMAGE_PNG_FILTER_UP,
+  IMAGE_PNG_FILTER_AVERAGE,
+  IMAGE_PNG_FILTER_PAETH
+};
+
+#ifdef IMAGE_X86
+
+/*
+ * Each filter starts at byte `i` and returns the index where the
+ * scalar loop goes on.  `i` is at least `bpp`, if the filter reads
+ * the left neighbour.
+ */
+
+static std::size_t
+_png_sub_sse2(const std::uint8_t* cur, std::size_t i, std::size_t n,
+              unsigned bpp, std::uint8_t* out)
+{
+  for (; i + 16 <= n; i += 16) {
+    const __m128i x
+      = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + i));
+    const __m128i a = _mm_loadu_si128(
+      reinterpret_cast<const __m128i*>(cur + i - bpp));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                     _mm_sub_epi8(x, a));
+  }
+
+  return i;
+}
+
+static std::size_t
+_png_up_sse2(const std::uint8_t* cur, const std::uint8_t* prev,
+             std::size_t i, std::size_t n, std::uint8_t* out)
+{
+  for (; i + 16 <= n; i += 16) {
+    const __m128i x
+      = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + i));
+    const __m128i b
+      = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                     _mm_sub_epi8(x, b));
+  }
+
+  return i;
+}
+
+static std::size_t
+_png_average_sse2(const std::uint8_t* cur, const std::uint8_t* prev,
+                  std::size_t i, std::size_t n, unsigned bpp,
+                  std::uint8_t* out)
+{
+  const __m128i one = _mm_set1_epi8(1);
+
+  for (; i + 16 <= n; i += 16) {
+    const __m128i x
+      = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + i));
+    const __m128i a = _mm_loadu_si128(
+      reinterpret_cast<const __m128i*>(cur + i - bpp));
+    const __m128i b
+      = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + i));
+
+    /* AVG_EPU8() rounds up, the filter rounds down.  */
+    const __m128i avg = _mm_sub_epi8(
+      _mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                     _mm_sub_epi8(x, avg));
+  }
+
+  return i;
+}
+
+/** Paeth predictor of 8 bytes, widened to 16 bit.  */
+static inline __m128i
+_png_paeth_epi16(__m128i a, __m128i b, __m128i c)
+{
+  const __m128i zero = _mm_setzero_si128();
+  auto abs = [zero](__m128i v) {
+    return _mm_max_epi16(v, _mm_sub_epi16(zero, v));
+  };
+
+  const __m128i pa = abs(_mm_sub_epi16(b, c));
+  const __m128i pb = abs(_mm_sub_epi16(a, c));
+  const __m128i pc = abs(_mm_sub_epi16(_mm_add_epi16(a, b),
+                                       _mm_add_epi16(c, c)));
+
+  const __m128i not_a = _mm_or_si128(_mm_cmpgt_epi16(pa, pb),
+                                     _mm_cmpgt_epi16(pa, pc));
+  const __m128i not_b = _mm_cmpgt_epi16(pb, pc);
+
+  const __m128i b_or_c = _mm_or_si128(_mm_and_si128(not_b, c),
+                                      _mm_andnot_si128(not_b, b));
+  return _mm_or_si128(_mm_and_si128(not_a, b_or_c),
+                      _mm_andnot_si128(not_a, a));
+}
+
+static std::size_t
+_png_paeth_sse2(const std::uint8_t* cur, const std::uint8_t* prev,
+                std::size_t i, std::size_t n, unsigned bpp,
+                std::uint8_t* out)
+{
+  const __m128i zero = _mm_setzero_si128();
+
+  for (; i + 16 <= n; i += 16) {
+    const __m128i x
+      = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + i));
+    const __m128i a = _mm_loadu_si128(
+      reinterpret_cast<const __m128i*>(cur + i - bpp));
+    const __m128i b
+      = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + i));
+    const __m128i c = _mm_loadu_si128(
+      reinterpret_cast<const __m128i*>(prev + i - bpp));
+
+    const __m128i lo = _png_paeth_epi16(_mm_unpacklo_epi8(a, zero),
+      _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero));
+    const __m128i hi = _png_paeth_epi16(_mm_unpackhi_epi8(a, zero),
+      _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                     _mm_sub_epi8(x, _mm_packus_epi16(lo, hi)));
+  }
+
+  return i;
+}
+
+/** Adds the absolute values of the signed bytes `out` to `sum`.  */
+static std::size_t
+_png_sum_sse2(const std::uint8_t* out, std::size_t n,
+              std::uint64_t& sum)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i acc = zero;
+
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const __m128i v
+      = _mm_loadu_si128(reinterpret_cast<const __m128i*>(out + i));
+    /* MIN_EPU8(v, -v) is the absolute value, also for -128.  */
+    const __m128i abs = _mm_min_epu8(v, _mm_sub_epi8(zero, v));
+    acc = _mm_add_epi64(acc, _mm_sad_epu8(abs, zero));
+  }
+
+  sum += static_cast<std::uint64_t>(_mm_cvtsi128_si64(acc))
+    + static_cast<std::uint64_t>(
+        _mm_cvtsi128_si64(_mm_unpackhi_epi64(acc, acc)));
+  return i;
+}
+
+#endif /* IMAGE_X86  */
+
+/**
+ * Applies `filter` to the `n` bytes of row `cur` into `out`.
+ * Returns the sum of absolute values of the signed result, the
+ * heuristic which is recommended by the PNG specification.
+ */
+static std::uint64_t
+_png_filter(image_png_filter filter, const std::uint8_t* cur,
+            const std::uint8_t* prev, std::size_t n, unsigned bpp,
+            std::uint8_t* out)
+{
+  const std::size_t head = std::min<std::size_t>(bpp, n);
+  std::size_t i = head;
+
+  switch (filter) {
+  case IMAGE_PNG_FILTER_NONE:
+    std::memcpy(out, cur, n);
+    break;
+  case IMAGE_PNG_FILTER_SUB:
+    std::memcpy(out, cur, head);
+#ifdef IMAGE_X86
+    i = _png_sub_sse2(cur, i, n, bpp, out);
+#endif
+    for (; i < n; i++)
+      out[i] = cur[i] - cur[i - bpp];
+    break;
+  case IMAGE_PNG_FILTER_UP:
+    i = 0;
+#ifdef IMAGE_X86
+    i = _png_up_sse2(cur, prev, i, n, out);
+#endif
+    for (; i < n; i++)
+      out[i] = cur[i] - prev[i];
+    break;
+  case IMAGE_PNG_FILTER_AVERAGE:
+    for (std::size_t j=0; j < head; j++)
+      out[j] = cur[j] - (prev[j] >> 1);
+#ifdef IMAGE_X86
+    i = _png_average_sse2(cur, prev, i, n, bpp, out);
+#endif
+    for (; i < n; i++)
+      out[i] = cur[i] - ((cur[i - bpp] + prev[i]) >> 1);
+    break;
+  case IMAGE_PNG_FILTER_PAETH:
+    for (std::size_t j=0; j < head; j++)
+      out[j] = cur[j] - prev[j];
+#ifdef IMAGE_X86
+    i = _png_paeth_sse2(cur, prev, i, n, bpp, out);
+#endif
+    for (; i < n; i++) {
+      const int a = cur[i - bpp], b = prev[i], c = prev[i - bpp];
+      const int pa = std::abs(b - c);
+      const int pb = std::abs(a - c);
+      const int pc = std::abs(a + b - 2 * c);
+      const int pred = (pa <= pb && pa <= pc)? a: (pb <= pc? b: c);
+
+      out[i] = cur[i] - pred;
+    }
+    break;
+  }
+
+  std::uint64_t sum = 0;
+  i = 0;
+#ifdef IMAGE_X86
+  i = _png_sum_sse2(out, n, sum);
+#endif
+  for (; i < n; i++)
+    sum += std::abs(static_cast<int>(static_cast<std::int8_t>(out[i])));
+
+  return sum;
+}
+
+/**
+ * Writes filter type byte and filtered row to `out[0 .. n]`.
+ * `scratch` needs `n` bytes.
+ */
+static void
+_png_filter_row(const std::uint8_t* cur, const std::uint8_t* prev,
+                std::size_t n, unsigned bpp, int level,
+                std::uint8_t* out, std::uint8_t* scratch)
+{
+  const image_png_filter last
+    = level <= 0? IMAGE_PNG_FILTER_NONE
+    : level <= 3? IMAGE_PNG_FILTER_UP: IMAGE_PNG_FILTER_PAETH;
+
+  std::uint8_t* best = out + 1;
+  std::uint8_t* candidate = scratch;
+  std::uint64_t best_sum = UINT64_MAX;
+
+  for (int f=IMAGE_PNG_FILTER_NONE; f <= last; f++) {
+    const std::uint64_t sum = _png_filter(
+      static_cast<image_png_filter>(f), cur, prev, n, bpp, candidate);
+
+    if (sum < best_sum) {
+      best_sum = sum;
+      out[0] = static_cast<std::uint8_t>(f);
+      std::swap(best, candidate);
+    }
+  }
+
+  if (best != out + 1) std::memcpy(out + 1, best, n);
+}
+
+/** Runs `task(0 .. count-1)` on up to `threads` threads.  */
+static void
+_image_parallel(std::size_t count, unsigned threads,
+                const std::function<void(std::size_t)>& task)
+{
+  std::atomic<std::size_t> next(0);
+  auto worker = [&next, count, &task]() {
+    for (std::size_t i; (i = next++) < count;) task(i);
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned t=1; t < threads && t < count; t++)
+    pool.emplace_back(worker);
+
+  worker();
+  for (std::thread& thread: pool) thread.join();
+}
+
+static void
+_png_put32(std::uint8_t* dst, std::uint32_t value)
+{
+  dst[0] = static_cast<std::uint8_t>(value >> 24);
+  dst[1] = static_cast<std::uint8_t>(value >> 16);
+  dst[2] = static_cast<std::uint8_t>(value >> 8);
+  dst[3] = static_cast<std::uint8_t>(value);
+}
+
+/** Returns false on I/O error.  */
+static bool
+_png_write_chunk(std::FILE* file, const char* type,
+                 const std::uint8_t* data, std::size_t len)
+{
+  std::uint8_t head[8], tail[4];
+
+  _png_put32(head, static_cast<std::uint32_t>(len));
+  std::memcpy(head + 4, type, 4);
+
+  uLong crc = crc32(0L, Z_NULL, 0);
+  crc = crc32(crc, head + 4, 4);
+  if (len > 0) crc = crc32(crc, data, static_cast<uInt>(len));
+  _png_put32(tail, static_cast<std::uint32_t>(crc));
+
+  return std::fwrite(head, 1, sizeof(head), file) == sizeof(head)
+    && (len == 0 || std::fwrite(data, 1, len, file) == len)
+    && std::fwrite(tail, 1, sizeof(tail), file) == sizeof(tail);
+}
+
+/* -------------------------------------------------------------------
+ * QR finder pattern detection of Image::estimate_qr_module().
+ */
+
+/**
+ * Luminance of `pixels` binarized at its mean, 1 is dark.  The mean
+ * is good enough for the high contrast of a rendered QR code.
+ */
+static PixelBuffer
+_image_binarize(const PixelBuffer& pixels, unsigned channels)
+{
+  const unsigned width = pixels.get_width();
+  const unsigned height = pixels.get_height();
+
+  PixelBuffer result(width, height, 1);
+  std::uint64_t sum = 0;
+
+  for (unsigned y=0; y < height; y++) {
+    const std::uint8_t* src = pixels.get_row(y);
+    std::uint8_t* dst = result.get_row(y);
+
+    if (channels < 3) {
+      for (unsigned x=0; x < width; x++) dst[x] = src[x * channels];
+    } else {
+      for (unsigned x=0; x < width; x++) {
+        const std::uint8_t* px = &src[x * channels];
+        dst[x] = (px[0] + 2 * px[1] + px[2]) >> 2;
+      }
+    }
+
+    for (unsigned x=0; x < width; x++) sum += dst[x];
+  }
+
+  const unsigned mean = static_cast<unsigned>(
+    sum / std::max<std::uint64_t>(1, (std::uint64_t) width * height));
+
+  for (unsigned y=0; y < height; y++) {
+    std::uint8_t* row = result.get_row(y);
+    for (unsigned x=0; x < width; x++) row[x] = row[x] < mean;
+  }
+
+  return result;
+}
+
+/** True if `runs` has the ratio 1:1:3:1:1 with 50% tolerance.  */
+static bool
+_qr_finder_ratio(const unsigned (&runs)[5], unsigned& total)
+{
+  total = runs[0] + runs[1] + runs[2] + runs[3] + runs[4];
+  if (total < 7) return false;
+
+  const float unit = total / 7.0f;
+  const float tolerance = unit / 2.0f;
+
+  return std::abs(unit - runs[0]) < tolerance
+    && std::abs(unit - runs[1]) < tolerance
+    && std::abs(3.0f * unit - runs[2]) < 3.0f * tolerance
+    && std::abs(unit - runs[3]) < tolerance
+    && std::abs(unit - runs[4]) < tolerance;
+}
+
+/**
+ * Cross check of a horizontal hit in column `x` around row `y`.
+ * Returns the total height of the finder pattern, or 0.
+ */
+static unsigned
+_qr_finder_vertical(const PixelBuffer& bin, unsigned x, unsigned y)
+{
+  const unsigned height = bin.get_height();
+  unsigned runs[5] = {};
+  unsigned total;
+
+  auto is_dark = [&bin, x](unsigned row) {
+    return bin.get_row(row)[x] != 0;
+  };
+
+  unsigned i = y + 1;
+  while (i > 0 && is_dark(i - 1)) { runs[2]++; i--; }
+  while (i > 0 && !is_dark(i - 1)) { runs[1]++; i--; }
+  while (i > 0 && is_dark(i - 1)) { runs[0]++; i--; }
+
+  i = y + 1;
+  while (i < height && is_dark(i)) { runs[2]++; i++; }
+  while (i < height && !is_dark(i)) { runs[3]++; i++; }
+  while (i < height && is_dark(i)) { runs[4]++; i++; }
+
+  return _qr_finder_ratio(runs, total)? total: 0;
+}
+
+struct qr_finder {
+  float x;
+  float module;
+  unsigned hits;
+  unsigned y_last;
+};
+
+/** Crossed by at least 2 of the 3 center modules of rows.  */
+static bool
+_qr_finder_confirmed(const qr_finder& finder)
+{
+  return finder.hits >= std::max(3.0f, 2.0f * finder.module);
+}
+
+} /* namespace socialmedia_signer  */
+
+/* ***************************************************************  */
+
+socialmedia_signer::Image::ImageErr::ImageErr(
+  const ustr& filename, const ustr& reason)
+  :Error(ustr::format("image '{}': {}", filename, reason))
+{}
+
 /* ***************************************************************  */
 
 socialmedia_signer::Image::Image()
-  :filename(), image(nullptr)
+  :filename(), width(0), height(0), region(Image::FULL), channels(0),
+   scale(1), pixels()
 {
 }
 
-socialmedia_signer::Image::Image(const ustr& filename)
-  :filename(filename), image(new int)
+socialmedia_signer::Image::Image(const ustr& filename, const Region& roi,
+                                 unsigned scale) noexcept(false)
+  :Image(filename, scale)
 {
+  if (scale != 1 && scale != 2 && scale != 4 && scale != 8) {
+    throw ImageErr(this->filename, ustr::format(
+      "invalid scale 1/{}, expected 1, 2, 4 or 8!", scale));
+  }
+
+  this->load(roi).value();
+}
+
+socialmedia_signer::Image::Image(const ustr& filename, unsigned scale)
+  :filename(filename), width(0), height(0), region(Image::FULL),
+   channels(0), scale(scale), pixels()
+{
+}
+
+socialmedia_signer::Image::Image(const QrCode& qr, const QrStyle& style)
+  :filename(u8"<QR code>"), width(0), height(0), region(Image::FULL),
+   channels(3), scale(1), pixels()
+{
+  Alloc::Scope scope(Alloc::Tag::IMAGE);
+
+  const unsigned modules = qr.get_size() + 2 * style.quiet_zone;
+
+  this->width  = modules * style.scale;
+  this->height = this->width;
+  this->region = {Corner::TOP_LEFT, 0, 0, this->width, this->height};
+
+  const std::uint8_t dark[3] = {
+    static_cast<std::uint8_t>(style.color_dark >> 16),
+    static_cast<std::uint8_t>(style.color_dark >> 8),
+    static_cast<std::uint8_t>(style.color_dark)};
+  const std::uint8_t light[3] = {
+    static_cast<std::uint8_t>(style.color_light >> 16),
+    static_cast<std::uint8_t>(style.color_light >> 8),
+    static_cast<std::uint8_t>(style.color_light)};
+
+  this->pixels = PixelBuffer(this->width, this->height, this->channels);
+  const std::size_t row_len = (std::size_t) this->width * this->channels;
+
+  /* Render one pixel row per module row, then copy it SCALE times.  */
+  for (unsigned my=0; my < modules; my++) {
+    std::uint8_t* row = this->pixels.get_row(my * style.scale);
+
+    for (unsigned mx=0; mx < modules; mx++) {
+      const bool is_dark
+        = mx >= style.quiet_zone && my >= style.quiet_zone
+        && mx - style.quiet_zone < qr.get_size()
+        && my - style.quiet_zone < qr.get_size()
+        && qr.get_module(mx - style.quiet_zone, my - style.quiet_zone);
+      const std::uint8_t* color = is_dark? dark: light;
+
+      for (unsigned i=0; i < style.scale; i++)
+        std::memcpy(&row[(mx * style.scale + i) * 3], color, 3);
+    }
+
+    for (unsigned i=1; i < style.scale; i++)
+      std::memcpy(this->pixels.get_row(my * style.scale + i), row,
+                  row_len);
+  }
 }
 
 socialmedia_signer::Image::~Image()
 {
-  delete this->image;
+}
+
+/* ***************************************************************  */
+
+std::shared_ptr<const socialmedia_signer::Image>
+socialmedia_signer::Image::render_qr(const std::u8string& payload,
+  const QrStyle& style) noexcept(false)
+{
+  Trace::Span span("render QR", "image");
+  return QrCache::get()->get_raster(payload, style);
+}
+
+socialmedia_signer::Result<std::unique_ptr<socialmedia_signer::Image>>
+socialmedia_signer::Image::open(const ustr& filename, const Region& roi,
+                                unsigned scale) noexcept(false)
+{
+  if (scale != 1 && scale != 2 && scale != 4 && scale != 8) {
+    return Failure(ImageErr(filename, ustr::format(
+      "invalid scale 1/{}, expected 1, 2, 4 or 8!", scale)));
+  }
+
+  std::unique_ptr<Image> result(new Image(filename, scale));
+
+  Result<void> loaded = result->load(roi);
+  if (!loaded) return std::move(loaded).error();
+
+  return result;
+}
+
+socialmedia_signer::Result<std::unique_ptr<socialmedia_signer::Image>>
+socialmedia_signer::Image::open_for_verify(const ustr& filename,
+  const Region& roi, float min_module) noexcept(false)
+{
+  static const unsigned SCALES[] = {4, 2};
+
+  Result<std::unique_ptr<Image>> opened = Image::open(filename, roi, 8);
+  if (!opened) return opened;
+
+  std::unique_ptr<Image> probe = std::move(*opened);
+  if (probe->get_scale() == 1) return probe;
+
+  const float probe_module = probe->estimate_qr_module();
+  if (probe_module >= min_module) return probe;
+
+  /* Without an estimate every scale is tried, from the smallest.  */
+  const float full_module = probe_module * probe->get_scale();
+
+  for (unsigned scale: SCALES) {
+    if (probe_module > 0.0f && full_module / scale < min_module)
+      continue;
+
+    Result<std::unique_ptr<Image>> result
+      = Image::open(filename, roi, scale);
+    if (!result || (*result)->estimate_qr_module() >= min_module)
+      return result;
+  }
+
+  LOG_DEBUG(IMAGE,
+    "IMAGE: {} no QR code at reduced scale, retry at full size",
+    filename);
+
+  return Image::open(filename, roi, 1);
 }
 
 /* ***************************************************************  */
@@ -45,7 +682,7 @@ socialmedia_signer::Image::~Image()
 bool
 socialmedia_signer::Image::is_empty() const
 {
-  return this->image == nullptr;
+  return this->pixels.is_empty();
 }
 
 const socialmedia_signer::ustr&
@@ -55,4 +692,716 @@ socialmedia_signer::Image::to_string() const
     ? Image::EMPTY_IMAGE_STR: this->filename;
 }
 
+unsigned
+socialmedia_signer::Image::get_width() const
+{
+  return this->width;
+}
+
+unsigned
+socialmedia_signer::Image::get_height() const
+{
+  return this->height;
+}
+
+const socialmedia_signer::Image::Region&
+socialmedia_signer::Image::get_region() const
+{
+  return this->region;
+}
+
+unsigned
+socialmedia_signer::Image::get_channels() const
+{
+  return this->channels;
+}
+
+unsigned
+socialmedia_signer::Image::get_scale() const
+{
+  return this->scale;
+}
+
+const socialmedia_signer::PixelBuffer&
+socialmedia_signer::Image::get_buffer() const
+{
+  return this->pixels;
+}
+
+/* ***************************************************************  */
+
+void
+socialmedia_signer::Image::compose(const Image& overlay,
+  const Region& placement) noexcept(false)
+{
+  if (this->is_empty() || overlay.is_empty()) {
+    throw ImageErr(this->filename, ustr::format(
+      "could not compose {}, image is empty!", overlay.to_string()));
+  }
+
+  Alloc::Scope scope(Alloc::Tag::IMAGE);
+
+  const Region& src = overlay.get_region();
+  const unsigned dst_ch = this->channels;
+  const unsigned src_ch = overlay.get_channels();
+
+  const unsigned x = std::min(placement.x, this->region.width);
+  const unsigned y = std::min(placement.y, this->region.height);
+  const unsigned w = std::min({
+    placement.width == 0? src.width: placement.width, src.width,
+    this->region.width - x});
+  const unsigned h = std::min({
+    placement.height == 0? src.height: placement.height, src.height,
+    this->region.height - y});
+
+  unsigned dst_x = x, dst_y = y;
+  if (placement.anchor == Corner::TOP_RIGHT
+      || placement.anchor == Corner::BOTTOM_RIGHT)
+    dst_x = this->region.width - x - w;
+  if (placement.anchor == Corner::BOTTOM_LEFT
+      || placement.anchor == Corner::BOTTOM_RIGHT)
+    dst_y = this->region.height - y - h;
+
+  for (unsigned row=0; row < h; row++) {
+    const std::uint8_t* s = overlay.get_buffer().get_row(row);
+    std::uint8_t* d
+      = this->pixels.get_row(dst_y + row) + (std::size_t) dst_x * dst_ch;
+
+    /* Fast path, opaque overlay with same channels.  */
+    if (src_ch == dst_ch && src_ch % 2 == 1) {
+      std::memcpy(d, s, (std::size_t) w * dst_ch);
+      continue;
+    }
+
+    for (unsigned i=0; i < w; i++, s += src_ch, d += dst_ch) {
+      const std::uint8_t rgb[3] = {
+        s[0], s[src_ch < 3? 0: 1], s[src_ch < 3? 0: 2]};
+      const unsigned alpha = src_ch % 2 == 0? s[src_ch - 1]: 255;
+      const unsigned inv = 255 - alpha;
+
+      if (dst_ch < 3) {
+        const unsigned luma = (rgb[0] + 2 * rgb[1] + rgb[2]) >> 2;
+        d[0] = (luma * alpha + d[0] * inv + 127) / 255;
+      } else {
+        for (unsigned c=0; c < 3; c++)
+          d[c] = (rgb[c] * alpha + d[c] * inv + 127) / 255;
+      }
+
+      if (dst_ch % 2 == 0)
+        d[dst_ch - 1] = alpha + (d[dst_ch - 1] * inv + 127) / 255;
+    }
+  }
+}
+
+void
+socialmedia_signer::Image::save_png(const ustr& filename,
+  const PngOptions& options) const noexcept(false)
+{
+  static const std::uint8_t MAGIC_PNG[]  = {
+    0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a};
+  static const std::uint8_t COLOR_TYPES[] = {0, 0, 4, 2, 6};
+
+  struct block_t {
+    unsigned y_begin, y_end;
+    std::vector<std::uint8_t> data;
+    uLong adler;
+  };
+
+  if (this->is_empty())
+    throw ImageErr(filename, u8"nothing to save, image is empty!");
+  if (this->channels < 1 || this->channels > 4)
+    throw ImageErr(filename, u8"unsupported number of channels!");
+
+  const auto time_start = std::chrono::steady_clock::now();
+  Trace::Span span("encode PNG", "image");
+  Metrics::Timer timer(Metrics::Histogram::IMAGE_SAVE);
+  Alloc::Scope alloc_scope(Alloc::Tag::IMAGE);
+
+  const int level = std::clamp(options.level, 0, 9);
+  const unsigned width = this->region.width;
+  const unsigned height = this->region.height;
+  const std::size_t row_len = (std::size_t) width * this->channels;
+  const std::size_t filtered_len = row_len + 1;
+
+  unsigned threads = options.threads;
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+
+  const unsigned rows_per_block = static_cast<unsigned>(std::max<
+    std::size_t>(1, IMAGE_PNG_BLOCK_SIZE / filtered_len));
+
+  std::vector<block_t> blocks;
+  for (unsigned y=0; y < height; y += rows_per_block) {
+    blocks.push_back({y, std::min(height, y + rows_per_block),
+                      {}, 0});
+  }
+
+  /* Filter all rows first, so every block can use the filtered tail
+   * of its predecessor as dictionary.  Without row padding, i.e. the
+   * data of the DEFLATE stream as is.  */
+  const std::unique_ptr<std::uint8_t[]> filtered
+    = std::make_unique_for_overwrite<std::uint8_t[]>(
+        height * filtered_len);
+  const std::vector<std::uint8_t> zero_row(row_len, 0);
+
+  _image_parallel(blocks.size(), threads,
+    [this, &blocks, &filtered, &zero_row, row_len, filtered_len,
+     level](std::size_t b) {
+      std::vector<std::uint8_t> scratch(row_len);
+
+      for (unsigned y=blocks[b].y_begin; y < blocks[b].y_end; y++) {
+        const std::uint8_t* prev
+          = y == 0? zero_row.data(): this->pixels.get_row(y - 1);
+
+        _png_filter_row(this->pixels.get_row(y), prev, row_len,
+                        this->channels, level,
+                        filtered.get() + y * filtered_len,
+                        scratch.data());
+      }
+    });
+
+  _image_parallel(blocks.size(), threads,
+    [&blocks, &filtered, filtered_len, level](std::size_t b) {
+      block_t& block = blocks[b];
+      const bool is_last = b + 1 == blocks.size();
+      std::uint8_t* data = filtered.get() + block.y_begin * filtered_len;
+      const std::size_t len
+        = (block.y_end - block.y_begin) * filtered_len;
+
+      /* Raw DEFLATE, the ZLIB header and trailer are added below.
+       * Z_FILTERED is the strategy LIBPNG uses for filtered rows.  */
+      z_stream strm = {};
+      if (deflateInit2(&strm, level, Z_DEFLATED, -15, 8,
+                       Z_FILTERED) != Z_OK)
+        Log::fatal(u8"Image::save_png(): deflateInit2() failed!");
+
+      /* The preceding window is right in front of the block.  */
+      if (b > 0 && level > 0) {
+        const std::size_t dict_len = std::min<std::size_t>(
+          IMAGE_PNG_DICT_SIZE, block.y_begin * filtered_len);
+        deflateSetDictionary(&strm, data - dict_len,
+                             static_cast<uInt>(dict_len));
+      }
+
+      block.data.resize(deflateBound(&strm, len) + 64);
+      strm.next_out = block.data.data();
+      strm.avail_out = static_cast<uInt>(block.data.size());
+      strm.next_in = data;
+      strm.avail_in = static_cast<uInt>(len);
+      block.adler = adler32(adler32(0L, Z_NULL, 0), data,
+                            static_cast<uInt>(len));
+
+      const int flush = is_last? Z_FINISH: Z_SYNC_FLUSH;
+      for (;;) {
+        if (strm.avail_out == 0) {
+          const std::size_t used = block.data.size();
+          block.data.resize(2 * used);
+          strm.next_out = block.data.data() + used;
+          strm.avail_out = static_cast<uInt>(used);
+        }
+
+        const int ret = deflate(&strm, flush);
+        if (ret == Z_STREAM_ERROR)
+          Log::fatal(u8"Image::save_png(): deflate() failed!");
+
+        if (strm.avail_in == 0 && strm.avail_out != 0
+            && (flush != Z_FINISH || ret == Z_STREAM_END))
+          break;
+      }
+
+      block.data.resize(block.data.size() - strm.avail_out);
+      deflateEnd(&strm);
+    });
+
+  /* ZLIB header with FLEVEL, and ADLER-32 of the whole stream.  */
+  const std::uint8_t cmf = 0x78;
+  std::uint8_t flg = (level <= 1? 0: level <= 5? 1: level == 6? 2: 3)
+    << 6;
+  flg += 31 - (cmf * 256 + flg) % 31;
+  blocks.front().data.insert(blocks.front().data.begin(), {cmf, flg});
+
+  uLong adler = adler32(0L, Z_NULL, 0);
+  for (const block_t& block: blocks) {
+    adler = adler32_combine(adler, block.adler, static_cast<z_off_t>(
+      (block.y_end - block.y_begin) * filtered_len));
+  }
+  std::uint8_t trailer[4];
+  _png_put32(trailer, static_cast<std::uint32_t>(adler));
+  blocks.back().data.insert(blocks.back().data.end(),
+                            trailer, trailer + sizeof(trailer));
+
+  std::uint8_t ihdr[13];
+  _png_put32(ihdr, width);
+  _png_put32(ihdr + 4, height);
+  ihdr[8]  = 8;                                /* bit depth  */
+  ihdr[9]  = COLOR_TYPES[this->channels];
+  ihdr[10] = 0;                                /* DEFLATE  */
+  ihdr[11] = 0;                                /* adaptive filter  */
+  ihdr[12] = 0;                                /* no interlace  */
+
+  std::u8string filename_utf8;
+  filename.out_utf8(filename_utf8);
+  const char* path = reinterpret_cast<const char*>(filename_utf8.data());
+
+  std::FILE* file = std::fopen(path, "wb");
+  if (file == nullptr) {
+    throw ImageErr(filename,
+      reinterpret_cast<const char8_t*>(std::strerror(errno)));
+  }
+
+  std::size_t written = sizeof(MAGIC_PNG);
+  bool is_ok
+    = std::fwrite(MAGIC_PNG, 1, sizeof(MAGIC_PNG), file)
+      == sizeof(MAGIC_PNG)
+    && _png_write_chunk(file, "IHDR", ihdr, sizeof(ihdr));
+
+  for (const block_t& block: blocks) {
+    if (!is_ok) break;
+    is_ok = _png_write_chunk(file, "IDAT", block.data.data(),
+                             block.data.size());
+    written += block.data.size() + 12;
+  }
+  is_ok = is_ok && _png_write_chunk(file, "IEND", nullptr, 0);
+
+  int write_errno = is_ok? 0: errno;
+  if (std::fclose(file) != 0 && is_ok) {
+    is_ok = false;
+    write_errno = errno;
+  }
+  if (!is_ok) {
+    std::remove(path);
+    throw ImageErr(filename,
+      reinterpret_cast<const char8_t*>(std::strerror(write_errno)));
+  }
+
+  LOG_DEBUG(IMAGE,
+    "IMAGE: {} saved {}x{} as PNG level {}, {} blocks on {} threads,"
+    " {} bytes in {} us", filename, width, height, level,
+    blocks.size(), std::min<std::size_t>(threads, blocks.size()),
+    written + 37, _image_us_since(time_start));
+}
+
+float
+socialmedia_signer::Image::estimate_qr_module() const
+{
+  if (this->is_empty()) return 0.0f;
+
+  Trace::Span span("QR detect", "image");
+  Metrics::Timer timer(Metrics::Histogram::IMAGE_QR_DETECT);
+  Profile::Scope scope(Profile::Stage::QR_DETECT);
+  Alloc::Scope alloc_scope(Alloc::Tag::IMAGE);
+
+  const PixelBuffer bin = _image_binarize(this->pixels, this->channels);
+  const unsigned width = bin.get_width();
+
+  /* Hits of the same finder pattern, which are in consecutive rows.
+   * Real finder patterns are crossed by 3 modules of rows, noise
+   * just by a few.  */
+  std::vector<qr_finder> active, found;
+
+  for (unsigned y=0; y < bin.get_height(); y++) {
+    const std::uint8_t* row = bin.get_row(y);
+
+    /* RUNS[STATE] is being counted, even states are dark.  */
+    unsigned runs[5] = {};
+    unsigned state = 0;
+    unsigned total;
+
+    auto check = [&](unsigned x_end) {
+      if (!_qr_finder_ratio(runs, total)) return;
+
+      const unsigned center = x_end - runs[4] - runs[3] - runs[2] / 2;
+      const unsigned vertical = _qr_finder_vertical(bin, center, y);
+      if (vertical == 0) return;
+
+      const float module = (total + vertical) / 14.0f;
+      for (qr_finder& finder: active) {
+        if (std::abs(finder.x - center) <= 1.5f * finder.module
+            && std::abs(finder.module - module) < finder.module / 2.0f) {
+          finder.x = (finder.x * finder.hits + center) / (finder.hits + 1);
+          finder.module = (finder.module * finder.hits + module)
+            / (finder.hits + 1);
+          finder.hits++;
+          finder.y_last = y;
+          return;
+        }
+      }
+
+      active.push_back({static_cast<float>(center), module, 1, y});
+    };
+
+    for (unsigned x=0; x < width; x++) {
+      const bool is_dark = row[x] != 0;
+
+      if (is_dark == (state % 2 == 0)) {
+        runs[state]++;
+      } else if (state == 0 && runs[0] == 0) {
+        /* Leading light pixels.  */
+      } else if (state < 4) {
+        runs[++state] = 1;
+      } else {
+        /* Light after the fifth run, shift by one dark/light pair.  */
+        check(x);
+        runs[0] = runs[2]; runs[1] = runs[3]; runs[2] = runs[4];
+        runs[3] = 1; runs[4] = 0;
+        state = 3;
+      }
+    }
+
+    if (state == 4) check(width);
+
+    /* Close finder patterns without hits in the last rows.  */
+    std::erase_if(active, [&found, y](const qr_finder& finder) {
+      if (finder.y_last + 2 > y) return false;
+      if (_qr_finder_confirmed(finder)) found.push_back(finder);
+      return true;
+    });
+  }
+
+  for (const qr_finder& finder: active)
+    if (_qr_finder_confirmed(finder)) found.push_back(finder);
+
+  if (found.empty()) return 0.0f;
+
+  /* A QR code has 3 finder patterns, take the best supported.  */
+  const std::size_t count = std::min<std::size_t>(3, found.size());
+  std::partial_sort(found.begin(), found.begin() + count, found.end(),
+    [](const qr_finder& a, const qr_finder& b) {
+      return a.hits > b.hits;
+    });
+
+  float modules[3];
+  for (std::size_t i=0; i < count; i++) modules[i] = found[i].module;
+  std::sort(modules, modules + count);
+
+  return modules[count / 2];
+}
+
+/* ***************************************************************  */
+
+socialmedia_signer::Image::Region
+socialmedia_signer::Image::resolve(const Region& roi) const
+{
+  const unsigned s = this->scale;
+
+  const unsigned x = std::min(roi.x / s, this->width);
+  const unsigned y = std::min(roi.y / s, this->height);
+
+  const unsigned w = roi.width == 0? this->width - x
+    : std::min((roi.width + s - 1) / s, this->width - x);
+  const unsigned h = roi.height == 0? this->height - y
+    : std::min((roi.height + s - 1) / s, this->height - y);
+
+  Region result = {Corner::TOP_LEFT, x, y, w, h};
+
+  if (roi.anchor == Corner::TOP_RIGHT
+      || roi.anchor == Corner::BOTTOM_RIGHT)
+    result.x = this->width - x - w;
+  if (roi.anchor == Corner::BOTTOM_LEFT
+      || roi.anchor == Corner::BOTTOM_RIGHT)
+    result.y = this->height - y - h;
+
+  return result;
+}
+
+socialmedia_signer::Failure
+socialmedia_signer::Image::failure(const char8_t* reason) const
+{
+  Metrics::add(Metrics::Counter::IMAGE_ERRORS);
+
+  return Failure(ImageErr(this->filename, reason));
+}
+
+socialmedia_signer::Result<void>
+socialmedia_signer::Image::check_limits(unsigned width, unsigned height,
+  unsigned channels) const noexcept(false)
+{
+  if (width > Image::DECODE_SIDE_MAX || height > Image::DECODE_SIDE_MAX
+      || (std::uint64_t) width * height * channels
+         > Image::DECODE_BYTES_MAX)
+    return this->failure(u8"image dimensions exceed the limits!");
+
+  return Result<void>();
+}
+
+socialmedia_signer::Result<void>
+socialmedia_signer::Image::load(const Region& roi) noexcept(false)
+{
+  static const std::uint8_t MAGIC_JPEG[] = {0xff, 0xd8, 0xff};
+  static const std::uint8_t MAGIC_PNG[]  = {
+    0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a};
+
+  const auto time_start = std::chrono::steady_clock::now();
+  Trace::Span span("decode", "image");
+  Metrics::Timer timer(Metrics::Histogram::IMAGE_LOAD);
+  Profile::Scope scope(Profile::Stage::IMAGE_DECODE);
+  Alloc::Scope alloc_scope(Alloc::Tag::IMAGE);
+
+  std::u8string filename_utf8;
+  this->filename.out_utf8(filename_utf8);
+
+  std::FILE* file
+    = std::fopen(reinterpret_cast<const char*>(filename_utf8.data()),
+                 "rb");
+  if (file == nullptr) {
+    return this->failure(
+      reinterpret_cast<const char8_t*>(std::strerror(errno)));
+  }
+
+  std::uint8_t magic[sizeof(MAGIC_PNG)] = {};
+  const std::size_t magic_len
+    = std::fread(magic, 1, sizeof(magic), file);
+  std::rewind(file);
+
+  Result<void> result;
+  if (magic_len >= sizeof(MAGIC_JPEG)
+      && std::memcmp(magic, MAGIC_JPEG, sizeof(MAGIC_JPEG)) == 0)
+    result = this->load_jpeg(file, roi);
+  else if (magic_len >= sizeof(MAGIC_PNG)
+      && std::memcmp(magic, MAGIC_PNG, sizeof(MAGIC_PNG)) == 0)
+    result = this->load_png(file, roi);
+  else
+    result = this->failure(u8"unsupported file format!");
+
+  std::fclose(file);
+  if (!result) return result;
+  Metrics::add(Metrics::Counter::IMAGE_PIXELS,
+               (std::uint64_t) this->region.width * this->region.height);
+
+  LOG_DEBUG(IMAGE,
+    "IMAGE: {} {}x{} at 1/{}, decoded {}x{}+{}+{} ({:.1f}% pixels)"
+    " in {} us", this->filename, this->width, this->height,
+    this->scale, this->region.width,
+    this->region.height, this->region.x, this->region.y,
+    100.0 * this->region.width * this->region.height
+    / ((double) this->width * this->height),
+    _image_us_since(time_start));
+
+  return result;
+}
+
+/* ---------------------------------------------------------------  */
+
+socialmedia_signer::Result<void>
+socialmedia_signer::Image::load_jpeg(std::FILE* file, const Region& roi)
+  noexcept(false)
+{
+  struct jpeg_decompress_struct cinfo;
+  struct image_jpeg_err jerr;
+
+  cinfo.err = jpeg_std_error(&jerr.pub);
+  jerr.pub.error_exit     = _jpeg_error_exit;
+  jerr.pub.output_message = _jpeg_output_message;
+  jerr.msg[0] = '\0';
+
+  if (setjmp(jerr.jmp)) {
+    jpeg_destroy_decompress(&cinfo);
+    return this->failure(reinterpret_cast<const char8_t*>(jerr.msg));
+  }
+
+  jpeg_create_decompress(&cinfo);
+  jpeg_stdio_src(&cinfo, file);
+  jpeg_read_header(&cinfo, TRUE);
+
+  /* Scaled IDCT, just computes SCALE_DENOM times less coefficients
+   * per block and skips the upsampling.  */
+  cinfo.out_color_space
+    = cinfo.num_components == 1? JCS_GRAYSCALE: JCS_RGB;
+  cinfo.scale_num   = 1;
+  cinfo.scale_denom = this->scale;
+  jpeg_calc_output_dimensions(&cinfo);
+
+  /* Own scope, LIBJPEG may longjmp() to the setjmp() above later.  */
+  {
+    Result<void> limits = this->check_limits(cinfo.output_width,
+      cinfo.output_height, cinfo.out_color_components);
+    if (!limits) {
+      jpeg_destroy_decompress(&cinfo);
+      return limits;
+    }
+  }
+
+  this->width  = cinfo.output_width;
+  this->height = cinfo.output_height;
+  this->region = this->resolve(roi);
+
+  if (this->region.width == 0 || this->region.height == 0) {
+    jpeg_destroy_decompress(&cinfo);
+    return this->failure(u8"region of interest is empty!");
+  }
+
+  jpeg_start_decompress(&cinfo);
+  this->channels = cinfo.output_components;
+
+  /* Skip the IDCT of all MCUs left/right of the region and all rows
+   * above it.  JPEG_CROP_SCANLINE() aligns CROP_X to the iMCU
+   * boundary, so the region starts at REGION.X - CROP_X within the
+   * cropped scanline.
+   */
+  JDIMENSION crop_x     = this->region.x;
+  JDIMENSION crop_width = this->region.width;
+  /* Read after the second setjmp() below.  */
+  volatile JDIMENSION skip_rows = this->region.y;
+
+#ifdef LIBJPEG_TURBO_VERSION
+  if (crop_width < cinfo.output_width)
+    jpeg_crop_scanline(&cinfo, &crop_x, &crop_width);
+  else
+    crop_x = 0;
+
+  if (skip_rows > 0)
+    skip_rows = skip_rows - jpeg_skip_scanlines(&cinfo, skip_rows);
+#else
+  crop_x     = 0;
+  crop_width = cinfo.output_width;
+#endif
+
+  const std::size_t roi_len
+    = (std::size_t) this->region.width * this->channels;
+  const std::size_t roi_off
+    = (std::size_t) (this->region.x - crop_x) * this->channels;
+
+  PixelBuffer row(crop_width, 1, this->channels);
+  this->pixels = PixelBuffer(this->region.width, this->region.height,
+                             this->channels);
+
+  JSAMPROW row_ptr = row.get_row(0);
+
+  /* Again, so no local is modified between setjmp() and longjmp().  */
+  if (setjmp(jerr.jmp)) {
+    jpeg_destroy_decompress(&cinfo);
+    return this->failure(reinterpret_cast<const char8_t*>(jerr.msg));
+  }
+
+  for (JDIMENSION y=0; y < skip_rows; y++)
+    jpeg_read_scanlines(&cinfo, &row_ptr, 1);
+
+  for (unsigned y=0; y < this->region.height; y++) {
+    if (jpeg_read_scanlines(&cinfo, &row_ptr, 1) != 1) break;
+
+    std::memcpy(this->pixels.get_row(y), &row_ptr[roi_off], roi_len);
+  }
+
+  /* Rows below the region are never decoded.  */
+  jpeg_destroy_decompress(&cinfo);
+
+  return Result<void>();
+}
+
+socialmedia_signer::Result<void>
+socialmedia_signer::Image::load_png(std::FILE* file, const Region& roi)
+  noexcept(false)
+{
+  struct image_png_err perr;
+  perr.msg[0] = '\0';
+
+  png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING,
+    &perr, _png_error, _png_warning);
+  if (png == nullptr)
+    Log::fatal(u8"Could not allocate LIBPNG read struct!");
+
+  png_infop info = png_create_info_struct(png);
+  if (info == nullptr)
+    Log::fatal(u8"Could not allocate LIBPNG info struct!");
+
+  if (setjmp(png_jmpbuf(png))) {
+    png_destroy_read_struct(&png, &info, nullptr);
+    return this->failure(reinterpret_cast<const char8_t*>(perr.msg));
+  }
+
+  /* Checked by png_read_info(), before any row is allocated.  */
+  png_set_user_limits(png, Image::DECODE_SIDE_MAX,
+                      Image::DECODE_SIDE_MAX);
+
+  png_init_io(png, file);
+  png_read_info(png, info);
+
+  /* PNG has no scaled decoding.  */
+  this->scale  = 1;
+  this->width  = png_get_image_width(png, info);
+  this->height = png_get_image_height(png, info);
+  this->region = this->resolve(roi);
+
+  if (this->region.width == 0 || this->region.height == 0) {
+    png_destroy_read_struct(&png, &info, nullptr);
+    return this->failure(u8"region of interest is empty!");
+  }
+
+  /* Normalize to 8 bit gray, RGB or RGBA.  */
+  const int bit_depth  = png_get_bit_depth(png, info);
+  const int color_type = png_get_color_type(png, info);
+  const bool has_trns  = png_get_valid(png, info, PNG_INFO_tRNS) != 0;
+
+  if (bit_depth == 16)
+    png_set_strip_16(png);
+  if (color_type == PNG_COLOR_TYPE_PALETTE)
+    png_set_palette_to_rgb(png);
+  if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8)
+    png_set_expand_gray_1_2_4_to_8(png);
+  if (has_trns)
+    png_set_tRNS_to_alpha(png);
+  if (color_type == PNG_COLOR_TYPE_GRAY_ALPHA
+      || (color_type == PNG_COLOR_TYPE_GRAY && has_trns))
+    png_set_gray_to_rgb(png);
+
+  const int passes = png_set_interlace_handling(png);
+  png_read_update_info(png, info);
+
+  /* Own scope, like in Image::load_jpeg().  */
+  {
+    Result<void> limits = this->check_limits(this->width, this->height,
+      png_get_channels(png, info));
+    if (!limits) {
+      png_destroy_read_struct(&png, &info, nullptr);
+      return limits;
+    }
+  }
+
+  this->channels = png_get_channels(png, info);
+
+  const std::size_t roi_len
+    = (std::size_t) this->region.width * this->channels;
+  const std::size_t roi_off
+    = (std::size_t) this->region.x * this->channels;
+
+  this->pixels = PixelBuffer(this->region.width, this->region.height,
+                             this->channels);
+
+  /* Adam7 interlaced, every pass touches all rows.  */
+  PixelBuffer row(this->width, passes > 1? this->height: 1,
+                  this->channels);
+
+  /* Again, so no local is modified between setjmp() and longjmp().  */
+  if (setjmp(png_jmpbuf(png))) {
+    png_destroy_read_struct(&png, &info, nullptr);
+    return this->failure(reinterpret_cast<const char8_t*>(perr.msg));
+  }
+
+  if (passes > 1) {
+    for (int pass=0; pass < passes; pass++) {
+      for (unsigned y=0; y < this->height; y++)
+        png_read_row(png, row.get_row(y), nullptr);
+    }
+
+    for (unsigned y=0; y < this->region.height; y++) {
+      std::memcpy(this->pixels.get_row(y),
+        row.get_row(this->region.y + y) + roi_off, roi_len);
+    }
+  } else {
+    for (unsigned y=0; y < this->region.y; y++)
+      png_read_row(png, row.get_row(0), nullptr);
+
+    for (unsigned y=0; y < this->region.height; y++) {
+      png_read_row(png, row.get_row(0), nullptr);
+      std::memcpy(this->pixels.get_row(y), row.get_row(0) + roi_off,
+                  roi_len);
+    }
+  }
+
+  /* Stop here, rows below the region are never inflated.  */
+  png_destroy_read_struct(&png, &info, nullptr);
+
+  return Result<void>();
+}
+
 /* ***************************************************************  */
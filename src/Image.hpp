@@ -19,8 +19,15 @@
 #ifndef IMAGE_HPP__
 #define IMAGE_HPP__
 
+#include "QrCode.hpp"
+#include "PixelBuffer.hpp"
+
 #include "common.hpp"
 
+#include <memory>
+#include <cstdint>
+#include <cstdio>
+
 /* ***************************************************************  */
 
 namespace socialmedia_signer {
@@ -28,10 +35,94 @@ namespace socialmedia_signer {
 /**
  * Class which includes data of an image, for example BITMAP, JPEG,
  * PNG, etc...
+ *
+ * Pixels are stored in a ::PixelBuffer, 8 bit per channel.
+ * Depending on the file 1 (gray), 3 (RGB) or 4 (RGBA) channels are
+ * used.  If the image was opened with a Region of interest then just
+ * the pixels inside of this region are decoded and stored.
  */
 class Image
 {
 public:
+
+  class ImageErr: public Error {
+  public:
+    ImageErr(const ustr& filename, const ustr& reason);
+  };
+
+  enum class Corner { TOP_LEFT, TOP_RIGHT, BOTTOM_LEFT, BOTTOM_RIGHT };
+
+  /**
+   * Region of interest in pixels.  `x` and `y` are the offsets from
+   * the `anchor` corner towards the center of the image, so a
+   * signature at the bottom right with 16 pixels margin is
+   * `{Corner::BOTTOM_RIGHT, 16, 16, size, size}`.
+   *
+   * `width` or `height` of 0 means up to the opposite image border.
+   * Regions exceeding the image are clipped.
+   */
+  struct Region {
+    Corner anchor;
+    unsigned x, y;
+    unsigned width, height;
+  };
+
+  /** The whole image, i.e. `{Corner::TOP_LEFT, 0, 0, 0, 0}`.  */
+  static const Region FULL;
+
+  /**
+   * How a QrCode is rendered.  Colors are `0xRRGGBB`.
+   */
+  struct QrStyle {
+    QrCode::Ecc ecc;
+
+    /** Pixels per module.  */
+    unsigned scale;
+    /** Modules of light border around the code.  */
+    unsigned quiet_zone;
+
+    std::uint32_t color_dark;
+    std::uint32_t color_light;
+  };
+
+  static const QrStyle QR_STYLE_DEFAULT;
+
+  /**
+   * Tradeoff of Image::save_png() between speed and file size.
+   */
+  struct PngOptions {
+    /**
+     * ZLIB level, 1 (fast) ... 9 (small), 0 stores uncompressed.  Up
+     * to level 3 just the cheap filters NONE, SUB and UP are tried
+     * per row, above also AVERAGE and PAETH.
+     */
+    int level;
+
+    /** Worker threads, 0 uses all hardware threads.  */
+    unsigned threads;
+  };
+
+  static const PngOptions PNG_FAST;
+  static const PngOptions PNG_SMALL;
+  static const PngOptions PNG_DEFAULT;
+
+  /**
+   * Minimal size of a QR module in pixels, which is still readable.
+   * Image::open_for_verify() does not scale below it.
+   */
+  static constexpr float QR_MODULE_MIN = 3.0f;
+
+  /**
+   * Limits of decoded images, which are checked against the header
+   * before anything is allocated, so a forged header yields a
+   * Failure.  The side is the limit of JPEG.
+   */
+  static constexpr unsigned DECODE_SIDE_MAX = 65500;
+  static constexpr std::uint64_t DECODE_BYTES_MAX
+    = std::uint64_t(1) << 30;
+
+  /* -------------------------------------------------------------  */
+
   /**
    * Open empty image for signature only, without custom background.
    */
@@ -39,18 +130,139 @@ public:
   /**
    * Open image from `filename` as custom background or as a signature
    * to analyze.
+   *
+   * Just decodes the pixels inside of `roi`.  For JPEG the IDCT of
+   * MCUs outside of `roi` is skipped, for PNG the decoding stops
+   * after the last row of `roi`.
+   *
+   * JPEG is decoded at 1/`scale` of its size using the scaled IDCT,
+   * `scale` is 1, 2, 4 or 8.  `roi` is always given in pixels of the
+   * full size, but sizes and regions returned by the getters are
+   * those of the scaled image.  Other formats ignore `scale`.
+   */
+  explicit Image(const ustr& filename, const Region& roi = FULL,
+                 unsigned scale = 1) noexcept(false);
+  /**
+   * Render the RGB raster of `qr`.  Prefer Image::render_qr() which
+   * returns cached rasters.
    */
-  explicit Image(const ustr& filename);
+  explicit Image(const QrCode& qr, const QrStyle& style);
   virtual ~Image();
 
+  /**
+   * Returns the rendered QR code of `payload`.  Consults the process
+   * wide QrCache before encoding, so repeated previews and retries of
+   * the same post are not encoded again.
+   */
+  static std::shared_ptr<const Image> render_qr(
+    const std::u8string& payload,
+    const QrStyle& style = QR_STYLE_DEFAULT) noexcept(false);
+
+  /**
+   * Like the constructor Image(const ustr&, const Region&, unsigned),
+   * but returns a Failure instead of throwing if the file is missing
+   * or no supported image.  Use it where broken files are expected.
+   */
+  static Result<std::unique_ptr<Image>> open(const ustr& filename,
+    const Region& roi = FULL, unsigned scale = 1) noexcept(false);
+
+  /**
+   * Opens `filename` for verification of its QR signature at the
+   * smallest scale at which the QR modules are at least `min_module`
+   * pixels.
+   *
+   * A cheap 1/8 probe estimates the module size, which skips the
+   * scales at which the modules would be too small.  The remaining
+   * scales 1/4 and 1/2 are tried in turn until a QR code is found,
+   * the last retry is at full size.  Returns a Failure if the file
+   * could not be decoded.
+   */
+  static Result<std::unique_ptr<Image>> open_for_verify(
+    const ustr& filename, const Region& roi = FULL,
+    float min_module = QR_MODULE_MIN) noexcept(false);
+
   virtual bool is_empty() const;
   virtual const ustr& to_string() const;
 
+  /** Size of the full image, as stored in the file header.  */
+  virtual unsigned get_width() const;
+  virtual unsigned get_height() const;
+
+  /** Decoded region, `anchor` is always Corner::TOP_LEFT.  */
+  virtual const Region& get_region() const;
+  virtual unsigned get_channels() const;
+  /** Denominator of the decoded scale, 1 is full size.  */
+  virtual unsigned get_scale() const;
+
+  /** Pixels of Image::get_region(), Layout::INTERLEAVED.  */
+  virtual const PixelBuffer& get_buffer() const;
+
+  /**
+   * Draws `overlay` onto the pixels of Image::get_region(), for
+   * example the QR signature onto a custom background.
+   *
+   * `placement` is relative to the decoded region, a `width` or
+   * `height` of 0 means the size of `overlay`.  Pixels outside of the
+   * region are clipped.  RGBA overlays are alpha blended, channels
+   * are converted to Image::get_channels().
+   */
+  virtual void compose(const Image& overlay, const Region& placement)
+    noexcept(false);
+
+  /**
+   * Writes the pixels of Image::get_region() as PNG to `filename`.
+   *
+   * The filtered rows are split into blocks which are DEFLATEd in
+   * parallel, each block primed with the last 32 KiB of its
+   * predecessor as dictionary.  All but the last block end with a
+   * sync flush, so the concatenation is one valid ZLIB stream.
+   */
+  virtual void save_png(const ustr& filename,
+                        const PngOptions& options = PNG_DEFAULT) const
+    noexcept(false);
+
+  /**
+   * Median size of a QR module in pixels, measured at the finder
+   * patterns (dark-light-dark-light-dark in ratio 1:1:3:1:1,
+   * horizontally and vertically).  Returns 0 if no finder pattern was
+   * found.
+   */
+  virtual float estimate_qr_module() const;
+
 private:
   static const ustr EMPTY_IMAGE_STR;
 
+  /**
+   * Converts `roi` in full size pixels to an absolute
+   * Corner::TOP_LEFT region at 1/Image::scale, clipped to
+   * Image::width and Image::height.
+   */
+  Region resolve(const Region& roi) const;
+
+  /** Empty image of `filename`, which is decoded by Image::load().  */
+  explicit Image(const ustr& filename, unsigned scale);
+
+  /** Failure which Failure::raise() throws as ImageErr.  */
+  Failure failure(const char8_t* reason) const;
+  /** A Failure if a decoded image would exceed the limits.  */
+  Result<void> check_limits(unsigned width, unsigned height,
+                            unsigned channels) const noexcept(false);
+
+  Result<void> load(const Region& roi) noexcept(false);
+  Result<void> load_jpeg(std::FILE* file,
+                         const Region& roi) noexcept(false);
+  Result<void> load_png(std::FILE* file,
+                        const Region& roi) noexcept(false);
+
   const ustr filename;
-  int* image;
+
+  unsigned width;
+  unsigned height;
+
+  Region region;
+  unsigned channels;
+  unsigned scale;
+  PixelBuffer pixels;
 };
 
 }
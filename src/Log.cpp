@@ -21,104 +21,818 @@
 #include "Params.hpp"
 
 #include <iostream>
+#include <algorithm>
+#include <iterator>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/** Line buffer of the calling thread, reused by every message.  */
+static thread_local std::string _log_line;
+
+/** Header of a line in a ring buffer, followed by the line.  */
+struct _LogRecord {
+  std::uint32_t length;
+  /** File descriptor to write to, or _LOG_SKIP.  */
+  std::int32_t  fd;
+};
+
+/** Marks the unused end of a ring buffer, before it wraps around.  */
+static constexpr std::int32_t _LOG_SKIP = -1;
+
+/** Lines are aligned, so headers never wrap around.  */
+static constexpr std::size_t _LOG_ALIGN = sizeof(_LogRecord);
+
+/** Lines per WRITEV() call.  */
+static constexpr int _LOG_IOV_MAX = 64;
+
+/**
+ * Ring buffer of one thread.  Positions count bytes since the start
+ * and do not wrap around, the thread moves `head` and the background
+ * thread moves `tail`.
+ */
+struct _LogRing {
+  alignas(64) std::atomic<std::uint64_t> head;
+  alignas(64) std::atomic<std::uint64_t> tail;
+
+  /** The thread exited, free the ring after it is drained.  */
+  std::atomic<bool> closed;
+
+  alignas(64) char data[Log::RING_SIZE];
+};
+
+/** Ring of the calling thread, registered on its first line.  */
+struct _LogHandle {
+  std::shared_ptr<_LogRing> ring;
+
+  ~_LogHandle()
+  {
+    if (this->ring) this->ring->closed.store(true,
+                                             std::memory_order_release);
+  }
+};
+
+static thread_local _LogHandle _log_handle;
+
+/** Between Log::init() and Log::release().  */
+static std::atomic<bool> _log_async(false);
+static Log::Overflow _log_overflow = Log::Overflow::BLOCK;
+
+/** Protects `_log_rings` and the start and stop of `_log_writer`.  */
+static std::mutex _log_mutex;
+static std::vector<std::shared_ptr<_LogRing>> _log_rings;
+
+/* Not an object with destructor, Log::fatal() may exit while the
+ * thread runs.
+ */
+static std::thread* _log_writer = nullptr;
+static std::atomic<bool> _log_stopping(false);
+
+/** Incremented per line, the background thread waits on it.  */
+static std::atomic<std::uint32_t> _log_pending(0);
+
+static std::atomic<unsigned long> _log_records(0);
+static std::atomic<unsigned long> _log_bytes(0);
+static std::atomic<unsigned long> _log_writes(0);
+static std::atomic<unsigned long> _log_dropped(0);
+static std::atomic<unsigned long> _log_blocked(0);
+
+static_assert(std::size(LogBinary::SUBSYSTEM_NAMES)
+              == static_cast<unsigned>(Log::Subsystem::COUNT));
+
+/** Protects `_log_formats` and the writes of Format records.  */
+static std::mutex _log_binary_mutex;
+static std::uint32_t _log_formats = 0;
+
+/* ---------------------------------------------------------------  */
+
+/** Writes all of `iov`, which is modified.  */
+static void
+_log_writev(int fd, struct iovec* iov, int count)
+{
+  while (count > 0) {
+    const ssize_t written = ::writev(fd, iov, count);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return;
+    }
+    _log_writes.fetch_add(1, std::memory_order_relaxed);
+
+    std::size_t left = static_cast<std::size_t>(written);
+    while (count > 0 && left >= iov->iov_len) {
+      left -= iov->iov_len;
+      iov++;
+      count--;
+    }
+    if (count > 0) {
+      iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+      iov->iov_len -= left;
+    }
+  }
+}
+
+/**
+ * Writes the lines of `ring`, consecutive lines to the same file
+ * descriptor with one WRITEV() call.
+ */
+static void
+_log_drain(_LogRing& ring)
+{
+  const std::uint64_t head = ring.head.load(std::memory_order_acquire);
+  std::uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+
+  struct iovec iov[_LOG_IOV_MAX];
+  int count = 0;
+  int fd = _LOG_SKIP;
+  std::size_t bytes = 0;
+
+  while (tail != head) {
+    const std::size_t offset = tail & (Log::RING_SIZE - 1);
+
+    _LogRecord record;
+    std::memcpy(&record, ring.data + offset, sizeof(record));
+
+    const std::size_t size = (sizeof(record) + record.length
+                              + _LOG_ALIGN - 1) & ~(_LOG_ALIGN - 1);
+
+    if (record.fd != _LOG_SKIP) {
+      if (count == _LOG_IOV_MAX || (count > 0 && record.fd != fd)) {
+        _log_writev(fd, iov, count);
+        _log_records.fetch_add(count, std::memory_order_relaxed);
+        count = 0;
+
+        /* Space of written lines is free again.  */
+        ring.tail.store(tail, std::memory_order_release);
+        ring.tail.notify_all();
+      }
+
+      fd = record.fd;
+      iov[count].iov_base = ring.data + offset + sizeof(record);
+      iov[count].iov_len = record.length;
+      count++;
+      bytes += record.length;
+    }
+
+    tail += size;
+  }
+
+  if (count > 0) {
+    _log_writev(fd, iov, count);
+    _log_records.fetch_add(count, std::memory_order_relaxed);
+  }
+  _log_bytes.fetch_add(bytes, std::memory_order_relaxed);
+
+  ring.tail.store(tail, std::memory_order_release);
+  ring.tail.notify_all();
+}
+
+/** Drains all rings and frees the ones of exited threads.  */
+static void
+_log_drain_all()
+{
+  std::vector<std::shared_ptr<_LogRing>> rings;
+  {
+    std::lock_guard<std::mutex> lock(_log_mutex);
+    rings = _log_rings;
+  }
+
+  /* A ring closed before its drain gets no new lines, so it is empty
+   * after it.  One closed during the drain is freed next time.  */
+  std::vector<const _LogRing*> drained;
+  for (const std::shared_ptr<_LogRing>& ring: rings) {
+    const bool closed = ring->closed.load(std::memory_order_acquire);
+    _log_drain(*ring);
+    if (closed) drained.push_back(ring.get());
+  }
+  if (drained.empty()) return;
+
+  std::lock_guard<std::mutex> lock(_log_mutex);
+  std::erase_if(_log_rings,
+    [&drained](const std::shared_ptr<_LogRing>& ring) {
+      return std::find(drained.begin(), drained.end(), ring.get())
+        != drained.end();
+    });
+}
+
+static void
+_log_run_writer()
+{
+  for (;;) {
+    const std::uint32_t pending
+      = _log_pending.load(std::memory_order_acquire);
+    const bool stopping = _log_stopping.load(std::memory_order_acquire);
+
+    _log_drain_all();
+    if (stopping) return;
+
+    _log_pending.wait(pending, std::memory_order_acquire);
+  }
+}
+
+static void
+_log_wake_writer()
+{
+  _log_pending.fetch_add(1, std::memory_order_release);
+  _log_pending.notify_one();
+}
+
+/** Waits until the lines in `ring` up to `pos` are written.  */
+static void
+_log_wait_tail(_LogRing& ring, std::uint64_t pos)
+{
+  std::uint64_t tail;
+  while ((tail = ring.tail.load(std::memory_order_acquire)) < pos)
+    ring.tail.wait(tail, std::memory_order_acquire);
+}
+
+static _LogRing&
+_log_get_ring()
+{
+  if (!_log_handle.ring) {
+    _log_handle.ring = std::make_shared<_LogRing>();
+
+    std::lock_guard<std::mutex> lock(_log_mutex);
+    _log_rings.push_back(_log_handle.ring);
+  }
+
+  return *_log_handle.ring;
+}
+
+/** Appends `msg` to the ring of the calling thread.  */
+static void
+_log_push(int fd, std::string_view msg)
+{
+  _LogRing& ring = _log_get_ring();
+
+  const std::size_t size = (sizeof(_LogRecord) + msg.length()
+                            + _LOG_ALIGN - 1) & ~(_LOG_ALIGN - 1);
+  std::uint64_t head = ring.head.load(std::memory_order_relaxed);
+
+  /* Does not fit, write it here after the pending lines.  */
+  if (size > Log::RING_SIZE / 2) {
+    _log_wake_writer();
+    _log_wait_tail(ring, head);
+
+    struct iovec iov = {const_cast<char*>(msg.data()), msg.length()};
+    _log_writev(fd, &iov, 1);
+    _log_records.fetch_add(1, std::memory_order_relaxed);
+    _log_bytes.fetch_add(msg.length(), std::memory_order_relaxed);
+    return;
+  }
+
+  /* Lines are not wrapped, skip the end of the ring if needed.  */
+  const std::size_t offset = head & (Log::RING_SIZE - 1);
+  const std::size_t skip
+    = Log::RING_SIZE - offset < size? Log::RING_SIZE - offset: 0;
+
+  std::uint64_t tail = ring.tail.load(std::memory_order_acquire);
+  if (head + skip + size - tail > Log::RING_SIZE) {
+    if (_log_overflow == Log::Overflow::DROP) {
+      _log_dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    _log_blocked.fetch_add(1, std::memory_order_relaxed);
+    _log_wake_writer();
+    _log_wait_tail(ring, head + skip + size - Log::RING_SIZE);
+  }
+
+  if (skip > 0) {
+    const _LogRecord record = {
+      static_cast<std::uint32_t>(skip - sizeof(_LogRecord)), _LOG_SKIP};
+    std::memcpy(ring.data + offset, &record, sizeof(record));
+    head += skip;
+  }
+
+  const _LogRecord record = {
+    static_cast<std::uint32_t>(msg.length()), fd};
+  char* dest = ring.data + (head & (Log::RING_SIZE - 1));
+  std::memcpy(dest, &record, sizeof(record));
+  std::memcpy(dest + sizeof(record), msg.data(), msg.length());
+
+  ring.head.store(head + size, std::memory_order_release);
+  _log_wake_writer();
+}
+
+/* ---------------------------------------------------------------  */
+
+static inline void
+_write(int fd, std::string_view msg)
+{
+  if (_log_async.load(std::memory_order_acquire)) {
+    _log_push(fd, msg);
+    return;
+  }
+
+  if (fd != STDOUT_FILENO && fd != STDERR_FILENO) {
+    struct iovec iov = {const_cast<char*>(msg.data()), msg.length()};
+    _log_writev(fd, &iov, 1);
+    return;
+  }
+
+  std::ostream& out = fd == STDOUT_FILENO? std::cout: std::clog;
+  out.write(msg.data(), msg.length());
+}
+
+static inline std::string_view
+_view(const ustr8& msg)
+{
+  return std::string_view(reinterpret_cast<const char*>(msg.c_str()),
+                          msg.size_bytes());
+}
+
+static inline std::string_view
+_view(const char8_t* msg)
+{
+  return std::string_view(reinterpret_cast<const char*>(msg));
+}
+
+/**
+ * Formats `prefix` + "LEVEL:command-name: MESSAGE" + `end` into
+ * `_log_line`, or without level if `level` is nullptr, and writes it
+ * to `fd`.
+ */
+static void
+_vwrite(int fd, const char* prefix, const char* level,
+        std::string_view fmt, std::format_args args, const char* end)
+{
+  _log_line.clear();
+  _log_line += prefix;
+
+  if (level != nullptr) {
+    _log_line += level;
+    _log_line += ':';
+    _log_line += _view(Params::get_command_name_utf8());
+    _log_line += ": ";
+  }
+
+  std::vformat_to(std::back_inserter(_log_line), fmt, args);
+  _log_line += end;
+
+  _write(fd, _log_line);
+}
+
+} /* namespace socialmedia_signer  */
+
+/* ***************************************************************  */
+
+/* Zero initialized to Level::DEBUGGING, so Log::LEVEL_MIN is the
+ * default.
+ */
+std::atomic<socialmedia_signer::Log::Level>
+socialmedia_signer::Log::levels[static_cast<unsigned>(Subsystem::COUNT)];
+
+std::atomic<int>
+socialmedia_signer::Log::binary_fd(-1);
+
+/* ***************************************************************  */
+
+void
+socialmedia_signer::Log::init(Overflow overflow)
+{
+  std::unique_lock<std::mutex> lock(_log_mutex);
+
+  if (_log_writer != nullptr) {
+    lock.unlock();
+    Log::fatal(u8"Log::init(): double call!");
+  }
+
+  /* Lines written synchronously before go first.  */
+  std::cout.flush();
+  std::clog.flush();
+
+  _log_overflow = overflow;
+  _log_stopping.store(false, std::memory_order_release);
+  _log_writer = new std::thread(_log_run_writer);
+
+  _log_async.store(true, std::memory_order_release);
+}
+
+void
+socialmedia_signer::Log::release()
+{
+  std::thread* writer;
+  {
+    std::lock_guard<std::mutex> lock(_log_mutex);
+    if (_log_writer == nullptr) return;
+
+    writer = _log_writer;
+    _log_writer = nullptr;
+  }
+
+  _log_async.store(false, std::memory_order_release);
+  _log_stopping.store(true, std::memory_order_release);
+  _log_wake_writer();
+
+  writer->join();
+  delete writer;
+
+  Stats stats = Log::get_stats();
+  LOG_DEBUG(LOG,
+    "LOG: {} lines, {} bytes, {} writes, {} dropped, {} blocked",
+    stats.records, stats.bytes, stats.writes, stats.dropped,
+    stats.blocked);
+}
+
+void
+socialmedia_signer::Log::flush()
+{
+  if (!_log_async.load(std::memory_order_acquire)) return;
+
+  std::vector<std::shared_ptr<_LogRing>> rings;
+  {
+    std::lock_guard<std::mutex> lock(_log_mutex);
+    rings = _log_rings;
+  }
+
+  std::vector<std::uint64_t> heads;
+  heads.reserve(rings.size());
+  for (const std::shared_ptr<_LogRing>& ring: rings)
+    heads.push_back(ring->head.load(std::memory_order_acquire));
+
+  _log_wake_writer();
+  for (std::size_t i=0; i < rings.size(); i++)
+    _log_wait_tail(*rings[i], heads[i]);
+}
+
+socialmedia_signer::Log::Stats
+socialmedia_signer::Log::get_stats()
+{
+  return {
+    _log_records.load(std::memory_order_relaxed),
+    _log_bytes.load(std::memory_order_relaxed),
+    _log_writes.load(std::memory_order_relaxed),
+    _log_dropped.load(std::memory_order_relaxed),
+    _log_blocked.load(std::memory_order_relaxed)
+  };
+}
+
+/* ***************************************************************  */
+
+void
+socialmedia_signer::Log::open_binary(const char* path) noexcept(false)
+{
+  if (path == nullptr) return;
+
+  if (Log::is_binary())
+    Log::fatal(u8"Log::open_binary(): double call!");
+
+  const int fd = ::open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC,
+                        0644);
+  if (fd < 0) {
+    throw Error(ustr::format("binary log '{}': {}",
+                             path, std::strerror(errno)));
+  }
+
+  /* Append to a log of previous runs, if it is one.  */
+  LogBinary::Header header;
+  const ssize_t size = ::pread(fd, &header, sizeof(header), 0);
+  if (size == 0) {
+    header = {{}, LogBinary::VERSION, 0};
+    std::memcpy(header.magic, LogBinary::MAGIC, sizeof(header.magic));
+
+    struct iovec iov = {&header, sizeof(header)};
+    _log_writev(fd, &iov, 1);
+  } else if (size != sizeof(header)
+             || std::memcmp(header.magic, LogBinary::MAGIC,
+                            sizeof(header.magic)) != 0
+             || header.version != LogBinary::VERSION) {
+    ::close(fd);
+    throw Error(ustr::format("binary log '{}': not a binary log of"
+                             " version {}", path, LogBinary::VERSION));
+  }
+
+  /* Synchronously, like the Format records.  */
+  std::string record;
+  LogBinary::session(record);
+
+  struct iovec iov = {record.data(), record.length()};
+  _log_writev(fd, &iov, 1);
+
+  Log::binary_fd.store(fd, std::memory_order_release);
+}
+
+void
+socialmedia_signer::Log::close_binary()
+{
+  Log::flush();
+
+  const int fd = Log::binary_fd.exchange(-1);
+  if (fd >= 0) ::close(fd);
+}
+
+std::uint32_t
+socialmedia_signer::Log::register_format(Level level,
+  Subsystem subsystem, std::string_view fmt)
+{
+  std::lock_guard<std::mutex> lock(_log_binary_mutex);
+  const std::uint32_t id = ++_log_formats;
+
+  std::string record;
+  LogBinary::format(record, id, static_cast<std::uint8_t>(level),
+                    static_cast<std::uint8_t>(subsystem), fmt);
+
+  /* Synchronously, so it is in the file before any line using it.  */
+  struct iovec iov = {record.data(), record.length()};
+  _log_writev(Log::binary_fd.load(std::memory_order_acquire), &iov, 1);
+
+  return id;
+}
+
+void
+socialmedia_signer::Log::write_binary(std::string& record)
+{
+  LogBinary::end_record(record);
+
+  _write(Log::binary_fd.load(std::memory_order_relaxed), record);
+}
+
+/* ***************************************************************  */
+
+void
+socialmedia_signer::Log::set_levels(const char* spec)
+{
+  if (spec == nullptr) return;
+
+  const auto& level_names = LogBinary::LEVEL_NAMES;
+  const auto& subsystem_names = LogBinary::SUBSYSTEM_NAMES;
+
+  std::string_view rest = spec;
+  while (!rest.empty()) {
+    const std::size_t comma = rest.find(',');
+    std::string_view item = rest.substr(0, comma);
+    rest = comma == std::string_view::npos? "": rest.substr(comma + 1);
+    if (item.empty()) continue;
+
+    std::string_view name;
+    const std::size_t equals = item.find('=');
+    if (equals != std::string_view::npos) {
+      name = item.substr(0, equals);
+      item = item.substr(equals + 1);
+    }
+
+    const auto level = std::find(std::begin(level_names),
+                                 std::end(level_names), item);
+    if (level == std::end(level_names)) {
+      Log::warn("log levels: unknown level '{}'", item);
+      continue;
+    }
+    const Level value = static_cast<Level>(
+      level - std::begin(level_names));
+
+    if (name.empty()) {
+      for (std::atomic<Level>& cur: Log::levels)
+        cur.store(value, std::memory_order_relaxed);
+      continue;
+    }
+
+    const auto subsystem = std::find(std::begin(subsystem_names),
+                                     std::end(subsystem_names), name);
+    if (subsystem == std::end(subsystem_names)) {
+      Log::warn("log levels: unknown subsystem '{}'", name);
+      continue;
+    }
+    Log::set_level(static_cast<Subsystem>(
+      subsystem - std::begin(subsystem_names)), value);
+  }
+}
+
+void
+socialmedia_signer::Log::set_level(Subsystem subsystem,
+                                   Level level) noexcept
+{
+  Log::levels[static_cast<unsigned>(subsystem)]
+    .store(level, std::memory_order_relaxed);
+}
 
 /* ***************************************************************  */
 
 void
 socialmedia_signer::Log::print(const ustr& msg)
 {
-  std::u8string buf;
-  msg.out_utf8(buf);
+  _write(STDOUT_FILENO, msg.utf8_scratch());
+}
+
+void
+socialmedia_signer::Log::print(const ustr8& msg)
+{
+  _write(STDOUT_FILENO, _view(msg));
+}
 
-  std::cout << reinterpret_cast<const char*>(buf.data());
+void
+socialmedia_signer::Log::print(const char8_t* msg)
+{
+  _write(STDOUT_FILENO, _view(msg));
 }
 
 void
 socialmedia_signer::Log::println(const ustr& msg)
 {
-  std::u8string buf;
-  msg.out_utf8(buf);
+  Log::vprintln("{}", std::make_format_args(msg));
+}
+
+void
+socialmedia_signer::Log::println(const ustr8& msg)
+{
+  Log::vprintln("{}", std::make_format_args(msg));
+}
 
-  std::cout << reinterpret_cast<const char*>(buf.data()) << "\n";
+void
+socialmedia_signer::Log::println(const char8_t* msg)
+{
+  Log::vprintln("{}", std::make_format_args(msg));
 }
 
 void
 socialmedia_signer::Log::println()
 {
-  std::cout << "\n";
+  _write(STDOUT_FILENO, "\n");
 }
 
-/* ***************************************************************  */
+void
+socialmedia_signer::Log::vprint(std::string_view fmt,
+                                std::format_args args)
+{
+  _vwrite(STDOUT_FILENO, "", nullptr, fmt, args, "");
+}
 
-namespace socialmedia_signer {
+void
+socialmedia_signer::Log::vprintln(std::string_view fmt,
+                                  std::format_args args)
+{
+  _vwrite(STDOUT_FILENO, "", nullptr, fmt, args, "\n");
+}
 
-static void _prefix(ustr& out, const ustr& level, const ustr& msg)
+void
+socialmedia_signer::Log::println_sync(std::string_view msg)
 {
-  const ustr& cmd_name = Params::get_command_name();
+  /* Synchronous lines before are still buffered by std::cout.  */
+  if (!_log_async.load(std::memory_order_acquire)) std::cout.flush();
 
-  out = ustr::format("{}:{}: {}\n", level, cmd_name, msg);
+  struct iovec iov[2] = {
+    {const_cast<char*>(msg.data()), msg.length()},
+    {const_cast<char*>("\n"), 1}};
+  _log_writev(STDOUT_FILENO, iov, 2);
+
+  _log_records.fetch_add(1, std::memory_order_relaxed);
+  _log_bytes.fetch_add(msg.length() + 1, std::memory_order_relaxed);
 }
 
-} /* namespace socialmedia_signer  */
+/* ***************************************************************  */
 
 #ifdef DEBUG
 void
 socialmedia_signer::Log::debug(const ustr& msg)
 {
-  std::u8string buf;
-  msg.out_utf8(buf);
+  Log::vdebug("{}", std::make_format_args(msg));
+}
+
+void
+socialmedia_signer::Log::debug(const ustr8& msg)
+{
+  Log::vdebug("{}", std::make_format_args(msg));
+}
+
+void
+socialmedia_signer::Log::debug(const char8_t* msg)
+{
+  Log::vdebug("{}", std::make_format_args(msg));
+}
 
-  std::clog << "DEBUG: "
-            << reinterpret_cast<const char*>(buf.data()) << "\n";
+void
+socialmedia_signer::Log::vdebug(std::string_view fmt,
+                                std::format_args args)
+{
+  _vwrite(STDERR_FILENO, "DEBUG: ", nullptr, fmt, args, "\n");
 }
 #endif
 
+/* ---------------------------------------------------------------  */
+
 void
 socialmedia_signer::Log::note(const ustr& msg)
 {
-  ustr out;
-  _prefix(out, u8"note", msg);
+  Log::vnote("{}", std::make_format_args(msg));
+}
+
+void
+socialmedia_signer::Log::note(const ustr8& msg)
+{
+  Log::vnote("{}", std::make_format_args(msg));
+}
 
-  std::u8string buf;
-  out.out_utf8(buf);
+void
+socialmedia_signer::Log::note(const char8_t* msg)
+{
+  Log::vnote("{}", std::make_format_args(msg));
+}
 
-  std::clog << reinterpret_cast<const char*>(buf.data());
+void
+socialmedia_signer::Log::vnote(std::string_view fmt,
+                               std::format_args args)
+{
+  _vwrite(STDERR_FILENO, "", "note", fmt, args, "\n");
 }
 
+/* ---------------------------------------------------------------  */
+
 void
 socialmedia_signer::Log::warn(const ustr& msg)
 {
-  ustr out;
-  _prefix(out, u8"Warning", msg);
+  Log::vwarn("{}", std::make_format_args(msg));
+}
+
+void
+socialmedia_signer::Log::warn(const ustr8& msg)
+{
+  Log::vwarn("{}", std::make_format_args(msg));
+}
 
-  std::u8string buf;
-  out.out_utf8(buf);
+void
+socialmedia_signer::Log::warn(const char8_t* msg)
+{
+  Log::vwarn("{}", std::make_format_args(msg));
+}
 
-  std::clog << reinterpret_cast<const char*>(buf.data());
+void
+socialmedia_signer::Log::vwarn(std::string_view fmt,
+                               std::format_args args)
+{
+  _vwrite(STDERR_FILENO, "", "Warning", fmt, args, "\n");
 }
 
+/* ---------------------------------------------------------------  */
+
 void
 socialmedia_signer::Log::error(const ustr& msg)
 {
-  ustr out;
-  _prefix(out, u8"ERROR", msg);
+  Log::verror("{}", std::make_format_args(msg));
+}
+
+void
+socialmedia_signer::Log::error(const ustr8& msg)
+{
+  Log::verror("{}", std::make_format_args(msg));
+}
 
-  std::u8string buf;
-  out.out_utf8(buf);
+void
+socialmedia_signer::Log::error(const char8_t* msg)
+{
+  Log::verror("{}", std::make_format_args(msg));
+}
 
-  std::clog << reinterpret_cast<const char*>(buf.data());
+void
+socialmedia_signer::Log::verror(std::string_view fmt,
+                                std::format_args args)
+{
+  _vwrite(STDERR_FILENO, "", "ERROR", fmt, args, "\n");
 }
 
+/* ---------------------------------------------------------------  */
+
 void
 socialmedia_signer::Log::fatal(const ustr& msg, int exit_code)
 {
-  ustr out;
-  _prefix(out, u8"FATAL", msg);
+  Log::vfatal("{}", std::make_format_args(msg), exit_code);
+}
+
+void
+socialmedia_signer::Log::fatal(const ustr8& msg, int exit_code)
+{
+  Log::vfatal("{}", std::make_format_args(msg), exit_code);
+}
+
+void
+socialmedia_signer::Log::fatal(const char8_t* msg, int exit_code)
+{
+  Log::vfatal("{}", std::make_format_args(msg), exit_code);
+}
+
+void
+socialmedia_signer::Log::vfatal(std::string_view fmt,
+                                std::format_args args, int exit_code)
+{
+  const std::string msg = std::vformat(fmt, args);
 
-  std::u8string buf;
-  out.out_utf8(buf);
+  /* Writes the pending lines first, this one synchronously.  */
+  Log::release();
 
-  std::clog << reinterpret_cast<const char*>(buf.data());
+  _vwrite(STDERR_FILENO, "", "FATAL", "{}", std::make_format_args(msg),
+          "\n");
+  FlightRecorder::dump(msg.c_str());
 
   std::exit(exit_code);
 }
@@ -20,6 +20,10 @@
 #define LOG_HPP__
 
 #include "common.hpp"
+#include "LogBinary.hpp"
+
+#include <atomic>
+#include <cstdint>
 
 /* ***************************************************************  */
 
@@ -28,6 +32,40 @@ namespace socialmedia_signer {
 /**
  * Abstract class which includes static methods for outputting
  * text messages to log or console.
+ *
+ * Every method takes a ::ustr, a ::ustr8 which is written without
+ * conversion, or a UTF-8 literal which would be ambiguous otherwise.
+ *
+ * The formatting overloads take the arguments of ustr::format() and
+ * format the line directly to UTF-8, into a buffer of the calling
+ * thread, so
+ * ```cpp
+ *   Log::println("{} bytes", size);
+ * ```
+ * needs no allocation after warm up, while
+ * `Log::println(ustr::format("{} bytes", size))` converts the line to
+ * UTF-32 and back.
+ *
+ * Between Log::init() and Log::release() the lines are written
+ * asynchronously.  Each thread appends its formatted lines to a ring
+ * buffer of Log::RING_SIZE bytes, and a background thread writes
+ * them out, many lines per WRITEV() call.  The lines of one thread
+ * keep their order, and no line is split by lines of other threads.
+ * If a ring buffer is full, the caller waits or the line is dropped,
+ * see Log::Overflow and Log::get_stats().  Log::fatal() writes all
+ * pending lines before it exits.
+ *
+ * Use the macros LOG_DEBUG(), LOG_NOTE(), LOG_WARN() and LOG_ERROR()
+ * where the arguments are expensive, they are evaluated only if the
+ * level is enabled for the Log::Subsystem:
+ * ```cpp
+ *   LOG_DEBUG(IMAGE, "IMAGE: {} saved", image->to_string());
+ * ```
+ * Without `-DDEBUG` the debug level is disabled at compile time and
+ * such lines are removed completely, but still type checked.  At
+ * runtime the levels are set per subsystem by Log::set_levels().
+ * After Log::open_binary() the macros append binary records to a
+ * file instead, which are formatted offline, see ::LogBinary.
  */
 class Log
 {
@@ -37,30 +75,258 @@ public:
   Log(Log& other) = delete;
   virtual ~Log()  = 0;
 
+  /** What happens if the ring buffer of the calling thread is full.  */
+  enum class Overflow {
+    /** Wait until the background thread made space.  */
+    BLOCK,
+    /** Drop the line, counted in Log::Stats::dropped.  */
+    DROP
+  };
+
+  struct Stats {
+    unsigned long records;
+    unsigned long bytes;
+    unsigned long writes;
+
+    unsigned long dropped;
+    unsigned long blocked;
+  };
+
+  /** Bytes of the ring buffer per thread, a power of two.  */
+  static constexpr std::size_t RING_SIZE = 64UL << 10;
+
+  /* DEBUG is taken by the build flag.  */
+  enum class Level: unsigned char {
+    DEBUGGING, NOTE, WARNING, ERROR
+  };
+
+  /** Parts of the program, which have their own minimum level.  */
+  enum class Subsystem: unsigned char {
+    GENERAL, APP, PARAMS, IMAGE, ARCHIVE, CRYPTO, BUFFERPOOL, QRCACHE,
+    LOG,
+
+    COUNT
+  };
+
+  /** Lowest level which is compiled in.  */
+#ifdef DEBUG
+  static constexpr Level LEVEL_MIN = Level::DEBUGGING;
+#else
+  static constexpr Level LEVEL_MIN = Level::NOTE;
+#endif
+
+  /* -------------------------------------------------------------  */
+
+  /**
+   * Starts the background thread.  Without it, every line is written
+   * synchronously by the calling thread.
+   */
+  static void init(Overflow overflow = Overflow::BLOCK);
+
+  /**
+   * Writes all pending lines and stops the background thread.  Call
+   * it after all other threads stopped logging, the following lines
+   * are written synchronously again.
+   */
+  static void release();
+
+  /** Waits until all lines logged so far are written.  */
+  static void flush();
+
+  static Stats get_stats();
+
+  /* -------------------------------------------------------------  */
+
+  /**
+   * Sets the minimum levels from `spec`, a comma separated list of
+   * `level` for all subsystems or `subsystem=level`, applied from
+   * left to right, i.e. "warning,image=debug".  Names are lower
+   * case, unknown ones are warned about.  Does nothing if `spec` is
+   * nullptr.
+   */
+  static void set_levels(const char* spec);
+
+  static void set_level(Subsystem subsystem, Level level) noexcept;
+
+  /* -------------------------------------------------------------  */
+
+  /**
+   * Appends the lines of the LOG_*() macros to the binary log at
+   * `path` from now on, instead of formatting them.  Does nothing if
+   * `path` is nullptr.  Throws an ::Error if the file can not be
+   * opened or is no binary log.  Once per process.
+   */
+  static void open_binary(const char* path) noexcept(false);
+  /** Call it after Log::release().  */
+  static void close_binary();
+
+  static bool is_binary() noexcept
+  {
+    return Log::binary_fd.load(std::memory_order_relaxed) >= 0;
+  }
+
+  /** Writes the format string of a LOG_*() call site, once.  */
+  static std::uint32_t register_format(Level level, Subsystem subsystem,
+                                       std::string_view fmt);
+
+  template<typename... Args> inline static void
+    binary(std::uint32_t format_id, const Args&... args)
+  {
+    std::string& record = LogBinary::begin_event(format_id);
+    (LogBinary::put(record, args), ...);
+
+    Log::write_binary(record);
+  }
+
+  static void write_binary(std::string& record);
+
+  /* -------------------------------------------------------------  */
+
+  /** Constant false for levels below Log::LEVEL_MIN.  */
+  static bool is_enabled(Level level, Subsystem subsystem) noexcept
+  {
+    return level >= Log::LEVEL_MIN
+      && level >= Log::levels[static_cast<unsigned>(subsystem)]
+                     .load(std::memory_order_relaxed);
+  }
+
   /* -------------------------------------------------------------  */
 
   static void print(const ustr& msg);
+  static void print(const ustr8& msg);
+  static void print(const char8_t* msg);
 
   static void println(const ustr& msg);
+  static void println(const ustr8& msg);
+  static void println(const char8_t* msg);
   static void println();
 
+  template<typename... Args> inline static void
+    print(const std::format_string<Args...> fmt, Args&&... args)
+  {
+    Log::vprint(fmt.get(), std::make_format_args(args...));
+  }
+  template<typename... Args> inline static void
+    println(const std::format_string<Args...> fmt, Args&&... args)
+  {
+    Log::vprintln(fmt.get(), std::make_format_args(args...));
+  }
+
+  static void vprint(std::string_view fmt, std::format_args args);
+  static void vprintln(std::string_view fmt, std::format_args args);
+
+  /**
+   * Writes `msg` and a newline to STDOUT by the calling thread,
+   * bypassing the ring buffers, so the line is written when it
+   * returns.  For results of a run which must not be lost or follow
+   * its final error.  Lines logged asynchronously before may follow.
+   */
+  static void println_sync(std::string_view msg);
+
   /* -------------------------------------------------------------  */
 
 #ifdef DEBUG
   static void debug(const ustr& msg);
+  static void debug(const ustr8& msg);
+  static void debug(const char8_t* msg);
+
+  template<typename... Args> inline static void
+    debug(const std::format_string<Args...> fmt, Args&&... args)
+  {
+    Log::vdebug(fmt.get(), std::make_format_args(args...));
+  }
+
+  static void vdebug(std::string_view fmt, std::format_args args);
 #else
   static void debug([[maybe_unused]] const ustr& msg) {};
+  static void debug([[maybe_unused]] const ustr8& msg) {};
+  static void debug([[maybe_unused]] const char8_t* msg) {};
+
+  template<typename... Args> inline static void
+    debug([[maybe_unused]] const std::format_string<Args...> fmt,
+          [[maybe_unused]] Args&&... args) {};
+
+  static void vdebug([[maybe_unused]] std::string_view fmt,
+                     [[maybe_unused]] std::format_args args) {};
 #endif
 
   static void note(const ustr& msg);
+  static void note(const ustr8& msg);
+  static void note(const char8_t* msg);
   static void warn(const ustr& msg);
+  static void warn(const ustr8& msg);
+  static void warn(const char8_t* msg);
   static void error(const ustr& msg);
+  static void error(const ustr8& msg);
+  static void error(const char8_t* msg);
 
+  template<typename... Args> inline static void
+    note(const std::format_string<Args...> fmt, Args&&... args)
+  {
+    Log::vnote(fmt.get(), std::make_format_args(args...));
+  }
+  template<typename... Args> inline static void
+    warn(const std::format_string<Args...> fmt, Args&&... args)
+  {
+    Log::vwarn(fmt.get(), std::make_format_args(args...));
+  }
+  template<typename... Args> inline static void
+    error(const std::format_string<Args...> fmt, Args&&... args)
+  {
+    Log::verror(fmt.get(), std::make_format_args(args...));
+  }
+
+  static void vnote(std::string_view fmt, std::format_args args);
+  static void vwarn(std::string_view fmt, std::format_args args);
+  static void verror(std::string_view fmt, std::format_args args);
+
+  /* The exit code would be ambiguous with a formatting overload.  */
   static void fatal(const ustr& msg, int exit_code = 0xff);
+  static void fatal(const ustr8& msg, int exit_code = 0xff);
+  static void fatal(const char8_t* msg, int exit_code = 0xff);
+  static void vfatal(std::string_view fmt, std::format_args args,
+                     int exit_code = 0xff);
+
+private:
+  /** Minimum level per subsystem, read by all threads.  */
+  static std::atomic<Level>
+    levels[static_cast<unsigned>(Subsystem::COUNT)];
+
+  /** File descriptor of the binary log, or -1.  */
+  static std::atomic<int> binary_fd;
 };
 
 }
 
 /* ***************************************************************  */
 
+/* Evaluates the arguments only if LEVEL is enabled for SUBSYSTEM.
+ * The format string of each call site is registered once for the
+ * binary log.
+ */
+#define LOG_AT(level, method, subsystem, fmt, ...) \
+  do { \
+    using socialmedia_signer::Log; \
+    if (!Log::is_enabled(Log::Level::level, \
+                         Log::Subsystem::subsystem)) break; \
+    if (Log::is_binary()) { \
+      static const std::uint32_t log_format_id = Log::register_format( \
+        Log::Level::level, Log::Subsystem::subsystem, fmt); \
+      Log::binary(log_format_id __VA_OPT__(,) __VA_ARGS__); \
+    } else { \
+      Log::method(fmt __VA_OPT__(,) __VA_ARGS__); \
+    } \
+  } while (false)
+
+#define LOG_DEBUG(subsystem, ...) \
+  LOG_AT(DEBUGGING, debug, subsystem, __VA_ARGS__)
+#define LOG_NOTE(subsystem, ...) \
+  LOG_AT(NOTE, note, subsystem, __VA_ARGS__)
+#define LOG_WARN(subsystem, ...) \
+  LOG_AT(WARNING, warn, subsystem, __VA_ARGS__)
+#define LOG_ERROR(subsystem, ...) \
+  LOG_AT(ERROR, error, subsystem, __VA_ARGS__)
+
+/* ***************************************************************  */
+
 #endif /* LOG_HPP__  */
@@ -0,0 +1,214 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "LogBinary.hpp"
+
+#include "Utf8.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+
+#include <unistd.h>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/** Record of the calling thread, reused by every line.  */
+static thread_local std::string _logbinary_event;
+
+/** Event::thread of the calling thread, 0 before its first line.  */
+static thread_local std::uint32_t _logbinary_thread = 0;
+static std::atomic<std::uint32_t> _logbinary_threads(0);
+
+/** Event::time_ns zero, set by LogBinary::session().  */
+static std::chrono::steady_clock::time_point _logbinary_start;
+
+template<typename T> static inline void
+_logbinary_append(std::string& out, const T& value)
+{
+  out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+/** Appends a Record header, its size is set by end_record().  */
+static inline void
+_logbinary_begin(std::string& out, LogBinary::Type type)
+{
+  const LogBinary::Record record = {0, type, 0};
+  _logbinary_append(out, record);
+}
+
+} /* namespace socialmedia_signer  */
+
+/* ***************************************************************  */
+
+void
+socialmedia_signer::LogBinary::session(std::string& out)
+{
+  _logbinary_start = std::chrono::steady_clock::now();
+  const auto realtime = std::chrono::system_clock::now();
+
+  const std::size_t pos = out.length();
+  _logbinary_begin(out, Type::SESSION);
+
+  const Session session = {
+    std::chrono::duration_cast<std::chrono::nanoseconds>(
+      realtime.time_since_epoch()).count(),
+    static_cast<std::uint32_t>(getpid()), 0};
+  _logbinary_append(out, session);
+
+  LogBinary::end_record(out, pos);
+}
+
+void
+socialmedia_signer::LogBinary::format(std::string& out, std::uint32_t id,
+  std::uint8_t level, std::uint8_t subsystem, std::string_view fmt)
+{
+  const std::size_t pos = out.length();
+  _logbinary_begin(out, Type::FORMAT);
+
+  const Format format = {id, level, subsystem, 0};
+  _logbinary_append(out, format);
+  out += fmt;
+
+  LogBinary::end_record(out, pos);
+}
+
+std::string&
+socialmedia_signer::LogBinary::begin_event(std::uint32_t format_id)
+{
+  if (_logbinary_thread == 0)
+    _logbinary_thread = _logbinary_threads.fetch_add(1) + 1;
+
+  std::string& out = _logbinary_event;
+  out.clear();
+  _logbinary_begin(out, Type::EVENT);
+
+  const Event event = {
+    format_id, _logbinary_thread,
+    static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - _logbinary_start).count())};
+  _logbinary_append(out, event);
+
+  return out;
+}
+
+void
+socialmedia_signer::LogBinary::end_record(std::string& record,
+                                          std::size_t pos)
+{
+  const std::uint32_t size
+    = static_cast<std::uint32_t>(record.length() - pos);
+  std::memcpy(record.data() + pos, &size, sizeof(size));
+
+  record.append((ALIGN - size % ALIGN) % ALIGN, '\0');
+}
+
+/* ***************************************************************  */
+
+void
+socialmedia_signer::LogBinary::put(std::string& out, bool value)
+{
+  out += static_cast<char>(Arg::BOOL);
+  out += static_cast<char>(value);
+}
+
+void
+socialmedia_signer::LogBinary::put(std::string& out, char32_t value)
+{
+  char8_t seq[Utf8::MAX_LENGTH];
+  const Utf8::Result result = Utf8::encode(seq, &value, 1);
+
+  LogBinary::put(out, std::string_view(
+    reinterpret_cast<const char*>(seq), result.written));
+}
+
+void
+socialmedia_signer::LogBinary::put(std::string& out,
+                                   std::string_view value)
+{
+  const std::size_t pos = LogBinary::begin_string(out);
+  out += value;
+  LogBinary::end_string(out, pos);
+}
+
+void
+socialmedia_signer::LogBinary::put(std::string& out, const char* value)
+{
+  LogBinary::put(out, std::string_view(value));
+}
+
+void
+socialmedia_signer::LogBinary::put(std::string& out,
+                                   const char8_t* value)
+{
+  LogBinary::put(out,
+    std::string_view(reinterpret_cast<const char*>(value)));
+}
+
+void
+socialmedia_signer::LogBinary::put(std::string& out,
+                                   const std::u8string& value)
+{
+  LogBinary::put(out, std::string_view(
+    reinterpret_cast<const char*>(value.data()), value.length()));
+}
+
+void
+socialmedia_signer::LogBinary::put(std::string& out, const ustr& value)
+{
+  LogBinary::put(out, value.utf8_scratch());
+}
+
+void
+socialmedia_signer::LogBinary::put(std::string& out, ustr_view value)
+{
+  LogBinary::put(out,
+    ustr::utf8_scratch(value.data(), value.length()));
+}
+
+void
+socialmedia_signer::LogBinary::put(std::string& out, const ustr8& value)
+{
+  LogBinary::put(out, std::string_view(
+    reinterpret_cast<const char*>(value.c_str()), value.size_bytes()));
+}
+
+/* ---------------------------------------------------------------  */
+
+std::size_t
+socialmedia_signer::LogBinary::begin_string(std::string& out)
+{
+  out += static_cast<char>(Arg::STRING);
+
+  const std::size_t pos = out.length();
+  out.append(sizeof(std::uint32_t), '\0');
+
+  return pos;
+}
+
+void
+socialmedia_signer::LogBinary::end_string(std::string& out,
+                                          std::size_t pos)
+{
+  const std::uint32_t length = static_cast<std::uint32_t>(
+    out.length() - pos - sizeof(std::uint32_t));
+  std::memcpy(out.data() + pos, &length, sizeof(length));
+}
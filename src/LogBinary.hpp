@@ -0,0 +1,201 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef LOGBINARY_HPP__
+#define LOGBINARY_HPP__
+
+#include "ustr.hpp"
+#include "ustr8.hpp"
+
+#include <string>
+#include <string_view>
+#include <format>
+#include <concepts>
+#include <iterator>
+#include <cstdint>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/**
+ * Abstract class which describes the binary log of ::Log, see
+ * Log::open_binary(), and encodes its records.  Instead of the
+ * formatted line, a record holds the id of the format string and the
+ * raw arguments, which are formatted later by `tools/log-decode`.
+ *
+ * The file is little endian, all records are aligned to
+ * LogBinary::ALIGN bytes:
+ *
+ *   LogBinary::Header              once per file
+ *   Record + Session               per process which appends
+ *   Record + Format + string       per format string, before its use
+ *   Record + Event + arguments     per line
+ *
+ * Each record is written by one WRITE() call and never changed
+ * afterwards.  So a reader may MMAP() the file while it grows, and
+ * stops at a record which reaches beyond the end of the file.  The
+ * ids of format strings are valid until the next Session record.
+ *
+ * Each argument is a LogBinary::Arg tag followed by its value, 8
+ * bytes for numbers, and a 32 bit length followed by UTF-8 for
+ * strings.  Arguments of other types are formatted to strings.
+ */
+class LogBinary
+{
+public:
+  /* Abstract class  */
+  LogBinary()                 = delete;
+  LogBinary(LogBinary& other) = delete;
+  virtual ~LogBinary()        = 0;
+
+  /* -------------------------------------------------------------  */
+
+  static constexpr char MAGIC[8] = {'S','M','S','B','L','O','G','\0'};
+  static constexpr std::uint32_t VERSION = 1;
+
+  static constexpr std::size_t ALIGN = 8;
+
+  /** Names of Log::Level and Log::Subsystem, lower case.  */
+  static constexpr std::string_view LEVEL_NAMES[] = {
+    "debug", "note", "warning", "error"
+  };
+  static constexpr std::string_view SUBSYSTEM_NAMES[] = {
+    "general", "app", "params", "image", "archive", "crypto",
+    "bufferpool", "qrcache", "log"
+  };
+
+  struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t reserved;
+  };
+
+  enum class Type: std::uint16_t {
+    SESSION = 1, FORMAT, EVENT
+  };
+
+  struct Record {
+    /** Bytes of the record including this header, without padding.  */
+    std::uint32_t size;
+    Type type;
+    std::uint16_t reserved;
+  };
+
+  struct Session {
+    /** Wall clock time of Event::time_ns zero.  */
+    std::int64_t realtime_ns;
+    std::uint32_t pid;
+    std::uint32_t reserved;
+  };
+
+  /** Followed by the format string.  */
+  struct Format {
+    std::uint32_t id;
+    std::uint8_t level;
+    std::uint8_t subsystem;
+    std::uint16_t reserved;
+  };
+
+  /** Followed by the arguments.  */
+  struct Event {
+    std::uint32_t id;
+    /** 1, 2, ... in order of the first line of a thread.  */
+    std::uint32_t thread;
+    /** Steady clock since the Session record.  */
+    std::uint64_t time_ns;
+  };
+
+  enum class Arg: std::uint8_t {
+    BOOL, INT, UINT, FLOAT, STRING
+  };
+
+  /* -------------------------------------------------------------  */
+
+  /** Appends a Session record to `out`, Event::time_ns starts here.  */
+  static void session(std::string& out);
+
+  static void format(std::string& out, std::uint32_t id,
+                     std::uint8_t level, std::uint8_t subsystem,
+                     std::string_view fmt);
+
+  /**
+   * Starts an Event record in a buffer of the calling thread, append
+   * the arguments with LogBinary::put() and finish it with
+   * LogBinary::end_record().
+   */
+  static std::string& begin_event(std::uint32_t format_id);
+
+  /** Sets Record::size and pads the record.  */
+  static void end_record(std::string& record, std::size_t pos = 0);
+
+  /* -------------------------------------------------------------  */
+
+  static void put(std::string& out, bool value);
+  static void put(std::string& out, char32_t value);
+  static void put(std::string& out, std::string_view value);
+  static void put(std::string& out, const char* value);
+  static void put(std::string& out, const char8_t* value);
+  static void put(std::string& out, const std::u8string& value);
+  static void put(std::string& out, const ustr& value);
+  static void put(std::string& out, ustr_view value);
+  static void put(std::string& out, const ustr8& value);
+
+  template<std::signed_integral T> inline static void
+    put(std::string& out, const T& value)
+  {
+    LogBinary::put_number(out, Arg::INT, static_cast<std::int64_t>(value));
+  }
+  template<std::unsigned_integral T> inline static void
+    put(std::string& out, const T& value)
+  {
+    LogBinary::put_number(out, Arg::UINT,
+                          static_cast<std::uint64_t>(value));
+  }
+  template<std::floating_point T> inline static void
+    put(std::string& out, const T& value)
+  {
+    LogBinary::put_number(out, Arg::FLOAT, static_cast<double>(value));
+  }
+
+  /** Anything else is formatted, i.e. socialmedia_signer::Ident.  */
+  template<typename T> inline static void
+    put(std::string& out, const T& value)
+  {
+    const std::size_t pos = LogBinary::begin_string(out);
+    std::format_to(std::back_inserter(out), "{}", value);
+    LogBinary::end_string(out, pos);
+  }
+
+private:
+  template<typename T> static void
+    put_number(std::string& out, Arg tag, T value)
+  {
+    out += static_cast<char>(tag);
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  static std::size_t begin_string(std::string& out);
+  static void end_string(std::string& out, std::size_t pos);
+};
+
+}
+
+/* ***************************************************************  */
+
+#endif /* LOGBINARY_HPP__  */
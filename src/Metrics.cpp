@@ -0,0 +1,565 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "Metrics.hpp"
+
+#include "common.hpp"
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <string_view>
+#include <format>
+#include <cerrno>
+#include <cstring>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+struct metrics_name {
+  /** Name of the family, without prefix.  */
+  const char* name;
+  /** Labels, or an empty string.  */
+  const char* labels;
+  const char* help;
+};
+
+#define _METRICS_PREFIX "socialmedia_signer_"
+
+static const metrics_name _metrics_counters[] = {
+  {"sign_total", "", "Posts signed."},
+  {"verify_total", "", "Posts verified."},
+  {"archive_files_total", "status=\"qr\"",
+   "Files scanned for a QR code by --archive."},
+  {"archive_files_total", "status=\"no_qr\"", ""},
+  {"archive_files_total", "status=\"error\"", ""},
+  {"crypto_keys_generated_total", "", "Private keys generated."},
+  {"crypto_digest_bytes_total", "", "Bytes hashed by Crypto::digest()."},
+  {"image_errors_total", "", "Images which could not be loaded."},
+  {"image_decoded_pixels_total", "", "Pixels decoded from image files."},
+  {"batch_requests_total", "status=\"ok\"",
+   "Requests signed by --batch."},
+  {"batch_requests_total", "status=\"error\"", ""}
+};
+
+static const metrics_name _metrics_gauges[] = {
+  {"archive_queued_files", "",
+   "Files queued by --archive, not yet taken by a worker."},
+  {"archive_busy_workers", "", "Workers of --archive scanning a file."},
+  {"qrcache_bytes", "", "Bytes of the cached QR codes."},
+  {"bufferpool_cached_bytes", "",
+   "Bytes of unused buffers kept for reuse."},
+  {"batch_queued_requests", "",
+   "Requests read by --batch, not yet taken by a worker."},
+  {"batch_busy_workers", "", "Workers of --batch signing a request."}
+};
+
+static const metrics_name _metrics_histograms[] = {
+  {"sign_duration_seconds", "", "Latency of App::sign()."},
+  {"verify_duration_seconds", "", "Latency of App::verify()."},
+  {"archive_file_duration_seconds", "",
+   "Latency of --archive per file."},
+  {"crypto_keygen_duration_seconds", "",
+   "Latency of a private key generation."},
+  {"crypto_digest_duration_seconds", "",
+   "Latency of Crypto::digest()."},
+  {"image_load_duration_seconds", "",
+   "Latency of decoding an image file."},
+  {"image_qr_detect_duration_seconds", "",
+   "Latency of the detection of a QR code."},
+  {"image_save_duration_seconds", "",
+   "Latency of encoding a PNG file."}
+};
+
+static_assert(std::size(_metrics_counters)
+              == static_cast<unsigned>(Metrics::Counter::COUNT));
+static_assert(std::size(_metrics_gauges)
+              == static_cast<unsigned>(Metrics::Gauge::COUNT));
+static_assert(std::size(_metrics_histograms)
+              == static_cast<unsigned>(Metrics::Histogram::COUNT));
+
+static constexpr unsigned _METRICS_COUNTERS
+  = static_cast<unsigned>(Metrics::Counter::COUNT);
+static constexpr unsigned _METRICS_HISTOGRAMS
+  = static_cast<unsigned>(Metrics::Histogram::COUNT);
+
+/**
+ * Counters and histograms of one thread.  Just the owning thread
+ * writes, so a load and a store are enough, and
+ * Metrics::write_prometheus() reads torn free.
+ */
+struct _MetricsShard {
+  std::atomic<std::uint64_t> counters[_METRICS_COUNTERS];
+
+  std::atomic<std::uint64_t> buckets[_METRICS_HISTOGRAMS]
+                                    [Metrics::BUCKETS];
+  std::atomic<std::uint64_t> sums_ns[_METRICS_HISTOGRAMS];
+};
+
+/** Protects `_metrics_shards` and `_metrics_retired`.  */
+static std::mutex _metrics_mutex;
+static std::vector<_MetricsShard*> _metrics_shards;
+/** Sum of the shards of exited threads.  */
+static _MetricsShard _metrics_retired;
+
+static std::atomic<std::int64_t>
+_metrics_gauge_values[static_cast<unsigned>(Metrics::Gauge::COUNT)];
+
+template<typename T> static inline void
+_metrics_inc(std::atomic<T>& value, T delta)
+{
+  value.store(value.load(std::memory_order_relaxed) + delta,
+              std::memory_order_relaxed);
+}
+
+/** Shard of the calling thread, registered on its first update.  */
+struct _MetricsHandle {
+  _MetricsShard* shard = nullptr;
+
+  ~_MetricsHandle()
+  {
+    if (this->shard == nullptr) return;
+
+    std::lock_guard<std::mutex> lock(_metrics_mutex);
+    std::erase(_metrics_shards, this->shard);
+
+    for (unsigned i=0; i < _METRICS_COUNTERS; i++) {
+      _metrics_inc(_metrics_retired.counters[i],
+                   this->shard->counters[i].load());
+    }
+    for (unsigned h=0; h < _METRICS_HISTOGRAMS; h++) {
+      for (unsigned b=0; b < Metrics::BUCKETS; b++) {
+        _metrics_inc(_metrics_retired.buckets[h][b],
+                     this->shard->buckets[h][b].load());
+      }
+      _metrics_inc(_metrics_retired.sums_ns[h],
+                   this->shard->sums_ns[h].load());
+    }
+
+    delete this->shard;
+  }
+};
+
+static thread_local _MetricsHandle _metrics_handle;
+
+static inline _MetricsShard&
+_metrics_shard()
+{
+  if (_metrics_handle.shard == nullptr) {
+    _metrics_handle.shard = new _MetricsShard();
+
+    std::lock_guard<std::mutex> lock(_metrics_mutex);
+    _metrics_shards.push_back(_metrics_handle.shard);
+  }
+
+  return *_metrics_handle.shard;
+}
+
+/* ---------------------------------------------------------------  */
+
+#define _METRICS_UNIX "unix:"
+
+/** Target of Metrics::init(), a file or a Unix socket.  */
+static std::string _metrics_path;
+static bool _metrics_is_unix = false;
+
+static int _metrics_listen_fd = -1;
+/** Wakes the server thread to stop it.  */
+static int _metrics_stop_fd = -1;
+static std::thread* _metrics_server = nullptr;
+
+static void
+_metrics_write_all(int fd, std::string_view data)
+{
+  while (!data.empty()) {
+    const ssize_t written = ::write(fd, data.data(), data.length());
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return;
+    }
+    data.remove_prefix(written);
+  }
+}
+
+/** Answers one client, waits up to 100 ms for its request.  */
+static void
+_metrics_serve(int fd)
+{
+  char request[512];
+  ssize_t len = 0;
+
+  struct pollfd pfd = {fd, POLLIN, 0};
+  if (::poll(&pfd, 1, 100) > 0)
+    len = ::recv(fd, request, sizeof(request), MSG_DONTWAIT);
+
+  std::string body;
+  Metrics::write_prometheus(body);
+
+  std::string response;
+  if (len >= 4 && std::memcmp(request, "GET ", 4) == 0) {
+    std::format_to(std::back_inserter(response),
+      "HTTP/1.0 200 OK\r\n"
+      "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+      "Content-Length: {}\r\n\r\n", body.length());
+  }
+  response += body;
+
+  _metrics_write_all(fd, response);
+}
+
+static void
+_metrics_run_server()
+{
+  struct pollfd pfds[2] = {
+    {_metrics_listen_fd, POLLIN, 0}, {_metrics_stop_fd, POLLIN, 0}
+  };
+
+  for (;;) {
+    if (::poll(pfds, 2, -1) < 0) {
+      if (errno == EINTR) continue;
+      return;
+    }
+    if (pfds[1].revents != 0) return;
+
+    const int fd = ::accept4(_metrics_listen_fd, nullptr, nullptr,
+                             SOCK_CLOEXEC);
+    if (fd < 0) continue;
+
+    _metrics_serve(fd);
+    ::close(fd);
+  }
+}
+
+/** Throws an Error, with the reason of ERRNO.  */
+[[noreturn]] static void
+_metrics_throw(const char* what)
+{
+  throw Error(ustr::format("metrics '{}': {}: {}", _metrics_path, what,
+                           std::strerror(errno)));
+}
+
+static void
+_metrics_listen()
+{
+  struct sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  if (_metrics_path.length() >= sizeof(addr.sun_path)) {
+    errno = ENAMETOOLONG;
+    _metrics_throw("bind");
+  }
+  std::memcpy(addr.sun_path, _metrics_path.c_str(),
+              _metrics_path.length() + 1);
+
+  /* A socket left by a previous run, but nothing else.  */
+  struct stat st;
+  if (::lstat(_metrics_path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+    ::unlink(_metrics_path.c_str());
+
+  _metrics_listen_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (_metrics_listen_fd < 0) _metrics_throw("socket");
+
+  if (::bind(_metrics_listen_fd, reinterpret_cast<sockaddr*>(&addr),
+             sizeof(addr)) != 0
+      || ::listen(_metrics_listen_fd, 8) != 0) {
+    const int bind_errno = errno;
+    ::close(_metrics_listen_fd);
+    _metrics_listen_fd = -1;
+
+    errno = bind_errno;
+    _metrics_throw("bind");
+  }
+
+  _metrics_stop_fd = ::eventfd(0, EFD_CLOEXEC);
+  if (_metrics_stop_fd < 0) _metrics_throw("eventfd");
+
+  _metrics_server = new std::thread(_metrics_run_server);
+}
+
+/** Writes to a temporary file first, so readers see complete files.  */
+static void
+_metrics_write_file()
+{
+  std::string out;
+  Metrics::write_prometheus(out);
+
+  const std::string tmp_path = _metrics_path + ".tmp";
+  const int fd = ::open(tmp_path.c_str(),
+                        O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    Log::warn("metrics '{}': {}", tmp_path, std::strerror(errno));
+    return;
+  }
+  _metrics_write_all(fd, out);
+
+  if (::close(fd) != 0
+      || ::rename(tmp_path.c_str(), _metrics_path.c_str()) != 0) {
+    Log::warn("metrics '{}': {}", _metrics_path, std::strerror(errno));
+    ::unlink(tmp_path.c_str());
+  }
+}
+
+/** Appends HELP and TYPE, if `name` starts a family.  */
+static void
+_metrics_write_family(std::string& out, const metrics_name& name,
+                      const metrics_name* previous, const char* type)
+{
+  if (previous != nullptr
+      && std::strcmp(previous->name, name.name) == 0) return;
+
+  std::format_to(std::back_inserter(out),
+    "# HELP " _METRICS_PREFIX "{} {}\n"
+    "# TYPE " _METRICS_PREFIX "{} {}\n",
+    name.name, name.help, name.name, type);
+}
+
+static void
+_metrics_write_sample(std::string& out, const metrics_name& name,
+                      auto value)
+{
+  if (name.labels[0] == '\0') {
+    std::format_to(std::back_inserter(out),
+      _METRICS_PREFIX "{} {}\n", name.name, value);
+  } else {
+    std::format_to(std::back_inserter(out),
+      _METRICS_PREFIX "{}{{{}}} {}\n", name.name, name.labels, value);
+  }
+}
+
+} /* namespace socialmedia_signer  */
+
+/* ***************************************************************  */
+
+std::atomic<bool> socialmedia_signer::Metrics::enabled(false);
+
+/* ---------------------------------------------------------------  */
+
+socialmedia_signer::Metrics::Timer::Timer(Histogram histogram)
+  :histogram(histogram),
+   start(Metrics::is_enabled()
+         ? std::chrono::steady_clock::now()
+         : std::chrono::steady_clock::time_point())
+{
+}
+
+socialmedia_signer::Metrics::Timer::~Timer()
+{
+  if (this->start == std::chrono::steady_clock::time_point()) return;
+
+  Metrics::observe(this->histogram,
+    std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - this->start).count());
+}
+
+/* ***************************************************************  */
+
+void
+socialmedia_signer::Metrics::init(const char* target) noexcept(false)
+{
+  if (target == nullptr) return;
+
+  if (Metrics::is_enabled())
+    Log::fatal(u8"Metrics::init(): double call!");
+
+  const std::string_view target_view = target;
+  _metrics_is_unix = target_view.starts_with(_METRICS_UNIX);
+  _metrics_path = _metrics_is_unix
+    ? target_view.substr(std::strlen(_METRICS_UNIX)): target_view;
+
+  if (_metrics_is_unix) _metrics_listen();
+
+  Metrics::enabled.store(true, std::memory_order_relaxed);
+}
+
+void
+socialmedia_signer::Metrics::release()
+{
+  if (!Metrics::is_enabled()) return;
+
+  if (_metrics_server != nullptr) {
+    const std::uint64_t one = 1;
+    while (::write(_metrics_stop_fd, &one, sizeof(one)) < 0
+           && errno == EINTR) {}
+
+    _metrics_server->join();
+    delete _metrics_server;
+    _metrics_server = nullptr;
+  }
+  if (_metrics_stop_fd >= 0) ::close(_metrics_stop_fd);
+  _metrics_stop_fd = -1;
+
+  if (_metrics_is_unix) {
+    ::close(_metrics_listen_fd);
+    _metrics_listen_fd = -1;
+    ::unlink(_metrics_path.c_str());
+  } else {
+    _metrics_write_file();
+  }
+
+  Metrics::enabled.store(false, std::memory_order_relaxed);
+}
+
+/* ---------------------------------------------------------------  */
+
+void
+socialmedia_signer::Metrics::add(Counter counter, std::uint64_t value)
+{
+  if (!Metrics::is_enabled()) return;
+
+  _metrics_inc(_metrics_shard().counters[static_cast<unsigned>(counter)],
+               value);
+}
+
+void
+socialmedia_signer::Metrics::set(Gauge gauge, std::int64_t value)
+{
+  if (!Metrics::is_enabled()) return;
+
+  _metrics_gauge_values[static_cast<unsigned>(gauge)].store(
+    value, std::memory_order_relaxed);
+}
+
+void
+socialmedia_signer::Metrics::add(Gauge gauge, std::int64_t delta)
+{
+  if (!Metrics::is_enabled()) return;
+
+  _metrics_gauge_values[static_cast<unsigned>(gauge)].fetch_add(
+    delta, std::memory_order_relaxed);
+}
+
+void
+socialmedia_signer::Metrics::observe(Histogram histogram,
+                                     std::uint64_t ns)
+{
+  if (!Metrics::is_enabled()) return;
+
+  _MetricsShard& shard = _metrics_shard();
+  const unsigned h = static_cast<unsigned>(histogram);
+
+  _metrics_inc(shard.buckets[h][Metrics::bucket(ns)], std::uint64_t(1));
+  _metrics_inc(shard.sums_ns[h], ns);
+}
+
+/* ---------------------------------------------------------------  */
+
+unsigned
+socialmedia_signer::Metrics::bucket(std::uint64_t ns)
+{
+  if (ns < (std::uint64_t(1) << MIN_EXPONENT)) return 0;
+
+  const unsigned exponent = 63 - __builtin_clzll(ns);
+  if (exponent >= MAX_EXPONENT) return BUCKETS - 1;
+
+  /* The 3 bits below the leading one, for SUB_BUCKETS == 8.  */
+  const unsigned sub = (ns >> (exponent - 3)) & (SUB_BUCKETS - 1);
+
+  return 1 + (exponent - MIN_EXPONENT) * SUB_BUCKETS + sub;
+}
+
+std::uint64_t
+socialmedia_signer::Metrics::bucket_bound_ns(unsigned bucket)
+{
+  if (bucket == 0) return std::uint64_t(1) << MIN_EXPONENT;
+
+  const unsigned exponent = MIN_EXPONENT + (bucket - 1) / SUB_BUCKETS;
+  const unsigned sub = (bucket - 1) % SUB_BUCKETS;
+
+  return std::uint64_t(SUB_BUCKETS + sub + 1) << (exponent - 3);
+}
+
+/* ---------------------------------------------------------------  */
+
+void
+socialmedia_signer::Metrics::write_prometheus(std::string& out)
+{
+  static_assert(SUB_BUCKETS == 8, "Metrics::bucket() takes 3 bits");
+
+  std::uint64_t counters[_METRICS_COUNTERS] = {};
+  std::uint64_t buckets[_METRICS_HISTOGRAMS][BUCKETS] = {};
+  std::uint64_t sums_ns[_METRICS_HISTOGRAMS] = {};
+
+  {
+    std::lock_guard<std::mutex> lock(_metrics_mutex);
+
+    std::vector<const _MetricsShard*> shards(_metrics_shards.begin(),
+                                             _metrics_shards.end());
+    shards.push_back(&_metrics_retired);
+
+    for (const _MetricsShard* shard: shards) {
+      for (unsigned i=0; i < _METRICS_COUNTERS; i++)
+        counters[i] += shard->counters[i].load(std::memory_order_relaxed);
+      for (unsigned h=0; h < _METRICS_HISTOGRAMS; h++) {
+        for (unsigned b=0; b < BUCKETS; b++) {
+          buckets[h][b]
+            += shard->buckets[h][b].load(std::memory_order_relaxed);
+        }
+        sums_ns[h] += shard->sums_ns[h].load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  const metrics_name* previous = nullptr;
+  for (unsigned i=0; i < _METRICS_COUNTERS; i++) {
+    _metrics_write_family(out, _metrics_counters[i], previous, "counter");
+    _metrics_write_sample(out, _metrics_counters[i], counters[i]);
+    previous = &_metrics_counters[i];
+  }
+
+  previous = nullptr;
+  for (unsigned i=0; i < std::size(_metrics_gauges); i++) {
+    _metrics_write_family(out, _metrics_gauges[i], previous, "gauge");
+    _metrics_write_sample(out, _metrics_gauges[i],
+      _metrics_gauge_values[i].load(std::memory_order_relaxed));
+    previous = &_metrics_gauges[i];
+  }
+
+  /* Empty buckets are left out, the cumulative counts stay valid.  */
+  for (unsigned h=0; h < _METRICS_HISTOGRAMS; h++) {
+    const char* name = _metrics_histograms[h].name;
+    _metrics_write_family(out, _metrics_histograms[h], nullptr,
+                          "histogram");
+
+    std::uint64_t count = 0;
+    for (unsigned b=0; b < BUCKETS - 1; b++) {
+      if (buckets[h][b] == 0) continue;
+
+      count += buckets[h][b];
+      std::format_to(std::back_inserter(out),
+        _METRICS_PREFIX "{}_bucket{{le=\"{}\"}} {}\n", name,
+        Metrics::bucket_bound_ns(b) * 1e-9, count);
+    }
+    count += buckets[h][BUCKETS - 1];
+
+    std::format_to(std::back_inserter(out),
+      _METRICS_PREFIX "{}_bucket{{le=\"+Inf\"}} {}\n"
+      _METRICS_PREFIX "{}_sum {}\n"
+      _METRICS_PREFIX "{}_count {}\n",
+      name, count, name, sums_ns[h] * 1e-9, name, count);
+  }
+}
+
+/* ***************************************************************  */
@@ -0,0 +1,155 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef METRICS_HPP__
+#define METRICS_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstdint>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/**
+ * Abstract class which includes static methods for counting events
+ * and measuring latencies, exported in the Prometheus text format.
+ *
+ * The metrics are fixed, each one is an entry of Metrics::Counter,
+ * Metrics::Gauge or Metrics::Histogram:
+ * ```cpp
+ *   Metrics::add(Metrics::Counter::IMAGE_PIXELS, width * height);
+ *
+ *   Metrics::Timer timer(Metrics::Histogram::IMAGE_LOAD);
+ * ```
+ * Counters and histograms are sharded per thread.  A thread updates
+ * just its own shard without atomic read-modify-write, and the shards
+ * are summed up by Metrics::write_prometheus().  Histograms have
+ * Metrics::SUB_BUCKETS buckets per power of two nanoseconds like an
+ * HDR histogram, so a latency is recorded with an error of at most
+ * 12.5%.  Gauges are not sharded.
+ *
+ * Nothing is measured before Metrics::init() is called with a target.
+ * Then every update costs a few nanoseconds, every Metrics::Timer
+ * two reads of the steady clock.
+ */
+class Metrics
+{
+public:
+  /* Abstract class  */
+  Metrics()               = delete;
+  Metrics(Metrics& other) = delete;
+  virtual ~Metrics()      = 0;
+
+  enum class Counter: unsigned char {
+    SIGNS, VERIFICATIONS, ARCHIVE_QR_FOUND, ARCHIVE_NO_QR,
+    ARCHIVE_ERRORS, KEYS_GENERATED, DIGEST_BYTES, IMAGE_ERRORS,
+    IMAGE_PIXELS, BATCH_OK, BATCH_ERRORS,
+
+    COUNT
+  };
+
+  enum class Gauge: unsigned char {
+    ARCHIVE_QUEUED, ARCHIVE_BUSY, QRCACHE_BYTES, BUFFERPOOL_CACHED_BYTES,
+    BATCH_QUEUED, BATCH_BUSY,
+
+    COUNT
+  };
+
+  enum class Histogram: unsigned char {
+    SIGN, VERIFY, ARCHIVE_FILE, KEYGEN, DIGEST, IMAGE_LOAD,
+    IMAGE_QR_DETECT, IMAGE_SAVE,
+
+    COUNT
+  };
+
+  /** Buckets per power of two.  */
+  static constexpr unsigned SUB_BUCKETS = 8;
+  /** Lowest bucket, up to 2^MIN_EXPONENT ns (1 us).  */
+  static constexpr unsigned MIN_EXPONENT = 10;
+  /** Highest bucket below +Inf, up to 2^MAX_EXPONENT ns (73 min).  */
+  static constexpr unsigned MAX_EXPONENT = 42;
+
+  static constexpr unsigned BUCKETS
+    = (MAX_EXPONENT - MIN_EXPONENT) * SUB_BUCKETS + 2;
+
+  /** Measures its lifetime into a Metrics::Histogram.  */
+  class Timer
+  {
+  public:
+    explicit Timer(Histogram histogram);
+    ~Timer();
+
+    Timer(Timer& other) = delete;
+
+  private:
+    const Histogram histogram;
+    /** Epoch, if Metrics are disabled.  */
+    const std::chrono::steady_clock::time_point start;
+  };
+
+  /* -------------------------------------------------------------  */
+
+  /**
+   * Enables the metrics, they are written to `target` by
+   * Metrics::release().  If `target` is `unix:<path>`, a Unix socket
+   * is bound to `<path>` instead, which writes the current metrics to
+   * every client, with an HTTP header if it sends a GET request:
+   * ```shell
+   *   $> curl --unix-socket <path> http://localhost/metrics
+   * ```
+   * Does nothing if `target` is nullptr.
+   */
+  static void init(const char* target) noexcept(false);
+
+  /** Writes the metrics file or closes the Unix socket.  */
+  static void release();
+
+  static inline bool is_enabled()
+  {
+    return Metrics::enabled.load(std::memory_order_relaxed);
+  }
+
+  /* -------------------------------------------------------------  */
+
+  static void add(Counter counter, std::uint64_t value = 1);
+
+  static void set(Gauge gauge, std::int64_t value);
+  static void add(Gauge gauge, std::int64_t delta);
+
+  static void observe(Histogram histogram, std::uint64_t ns);
+
+  /** Index into the Metrics::BUCKETS of a histogram.  */
+  static unsigned bucket(std::uint64_t ns);
+  /** Upper bound of a bucket, the last one has none.  */
+  static std::uint64_t bucket_bound_ns(unsigned bucket);
+
+  /** Appends all metrics in the Prometheus text format 0.0.4.  */
+  static void write_prometheus(std::string& out);
+
+private:
+  static std::atomic<bool> enabled;
+};
+
+}
+
+/* ***************************************************************  */
+
+#endif /* METRICS_HPP__  */
@@ -34,6 +34,8 @@ socialmedia_signer::ustr
 socialmedia_signer::Params::dir_name = u8"";
 socialmedia_signer::ustr
 socialmedia_signer::Params::command_name = u8"socialmedia-signer_";
+socialmedia_signer::ustr8
+socialmedia_signer::Params::command_name_utf8 = u8"socialmedia-signer_";
 
 socialmedia_signer::Params*
 socialmedia_signer::Params::instance = nullptr;
@@ -41,29 +43,37 @@ socialmedia_signer::Params::instance = nullptr;
 /* ***************************************************************  */
 
 socialmedia_signer::Params::CmdErr::CmdErr(const ustr& reason)
-  :Error(ustr::format(
-    "command-line: {}  Try '{} --help' for full help.",
-    reason, Params::get_command_name()))
-{}
+  :Error()
+{
+  const ustr& command_name = Params::get_command_name();
+
+  ustr_builder out(reason.length() + command_name.length() + 48);
+  out += U"command-line: ";
+  out += reason;
+  out += U"  Try '";
+  out += command_name;
+  out += U" --help' for full help.";
+
+  this->set_reason(out.finish());
+}
 
 /* ***************************************************************  */
 
 socialmedia_signer::Params::Subargument::Subargument(
-  const ustr name, const char32_t abbr, const ustr description,
-  const ustr value_doc, const bool value_allowed,
-  const bool value_emptyallowed)
-  :name(name), abbr(abbr), description(description),
-   value_doc(value_doc), value_allowed(value_allowed),
-   value_emptyallowed(value_emptyallowed), set(false), set_value(u8"")
+  ustr name, char32_t abbr, ustr description, ustr value_doc,
+  bool value_allowed, bool value_emptyallowed)
+  :name(std::move(name)), abbr(abbr), ident(Ident::intern(this->name)),
+   description(std::move(description)), value_doc(std::move(value_doc)),
+   value_allowed(value_allowed), value_emptyallowed(value_emptyallowed),
+   set(false), set_value()
 {}
 
 socialmedia_signer::Params::Subcommand::Subcommand(
-  const ustr name, const char32_t abbr, const ustr description,
-  const ustr value_doc, const bool value_allowed,
-  const bool value_emptyallowed,
+  ustr name, char32_t abbr, ustr description, ustr value_doc,
+  bool value_allowed, bool value_emptyallowed,
   const char32_t* subargs_required, const char32_t* subargs_optional)
-  :Subargument(name, abbr, description, value_doc, value_allowed,
-                value_emptyallowed),
+  :Subargument(std::move(name), abbr, std::move(description),
+               std::move(value_doc), value_allowed, value_emptyallowed),
    subargs_required(subargs_required),
    subargs_optional(subargs_optional)
 {}
@@ -71,37 +81,72 @@ socialmedia_signer::Params::Subcommand::Subcommand(
 /* ***************************************************************  */
 
 socialmedia_signer::Params::Params(int argc, const char** argv)
-  :subargs({
-     Subargument(u8"message", u8'm',
-       u8"text message to sign or verify",
-       u8"<message>", true, false),
-     Subargument(u8"image", u8'i',
-       u8"filename of an image to overlay the QR signature",
-       u8"<filename>", true, false)
-   }),
-   subcmds({
-     Subcommand(u8"sign", u8's',
-       u8"post a signed message to <platform>",
-       u8"<platform>", true, false,
-       U"m",
-       U"i"),
-     Subcommand(u8"verify", u8'v',
-       u8"verify a post with a QR signature at <url>",
-       u8"<url>", true, false,
-       U"",
-       U""),
-
-     Subcommand(u8"help", u8'?',
-       u8"display this help and exit",
-       u8"", false, true, U"", U""),
-     Subcommand(u8"version", u8'V',
-       u8"output version information and exit",
-       u8"", false, true, U"", U"")
-   }), subarg_map(), subcmd_map(), subcommand(nullptr)
+  :subargs(), subcmds(), subarg_map(), subcmd_map(), subcommand(nullptr)
 {
-  /* UARGV: modifiable storage for parsing  */
-  std::vector<ustr> uargv;
-  for (int i=0; i<argc; i++) uargv.push_back((const char8_t*) argv[i]);
+  /* Emplaced in order, elements of an std::initializer_list could
+   * just be copied.
+   */
+  auto sarg = this->subargs.before_begin();
+  sarg = this->subargs.emplace_after(sarg, u8"message", u8'm',
+    u8"text message to sign or verify",
+    u8"<message>", true, false);
+  sarg = this->subargs.emplace_after(sarg, u8"image", u8'i',
+    u8"filename of an image to overlay the QR signature",
+    u8"<filename>", true, false);
+  sarg = this->subargs.emplace_after(sarg, u8"jobs", u8'j',
+    u8"number of workers, default all CPUs",
+    u8"<count>", true, false);
+  sarg = this->subargs.emplace_after(sarg, u8"trace", u8't',
+    u8"write a Chrome trace of the run to <file>",
+    u8"<file>", true, false);
+  sarg = this->subargs.emplace_after(sarg, u8"profile", u8'p',
+    u8"print CPU counters per stage at exit",
+    u8"", false, true);
+
+  auto scmd = this->subcmds.before_begin();
+  scmd = this->subcmds.emplace_after(scmd, u8"sign", u8's',
+    u8"post a signed message to <platform>",
+    u8"<platform>", true, false,
+    U"m",
+    U"itp");
+  scmd = this->subcmds.emplace_after(scmd, u8"verify", u8'v',
+    u8"verify a post with a QR signature at <url>",
+    u8"<url>", true, false,
+    U"",
+    U"tp");
+  scmd = this->subcmds.emplace_after(scmd, u8"archive", u8'a',
+    u8"find QR codes in images below <dir>, unverified",
+    u8"<dir>", true, false,
+    U"",
+    U"jtp");
+  scmd = this->subcmds.emplace_after(scmd, u8"batch", u8'b',
+    u8"sign NDJSON requests from stdin, one result per line",
+    u8"", false, true,
+    U"",
+    U"jtp");
+
+  scmd = this->subcmds.emplace_after(scmd, u8"help", u8'?',
+    u8"display this help and exit",
+    u8"", false, true, U"", U"");
+  scmd = this->subcmds.emplace_after(scmd, u8"version", u8'V',
+    u8"output version information and exit",
+    u8"", false, true, U"", U"");
+
+  /* UARGV: modifiable storage for parsing, BAD_ARG the first
+   * argument which is not valid UTF-8.
+   */
+  std::vector<ustr> uargv(argc > 0? argc: 0);
+  int bad_arg = -1;
+  ustr::size_type bad_offset = ustr::npos;
+  for (int i=0; i<argc; i++) {
+    const ustr::size_type offset
+      = uargv[i].in_utf8(reinterpret_cast<const char8_t*>(argv[i]));
+
+    if (bad_arg < 0 && offset != ustr::npos) {
+      bad_arg = i;
+      bad_offset = offset;
+    }
+  }
 
   /* -----------------------------------------------------------------
    * Parse ARGV[0].
@@ -111,12 +156,17 @@ socialmedia_signer::Params::Params(int argc, const char** argv)
     Log::fatal(u8"Operating system does not provide argv[0]!");
 
   this->parse_argv0(Params::dir_name, Params::command_name, uargv[0]);
+  Params::command_name_utf8 = ustr8(Params::command_name);
+
+  if (bad_arg >= 0)
+    throw CmdErr(ustr::format(
+      "argument {} is not valid UTF-8 at byte {} !", bad_arg, bad_offset));
 
   /* -----------------------------------------------------------------
    * Parse command-line parameters into PARSED_NAMES and PARSED_ABBRS.
    */
 
-  std::map<ustr, ustr>     parsed_names;
+  parsed_names_t           parsed_names;
   std::map<char32_t, ustr> parsed_abbrs;
 
   ustr* next;
@@ -136,30 +186,28 @@ socialmedia_signer::Params::Params(int argc, const char** argv)
   /* may throw CmdErr()  */
   this->check_parameters(parsed_names, parsed_abbrs);
 
-#ifdef DEBUG_PARAMS
   for (const auto& subarg_search: this->subarg_map) {
-    Subargument* sarg = subarg_search.second;
+    const Subargument& sarg = subarg_search.second;
 
-    Log::debug(ustr::format("-{} --{: <7} = {: >7} '{}'", sarg->abbr,
-      sarg->name, static_cast<ustr>(sarg->set? u8"SET": u8"not set"),
-      sarg->set_value));
+    LOG_DEBUG(PARAMS, "PARAMS: -{} --{: <7} = {: >7} '{}'", sarg.abbr,
+      sarg.name, static_cast<ustr>(sarg.set? u8"SET": u8"not set"),
+      sarg.set_value);
   }
   for (const auto& subcmd_search: this->subcmd_map) {
-    Subcommand* scmd = subcmd_search.second;
+    const Subcommand& scmd = subcmd_search.second;
 
-    Log::debug(ustr::format("-{} --{: <7} = {: >7} '{}'", scmd->abbr,
-      scmd->name, static_cast<ustr>(scmd->set? u8"SET": u8"not set"),
-      scmd->set_value));
+    LOG_DEBUG(PARAMS, "PARAMS: -{} --{: <7} = {: >7} '{}'", scmd.abbr,
+      scmd.name, static_cast<ustr>(scmd.set? u8"SET": u8"not set"),
+      scmd.set_value);
   }
   for (const auto& names: parsed_names) {
-    Log::debug(ustr::format("*** names --{} = '{}'", names.first,
-      names.second));
+    LOG_DEBUG(PARAMS, "PARAMS: names --{} = '{}'", names.first,
+      names.second);
   }
   for (const auto& abbrs: parsed_abbrs) {
-    Log::debug(ustr::format("*** abbrs -{} '{}'", abbrs.first,
-      abbrs.second));
+    LOG_DEBUG(PARAMS, "PARAMS: abbrs -{} '{}'", abbrs.first,
+      abbrs.second);
   }
-#endif
 
   /* -------------------------------------------------------------  */
 }
@@ -175,6 +223,7 @@ socialmedia_signer::Params::init(int argc, const char** argv)
   if (Params::instance != nullptr)
     Log::fatal(u8"Command line parameters double parsed!");
 
+  Alloc::Scope scope(Alloc::Tag::PARAMS);
   Params::instance = new Params(argc, argv);
 
   const Subcommand* subcmd = instance->get_subcommand();
@@ -195,6 +244,7 @@ void
 socialmedia_signer::Params::release()
 {
   delete Params::instance;
+  Params::instance = nullptr;
 }
 
 socialmedia_signer::Params*
@@ -218,6 +268,12 @@ socialmedia_signer::Params::get_command_name()
   return Params::command_name;
 }
 
+const socialmedia_signer::ustr8&
+socialmedia_signer::Params::get_command_name_utf8()
+{
+  return Params::command_name_utf8;
+}
+
 /* ***************************************************************  */
 
 void
@@ -252,48 +308,62 @@ socialmedia_signer::Params::print_help() const
   Log::println(COMMON_APP_NAME u8"\n\n" COMMON_APP_DESC u8"\n\nUsage:");
 
 #ifdef CONFIG_GUI
-  Log::println(ustr::format("  {} (GUI)", command_name));
+  Log::println("  {} (GUI)", command_name);
 #endif
 
+  /* One buffer for all lines, which is large enough after the first
+   * few of them.
+   */
+  ustr_builder out(80);
+
   for (const Subcommand& scmd: this->subcmds) {
     if (scmd.abbr == u8'?' || scmd.abbr == u8'V') continue;
 
-    ustr out = ustr::format("  {} {}",
-                            command_name, this->format(scmd, false));
+    out.clear();
+    out += U"  ";
+    out += command_name;
+    out += U' ';
+    this->format_to(out, scmd, false);
 
     for (const char32_t* sarg_req_abbr = scmd.subargs_required;
          *sarg_req_abbr != U'\0'; sarg_req_abbr++) {
       const Subargument& sarg_req = this->get_subargument(*sarg_req_abbr);
-      out = ustr::format("{} {}", out, this->format(sarg_req, true));
+      out += U' ';
+      this->format_to(out, sarg_req, true);
     }
     for (const char32_t* sarg_opt_abbr = scmd.subargs_optional;
          *sarg_opt_abbr != U'\0'; sarg_opt_abbr++) {
       const Subargument& sarg_opt = this->get_subargument(*sarg_opt_abbr);
-      out = ustr::format("{} {}", out, this->format(sarg_opt, true, true));
+      out += U' ';
+      this->format_to(out, sarg_opt, true, true);
     }
 
-    Log::println(out);
+    Log::println("{}", out.view());
   }
   Log::println(u8"\nSubcommands:");
 
   for (const Subcommand& scmd: this->subcmds) {
-    Log::println(ustr::format("  -{}, {: <19} {}",
-        scmd.abbr, this->format(scmd, false), scmd.description));
+    out.clear();
+    this->format_to(out, scmd, false);
+    Log::println("  -{}, {: <19} {}",
+        scmd.abbr, out.view(), scmd.description);
   }
   Log::println(u8"\nSubarguments:");
 
   for (const Subargument& sarg: this->subargs) {
-    Log::println(ustr::format("  -{}, {: <19} {}",
-        sarg.abbr, this->format(sarg, false), sarg.description));
+    out.clear();
+    this->format_to(out, sarg, false);
+    Log::println("  -{}, {: <19} {}",
+        sarg.abbr, out.view(), sarg.description);
   }
   Log::println(u8"\nPlatforms:");
 
   Platforms* platforms = Platforms::get();
-  Log::println(ustr::format("  {: ^23} {}",
-      u8"<platform>", u8"*** platform name ***"));
+  Log::println("  {: ^23} {}",
+      u8"<platform>", u8"*** platform name ***");
   for (Platform& platform: *platforms) {
-    Log::println(ustr::format("  {: ^23} {}",
-        platform.get_id(), platform.get_name()));
+    Log::println("  {: ^23} {}",
+        platform.get_id(), platform.get_name());
   }
 
   Log::println();
@@ -336,30 +406,48 @@ socialmedia_signer::Params::get_subargument(const char32_t sarg_abbr)
 
 /* ***************************************************************  */
 
-const socialmedia_signer::ustr
+socialmedia_signer::ustr
 socialmedia_signer::Params::format(const Subargument& subarg,
                                    bool abbr, bool optional) const
+{
+  ustr_builder out(subarg.name.length() + subarg.value_doc.length() + 8);
+  this->format_to(out, subarg, abbr, optional);
+
+  return out.finish();
+}
+
+void
+socialmedia_signer::Params::format_to(ustr_builder& out,
+  const Subargument& subarg, bool abbr, bool optional) const
 {
   const char32_t equals = abbr? u8' ': u8'=';
 
-  ustr out = abbr
-    ? ustr::format("-{}", subarg.abbr)
-    : ustr::format("--{}", subarg.name);
+  if (optional) out += U'[';
 
-  if (subarg.value_allowed && subarg.value_emptyallowed)
-    out = ustr::format("{}[{}{}]", out, equals, subarg.value_doc);
-  else if (!subarg.value_emptyallowed)
-    out = ustr::format("{}{}{}", out, equals, subarg.value_doc);
+  if (abbr) {
+    out += U'-';
+    out += subarg.abbr;
+  } else {
+    out += U"--";
+    out += subarg.name;
+  }
 
-  if (optional)
-    out = ustr::format("[{}]", out);
+  if (subarg.value_allowed && subarg.value_emptyallowed) {
+    out += U'[';
+    out += equals;
+    out += subarg.value_doc;
+    out += U']';
+  } else if (!subarg.value_emptyallowed) {
+    out += equals;
+    out += subarg.value_doc;
+  }
 
-  return out;
+  if (optional) out += U']';
 }
 
 void
 socialmedia_signer::Params::check_parameters(
-  std::map<ustr, ustr>& parsed_names,
+  parsed_names_t& parsed_names,
   std::map<char32_t, ustr>& parsed_abbrs) noexcept(false)
 {
   this->check_subaruments(&this->subargs, &this->subarg_map,
@@ -379,7 +467,7 @@ socialmedia_signer::Params::check_parameters(
 
 void
 socialmedia_signer::Params::check_subcommands(
-  std::map<ustr, ustr>& parsed_names,
+  parsed_names_t& parsed_names,
   std::map<char32_t, ustr>& parsed_abbrs) noexcept(false)
 {
   this->check_subaruments(
@@ -436,16 +524,16 @@ void
 socialmedia_signer::Params::check_subaruments(
   std::forward_list<Subargument>* subargs,
   std::map<char32_t, Subargument&>* subarg_map,
-  std::map<ustr, ustr>& parsed_names,
+  parsed_names_t& parsed_names,
   std::map<char32_t, ustr>& parsed_abbrs) const noexcept(false)
 {
   for (Subargument& sarg: *subargs) {
-    const auto& name_search = parsed_names.find(sarg.name);
+    const auto& name_search = parsed_names.find(sarg.ident);
     if (name_search != parsed_names.end()) {
       sarg.set = true;
-      sarg.set_value = name_search->second;
+      sarg.set_value = std::move(name_search->second);
 
-      if (parsed_names.erase(sarg.name) == 0) {
+      if (parsed_names.erase(sarg.ident) == 0) {
         Log::fatal(ustr::format(
           "Could not erase --{} from parsed names !", sarg.name));
       }
@@ -460,7 +548,7 @@ socialmedia_signer::Params::check_subaruments(
       }
 
       sarg.set = true;
-      sarg.set_value = abbr_search->second;
+      sarg.set_value = std::move(abbr_search->second);
 
       if (parsed_abbrs.erase(sarg.abbr) == 0) {
         Log::fatal(ustr::format(
@@ -517,7 +605,7 @@ socialmedia_signer::Params::parse_argv0(ustr& dir_name, ustr& cmd_name,
 
 void
 socialmedia_signer::Params::parse_argv(
-  std::map<ustr, ustr>& parsed_names,
+  parsed_names_t& parsed_names,
   std::map<char32_t, ustr>& parsed_abbrs, ustr& argv_next,
   const ustr& argv) const noexcept(false)
 {
@@ -526,17 +614,19 @@ socialmedia_signer::Params::parse_argv(
   if (argv[0] != u8'-' || argv.length() < 2)
     throw CmdErr(ustr::format("'{}' not a parameter !", argv));
 
+  const ustr_view argv_view = argv;
+
   if (argv[1] == u8'-')
-    this->parse_name(parsed_names, argv.substr(1));
+    this->parse_name(parsed_names, argv_view.substr(1));
   else
-    this->parse_abbr(parsed_abbrs, argv_next, argv.substr(1));
+    this->parse_abbr(parsed_abbrs, argv_next, argv_view.substr(1));
 }
 
 /* ---------------------------------------------------------------  */
 
 void
 socialmedia_signer::Params::parse_name(
-  std::map<ustr, ustr>& parsed_names, const ustr& argv)
+  parsed_names_t& parsed_names, ustr_view argv)
   const noexcept(false)
 {
   const std::size_t argv_len = argv.length();
@@ -549,7 +639,7 @@ socialmedia_signer::Params::parse_name(
     char32_t cur = argv[1+name_len];
     if (!(IS_CHAR_ALPHANUM(cur) || cur == u8'?')) break;
   }
-  ustr param_name = argv.substr(1, name_len);
+  const ustr_view param_name = argv.substr(1, name_len);
   const std::size_t param_len = param_name.length();
 
   if (param_len < 1)
@@ -566,8 +656,8 @@ socialmedia_signer::Params::parse_name(
 
 void
 socialmedia_signer::Params::parse_value(
-  std::map<ustr, ustr>& parsed_names, const ustr& param_name,
-  const ustr& argv) const noexcept(false)
+  parsed_names_t& parsed_names, ustr_view param_name,
+  ustr_view argv) const noexcept(false)
 {
   ustr value;
 
@@ -578,11 +668,12 @@ socialmedia_signer::Params::parse_value(
     throw CmdErr(ustr::format("Garbage '{}' behind --{} !",
                               argv, param_name));
   } else {
-    value = argv.substr(1);
+    value = ustr(argv.substr(1));
     /* {terminate}  */
   }
 
-  const auto& [_, success] = parsed_names.insert({param_name, value});
+  const auto& [_, success]
+    = parsed_names.emplace(Ident::intern(param_name), std::move(value));
   if (!success) {
     throw CmdErr(ustr::format("--{} double parameter name !",
                               param_name));
@@ -594,7 +685,7 @@ socialmedia_signer::Params::parse_value(
 void
 socialmedia_signer::Params::parse_abbr(
   std::map<char32_t, ustr>& parsed_abbrs, ustr& argv_next,
-  const ustr& argv) const noexcept(false)
+  ustr_view argv) const noexcept(false)
 {
   if (argv.empty())
     throw CmdErr(u8"'-' empty parameter abbreviation !");
@@ -605,7 +696,7 @@ socialmedia_signer::Params::parse_abbr(
 void
 socialmedia_signer::Params::parse_abbr_next(
   std::map<char32_t, ustr>& parsed_abbrs, ustr& argv_next,
-  const ustr& argv) const noexcept(false)
+  ustr_view argv) const noexcept(false)
 {
   char32_t abbr_name = argv[0];
   if (!(IS_CHAR_ALPHANUM(abbr_name) || abbr_name == u8'?')) {
@@ -642,11 +733,12 @@ socialmedia_signer::Params::parse_argv_next(
   if (argv_next.empty() || argv_next[0] == u8'-') {
     value = u8"";  /* 2x {terminate}  */
   } else {
-    value = argv_next; /* {terminate}  */
-    argv_next = u8"";  /* {clear}  */
+    value = std::move(argv_next);  /* {terminate}  */
+    argv_next.clear();             /* {clear}  */
   }
 
-  const auto& [_, success] = parsed_abbrs.insert({abbr_name, value});
+  const auto& [_, success]
+    = parsed_abbrs.emplace(abbr_name, std::move(value));
   if (!success) {
     throw CmdErr(ustr::format("-{} double parameter abbreviation !",
                               abbr_name));
@@ -21,6 +21,8 @@
 
 #include "common.hpp"
 
+#include "Ident.hpp"
+
 #include <map>
 #include <forward_list>
 
@@ -40,26 +42,30 @@ public:
 
   class CmdErr: public Error { public: CmdErr(const ustr& reason); };
 
+  /**
+   * Not `const`, to be movable.  Params hands out just `const`
+   * references.
+   */
   struct Subargument {
-    Subargument(const ustr name, const char32_t abbr,
-      const ustr description,const ustr value_doc,
-      const bool value_allowed, const bool value_emptyallowed);
+    Subargument(ustr name, char32_t abbr, ustr description,
+      ustr value_doc, bool value_allowed, bool value_emptyallowed);
 
-    const ustr name; const char32_t abbr;
-    const ustr description;
+    ustr name; char32_t abbr;
+    /** Interned `name`, to match the parsed names.  */
+    Ident ident;
+    ustr description;
 
-    const ustr value_doc;
-    const bool value_allowed;
-    const bool value_emptyallowed;
+    ustr value_doc;
+    bool value_allowed;
+    bool value_emptyallowed;
 
     bool set;
     ustr set_value;
   };
 
   struct Subcommand: public Subargument {
-    Subcommand(const ustr name, const char32_t abbr,
-      const ustr description, const ustr value_doc,
-      const bool value_allowed, const bool value_emptyallowed,
+    Subcommand(ustr name, char32_t abbr, ustr description,
+      ustr value_doc, bool value_allowed, bool value_emptyallowed,
       const char32_t* subargs_required,
       const char32_t* subargs_optional);
 
@@ -84,6 +90,8 @@ public:
    */
   static const ustr& get_dir_name();
   static const ustr& get_command_name();
+  /** Params::get_command_name() UTF-8 encoded, for ::ustr8 output.  */
+  static const ustr8& get_command_name_utf8();
 
   virtual void print_version() const;
   virtual void print_help() const;
@@ -100,18 +108,27 @@ public:
 
   /* -------------------------------------------------------------  */
 protected:
+  /**
+   * Parameter names and values.  The names are interned while
+   * parsing, so matching them against the subarguments compares
+   * integers.
+   */
+  using parsed_names_t = std::map<Ident, ustr>;
 
-  virtual const ustr format(const Subargument& subarg, bool abbr=false,
-                            bool optional=false) const;
+  virtual ustr format(const Subargument& subarg, bool abbr=false,
+                      bool optional=false) const;
+  /** Like Params::format(), but appends to `out`.  */
+  virtual void format_to(ustr_builder& out, const Subargument& subarg,
+                         bool abbr=false, bool optional=false) const;
 
-  virtual void check_parameters(std::map<ustr, ustr>& parsed_names,
+  virtual void check_parameters(parsed_names_t& parsed_names,
     std::map<char32_t, ustr>& parsed_abbrs) noexcept(false);
-  virtual void check_subcommands(std::map<ustr, ustr>& parsed_names,
+  virtual void check_subcommands(parsed_names_t& parsed_names,
     std::map<char32_t, ustr>& parsed_abbrs) noexcept(false);
   virtual void check_subaruments(
     std::forward_list<Subargument>* subargs,
     std::map<char32_t, Subargument&>* subarg_map,
-    std::map<ustr, ustr>& parsed_names,
+    parsed_names_t& parsed_names,
     std::map<char32_t, ustr>& parsed_abbrs) const noexcept(false);
 
   /* -------------------------------------------------------------  */
@@ -147,19 +164,20 @@ protected:
 
   virtual void parse_argv0(ustr& dir_name, ustr& cmd_name,
     const ustr& argv0) const;
-  virtual void parse_argv(std::map<ustr, ustr>& parsed_names,
+  virtual void parse_argv(parsed_names_t& parsed_names,
     std::map<char32_t, ustr>& parsed_abbrs, ustr& argv_next,
     const ustr& argv) const noexcept(false);
 
-  virtual void parse_name(std::map<ustr, ustr>& parsed_names,
-    const ustr& argv) const noexcept(false);
-  virtual void parse_value(std::map<ustr, ustr>& parsed_names,
-    const ustr& param_name, const ustr& argv) const noexcept(false);
+  /* The rules take views of ARGV, so no substring is copied.  */
+  virtual void parse_name(parsed_names_t& parsed_names,
+    ustr_view argv) const noexcept(false);
+  virtual void parse_value(parsed_names_t& parsed_names,
+    ustr_view param_name, ustr_view argv) const noexcept(false);
 
   virtual void parse_abbr(std::map<char32_t, ustr>& parsed_abbrs,
-    ustr& argv_next, const ustr& argv) const noexcept(false);
+    ustr& argv_next, ustr_view argv) const noexcept(false);
   virtual void parse_abbr_next(std::map<char32_t, ustr>& parsed_abbrs,
-    ustr& argv_next, const ustr& argv) const noexcept(false);
+    ustr& argv_next, ustr_view argv) const noexcept(false);
   virtual void parse_argv_next(std::map<char32_t, ustr>& parsed_abbrs,
     ustr& argv_next, const char32_t abbr_name) const noexcept(false);
 
@@ -176,6 +194,7 @@ private:
    */
   static ustr dir_name;
   static ustr command_name;
+  static ustr8 command_name_utf8;
 
   /** Memory location of subarguments.  */
   std::forward_list<Subargument> subargs;
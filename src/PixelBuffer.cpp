@@ -0,0 +1,189 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "PixelBuffer.hpp"
+
+#include "BufferPool.hpp"
+
+#include <algorithm>
+
+/* ***************************************************************  */
+
+socialmedia_signer::PixelBuffer::PixelBuffer()
+  :data(nullptr), capacity(0), width(0), height(0), channels(0),
+   layout(Layout::INTERLEAVED), stride(0)
+{
+}
+
+socialmedia_signer::PixelBuffer::PixelBuffer(unsigned width,
+  unsigned height, unsigned channels, Layout layout)
+  :data(nullptr), capacity(0), width(width), height(height),
+   channels(channels), layout(layout), stride(0)
+{
+  const std::size_t row_len = layout == Layout::PLANAR
+    ? width: (std::size_t) width * channels;
+  const std::size_t rows = layout == Layout::PLANAR
+    ? (std::size_t) height * channels: height;
+
+  this->stride = (row_len + BufferPool::ALIGNMENT - 1)
+    / BufferPool::ALIGNMENT * BufferPool::ALIGNMENT;
+
+  if (this->stride * rows == 0) return;
+
+  this->data = static_cast<std::uint8_t*>(
+    BufferPool::get()->acquire(this->stride * rows, this->capacity));
+}
+
+socialmedia_signer::PixelBuffer::~PixelBuffer()
+{
+  this->recycle();
+}
+
+socialmedia_signer::PixelBuffer::PixelBuffer(PixelBuffer&& other)
+  noexcept
+  :data(other.data), capacity(other.capacity), width(other.width),
+   height(other.height), channels(other.channels),
+   layout(other.layout), stride(other.stride)
+{
+  other.data     = nullptr;
+  other.capacity = 0;
+}
+
+socialmedia_signer::PixelBuffer&
+socialmedia_signer::PixelBuffer::operator=(PixelBuffer&& other) noexcept
+{
+  if (this == &other) return *this;
+
+  this->recycle();
+
+  this->data     = other.data;
+  this->capacity = other.capacity;
+  this->width    = other.width;
+  this->height   = other.height;
+  this->channels = other.channels;
+  this->layout   = other.layout;
+  this->stride   = other.stride;
+
+  other.data     = nullptr;
+  other.capacity = 0;
+
+  return *this;
+}
+
+void
+socialmedia_signer::PixelBuffer::recycle()
+{
+  if (this->data == nullptr) return;
+
+  BufferPool::get()->recycle(this->data, this->capacity);
+  this->data     = nullptr;
+  this->capacity = 0;
+}
+
+/* ***************************************************************  */
+
+bool
+socialmedia_signer::PixelBuffer::is_empty() const
+{
+  return this->data == nullptr;
+}
+
+unsigned
+socialmedia_signer::PixelBuffer::get_width() const
+{
+  return this->width;
+}
+
+unsigned
+socialmedia_signer::PixelBuffer::get_height() const
+{
+  return this->height;
+}
+
+unsigned
+socialmedia_signer::PixelBuffer::get_channels() const
+{
+  return this->channels;
+}
+
+socialmedia_signer::PixelBuffer::Layout
+socialmedia_signer::PixelBuffer::get_layout() const
+{
+  return this->layout;
+}
+
+std::size_t
+socialmedia_signer::PixelBuffer::get_stride() const
+{
+  return this->stride;
+}
+
+std::size_t
+socialmedia_signer::PixelBuffer::get_memsize() const
+{
+  return this->capacity;
+}
+
+std::uint8_t*
+socialmedia_signer::PixelBuffer::get_row(unsigned y, unsigned plane)
+{
+  return this->data
+    + ((std::size_t) plane * this->height + y) * this->stride;
+}
+
+const std::uint8_t*
+socialmedia_signer::PixelBuffer::get_row(unsigned y, unsigned plane)
+  const
+{
+  return this->data
+    + ((std::size_t) plane * this->height + y) * this->stride;
+}
+
+/* ***************************************************************  */
+
+socialmedia_signer::PixelBuffer
+socialmedia_signer::PixelBuffer::convert(Layout layout) const
+{
+  PixelBuffer result(this->width, this->height, this->channels, layout);
+  const unsigned ch = this->channels;
+
+  for (unsigned y=0; y < this->height; y++) {
+    if (layout == this->layout) {
+      std::copy_n(this->get_row(y), this->stride, result.get_row(y));
+      for (unsigned p=1; layout == Layout::PLANAR && p < ch; p++)
+        std::copy_n(this->get_row(y, p), this->stride,
+                    result.get_row(y, p));
+    } else if (layout == Layout::PLANAR) {
+      const std::uint8_t* src = this->get_row(y);
+      for (unsigned p=0; p < ch; p++) {
+        std::uint8_t* dst = result.get_row(y, p);
+        for (unsigned x=0; x < this->width; x++) dst[x] = src[x * ch + p];
+      }
+    } else {
+      std::uint8_t* dst = result.get_row(y);
+      for (unsigned p=0; p < ch; p++) {
+        const std::uint8_t* src = this->get_row(y, p);
+        for (unsigned x=0; x < this->width; x++) dst[x * ch + p] = src[x];
+      }
+    }
+  }
+
+  return result;
+}
+
+/* ***************************************************************  */
@@ -0,0 +1,103 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef PIXELBUFFER_HPP__
+#define PIXELBUFFER_HPP__
+
+#include "common.hpp"
+
+#include <cstdint>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/**
+ * 8 bit per channel pixel storage, allocated from the ::BufferPool.
+ *
+ * Every row starts at an address aligned to BufferPool::ALIGNMENT
+ * and is padded up to PixelBuffer::get_stride() bytes, so SIMD
+ * kernels can process full vectors without tail handling.
+ *
+ * Layout::INTERLEAVED stores `RGBRGB...` per row.  Layout::PLANAR
+ * stores one plane per channel (SoA), i.e. all R rows, then all G
+ * rows, etc.
+ *
+ * Move only, the memory is recycled to the pool on destruction.
+ */
+class PixelBuffer
+{
+public:
+  enum class Layout { INTERLEAVED, PLANAR };
+
+  explicit PixelBuffer();
+  explicit PixelBuffer(unsigned width, unsigned height,
+                       unsigned channels,
+                       Layout layout = Layout::INTERLEAVED);
+  virtual ~PixelBuffer();
+
+  PixelBuffer(const PixelBuffer& other) = delete;
+  PixelBuffer& operator=(const PixelBuffer& other) = delete;
+
+  PixelBuffer(PixelBuffer&& other) noexcept;
+  PixelBuffer& operator=(PixelBuffer&& other) noexcept;
+
+  /* -------------------------------------------------------------  */
+
+  virtual bool is_empty() const;
+
+  virtual unsigned get_width() const;
+  virtual unsigned get_height() const;
+  virtual unsigned get_channels() const;
+  virtual Layout get_layout() const;
+
+  /** Bytes from one row to the next within the same plane.  */
+  virtual std::size_t get_stride() const;
+  /** Bytes of memory, including padding.  */
+  virtual std::size_t get_memsize() const;
+
+  /**
+   * First byte of row `y`.  For Layout::INTERLEAVED `plane` needs to
+   * be 0.
+   */
+  virtual std::uint8_t* get_row(unsigned y, unsigned plane = 0);
+  virtual const std::uint8_t* get_row(unsigned y, unsigned plane = 0)
+    const;
+
+  /** Copy into a new buffer with another Layout.  */
+  virtual PixelBuffer convert(Layout layout) const;
+
+private:
+  void recycle();
+
+  std::uint8_t* data;
+  std::size_t capacity;
+
+  unsigned width;
+  unsigned height;
+  unsigned channels;
+  Layout layout;
+
+  std::size_t stride;
+};
+
+}
+
+/* ***************************************************************  */
+
+#endif /* PIXELBUFFER_HPP__  */
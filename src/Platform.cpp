@@ -20,10 +20,13 @@
 
 /* ***************************************************************  */
 
-socialmedia_signer::Platform::Platform(
-  const ustr& id, const ustr& name)
-  :id(id), name(name)
+socialmedia_signer::Platform::Platform(ustr id, ustr name)
+  :id(std::move(id)), ident(), name(std::move(name))
 {
+  ustr folded_id = this->id;
+  folded_id.casefold();
+
+  this->ident = Ident::intern(folded_id);
 }
 
 socialmedia_signer::Platform::~Platform()
@@ -36,6 +39,12 @@ socialmedia_signer::Platform::get_id() const
   return this->id;
 }
 
+socialmedia_signer::Ident
+socialmedia_signer::Platform::get_ident() const
+{
+  return this->ident;
+}
+
 const socialmedia_signer::ustr&
 socialmedia_signer::Platform::get_name() const
 {
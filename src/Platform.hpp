@@ -21,6 +21,8 @@
 
 #include "common.hpp"
 
+#include "Ident.hpp"
+
 /* ***************************************************************  */
 
 namespace socialmedia_signer {
@@ -32,18 +34,25 @@ namespace socialmedia_signer {
 class Platform
 {
 public:
-  explicit Platform(const ustr& id, const ustr& name);
+  explicit Platform(ustr id, ustr name);
   virtual ~Platform();
 
+  /* The virtual destructor would suppress the implicit moves.  */
+  Platform(const Platform& other) = default;
+  Platform(Platform&& other) noexcept = default;
+
   virtual const ustr& get_id() const;
+  /** Interned case folded id, see Platforms::get_by_ident().  */
+  virtual Ident get_ident() const;
   virtual const ustr& get_name() const;
 
 private:
   /** Used as abbreviation for command-line parameters.  */
-  const ustr id;
+  ustr id;
+  Ident ident;
 
   /** Human readable name of the platform.  */
-  const ustr name;
+  ustr name;
 };
 
 }
@@ -21,11 +21,16 @@
 #include "PlatformThreads.hpp"
 #include "PlatformXCom.hpp"
 
+#include "Utf8.hpp"
+#include "Ucase.hpp"
+
+#include <algorithm>
+
 /* ***************************************************************  */
 
 socialmedia_signer::Platforms::iterator::iterator(
-  const std::map<const ustr, Platform&>::iterator& other)
-  :std::map<const ustr, Platform&>::iterator(other)
+  const platform_map_t::iterator& other)
+  :platform_map_t::iterator(other)
 {
 }
 
@@ -33,7 +38,7 @@ socialmedia_signer::Platform&
 socialmedia_signer::Platforms::iterator::operator*()
 {
   std::pair<const ustr, Platform&>& super_pair
-    = std::map<const ustr, Platform&>::iterator::operator*();
+    = platform_map_t::iterator::operator*();
 
   return super_pair.second;
 }
@@ -42,7 +47,7 @@ socialmedia_signer::Platform*
 socialmedia_signer::Platforms::iterator::operator->()
 {
   std::pair<const ustr, Platform&>& super_pair
-    = std::map<const ustr, Platform&>::iterator::operator*();
+    = platform_map_t::iterator::operator*();
 
   return &super_pair.second;
 }
@@ -58,13 +63,15 @@ socialmedia_signer::Platforms::Platforms()
   :platforms({
       PlatformThreads(),
       PlatformXCom()
-  }), platform_map()
+  }), platform_map(), ident_map()
 {
   for (Platform& cur: this->platforms) {
     const auto& [_, success] = this->platform_map.insert({
-        cur.get_id(), cur});
+        cur.get_ident().get_name(), cur});
     if (!success)
       Log::fatal(u8"Could not build Platforms::platform_map!");
+
+    this->ident_map.insert({cur.get_ident(), cur});
   }
 }
 
@@ -80,6 +87,7 @@ socialmedia_signer::Platforms::init()
   if (Platforms::instance != nullptr)
     Log::fatal(u8"Platforms::init(): double call!");
 
+  Alloc::Scope scope(Alloc::Tag::PLATFORMS);
   Platforms::instance = new Platforms();
 }
 
@@ -101,15 +109,60 @@ socialmedia_signer::Platforms::get()
 /* ***************************************************************  */
 
 socialmedia_signer::Platform*
-socialmedia_signer::Platforms::get_by_id(const ustr& id) const
+socialmedia_signer::Platforms::get_by_id(ustr_view id) const
+{
+  Alloc::Scope scope(Alloc::Tag::PLATFORMS);
+
+  if (id.length() > Platforms::ID_MAX_LENGTH) {
+    ustr folded_id(id);
+    folded_id.casefold();
+
+    return this->get_by_folded_id(folded_id);
+  }
+
+  char32_t folded_id[Platforms::ID_MAX_LENGTH];
+  std::copy(id.begin(), id.end(), folded_id);
+  Ucase::fold(folded_id, id.length());
+
+  return this->get_by_folded_id(ustr_view(folded_id, id.length()));
+}
+
+socialmedia_signer::Platform*
+socialmedia_signer::Platforms::get_by_id(const ustr8& id) const
 {
-  const auto& platform_search = this->platform_map.find(id);
-  if (platform_search == this->platform_map.end())
+  /* Code points are never more than bytes.  */
+  if (id.size_bytes() > Platforms::ID_MAX_LENGTH)
+    return this->get_by_id(id.to_ustr());
+
+  char32_t folded_id[Platforms::ID_MAX_LENGTH];
+  const Utf8::Result result
+    = Utf8::decode(folded_id, id.c_str(), id.size_bytes());
+  Ucase::fold(folded_id, result.written);
+
+  return this->get_by_folded_id(ustr_view(folded_id, result.written));
+}
+
+socialmedia_signer::Platform*
+socialmedia_signer::Platforms::get_by_ident(Ident ident) const
+{
+  const auto& platform_search = this->ident_map.find(ident);
+  if (platform_search == this->ident_map.end())
     return nullptr;
 
   return &platform_search->second;
 }
 
+socialmedia_signer::Platform*
+socialmedia_signer::Platforms::get_by_folded_id(ustr_view folded_id)
+  const
+{
+  /* Not interned, so no platform has this id.  */
+  const Ident ident = Ident::find(folded_id);
+  if (!ident.is_valid()) return nullptr;
+
+  return this->get_by_ident(ident);
+}
+
 /* ---------------------------------------------------------------  */
 
 socialmedia_signer::Platforms::iterator
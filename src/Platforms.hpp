@@ -24,6 +24,7 @@
 #include "Platform.hpp"
 
 #include <map>
+#include <unordered_map>
 #include <forward_list>
 
 /* ***************************************************************  */
@@ -37,11 +38,12 @@ namespace socialmedia_signer {
 class Platforms
 {
 public:
+  /** Ordered by platform id, looked up by ::ustr_view.  */
+  using platform_map_t = std::map<const ustr, Platform&, ustr_less>;
 
-  class iterator: public std::map<const ustr, Platform&>::iterator {
+  class iterator: public platform_map_t::iterator {
   public:
-    explicit iterator(
-      const std::map<const ustr, Platform&>::iterator& other);
+    explicit iterator(const platform_map_t::iterator& other);
 
     virtual Platform& operator*();
     virtual Platform* operator->();
@@ -54,10 +56,19 @@ public:
   /* Get instance of singleton  */
   static Platforms* get();
 
+  /** Longest platform id which lookups fold on the stack.  */
+  static constexpr std::size_t ID_MAX_LENGTH = 32;
+
   /**
-   * Returns `nullptr` if `id` does not exist.
+   * Returns `nullptr` if `id` does not exist.  Ids are compared case
+   * insensitive, i.e. `XCom` finds `xcom`.  Takes a `ustr`, a `U""`
+   * literal or a ::ustr_view without allocation.
    */
-  virtual Platform* get_by_id(const ustr& id) const;
+  virtual Platform* get_by_id(ustr_view id) const;
+  virtual Platform* get_by_id(const ustr8& id) const;
+
+  /** Lookup by Platform::get_ident(), just compares integers.  */
+  virtual Platform* get_by_ident(Ident ident) const;
 
   /**
    * Iterate in alphabetic order of platform id.
@@ -74,8 +85,13 @@ private:
   /** Memory location of ::Platform´s .  */
   std::forward_list<Platform> platforms;
 
+  /** Finds `folded_id`, which is already case folded.  */
+  Platform* get_by_folded_id(ustr_view folded_id) const;
+
+  /** Iterates the list Platforms::platforms, by folded id.  */
+  platform_map_t platform_map;
   /** Used to lookup the list Platforms::platforms .  */
-  std::map<const ustr, Platform&> platform_map;
+  std::unordered_map<Ident, Platform&, Ident::Hash> ident_map;
 };
 
 }
@@ -0,0 +1,319 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "Profile.hpp"
+
+#include "common.hpp"
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <format>
+#include <chrono>
+#include <ctime>
+#include <cerrno>
+#include <cstring>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+static constexpr unsigned _PROFILE_STAGES
+  = static_cast<unsigned>(Profile::Stage::COUNT);
+
+static const char* const _profile_stage_names[_PROFILE_STAGES] = {
+  "crypto", "image decode", "QR detect", "network wait",
+};
+
+/** perf_event_attr::config of each Profile::Event.  */
+static const std::uint64_t _profile_event_configs[Profile::EVENTS] = {
+  PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+  PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+struct profile_total {
+  std::uint64_t calls;
+  std::uint64_t wall_ns;
+  std::uint64_t cpu_ns;
+  std::uint64_t events[Profile::EVENTS];
+};
+
+/** Counters of one thread, written by this thread only.  */
+struct profile_thread {
+  /** Group leader and members, -1 without hardware counters.  */
+  int fds[Profile::EVENTS];
+
+  profile_total totals[_PROFILE_STAGES];
+};
+
+/**
+ * Protects `_profile_threads`, but not their content, which is read
+ * by Profile::release() after the threads stopped counting.  Totals
+ * stay here after their thread exited.
+ */
+static std::mutex _profile_mutex;
+static std::vector<std::unique_ptr<profile_thread>> _profile_threads;
+
+/** Set by the first thread which could not open the counters.  */
+static std::atomic<bool> _profile_no_events(false);
+/** Counted in user space only, if the kernel is not permitted.  */
+static std::atomic<bool> _profile_user_only(false);
+
+static std::chrono::steady_clock::time_point _profile_epoch;
+
+static int
+_profile_open(std::uint64_t config, int group_fd, bool user_only)
+{
+  struct perf_event_attr attr = {};
+  attr.size           = sizeof(attr);
+  attr.type           = PERF_TYPE_HARDWARE;
+  attr.config         = config;
+  attr.read_format    = PERF_FORMAT_GROUP
+    | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  attr.exclude_kernel = user_only;
+  attr.exclude_hv     = 1;
+
+  /* This thread on any CPU.  */
+  return static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1,
+                                    group_fd, PERF_FLAG_FD_CLOEXEC));
+}
+
+static void
+_profile_close(profile_thread& thread)
+{
+  for (int& fd: thread.fds) {
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+  }
+}
+
+/** Opens the group of the calling thread, all fds -1 on error.  */
+static void
+_profile_open_group(profile_thread& thread)
+{
+  for (int& fd: thread.fds) fd = -1;
+  if (_profile_no_events.load(std::memory_order_relaxed)) return;
+
+  bool user_only = _profile_user_only.load(std::memory_order_relaxed);
+  for (unsigned e=0; e < Profile::EVENTS; e++) {
+    thread.fds[e] = _profile_open(_profile_event_configs[e],
+                                  e == 0? -1: thread.fds[0], user_only);
+
+    /* perf_event_paranoid 2 permits user space only.  */
+    if (thread.fds[e] < 0 && e == 0 && !user_only
+        && (errno == EACCES || errno == EPERM)) {
+      user_only = true;
+      _profile_user_only.store(true, std::memory_order_relaxed);
+      thread.fds[e] = _profile_open(_profile_event_configs[e], -1, true);
+    }
+
+    if (thread.fds[e] < 0) {
+      if (!_profile_no_events.exchange(true)) {
+        Log::warn("--profile: no hardware counters, just timing"
+                  " (perf_event_open(): {})", std::strerror(errno));
+      }
+      _profile_close(thread);
+      return;
+    }
+  }
+}
+
+/** Closes the counters of the thread on its exit.  */
+struct profile_handle {
+  profile_thread* thread = nullptr;
+
+  ~profile_handle()
+  {
+    if (this->thread != nullptr) _profile_close(*this->thread);
+  }
+};
+
+static thread_local profile_handle _profile_handle;
+
+static profile_thread&
+_profile_get_thread()
+{
+  if (_profile_handle.thread == nullptr) {
+    auto thread = std::make_unique<profile_thread>();
+    _profile_open_group(*thread);
+
+    _profile_handle.thread = thread.get();
+
+    std::lock_guard<std::mutex> lock(_profile_mutex);
+    _profile_threads.push_back(std::move(thread));
+  }
+
+  return *_profile_handle.thread;
+}
+
+/** The counts of `total`, or `-` without hardware counters.  */
+static std::string
+_profile_events(const profile_total& total)
+{
+  if (_profile_no_events.load()) {
+    return std::format("{:>10}{:>10}{:>6}{:>10}{:>10}",
+                       "-", "-", "-", "-", "-");
+  }
+
+  const double instructions = static_cast<double>(
+    total.events[static_cast<unsigned>(Profile::Event::INSTRUCTIONS)]);
+  const double kilo_instructions = instructions / 1000.0;
+  auto per_ki = [&total, kilo_instructions](Profile::Event event) {
+    return kilo_instructions > 0.0
+      ? total.events[static_cast<unsigned>(event)] / kilo_instructions
+      : 0.0;
+  };
+
+  const double cycles = static_cast<double>(
+    total.events[static_cast<unsigned>(Profile::Event::CYCLES)]);
+
+  return std::format("{:>10.1f}{:>10.1f}{:>6.2f}{:>10.2f}{:>10.2f}",
+    cycles / 1e6, instructions / 1e6,
+    cycles > 0.0? instructions / cycles: 0.0,
+    per_ki(Profile::Event::CACHE_MISSES),
+    per_ki(Profile::Event::BRANCH_MISSES));
+}
+
+} /* namespace socialmedia_signer  */
+
+/* ***************************************************************  */
+
+std::atomic<bool> socialmedia_signer::Profile::enabled(false);
+
+/* ---------------------------------------------------------------  */
+
+socialmedia_signer::Profile::Scope::Scope(Stage stage)
+  :stage(stage), is_active(Profile::is_enabled()), start()
+{
+  if (this->is_active) Profile::sample(this->start);
+}
+
+socialmedia_signer::Profile::Scope::~Scope()
+{
+  if (this->is_active) Profile::add(this->stage, this->start);
+}
+
+/* ***************************************************************  */
+
+void
+socialmedia_signer::Profile::init()
+{
+  if (Profile::is_enabled())
+    Log::fatal(u8"Profile::init(): double call!");
+
+  _profile_epoch = std::chrono::steady_clock::now();
+  Profile::enabled.store(true, std::memory_order_relaxed);
+}
+
+void
+socialmedia_signer::Profile::release()
+{
+  if (!Profile::is_enabled()) return;
+  Profile::enabled.store(false, std::memory_order_relaxed);
+
+  const double run_ms = std::chrono::duration<double, std::milli>(
+    std::chrono::steady_clock::now() - _profile_epoch).count();
+
+  std::lock_guard<std::mutex> lock(_profile_mutex);
+
+  profile_total totals[_PROFILE_STAGES] = {};
+  for (const auto& thread: _profile_threads) {
+    for (unsigned s=0; s < _PROFILE_STAGES; s++) {
+      const profile_total& src = thread->totals[s];
+
+      totals[s].calls   += src.calls;
+      totals[s].wall_ns += src.wall_ns;
+      totals[s].cpu_ns  += src.cpu_ns;
+      for (unsigned e=0; e < Profile::EVENTS; e++)
+        totals[s].events[e] += src.events[e];
+    }
+  }
+
+  Log::note("--profile: {} threads in {:.1f} ms, counted {}",
+    _profile_threads.size(), run_ms,
+    _profile_no_events.load()? "without hardware counters"
+    : _profile_user_only.load()? "in user space": "in user and kernel");
+  Log::note("{:<14}{:>8}{:>11}{:>11}{:>10}{:>10}{:>6}{:>10}{:>10}",
+            "stage", "calls", "wall ms", "cpu ms", "Mcycles", "Minstr",
+            "IPC", "cmiss/Ki", "bmiss/Ki");
+
+  for (unsigned s=0; s < _PROFILE_STAGES; s++) {
+    const profile_total& total = totals[s];
+    if (total.calls == 0) continue;
+
+    Log::note("{:<14}{:>8}{:>11.2f}{:>11.2f}{}",
+              _profile_stage_names[s], total.calls, total.wall_ns / 1e6,
+              total.cpu_ns / 1e6, _profile_events(total));
+  }
+
+  for (const auto& thread: _profile_threads) _profile_close(*thread);
+}
+
+/* ---------------------------------------------------------------  */
+
+void
+socialmedia_signer::Profile::sample(Sample& sample)
+{
+  profile_thread& thread = _profile_get_thread();
+
+  if (thread.fds[0] >= 0) {
+    /* PERF_FORMAT_GROUP: nr, time enabled, time running, values.  */
+    std::uint64_t data[3 + Profile::EVENTS] = {};
+
+    if (::read(thread.fds[0], data, sizeof(data)) == sizeof(data)) {
+      /* Scale up, if the PMU was multiplexed with other groups.  */
+      const double scale = data[2] > 0 && data[2] < data[1]
+        ? static_cast<double>(data[1]) / data[2]: 1.0;
+
+      for (unsigned e=0; e < Profile::EVENTS; e++) {
+        sample.events[e] = static_cast<std::uint64_t>(data[3 + e]
+                                                      * scale);
+      }
+    }
+  }
+
+  struct timespec cpu;
+  ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+  sample.cpu_ns = cpu.tv_sec * 1000000000ULL + cpu.tv_nsec;
+
+  sample.wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void
+socialmedia_signer::Profile::add(Stage stage, const Sample& start)
+{
+  Sample end = {};
+  Profile::sample(end);
+
+  profile_total& total
+    = _profile_get_thread().totals[static_cast<unsigned>(stage)];
+
+  total.calls++;
+  total.wall_ns += end.wall_ns - start.wall_ns;
+  total.cpu_ns  += end.cpu_ns - start.cpu_ns;
+  for (unsigned e=0; e < Profile::EVENTS; e++)
+    total.events[e] += end.events[e] - start.events[e];
+}
+
+/* ***************************************************************  */
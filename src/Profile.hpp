@@ -0,0 +1,125 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef PROFILE_HPP__
+#define PROFILE_HPP__
+
+#include <atomic>
+#include <cstdint>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/**
+ * Abstract class which includes static methods for counting CPU
+ * events per pipeline stage, enabled by `--profile`.
+ *
+ * A stage lasts from the construction to the destruction of a
+ * Profile::Scope:
+ * ```cpp
+ *   Profile::Scope scope(Profile::Stage::IMAGE_DECODE);
+ * ```
+ * Each thread opens its own `perf_event_open(2)` group of cycles,
+ * instructions, cache misses and branch misses, which is read at
+ * both ends of a scope.  Also wall and CPU time of the thread are
+ * measured, which works without hardware counters, too.  Nested
+ * scopes count into both stages.
+ *
+ * Profile::release() prints a table per stage.  CPU time far below
+ * wall time means the stage waits for I/O, a low IPC with many cache
+ * misses per 1000 instructions means it is bound by memory.  Before
+ * Profile::init() a scope costs just the check of
+ * Profile::is_enabled().
+ */
+class Profile
+{
+public:
+  /* Abstract class  */
+  Profile()               = delete;
+  Profile(Profile& other) = delete;
+  virtual ~Profile()      = 0;
+
+  enum class Stage: unsigned char {
+    CRYPTO, IMAGE_DECODE, QR_DETECT,
+    /** Requests to platforms, as soon as posts are downloaded.  */
+    NETWORK_WAIT,
+
+    COUNT
+  };
+
+  enum class Event: unsigned char {
+    CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES,
+
+    COUNT
+  };
+
+  static constexpr unsigned EVENTS
+    = static_cast<unsigned>(Event::COUNT);
+
+  /** Counters of a thread at one point in time.  */
+  struct Sample {
+    std::uint64_t wall_ns;
+    std::uint64_t cpu_ns;
+    /** Valid if the thread has hardware counters.  */
+    std::uint64_t events[EVENTS];
+  };
+
+  /** Counts its lifetime into a Profile::Stage.  */
+  class Scope
+  {
+  public:
+    explicit Scope(Stage stage);
+    ~Scope();
+
+    Scope(Scope& other) = delete;
+
+  private:
+    const Stage stage;
+    const bool is_active;
+    Sample start;
+  };
+
+  /* -------------------------------------------------------------  */
+
+  /** Starts counting, called for `--profile`.  */
+  static void init();
+
+  /** Prints the table of all stages and stops counting.  */
+  static void release();
+
+  static inline bool is_enabled()
+  {
+    return Profile::enabled.load(std::memory_order_relaxed);
+  }
+
+  /** Reads the counters of the calling thread into `sample`.  */
+  static void sample(Sample& sample);
+
+  /** Adds the counters since `start` to `stage`.  */
+  static void add(Stage stage, const Sample& start);
+
+private:
+  static std::atomic<bool> enabled;
+};
+
+}
+
+/* ***************************************************************  */
+
+#endif /* PROFILE_HPP__  */
@@ -0,0 +1,243 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "QrCache.hpp"
+
+#include <cstring>
+
+/* ***************************************************************  */
+
+socialmedia_signer::QrCache*
+socialmedia_signer::QrCache::instance = nullptr;
+
+/* ***************************************************************  */
+
+bool
+socialmedia_signer::QrCache::Key::operator==(const Key& other) const
+{
+  if (std::memcmp(this->digest, other.digest, sizeof(this->digest)) != 0
+      || this->style.ecc != other.style.ecc
+      || this->is_raster != other.is_raster)
+    return false;
+
+  return !this->is_raster
+    || (this->style.scale == other.style.scale
+        && this->style.quiet_zone == other.style.quiet_zone
+        && this->style.color_dark == other.style.color_dark
+        && this->style.color_light == other.style.color_light);
+}
+
+std::size_t
+socialmedia_signer::QrCache::KeyHash::operator()(const Key& key)
+  const noexcept
+{
+  /* The digest is already uniformly distributed.  */
+  std::size_t result;
+  std::memcpy(&result, key.digest, sizeof(result));
+
+  result ^= static_cast<std::size_t>(key.style.ecc) << 1
+    | (key.is_raster? 1: 0);
+
+  if (key.is_raster) {
+    result ^= (std::size_t) key.style.scale * 0x9e3779b97f4a7c15UL;
+    result ^= (std::size_t) key.style.quiet_zone << 8;
+    result ^= (std::size_t) key.style.color_dark << 16;
+    result ^= (std::size_t) key.style.color_light << 40;
+  }
+
+  return result;
+}
+
+/* ***************************************************************  */
+
+socialmedia_signer::QrCache::QrCache(std::size_t max_bytes)
+  :max_bytes(max_bytes), mutex(), lru(), map(), stats()
+{
+}
+
+socialmedia_signer::QrCache::~QrCache()
+{
+  LOG_DEBUG(QRCACHE,
+    "QRCACHE: {} hits, {} misses, {} evictions, {} entries, {} bytes",
+    this->stats.hits, this->stats.misses, this->stats.evictions,
+    this->stats.entries, this->stats.bytes);
+}
+
+/* ***************************************************************  */
+
+void
+socialmedia_signer::QrCache::init(std::size_t max_bytes)
+{
+  if (QrCache::instance != nullptr)
+    Log::fatal(u8"QrCache::init(): double call!");
+
+  QrCache::instance = new QrCache(max_bytes);
+}
+
+void
+socialmedia_signer::QrCache::release()
+{
+  delete QrCache::instance;
+}
+
+socialmedia_signer::QrCache*
+socialmedia_signer::QrCache::get()
+{
+  if (QrCache::instance == nullptr)
+    Log::fatal(u8"QrCache::init() not called!");
+
+  return QrCache::instance;
+}
+
+/* ***************************************************************  */
+
+std::shared_ptr<const socialmedia_signer::QrCode>
+socialmedia_signer::QrCache::get_code(const std::u8string& payload,
+  QrCode::Ecc ecc) noexcept(false)
+{
+  Image::QrStyle style = Image::QR_STYLE_DEFAULT;
+  style.ecc = ecc;
+
+  return this->get_code(this->make_key(payload, style, false), payload,
+                        true);
+}
+
+std::shared_ptr<const socialmedia_signer::QrCode>
+socialmedia_signer::QrCache::get_code(const Key& key,
+  const std::u8string& payload, bool is_counted) noexcept(false)
+{
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    const Entry* found = this->lookup(key, is_counted);
+    if (found != nullptr) return found->code;
+  }
+
+  /* Encode without lock, QrCode() may take some time.  */
+  std::shared_ptr<const QrCode> code
+    = std::make_shared<const QrCode>(payload, key.style.ecc);
+  const std::size_t bytes = code->get_memsize();
+
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return this->insert({key, std::move(code), nullptr, bytes})->code;
+}
+
+std::shared_ptr<const socialmedia_signer::Image>
+socialmedia_signer::QrCache::get_raster(const std::u8string& payload,
+  const Image::QrStyle& style) noexcept(false)
+{
+  const Key key = this->make_key(payload, style, true);
+
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    const Entry* found = this->lookup(key);
+    if (found != nullptr) return found->raster;
+  }
+
+  /* Same digest, the miss is already counted.  */
+  Key code_key = key;
+  code_key.style     = Image::QR_STYLE_DEFAULT;
+  code_key.style.ecc = style.ecc;
+  code_key.is_raster = false;
+
+  std::shared_ptr<const QrCode> code
+    = this->get_code(code_key, payload, false);
+
+  std::shared_ptr<const Image> raster
+    = std::make_shared<const Image>(*code, style);
+  const std::size_t bytes
+    = sizeof(Image) + raster->get_buffer().get_memsize();
+
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return this->insert({key, nullptr, std::move(raster), bytes})->raster;
+}
+
+socialmedia_signer::QrCache::Stats
+socialmedia_signer::QrCache::get_stats() const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+
+  return this->stats;
+}
+
+/* ***************************************************************  */
+
+socialmedia_signer::QrCache::Key
+socialmedia_signer::QrCache::make_key(const std::u8string& payload,
+  const Image::QrStyle& style, bool is_raster) const noexcept(false)
+{
+  Key result;
+
+  Crypto::get()->digest(result.digest, payload.data(), payload.length())
+    .value();
+  result.style     = style;
+  result.is_raster = is_raster;
+
+  return result;
+}
+
+const socialmedia_signer::QrCache::Entry*
+socialmedia_signer::QrCache::lookup(const Key& key, bool is_counted)
+{
+  const auto& search = this->map.find(key);
+  if (search == this->map.end()) {
+    if (is_counted) this->stats.misses++;
+    return nullptr;
+  }
+
+  /* Move to front, iterators stay valid.  */
+  this->lru.splice(this->lru.begin(), this->lru, search->second);
+  if (is_counted) this->stats.hits++;
+
+  return &*search->second;
+}
+
+const socialmedia_signer::QrCache::Entry*
+socialmedia_signer::QrCache::insert(Entry&& entry)
+{
+  /* Encoded concurrently by another thread?  Then use that one.  */
+  const auto& search = this->map.find(entry.key);
+  if (search != this->map.end()) {
+    this->lru.splice(this->lru.begin(), this->lru, search->second);
+    return &*search->second;
+  }
+
+  this->lru.push_front(std::move(entry));
+  this->map.insert({this->lru.front().key, this->lru.begin()});
+
+  this->stats.entries++;
+  this->stats.bytes += this->lru.front().bytes;
+
+  /* Evict, but keep at least the new entry.  */
+  while (this->stats.bytes > this->max_bytes && this->lru.size() > 1) {
+    const Entry& last = this->lru.back();
+
+    this->stats.bytes -= last.bytes;
+    this->stats.entries--;
+    this->stats.evictions++;
+
+    this->map.erase(last.key);
+    this->lru.pop_back();
+  }
+  Metrics::set(Metrics::Gauge::QRCACHE_BYTES, this->stats.bytes);
+
+  return &this->lru.front();
+}
+
+/* ***************************************************************  */
@@ -0,0 +1,144 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef QRCACHE_HPP__
+#define QRCACHE_HPP__
+
+#include "Image.hpp"
+#include "QrCode.hpp"
+#include "Crypto.hpp"
+
+#include "common.hpp"
+
+#include <list>
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/**
+ * Singleton class which can be accessed via QrCache::get().  It
+ * caches encoded QrCode module matrices and their rendered Image
+ * rasters, addressed by the Crypto::digest() of the payload plus the
+ * Image::QrStyle.
+ *
+ * The least recently used entries are evicted if the memory limit
+ * is exceeded.  Returned objects stay valid after eviction.  Thread
+ * safe.
+ */
+class QrCache
+{
+public:
+
+  struct Stats {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+
+    std::size_t entries;
+    std::size_t bytes;
+  };
+
+  /** Default memory limit of QrCache::init().  */
+  static constexpr std::size_t DEFAULT_MAX_BYTES = 64UL << 20;
+
+  /* -------------------------------------------------------------  */
+
+  /* Singleton class, needs Crypto::init()  */
+  static void init(std::size_t max_bytes = DEFAULT_MAX_BYTES);
+  static void release();
+
+  /* Get instance of singleton  */
+  static QrCache* get();
+
+  /* -------------------------------------------------------------  */
+
+  virtual std::shared_ptr<const QrCode> get_code(
+    const std::u8string& payload, QrCode::Ecc ecc) noexcept(false);
+  virtual std::shared_ptr<const Image> get_raster(
+    const std::u8string& payload, const Image::QrStyle& style)
+    noexcept(false);
+
+  virtual Stats get_stats() const;
+
+  /* -------------------------------------------------------------  */
+private:
+  explicit QrCache(std::size_t max_bytes);
+  virtual ~QrCache();
+
+  static QrCache* instance;
+
+  /**
+   * For module matrices just `digest` and `style.ecc` are used,
+   * `is_raster` is `false`.
+   */
+  struct Key {
+    std::uint8_t digest[Crypto::DIGEST_LEN];
+    Image::QrStyle style;
+    bool is_raster;
+
+    bool operator==(const Key& other) const;
+  };
+
+  struct KeyHash {
+    std::size_t operator()(const Key& key) const noexcept;
+  };
+
+  struct Entry {
+    Key key;
+    std::shared_ptr<const QrCode> code;
+    std::shared_ptr<const Image> raster;
+    std::size_t bytes;
+  };
+
+  using lru_list = std::list<Entry>;
+
+  Key make_key(const std::u8string& payload, const Image::QrStyle& style,
+               bool is_raster) const noexcept(false);
+
+  /**
+   * The module matrix of `key`, encoded on a miss.  Just counted in
+   * Stats if `is_counted`, so a raster miss counts once.
+   */
+  std::shared_ptr<const QrCode> get_code(const Key& key,
+    const std::u8string& payload, bool is_counted) noexcept(false);
+
+  /** Needs QrCache::mutex locked.  */
+  const Entry* lookup(const Key& key, bool is_counted = true);
+  /** Needs QrCache::mutex locked.  */
+  const Entry* insert(Entry&& entry);
+
+  const std::size_t max_bytes;
+
+  mutable std::mutex mutex;
+
+  /** Most recently used at front.  */
+  lru_list lru;
+  std::unordered_map<Key, lru_list::iterator, KeyHash> map;
+
+  Stats stats;
+};
+
+}
+
+/* ***************************************************************  */
+
+#endif /* QRCACHE_HPP__  */
@@ -0,0 +1,570 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "QrCode.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+/* Implementation follows the structure of Project Nayuki´s QR Code
+ * generator library (MIT License), see
+ * https://www.nayuki.io/page/qr-code-generator-library
+ */
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/* Indexed by [Ecc][version], version 0 is unused.  */
+
+static const std::int8_t QRCODE_ECC_CODEWORDS_PER_BLOCK[4][41] = {
+  {-1,  7, 10, 15, 20, 26, 18, 20, 24, 30, 18, 20, 24, 26, 30, 22, 24,
+   28, 30, 28, 28, 28, 28, 30, 30, 26, 28, 30, 30, 30, 30, 30, 30, 30,
+   30, 30, 30, 30, 30, 30, 30},
+  {-1, 10, 16, 26, 18, 24, 16, 18, 22, 22, 26, 30, 22, 22, 24, 24, 28,
+   28, 26, 26, 26, 26, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+   28, 28, 28, 28, 28, 28, 28},
+  {-1, 13, 22, 18, 26, 18, 24, 18, 22, 20, 24, 28, 26, 24, 20, 30, 24,
+   28, 28, 26, 30, 28, 30, 30, 30, 30, 28, 30, 30, 30, 30, 30, 30, 30,
+   30, 30, 30, 30, 30, 30, 30},
+  {-1, 17, 28, 22, 16, 22, 28, 26, 26, 24, 28, 24, 28, 22, 24, 24, 30,
+   28, 28, 26, 28, 30, 24, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30,
+   30, 30, 30, 30, 30, 30, 30}
+};
+
+static const std::int8_t QRCODE_NUM_ERROR_CORRECTION_BLOCKS[4][41] = {
+  {-1,  1,  1,  1,  1,  1,  2,  2,  2,  2,  4,  4,  4,  4,  4,  6,  6,
+    6,  6,  7,  8,  8,  9,  9, 10, 12, 12, 12, 13, 14, 15, 16, 17, 18,
+   19, 19, 20, 21, 22, 24, 25},
+  {-1,  1,  1,  1,  2,  2,  4,  4,  4,  5,  5,  5,  8,  9,  9, 10, 10,
+   11, 13, 14, 16, 17, 17, 18, 20, 21, 23, 25, 26, 28, 29, 31, 33, 35,
+   37, 38, 40, 43, 45, 47, 49},
+  {-1,  1,  1,  2,  2,  4,  4,  6,  6,  8,  8,  8, 10, 12, 16, 12, 17,
+   16, 18, 21, 20, 23, 23, 25, 27, 29, 34, 34, 35, 38, 40, 43, 45, 48,
+   51, 53, 56, 59, 62, 65, 68},
+  {-1,  1,  1,  2,  4,  4,  4,  5,  6,  8,  8, 11, 11, 16, 16, 18, 16,
+   19, 21, 25, 25, 25, 34, 30, 32, 35, 37, 40, 42, 45, 48, 51, 54, 57,
+   60, 63, 66, 70, 74, 77, 81}
+};
+
+/** Format information bits of Ecc, in order L, M, Q, H.  */
+static const int QRCODE_ECC_FORMAT_BITS[4] = {1, 0, 3, 2};
+
+static bool _get_bit(long x, int i)
+{
+  return ((x >> i) & 1) != 0;
+}
+
+} /* namespace socialmedia_signer  */
+
+/* ***************************************************************  */
+
+socialmedia_signer::QrCode::QrErr::QrErr(const ustr& reason)
+  :Error(ustr::format("QR code: {}", reason))
+{}
+
+/* ***************************************************************  */
+
+socialmedia_signer::QrCode::QrCode(const std::u8string& payload, Ecc ecc)
+  noexcept(false)
+  :version(0), ecc(ecc), size(0), modules(), is_function()
+{
+  const int e = static_cast<int>(ecc);
+
+  /* Find the smallest version, byte mode: 4 bits mode indicator,
+   * 8 or 16 bits character count and 8 bits per byte.
+   */
+  long data_bits = 0;
+  for (this->version=1; this->version <= 40; this->version++) {
+    const int count_bits = this->version <= 9? 8: 16;
+    data_bits = 4 + count_bits + 8L * payload.length();
+
+    if (payload.length() < (1UL << count_bits)
+        && data_bits <= num_data_codewords(this->version, ecc) * 8L)
+      break;
+  }
+  if (this->version > 40) {
+    throw QrErr(ustr::format(
+      "payload of {} bytes too long for error correction level {}!",
+      payload.length(), "LMQH"[e]));
+  }
+
+  const long capacity_bits = num_data_codewords(this->version, ecc) * 8L;
+  const int  count_bits    = this->version <= 9? 8: 16;
+
+  std::vector<std::uint8_t> data(capacity_bits / 8, 0);
+  long bit = 0;
+  auto append = [&data, &bit](unsigned long value, int len) {
+    for (int i=len-1; i >= 0; i--, bit++)
+      data[bit >> 3] |= ((value >> i) & 1) << (7 - (bit & 7));
+  };
+
+  append(0x4, 4);
+  append(payload.length(), count_bits);
+  for (char8_t ch: payload) append(ch, 8);
+
+  /* Terminator, byte alignment and pad bytes.  */
+  append(0, std::min(4L, capacity_bits - bit));
+  append(0, (8 - bit % 8) % 8);
+  for (std::uint8_t pad = 0xec; bit < capacity_bits; pad ^= 0xec ^ 0x11)
+    append(pad, 8);
+
+  /* Draw everything and choose the mask with the lowest penalty.  */
+  this->size = this->version * 4 + 17;
+  this->modules.assign(this->size * this->size, 0);
+  this->is_function.assign(this->size * this->size, 0);
+
+  this->draw_function_patterns();
+  this->draw_codewords(this->add_ecc_and_interleave(data));
+
+  int  best_mask    = 0;
+  long best_penalty = -1;
+  for (int mask=0; mask < 8; mask++) {
+    this->apply_mask(mask);
+    this->draw_format(mask);
+
+    const long penalty = this->penalty_score();
+    if (best_penalty < 0 || penalty < best_penalty) {
+      best_mask    = mask;
+      best_penalty = penalty;
+    }
+
+    /* XOR, undo  */
+    this->apply_mask(mask);
+  }
+
+  this->apply_mask(best_mask);
+  this->draw_format(best_mask);
+}
+
+socialmedia_signer::QrCode::~QrCode()
+{
+}
+
+/* ***************************************************************  */
+
+int
+socialmedia_signer::QrCode::get_version() const
+{
+  return this->version;
+}
+
+socialmedia_signer::QrCode::Ecc
+socialmedia_signer::QrCode::get_ecc() const
+{
+  return this->ecc;
+}
+
+unsigned
+socialmedia_signer::QrCode::get_size() const
+{
+  return this->size;
+}
+
+bool
+socialmedia_signer::QrCode::get_module(unsigned x, unsigned y) const
+{
+  return this->modules[y * this->size + x] != 0;
+}
+
+std::size_t
+socialmedia_signer::QrCode::get_memsize() const
+{
+  return sizeof(QrCode) + this->modules.capacity()
+    + this->is_function.capacity();
+}
+
+/* ***************************************************************  */
+
+int
+socialmedia_signer::QrCode::num_raw_data_modules(int version)
+{
+  int result = (16 * version + 128) * version + 64;
+
+  if (version >= 2) {
+    const int num_align = version / 7 + 2;
+    result -= (25 * num_align - 10) * num_align - 55;
+
+    if (version >= 7) result -= 36;
+  }
+
+  return result;
+}
+
+int
+socialmedia_signer::QrCode::num_data_codewords(int version, Ecc ecc)
+{
+  const int e = static_cast<int>(ecc);
+
+  return num_raw_data_modules(version) / 8
+    - QRCODE_ECC_CODEWORDS_PER_BLOCK[e][version]
+    * QRCODE_NUM_ERROR_CORRECTION_BLOCKS[e][version];
+}
+
+/* ---------------------------------------------------------------  */
+
+std::uint8_t
+socialmedia_signer::QrCode::rs_multiply(std::uint8_t x, std::uint8_t y)
+{
+  /* Russian peasant multiplication in GF(2^8/0x11d).  */
+  int z = 0;
+  for (int i=7; i >= 0; i--) {
+    z = (z << 1) ^ ((z >> 7) * 0x11d);
+    z ^= ((y >> i) & 1) * x;
+  }
+
+  return static_cast<std::uint8_t>(z);
+}
+
+std::vector<std::uint8_t>
+socialmedia_signer::QrCode::rs_divisor(int degree)
+{
+  std::vector<std::uint8_t> result(degree, 0);
+  result[degree - 1] = 1;
+
+  std::uint8_t root = 1;
+  for (int i=0; i < degree; i++) {
+    for (std::size_t j=0; j < result.size(); j++) {
+      result[j] = rs_multiply(result[j], root);
+      if (j + 1 < result.size()) result[j] ^= result[j + 1];
+    }
+    root = rs_multiply(root, 0x02);
+  }
+
+  return result;
+}
+
+std::vector<std::uint8_t>
+socialmedia_signer::QrCode::rs_remainder(
+  const std::vector<std::uint8_t>& data,
+  const std::vector<std::uint8_t>& divisor)
+{
+  std::vector<std::uint8_t> result(divisor.size(), 0);
+
+  for (std::uint8_t b: data) {
+    const std::uint8_t factor = b ^ result[0];
+
+    result.erase(result.begin());
+    result.push_back(0);
+
+    for (std::size_t i=0; i < result.size(); i++)
+      result[i] ^= rs_multiply(divisor[i], factor);
+  }
+
+  return result;
+}
+
+/* ***************************************************************  */
+
+void
+socialmedia_signer::QrCode::set_function(unsigned x, unsigned y,
+                                         bool dark)
+{
+  this->modules[y * this->size + x]     = dark? 1: 0;
+  this->is_function[y * this->size + x] = 1;
+}
+
+void
+socialmedia_signer::QrCode::draw_function_patterns()
+{
+  const int size = this->size;
+
+  /* Timing patterns  */
+  for (int i=0; i < size; i++) {
+    this->set_function(6, i, i % 2 == 0);
+    this->set_function(i, 6, i % 2 == 0);
+  }
+
+  this->draw_finder(3, 3);
+  this->draw_finder(size - 4, 3);
+  this->draw_finder(3, size - 4);
+
+  /* Alignment patterns, not overlapping the finders.  */
+  if (this->version >= 2) {
+    const int num_align = this->version / 7 + 2;
+    const int step = (this->version * 8 + num_align * 3 + 5)
+      / (num_align * 4 - 4) * 2;
+
+    std::vector<int> pos(num_align);
+    pos[0] = 6;
+    for (int i=num_align-1, p=size-7; i >= 1; i--, p-=step) pos[i] = p;
+
+    for (int i=0; i < num_align; i++) {
+      for (int j=0; j < num_align; j++) {
+        if ((i == 0 && j == 0) || (i == 0 && j == num_align - 1)
+            || (i == num_align - 1 && j == 0)) continue;
+
+        this->draw_alignment(pos[i], pos[j]);
+      }
+    }
+  }
+
+  /* Reserve the format area, drawn with the mask later.  */
+  this->draw_format(0);
+  this->draw_version();
+}
+
+void
+socialmedia_signer::QrCode::draw_finder(int x, int y)
+{
+  const int size = this->size;
+
+  for (int dy=-4; dy <= 4; dy++) {
+    for (int dx=-4; dx <= 4; dx++) {
+      const int dist = std::max(std::abs(dx), std::abs(dy));
+      const int xx = x + dx, yy = y + dy;
+
+      if (xx >= 0 && xx < size && yy >= 0 && yy < size)
+        this->set_function(xx, yy, dist != 2 && dist != 4);
+    }
+  }
+}
+
+void
+socialmedia_signer::QrCode::draw_alignment(int x, int y)
+{
+  for (int dy=-2; dy <= 2; dy++) {
+    for (int dx=-2; dx <= 2; dx++)
+      this->set_function(x + dx, y + dy,
+                         std::max(std::abs(dx), std::abs(dy)) != 1);
+  }
+}
+
+void
+socialmedia_signer::QrCode::draw_format(int mask)
+{
+  const int size = this->size;
+
+  /* BCH(15,5) code  */
+  const int data
+    = QRCODE_ECC_FORMAT_BITS[static_cast<int>(this->ecc)] << 3 | mask;
+  int rem = data;
+  for (int i=0; i < 10; i++) rem = (rem << 1) ^ ((rem >> 9) * 0x537);
+  const int bits = (data << 10 | rem) ^ 0x5412;
+
+  /* First copy, around the top left finder.  */
+  for (int i=0; i <= 5; i++) this->set_function(8, i, _get_bit(bits, i));
+  this->set_function(8, 7, _get_bit(bits, 6));
+  this->set_function(8, 8, _get_bit(bits, 7));
+  this->set_function(7, 8, _get_bit(bits, 8));
+  for (int i=9; i < 15; i++)
+    this->set_function(14 - i, 8, _get_bit(bits, i));
+
+  /* Second copy, split to the other finders.  */
+  for (int i=0; i < 8; i++)
+    this->set_function(size - 1 - i, 8, _get_bit(bits, i));
+  for (int i=8; i < 15; i++)
+    this->set_function(8, size - 15 + i, _get_bit(bits, i));
+
+  /* Always dark  */
+  this->set_function(8, size - 8, true);
+}
+
+void
+socialmedia_signer::QrCode::draw_version()
+{
+  if (this->version < 7) return;
+
+  /* BCH(18,6) code  */
+  long rem = this->version;
+  for (int i=0; i < 12; i++) rem = (rem << 1) ^ ((rem >> 11) * 0x1f25);
+  const long bits = (long) this->version << 12 | rem;
+
+  for (int i=0; i < 18; i++) {
+    const bool bit = _get_bit(bits, i);
+    const int a = this->size - 11 + i % 3;
+    const int b = i / 3;
+
+    this->set_function(a, b, bit);
+    this->set_function(b, a, bit);
+  }
+}
+
+/* ---------------------------------------------------------------  */
+
+std::vector<std::uint8_t>
+socialmedia_signer::QrCode::add_ecc_and_interleave(
+  const std::vector<std::uint8_t>& data) const
+{
+  const int e = static_cast<int>(this->ecc);
+
+  const int num_blocks = QRCODE_NUM_ERROR_CORRECTION_BLOCKS[e][this->version];
+  const int block_ecc_len = QRCODE_ECC_CODEWORDS_PER_BLOCK[e][this->version];
+  const int raw_codewords = num_raw_data_modules(this->version) / 8;
+  const int num_short_blocks = num_blocks - raw_codewords % num_blocks;
+  const int short_block_len  = raw_codewords / num_blocks;
+
+  const std::vector<std::uint8_t> divisor = rs_divisor(block_ecc_len);
+
+  /* Split into blocks, short blocks get a dummy byte for alignment
+   * which is skipped during interleaving.
+   */
+  std::vector<std::vector<std::uint8_t>> blocks;
+  for (int i=0, k=0; i < num_blocks; i++) {
+    const int len = short_block_len - block_ecc_len
+      + (i < num_short_blocks? 0: 1);
+
+    std::vector<std::uint8_t> block(data.begin() + k,
+                                    data.begin() + k + len);
+    k += len;
+
+    const std::vector<std::uint8_t> ecc = rs_remainder(block, divisor);
+    if (i < num_short_blocks) block.push_back(0);
+    block.insert(block.end(), ecc.begin(), ecc.end());
+
+    blocks.push_back(std::move(block));
+  }
+
+  std::vector<std::uint8_t> result;
+  result.reserve(raw_codewords);
+  for (std::size_t i=0; i < blocks[0].size(); i++) {
+    for (int j=0; j < num_blocks; j++) {
+      if ((int) i != short_block_len - block_ecc_len
+          || j >= num_short_blocks)
+        result.push_back(blocks[j][i]);
+    }
+  }
+
+  return result;
+}
+
+void
+socialmedia_signer::QrCode::draw_codewords(
+  const std::vector<std::uint8_t>& codewords)
+{
+  const int size = this->size;
+  const std::size_t num_bits = codewords.size() * 8;
+
+  /* Zig-zag in pairs of columns from the bottom right, skipping the
+   * vertical timing pattern.
+   */
+  std::size_t i = 0;
+  for (int right=size-1; right >= 1; right-=2) {
+    if (right == 6) right = 5;
+
+    for (int vert=0; vert < size; vert++) {
+      for (int j=0; j < 2; j++) {
+        const int x = right - j;
+        const bool upward = ((right + 1) & 2) == 0;
+        const int y = upward? size - 1 - vert: vert;
+
+        if (this->is_function[y * size + x] || i >= num_bits) continue;
+
+        this->modules[y * size + x]
+          = _get_bit(codewords[i >> 3], 7 - (i & 7))? 1: 0;
+        i++;
+      }
+    }
+  }
+}
+
+/* ---------------------------------------------------------------  */
+
+void
+socialmedia_signer::QrCode::apply_mask(int mask)
+{
+  const int size = this->size;
+
+  for (int y=0; y < size; y++) {
+    for (int x=0; x < size; x++) {
+      bool invert;
+      switch (mask) {
+      case 0:  invert = (x + y) % 2 == 0;                     break;
+      case 1:  invert = y % 2 == 0;                           break;
+      case 2:  invert = x % 3 == 0;                           break;
+      case 3:  invert = (x + y) % 3 == 0;                     break;
+      case 4:  invert = (x / 3 + y / 2) % 2 == 0;             break;
+      case 5:  invert = x * y % 2 + x * y % 3 == 0;           break;
+      case 6:  invert = (x * y % 2 + x * y % 3) % 2 == 0;     break;
+      default: invert = ((x + y) % 2 + x * y % 3) % 2 == 0;   break;
+      }
+
+      if (invert && !this->is_function[y * size + x])
+        this->modules[y * size + x] ^= 1;
+    }
+  }
+}
+
+long
+socialmedia_signer::QrCode::penalty_score() const
+{
+  const int size = this->size;
+  long result = 0;
+
+  auto module = [this, size](int x, int y) -> int {
+    return this->modules[y * size + x];
+  };
+
+  /* N1: runs of 5+ same colored modules, N3: finder like patterns
+   * 1:1:3:1:1 with 4 light modules on one side.
+   */
+  static const int FINDER_LIKE[2][11] = {
+    {1, 0, 1, 1, 1, 0, 1, 0, 0, 0, 0},
+    {0, 0, 0, 0, 1, 0, 1, 1, 1, 0, 1}
+  };
+
+  for (int horizontal=0; horizontal < 2; horizontal++) {
+    for (int a=0; a < size; a++) {
+      int run = 1;
+      for (int b=0; b < size; b++) {
+        const int cur = horizontal? module(b, a): module(a, b);
+
+        if (b > 0) {
+          const int prev = horizontal? module(b - 1, a): module(a, b - 1);
+          if (cur == prev) {
+            run++;
+            if (run == 5) result += 3;
+            else if (run > 5) result++;
+          } else {
+            run = 1;
+          }
+        }
+
+        if (b + 11 > size) continue;
+        for (const int* pattern: FINDER_LIKE) {
+          int k;
+          for (k=0; k < 11; k++) {
+            const int m = horizontal? module(b + k, a): module(a, b + k);
+            if (m != pattern[k]) break;
+          }
+          if (k == 11) result += 40;
+        }
+      }
+    }
+  }
+
+  /* N2: 2x2 blocks of same color  */
+  for (int y=0; y < size - 1; y++) {
+    for (int x=0; x < size - 1; x++) {
+      const int c = module(x, y);
+      if (c == module(x + 1, y) && c == module(x, y + 1)
+          && c == module(x + 1, y + 1)) result += 3;
+    }
+  }
+
+  /* N4: balance of dark modules, 10 points per 5% deviation  */
+  long dark = 0;
+  for (std::uint8_t m: this->modules) dark += m;
+  const long total = (long) size * size;
+  const long k = (std::abs(dark * 20 - total * 10) + total - 1) / total - 1;
+  result += std::max(0L, k) * 10;
+
+  return result;
+}
+
+/* ***************************************************************  */
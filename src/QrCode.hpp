@@ -0,0 +1,99 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef QRCODE_HPP__
+#define QRCODE_HPP__
+
+#include "common.hpp"
+
+#include <vector>
+#include <cstdint>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/**
+ * QR Code Model 2 module matrix (ISO/IEC 18004), byte mode only.
+ * The smallest version 1 ... 40 which fits the payload is choosen.
+ */
+class QrCode
+{
+public:
+
+  class QrErr: public Error { public: QrErr(const ustr& reason); };
+
+  /** Error correction level, recovers ~7%, ~15%, ~25%, ~30%.  */
+  enum class Ecc { LOW, MEDIUM, QUARTILE, HIGH };
+
+  explicit QrCode(const std::u8string& payload, Ecc ecc)
+    noexcept(false);
+  virtual ~QrCode();
+
+  virtual int get_version() const;
+  virtual Ecc get_ecc() const;
+
+  /** Modules per side, without quiet zone.  */
+  virtual unsigned get_size() const;
+
+  /** Returns `true` for a dark module.  */
+  virtual bool get_module(unsigned x, unsigned y) const;
+
+  /** Bytes of heap memory, used for cache accounting.  */
+  virtual std::size_t get_memsize() const;
+
+private:
+  static int num_raw_data_modules(int version);
+  static int num_data_codewords(int version, Ecc ecc);
+
+  static std::uint8_t rs_multiply(std::uint8_t x, std::uint8_t y);
+  static std::vector<std::uint8_t> rs_divisor(int degree);
+  static std::vector<std::uint8_t> rs_remainder(
+    const std::vector<std::uint8_t>& data,
+    const std::vector<std::uint8_t>& divisor);
+
+  void set_function(unsigned x, unsigned y, bool dark);
+
+  void draw_function_patterns();
+  void draw_finder(int x, int y);
+  void draw_alignment(int x, int y);
+  void draw_format(int mask);
+  void draw_version();
+
+  std::vector<std::uint8_t> add_ecc_and_interleave(
+    const std::vector<std::uint8_t>& data) const;
+  void draw_codewords(const std::vector<std::uint8_t>& codewords);
+
+  void apply_mask(int mask);
+  long penalty_score() const;
+
+  int version;
+  Ecc ecc;
+  unsigned size;
+
+  /** Row by row, `1` is a dark module.  */
+  std::vector<std::uint8_t> modules;
+  /** Finder, timing, alignment, format and version modules.  */
+  std::vector<std::uint8_t> is_function;
+};
+
+}
+
+/* ***************************************************************  */
+
+#endif /* QRCODE_HPP__  */
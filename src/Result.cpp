@@ -0,0 +1,53 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "common.hpp"
+
+/* ***************************************************************  */
+
+socialmedia_signer::Failure::Failure(ustr8&& reason, int exit_code)
+  :reason(std::move(reason)), exit_code(exit_code), error()
+{
+}
+
+socialmedia_signer::Failure::~Failure()
+{}
+
+/* ***************************************************************  */
+
+const socialmedia_signer::ustr8&
+socialmedia_signer::Failure::get_reason() const noexcept
+{
+  return this->reason;
+}
+
+int
+socialmedia_signer::Failure::get_exit_code() const noexcept
+{
+  return this->exit_code;
+}
+
+void
+socialmedia_signer::Failure::raise() const noexcept(false)
+{
+  if (this->error) std::rethrow_exception(this->error);
+
+  throw Error(this->reason.to_ustr(), this->exit_code);
+}
+
+/* ***************************************************************  */
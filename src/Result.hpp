@@ -0,0 +1,216 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef RESULT_HPP__
+#define RESULT_HPP__
+
+#include "Error.hpp"
+
+#include "common.hpp"
+
+#include <optional>
+#include <variant>
+#include <utility>
+#include <concepts>
+#include <exception>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/**
+ * Reason why an operation which returns a socialmedia_signer::Result
+ * failed.  Unlike socialmedia_signer::Error it is never thrown, the
+ * UTF-8 reason is formatted once and just moved to the caller.
+ */
+class Failure
+{
+public:
+  explicit Failure(ustr8&& reason, int exit_code = 1);
+  /**
+   * Takes reason and exit code of `error`, which is not thrown here
+   * but kept, so Failure::raise() throws it with its type `E`.
+   */
+  template<std::derived_from<Error> E>
+  explicit Failure(const E& error)
+    :reason(error.uwhat()), exit_code(error.get_exit_code()),
+     error(std::make_exception_ptr(error))
+  {}
+  virtual ~Failure();
+
+  Failure(const Failure& other) = default;
+  Failure(Failure&& other) noexcept = default;
+  Failure& operator=(const Failure& other) = default;
+  Failure& operator=(Failure&& other) noexcept = default;
+
+  virtual const ustr8& get_reason() const noexcept;
+  virtual int get_exit_code() const noexcept;
+
+  /**
+   * Throws the failure where the caller is at the CLI boundary and
+   * exceptions are fine, as the Error it was constructed from or as
+   * socialmedia_signer::Error.
+   */
+  [[noreturn]] virtual void raise() const noexcept(false);
+
+private:
+  ustr8 reason;
+  int exit_code;
+
+  /** Error of the constructor, if any.  */
+  std::exception_ptr error;
+};
+
+/* ***************************************************************  */
+
+/**
+ * Value of type `T` or a socialmedia_signer::Failure, returned
+ * instead of throwing where failing is an expected outcome, i.e. the
+ * verification of a foreign image:
+ * ```cpp
+ *   Result<std::unique_ptr<Image>> image
+ *     = Image::open_for_verify(path);
+ *   if (!image) return report(image.error().get_reason());
+ *
+ *   (*image)->estimate_qr_module();
+ * ```
+ * Result::value() throws the failure, so call sites which handle
+ * errors by exceptions anyway just append `.value()`.
+ */
+template<typename T>
+class Result
+{
+public:
+  Result(const T& value): data(std::in_place_index<0>, value) {}
+  Result(T&& value): data(std::in_place_index<0>, std::move(value)) {}
+  Result(Failure&& failure)
+    :data(std::in_place_index<1>, std::move(failure)) {}
+
+  inline bool has_value() const noexcept
+  {
+    return this->data.index() == 0;
+  }
+
+  inline explicit operator bool() const noexcept
+  {
+    return this->has_value();
+  }
+
+  /** Throws the failure, if any.  */
+  inline T& value() & noexcept(false)
+  {
+    if (!this->has_value()) this->error().raise();
+    return *std::get_if<0>(&this->data);
+  }
+
+  inline const T& value() const & noexcept(false)
+  {
+    if (!this->has_value()) this->error().raise();
+    return *std::get_if<0>(&this->data);
+  }
+
+  inline T&& value() && noexcept(false)
+  {
+    if (!this->has_value()) this->error().raise();
+    return std::move(*std::get_if<0>(&this->data));
+  }
+
+  /** Unchecked, call Result::has_value() before.  */
+  inline T& operator*() noexcept
+  {
+    return *std::get_if<0>(&this->data);
+  }
+
+  inline const T& operator*() const noexcept
+  {
+    return *std::get_if<0>(&this->data);
+  }
+
+  inline T* operator->() noexcept
+  {
+    return std::get_if<0>(&this->data);
+  }
+
+  inline const T* operator->() const noexcept
+  {
+    return std::get_if<0>(&this->data);
+  }
+
+  /** Unchecked, call Result::has_value() before.  */
+  inline const Failure& error() const & noexcept
+  {
+    return *std::get_if<1>(&this->data);
+  }
+
+  /** Passes the failure on, i.e. `return std::move(r).error();`.  */
+  inline Failure&& error() && noexcept
+  {
+    return std::move(*std::get_if<1>(&this->data));
+  }
+
+private:
+  std::variant<T, Failure> data;
+};
+
+/**
+ * Success or a socialmedia_signer::Failure, for operations without a
+ * value.  A default constructed Result<void> is the success.
+ */
+template<>
+class Result<void>
+{
+public:
+  Result(): failure() {}
+  Result(Failure&& failure): failure(std::move(failure)) {}
+
+  inline bool has_value() const noexcept
+  {
+    return !this->failure.has_value();
+  }
+
+  inline explicit operator bool() const noexcept
+  {
+    return this->has_value();
+  }
+
+  /** Throws the failure, if any.  */
+  inline void value() const noexcept(false)
+  {
+    if (!this->has_value()) this->failure->raise();
+  }
+
+  /** Unchecked, call Result::has_value() before.  */
+  inline const Failure& error() const & noexcept
+  {
+    return *this->failure;
+  }
+
+  inline Failure&& error() && noexcept
+  {
+    return std::move(*this->failure);
+  }
+
+private:
+  std::optional<Failure> failure;
+};
+
+}
+
+/* ***************************************************************  */
+
+#endif /* RESULT_HPP__  */
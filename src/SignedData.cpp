@@ -20,9 +20,25 @@
 
 /* ***************************************************************  */
 
+/* Bottom right corner, 512x512 pixels including the quiet zone.  */
+const socialmedia_signer::Image::Region
+socialmedia_signer::SignedData::DEFAULT_PLACEMENT
+  = {Image::Corner::BOTTOM_RIGHT, 0, 0, 512, 512};
+
+/* ***************************************************************  */
+
+socialmedia_signer::SignedData::SignedData(
+  const std::u8string& signed_msg, const Image* signature,
+  const Image::Region& placement)
+  :message(signed_msg), signature(signature), placement(placement),
+   qr(nullptr)
+{
+}
+
 socialmedia_signer::SignedData::SignedData(
-  const std::u8string& signed_msg, const Image* signature)
-  :message(signed_msg), signature(signature)
+  const ustr8& signed_msg, const Image* signature,
+  const Image::Region& placement)
+  :SignedData(signed_msg.str(), signature, placement)
 {
 }
 
@@ -31,18 +47,35 @@ socialmedia_signer::SignedData::~SignedData()
   delete this->signature;
 }
 
+const socialmedia_signer::Image::Region&
+socialmedia_signer::SignedData::get_placement() const
+{
+  return this->placement;
+}
+
+const socialmedia_signer::Image*
+socialmedia_signer::SignedData::get_qr() const
+{
+  return this->qr.get();
+}
+
 /* ***************************************************************  */
 
 void
 socialmedia_signer::SignedData::sign() noexcept(false)
 {
   // TODO: Call Crypto layer
+
+  // TODO: Payload is the signature, as soon as Crypto signs
+  this->qr = Image::render_qr(this->message);
 }
 
-void
+socialmedia_signer::Result<void>
 socialmedia_signer::SignedData::verify() const noexcept(false)
 {
   // TODO: Call Crypto layer
+
+  return Result<void>();
 }
 
 /* ***************************************************************  */
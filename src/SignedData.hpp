@@ -35,14 +35,34 @@ namespace socialmedia_signer {
 class SignedData
 {
 public:
+  /**
+   * Where the signer composes the QR signature into the posted image.
+   * The verifier decodes just this Image::Region.
+   */
+  static const Image::Region DEFAULT_PLACEMENT;
+
   explicit SignedData(
-    const std::u8string& signed_msg, const Image* signature);
+    const std::u8string& signed_msg, const Image* signature,
+    const Image::Region& placement = DEFAULT_PLACEMENT);
+  /** Takes the bytes of `signed_msg` as they are.  */
+  explicit SignedData(
+    const ustr8& signed_msg, const Image* signature,
+    const Image::Region& placement = DEFAULT_PLACEMENT);
   virtual ~SignedData();
 
+  virtual const Image::Region& get_placement() const;
+
+  /** Rendered QR signature, `nullptr` before SignedData::sign().  */
+  virtual const Image* get_qr() const;
+
   // TODO: Comment: Throws an Crypto exception.
   virtual void sign() noexcept(false);
-  // TODO: Comment: Throws an Crypto exception.
-  virtual void verify() const noexcept(false);
+  /**
+   * Returns a Failure if the signature does not match the message.
+   * An invalid signature is an expected outcome, so nothing is
+   * thrown.
+   */
+  virtual Result<void> verify() const noexcept(false);
 
 private:
   /**
@@ -52,6 +72,12 @@ private:
    */
   const std::u8string message;
   const Image* signature;
+
+  /** Placement of the QR signature within the posted image.  */
+  const Image::Region placement;
+
+  /** Owned by QrCache and this, may be shared with other posts.  */
+  std::shared_ptr<const Image> qr;
 };
 
 }
@@ -0,0 +1,265 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "Trace.hpp"
+
+#include "common.hpp"
+
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <format>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+struct trace_event {
+  const char* name;
+  const char* category;
+  std::int64_t start_ns;
+  std::int64_t duration_ns;
+
+  /** In trace_thread::details, `detail_len` 0 if none.  */
+  std::size_t detail_pos;
+  std::size_t detail_len;
+};
+
+/** Buffer of one thread, written by this thread only.  */
+struct trace_thread {
+  pid_t tid;
+  const char* name;
+
+  std::vector<trace_event> events;
+  /** Details of all events, UTF-8 without separator.  */
+  std::string details;
+};
+
+/**
+ * Protects `_trace_threads`, but not their content, which is read by
+ * Trace::release() after the threads stopped tracing.  Buffers stay
+ * here after their thread exited.
+ */
+static std::mutex _trace_mutex;
+static std::vector<std::unique_ptr<trace_thread>> _trace_threads;
+
+static thread_local trace_thread* _trace_thread = nullptr;
+
+static std::string _trace_path;
+static int _trace_fd = -1;
+static Trace::clock::time_point _trace_epoch;
+
+static trace_thread&
+_trace_get_thread()
+{
+  if (_trace_thread == nullptr) {
+    auto thread = std::make_unique<trace_thread>();
+    thread->tid = static_cast<pid_t>(::syscall(SYS_gettid));
+    thread->name = nullptr;
+    thread->events.reserve(1024);
+
+    _trace_thread = thread.get();
+
+    std::lock_guard<std::mutex> lock(_trace_mutex);
+    _trace_threads.push_back(std::move(thread));
+  }
+
+  return *_trace_thread;
+}
+
+static void
+_trace_json(std::string& out, std::string_view str)
+{
+  out += '"';
+  for (const char c: str) {
+    switch (c) {
+    case '"':  out += "\\\""; break;
+    case '\\': out += "\\\\"; break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20)
+        std::format_to(std::back_inserter(out), "\\u{:04x}",
+                       static_cast<unsigned>(c));
+      else
+        out += c;
+    }
+  }
+  out += '"';
+}
+
+static void
+_trace_write_all(int fd, std::string_view data)
+{
+  while (!data.empty()) {
+    const ssize_t written = ::write(fd, data.data(), data.length());
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      Log::warn("--trace '{}': {}", _trace_path, std::strerror(errno));
+      return;
+    }
+    data.remove_prefix(written);
+  }
+}
+
+} /* namespace socialmedia_signer  */
+
+/* ***************************************************************  */
+
+std::atomic<bool> socialmedia_signer::Trace::enabled(false);
+
+/* ---------------------------------------------------------------  */
+
+socialmedia_signer::Trace::Span::Span(const char* name,
+                                      const char* category)
+  :Span(name, category, std::string_view())
+{
+}
+
+socialmedia_signer::Trace::Span::Span(const char* name,
+  const char* category, std::string_view detail)
+  :name(name), category(category), detail(detail),
+   start(clock::now())
+{
+  FlightRecorder::record(FlightRecorder::Kind::BEGIN, name, 0, detail,
+                         this->start);
+}
+
+socialmedia_signer::Trace::Span::~Span()
+{
+  const clock::time_point end = clock::now();
+  FlightRecorder::record(FlightRecorder::Kind::END, this->name,
+    std::chrono::duration_cast<std::chrono::nanoseconds>(
+      end - this->start).count(), this->detail, end);
+
+  Trace::complete(this->name, this->category, this->start,
+                  this->detail);
+}
+
+/* ***************************************************************  */
+
+void
+socialmedia_signer::Trace::init(const ustr& path,
+  clock::time_point epoch) noexcept(false)
+{
+  if (Trace::is_enabled())
+    Log::fatal(u8"Trace::init(): double call!");
+
+  _trace_path = path.utf8_scratch();
+  _trace_fd = ::open(_trace_path.c_str(),
+                     O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (_trace_fd < 0) {
+    throw Error(ustr::format("--trace '{}': {}", path,
+                             std::strerror(errno)));
+  }
+
+  _trace_epoch = epoch;
+  Trace::enabled.store(true, std::memory_order_relaxed);
+
+  Trace::name_thread("main");
+}
+
+void
+socialmedia_signer::Trace::release()
+{
+  if (!Trace::is_enabled()) return;
+  Trace::enabled.store(false, std::memory_order_relaxed);
+
+  const pid_t pid = ::getpid();
+  std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  const char* separator = "\n";
+
+  std::lock_guard<std::mutex> lock(_trace_mutex);
+
+  for (const auto& thread: _trace_threads) {
+    if (thread->name != nullptr) {
+      std::format_to(std::back_inserter(out),
+        "{}{{\"ph\":\"M\",\"pid\":{},\"tid\":{},"
+        "\"name\":\"thread_name\",\"args\":{{\"name\":\"{}\"}}}}",
+        separator, pid, thread->tid, thread->name);
+      separator = ",\n";
+    }
+
+    for (const trace_event& event: thread->events) {
+      std::format_to(std::back_inserter(out),
+        "{}{{\"ph\":\"X\",\"pid\":{},\"tid\":{},\"name\":\"{}\","
+        "\"cat\":\"{}\",\"ts\":{:.3f},\"dur\":{:.3f}", separator,
+        pid, thread->tid, event.name, event.category,
+        event.start_ns / 1000.0, event.duration_ns / 1000.0);
+      separator = ",\n";
+
+      if (event.detail_len > 0) {
+        out += ",\"args\":{\"detail\":";
+        _trace_json(out, std::string_view(thread->details)
+                    .substr(event.detail_pos, event.detail_len));
+        out += '}';
+      }
+      out += '}';
+    }
+
+    /* Flush big traces early.  */
+    if (out.length() > (1UL << 20)) {
+      _trace_write_all(_trace_fd, out);
+      out.clear();
+    }
+  }
+  out += "\n]}\n";
+  _trace_write_all(_trace_fd, out);
+
+  ::close(_trace_fd);
+  _trace_fd = -1;
+}
+
+/* ---------------------------------------------------------------  */
+
+void
+socialmedia_signer::Trace::complete(const char* name,
+  const char* category, clock::time_point start, std::string_view detail)
+{
+  if (!Trace::is_enabled()) return;
+
+  const clock::time_point end = clock::now();
+  trace_thread& thread = _trace_get_thread();
+
+  const std::size_t detail_pos = thread.details.length();
+  thread.details += detail;
+
+  thread.events.push_back({name, category,
+    std::chrono::duration_cast<std::chrono::nanoseconds>(
+      start - _trace_epoch).count(),
+    std::chrono::duration_cast<std::chrono::nanoseconds>(
+      end - start).count(),
+    detail_pos, detail.length()});
+}
+
+void
+socialmedia_signer::Trace::name_thread(const char* name)
+{
+  FlightRecorder::name_thread(name);
+  if (!Trace::is_enabled()) return;
+
+  _trace_get_thread().name = name;
+}
+
+/* ***************************************************************  */
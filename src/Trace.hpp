@@ -0,0 +1,114 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TRACE_HPP__
+#define TRACE_HPP__
+
+#include "ustr.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <string_view>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/**
+ * Abstract class which includes static methods for tracing nested
+ * spans of the program, written as Chrome trace events.  The file
+ * can be opened in https://ui.perfetto.dev or `chrome://tracing`.
+ *
+ * A span lasts from the construction to the destruction of a
+ * Trace::Span:
+ * ```cpp
+ *   Trace::Span span("decode", "image");
+ * ```
+ * Spans of a thread nest by their time, so they show up as a call
+ * tree per thread.  `name` and `category` need to be string literals,
+ * a `detail` needs to live as long as its span.
+ *
+ * Each thread appends its spans to its own buffer, without locking,
+ * and all buffers are written by Trace::release().  Before
+ * Trace::init() a span is recorded just by the FlightRecorder, which
+ * is always on.
+ */
+class Trace
+{
+public:
+  /* Abstract class  */
+  Trace()             = delete;
+  Trace(Trace& other) = delete;
+  virtual ~Trace()    = 0;
+
+  using clock = std::chrono::steady_clock;
+
+  class Span
+  {
+  public:
+    Span(const char* name, const char* category);
+    /** With a `detail` shown as argument, i.e. a file name.  */
+    Span(const char* name, const char* category,
+         std::string_view detail);
+    ~Span();
+
+    Span(Span& other) = delete;
+
+  private:
+    const char* name;
+    const char* category;
+    std::string_view detail;
+
+    const clock::time_point start;
+  };
+
+  /* -------------------------------------------------------------  */
+
+  /**
+   * Starts tracing into the file `path`, which is created here.
+   * Timestamps count from `epoch`, which may be before this call.
+   */
+  static void init(const ustr& path,
+                   clock::time_point epoch = clock::now())
+    noexcept(false);
+
+  /** Writes the file and stops tracing.  */
+  static void release();
+
+  static inline bool is_enabled()
+  {
+    return Trace::enabled.load(std::memory_order_relaxed);
+  }
+
+  /** Adds a span which started at `start` and ends now.  */
+  static void complete(const char* name, const char* category,
+                       clock::time_point start,
+                       std::string_view detail = {});
+
+  /** Names the calling thread in the trace, `name` is a literal.  */
+  static void name_thread(const char* name);
+
+private:
+  static std::atomic<bool> enabled;
+};
+
+}
+
+/* ***************************************************************  */
+
+#endif /* TRACE_HPP__  */
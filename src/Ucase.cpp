@@ -0,0 +1,221 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "Ucase.hpp"
+
+#include "UcaseTables.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#  include <immintrin.h>
+#  define UCASE_X86
+#endif
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/** Smallest block of the SIMD kernels, shorter input is scalar.  */
+static constexpr std::size_t UCASE_ASCII_BLOCK = 8;
+
+/** ASCII letters which change, and by how much.  */
+struct UcaseAscii {
+  char32_t first;
+  std::int32_t delta;
+};
+
+static constexpr UcaseAscii UCASE_ASCII_LOWER = {U'A', 'a' - 'A'};
+static constexpr UcaseAscii UCASE_ASCII_UPPER = {U'a', 'A' - 'a'};
+
+#ifdef UCASE_X86
+
+/* The x86-64 baseline always has SSE2, AVX2 is selected at runtime,
+ * like in Utf8.cpp.  Both kernels map whole blocks of ASCII and stop
+ * in front of the first block with a non-ASCII code point.
+ */
+
+static std::size_t
+_ucase_ascii_sse2(char32_t* str, std::size_t len, UcaseAscii ascii)
+{
+  const __m128i non_ascii = _mm_set1_epi32(~0x7f);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i before = _mm_set1_epi32(ascii.first - 1);
+  const __m128i after = _mm_set1_epi32(ascii.first + 26);
+  const __m128i delta = _mm_set1_epi32(ascii.delta);
+
+  std::size_t i = 0;
+  for (; i + 4 <= len; i += 4) {
+    __m128i* cur = reinterpret_cast<__m128i*>(str + i);
+    const __m128i ch = _mm_loadu_si128(cur);
+
+    const __m128i is_ascii
+      = _mm_cmpeq_epi32(_mm_and_si128(ch, non_ascii), zero);
+    if (_mm_movemask_epi8(is_ascii) != 0xffff) break;
+
+    /* ASCII only, so the signed compare is fine.  */
+    const __m128i is_letter = _mm_and_si128(
+      _mm_cmpgt_epi32(ch, before), _mm_cmplt_epi32(ch, after));
+    _mm_storeu_si128(
+      cur, _mm_add_epi32(ch, _mm_and_si128(is_letter, delta)));
+  }
+
+  return i;
+}
+
+__attribute__((target("avx2"))) static std::size_t
+_ucase_ascii_avx2(char32_t* str, std::size_t len, UcaseAscii ascii)
+{
+  const __m256i non_ascii = _mm256_set1_epi32(~0x7f);
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i before = _mm256_set1_epi32(ascii.first - 1);
+  const __m256i after = _mm256_set1_epi32(ascii.first + 26);
+  const __m256i delta = _mm256_set1_epi32(ascii.delta);
+
+  std::size_t i = 0;
+  for (; i + 8 <= len; i += 8) {
+    __m256i* cur = reinterpret_cast<__m256i*>(str + i);
+    const __m256i ch = _mm256_loadu_si256(cur);
+
+    const __m256i is_ascii
+      = _mm256_cmpeq_epi32(_mm256_and_si256(ch, non_ascii), zero);
+    if (_mm256_movemask_epi8(is_ascii) != -1) break;
+
+    const __m256i is_letter = _mm256_and_si256(
+      _mm256_cmpgt_epi32(ch, before), _mm256_cmpgt_epi32(after, ch));
+    _mm256_storeu_si256(
+      cur, _mm256_add_epi32(ch, _mm256_and_si256(is_letter, delta)));
+  }
+
+  return i;
+}
+
+static bool
+_ucase_detect_avx2()
+{
+  /* May run before the CPU model of libgcc is initialized.  */
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+/* Zero, i.e. SSE2 only, until the dynamic initialization ran.  */
+static const bool
+_ucase_has_avx2 = _ucase_detect_avx2();
+
+#endif /* UCASE_X86  */
+
+/* ---------------------------------------------------------------  */
+
+/**
+ * Maps the leading ASCII of `str` block wise, returns the number of
+ * mapped code points.
+ */
+static inline std::size_t
+_ucase_ascii(char32_t* str, std::size_t len, UcaseAscii ascii)
+{
+#ifdef UCASE_X86
+  if (_ucase_has_avx2) return _ucase_ascii_avx2(str, len, ascii);
+  return _ucase_ascii_sse2(str, len, ascii);
+#else
+  (void) str; (void) len; (void) ascii;
+  return 0;
+#endif
+}
+
+template<std::int32_t UcaseRecord::*DELTA> static inline char32_t
+_ucase_map(char32_t ch)
+{
+  if (ch > UCASE_MAX) return ch;
+
+  constexpr char32_t block_mask = (1u << UCASE_BLOCK_SHIFT) - 1;
+  const UcaseRecord& record = ucase_records[
+    ucase_stage2[ucase_stage1[ch >> UCASE_BLOCK_SHIFT]][ch & block_mask]];
+
+  return static_cast<char32_t>(static_cast<std::int32_t>(ch)
+                               + record.*DELTA);
+}
+
+template<std::int32_t UcaseRecord::*DELTA> static void
+_ucase_map(char32_t* str, std::size_t len, UcaseAscii ascii)
+{
+  for (std::size_t i=0; i < len; ) {
+    if (str[i] < 0x80 && len - i >= UCASE_ASCII_BLOCK) {
+      const std::size_t mapped = _ucase_ascii(str + i, len - i, ascii);
+      i += mapped;
+      if (mapped > 0) continue;
+    }
+
+    /* Non-ASCII, or a block which mixes both.  */
+    const std::size_t end = std::min(len, i + UCASE_ASCII_BLOCK);
+    for (; i < end; i++) str[i] = _ucase_map<DELTA>(str[i]);
+  }
+}
+
+} /* namespace socialmedia_signer  */
+
+/* ***************************************************************  */
+
+char32_t
+socialmedia_signer::Ucase::to_lower(char32_t ch) noexcept
+{
+  return _ucase_map<&UcaseRecord::lower>(ch);
+}
+
+char32_t
+socialmedia_signer::Ucase::to_upper(char32_t ch) noexcept
+{
+  return _ucase_map<&UcaseRecord::upper>(ch);
+}
+
+char32_t
+socialmedia_signer::Ucase::fold(char32_t ch) noexcept
+{
+  return _ucase_map<&UcaseRecord::fold>(ch);
+}
+
+/* ---------------------------------------------------------------  */
+
+void
+socialmedia_signer::Ucase::to_lower(char32_t* str, std::size_t len)
+  noexcept
+{
+  _ucase_map<&UcaseRecord::lower>(str, len, UCASE_ASCII_LOWER);
+}
+
+void
+socialmedia_signer::Ucase::to_upper(char32_t* str, std::size_t len)
+  noexcept
+{
+  _ucase_map<&UcaseRecord::upper>(str, len, UCASE_ASCII_UPPER);
+}
+
+void
+socialmedia_signer::Ucase::fold(char32_t* str, std::size_t len) noexcept
+{
+  /* Within ASCII, folding is lower casing.  */
+  _ucase_map<&UcaseRecord::fold>(str, len, UCASE_ASCII_LOWER);
+}
+
+/* ---------------------------------------------------------------  */
+
+const char*
+socialmedia_signer::Ucase::get_unicode_version()
+{
+  return UCASE_UNICODE_VERSION;
+}
@@ -0,0 +1,69 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef UCASE_HPP__
+#define UCASE_HPP__
+
+#include <cstddef>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/**
+ * Abstract class which includes static methods for the simple case
+ * mapping of Unicode, independent of any locale.
+ *
+ * Simple means one code point maps to one code point, so strings keep
+ * their length and can be mapped in place.  Ucase::fold() maps to the
+ * simple case folding of CaseFolding.txt (status C+S), which is meant
+ * for case-insensitive comparison of identifiers such as platform IDs
+ * or host names, it is not for display.
+ *
+ * The mappings are looked up in two-stage tables, generated by
+ * UcaseTables.pl.  Runs of ASCII are mapped 4 (SSE2) or 8 (AVX2, if
+ * the CPU supports it) characters at once.
+ */
+class Ucase
+{
+public:
+  /* Abstract class  */
+  Ucase()             = delete;
+  Ucase(Ucase& other) = delete;
+  virtual ~Ucase()    = 0;
+
+  /* -------------------------------------------------------------  */
+
+  static char32_t to_lower(char32_t ch) noexcept;
+  static char32_t to_upper(char32_t ch) noexcept;
+  static char32_t fold(char32_t ch) noexcept;
+
+  /** Maps `len` code points of `str` in place.  */
+  static void to_lower(char32_t* str, std::size_t len) noexcept;
+  static void to_upper(char32_t* str, std::size_t len) noexcept;
+  static void fold(char32_t* str, std::size_t len) noexcept;
+
+  /** Version of the Unicode Character Database of the tables.  */
+  static const char* get_unicode_version();
+};
+
+}
+
+/* ***************************************************************  */
+
+#endif /* UCASE_HPP__  */
@@ -0,0 +1,935 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/* Generated by UcaseTables.pl, do not edit!
+ *
+ * Simple case mapping of Unicode 14.0.0, included by Ucase.cpp only.
+ */
+
+#ifndef UCASETABLES_HPP__
+#define UCASETABLES_HPP__
+
+#include <cstdint>
+
+namespace socialmedia_signer {
+/* ***************************************************************  */
+
+static constexpr const char* UCASE_UNICODE_VERSION = "14.0.0";
+
+/** Log2 of the code points per block of the second stage.  */
+static constexpr unsigned UCASE_BLOCK_SHIFT = 6;
+
+/** Code points above do not change their case.  */
+static constexpr char32_t UCASE_MAX = 0x1e943;
+
+/** Deltas to the lower case, upper case and case folded code point.  */
+struct UcaseRecord {
+  std::int32_t lower;
+  std::int32_t upper;
+  std::int32_t fold;
+};
+
+static constexpr UcaseRecord ucase_records[] = {
+  {     0,      0,      0},
+  {    32,      0,     32},
+  {     0,    -32,      0},
+  {     0,    743,    775},
+  {     0,    121,      0},
+  {     1,      0,      1},
+  {     0,     -1,      0},
+  {  -199,      0,      0},
+  {     0,   -232,      0},
+  {  -121,      0,   -121},
+  {     0,   -300,   -268},
+  {     0,    195,      0},
+  {   210,      0,    210},
+  {   206,      0,    206},
+  {   205,      0,    205},
+  {    79,      0,     79},
+  {   202,      0,    202},
+  {   203,      0,    203},
+  {   207,      0,    207},
+  {     0,     97,      0},
+  {   211,      0,    211},
+  {   209,      0,    209},
+  {     0,    163,      0},
+  {   213,      0,    213},
+  {     0,    130,      0},
+  {   214,      0,    214},
+  {   218,      0,    218},
+  {   217,      0,    217},
+  {   219,      0,    219},
+  {     0,     56,      0},
+  {     2,      0,      2},
+  {     1,     -1,      1},
+  {     0,     -2,      0},
+  {     0,    -79,      0},
+  {   -97,      0,    -97},
+  {   -56,      0,    -56},
+  {  -130,      0,   -130},
+  { 10795,      0,  10795},
+  {  -163,      0,   -163},
+  { 10792,      0,  10792},
+  {     0,  10815,      0},
+  {  -195,      0,   -195},
+  {    69,      0,     69},
+  {    71,      0,     71},
+  {     0,  10783,      0},
+  {     0,  10780,      0},
+  {     0,  10782,      0},
+  {     0,   -210,      0},
+  {     0,   -206,      0},
+  {     0,   -205,      0},
+  {     0,   -202,      0},
+  {     0,   -203,      0},
+  {     0,  42319,      0},
+  {     0,  42315,      0},
+  {     0,   -207,      0},
+  {     0,  42280,      0},
+  {     0,  42308,      0},
+  {     0,   -209,      0},
+  {     0,   -211,      0},
+  {     0,  10743,      0},
+  {     0,  42305,      0},
+  {     0,  10749,      0},
+  {     0,   -213,      0},
+  {     0,   -214,      0},
+  {     0,  10727,      0},
+  {     0,   -218,      0},
+  {     0,  42307,      0},
+  {     0,  42282,      0},
+  {     0,    -69,      0},
+  {     0,   -217,      0},
+  {     0,    -71,      0},
+  {     0,   -219,      0},
+  {     0,  42261,      0},
+  {     0,  42258,      0},
+  {     0,     84,    116},
+  {   116,      0,    116},
+  {    38,      0,     38},
+  {    37,      0,     37},
+  {    64,      0,     64},
+  {    63,      0,     63},
+  {     0,    -38,      0},
+  {     0,    -37,      0},
+  {     0,    -31,      1},
+  {     0,    -64,      0},
+  {     0,    -63,      0},
+  {     8,      0,      8},
+  {     0,    -62,    -30},
+  {     0,    -57,    -25},
+  {     0,    -47,    -15},
+  {     0,    -54,    -22},
+  {     0,     -8,      0},
+  {     0,    -86,    -54},
+  {     0,    -80,    -48},
+  {     0,      7,      0},
+  {     0,   -116,      0},
+  {   -60,      0,    -60},
+  {     0,    -96,    -64},
+  {    -7,      0,     -7},
+  {    80,      0,     80},
+  {     0,    -80,      0},
+  {    15,      0,     15},
+  {     0,    -15,      0},
+  {    48,      0,     48},
+  {     0,    -48,      0},
+  {  7264,      0,   7264},
+  {     0,   3008,      0},
+  { 38864,      0,      0},
+  {     8,      0,      0},
+  {     0,     -8,     -8},
+  {     0,  -6254,  -6222},
+  {     0,  -6253,  -6221},
+  {     0,  -6244,  -6212},
+  {     0,  -6242,  -6210},
+  {     0,  -6243,  -6211},
+  {     0,  -6236,  -6204},
+  {     0,  -6181,  -6180},
+  {     0,  35266,  35267},
+  { -3008,      0,  -3008},
+  {     0,  35332,      0},
+  {     0,   3814,      0},
+  {     0,  35384,      0},
+  {     0,    -59,    -58},
+  { -7615,      0,  -7615},
+  {     0,      8,      0},
+  {    -8,      0,     -8},
+  {     0,     74,      0},
+  {     0,     86,      0},
+  {     0,    100,      0},
+  {     0,    128,      0},
+  {     0,    112,      0},
+  {     0,    126,      0},
+  {     0,      9,      0},
+  {   -74,      0,    -74},
+  {    -9,      0,     -9},
+  {     0,  -7205,  -7173},
+  {   -86,      0,    -86},
+  {  -100,      0,   -100},
+  {  -112,      0,   -112},
+  {  -128,      0,   -128},
+  {  -126,      0,   -126},
+  { -7517,      0,  -7517},
+  { -8383,      0,  -8383},
+  { -8262,      0,  -8262},
+  {    28,      0,     28},
+  {     0,    -28,      0},
+  {    16,      0,     16},
+  {     0,    -16,      0},
+  {    26,      0,     26},
+  {     0,    -26,      0},
+  {-10743,      0, -10743},
+  { -3814,      0,  -3814},
+  {-10727,      0, -10727},
+  {     0, -10795,      0},
+  {     0, -10792,      0},
+  {-10780,      0, -10780},
+  {-10749,      0, -10749},
+  {-10783,      0, -10783},
+  {-10782,      0, -10782},
+  {-10815,      0, -10815},
+  {     0,  -7264,      0},
+  {-35332,      0, -35332},
+  {-42280,      0, -42280},
+  {     0,     48,      0},
+  {-42308,      0, -42308},
+  {-42319,      0, -42319},
+  {-42315,      0, -42315},
+  {-42305,      0, -42305},
+  {-42258,      0, -42258},
+  {-42282,      0, -42282},
+  {-42261,      0, -42261},
+  {   928,      0,    928},
+  {   -48,      0,    -48},
+  {-42307,      0, -42307},
+  {-35384,      0, -35384},
+  {     0,   -928,      0},
+  {     0, -38864, -38864},
+  {    40,      0,     40},
+  {     0,    -40,      0},
+  {    39,      0,     39},
+  {     0,    -39,      0},
+  {    34,      0,     34},
+  {     0,    -34,      0},
+};
+
+/** Block of ucase_stage2, per code point >> UCASE_BLOCK_SHIFT.  */
+static constexpr std::uint8_t ucase_stage1[] = {
+    0,   1,   2,   3,   4,   5,   6,   7,   8,   9,  10,   0,
+    0,  11,  12,  13,  14,  15,  16,  17,  18,  19,  20,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,  21,  22,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,  23,  24,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,  25,   0,   0,  26,  27,   0,
+   28,  28,  29,  28,  30,  31,  32,  33,   0,   0,   0,   0,
+   34,  35,  36,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,  37,  38,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,  39,  40,  28,  41,
+   42,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,  43,  44,   0,  45,  46,  47,  48,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,  49,  50,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+   51,  52,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,  53,  54,  55,  56,
+    0,  57,  58,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,  59,  60,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,  61,  62,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,  63,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+   64,  65,
+};
+
+/** Index into ucase_records, per code point.  */
+static constexpr std::uint8_t ucase_stage2[][64] = {
+  {
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,
+  },
+  {
+      0,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,
+      1,   1,   1,   0,   0,   0,   0,   0,   0,   2,   2,   2,
+      2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+      2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   0,
+      0,   0,   0,   0,
+  },
+  {
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   3,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,
+  },
+  {
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   0,
+      1,   1,   1,   1,   1,   1,   1,   0,   2,   2,   2,   2,
+      2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+      2,   2,   2,   2,   2,   2,   2,   0,   2,   2,   2,   2,
+      2,   2,   2,   4,
+  },
+  {
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      7,   8,   5,   6,   5,   6,   5,   6,   0,   5,   6,   5,
+      6,   5,   6,   5,
+  },
+  {
+      6,   5,   6,   5,   6,   5,   6,   5,   6,   0,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   9,   5,   6,   5,
+      6,   5,   6,  10,
+  },
+  {
+     11,  12,   5,   6,   5,   6,  13,   5,   6,  14,  14,   5,
+      6,   0,  15,  16,  17,   5,   6,  14,  18,  19,  20,  21,
+      5,   6,  22,   0,  20,  23,  24,  25,   5,   6,   5,   6,
+      5,   6,  26,   5,   6,  26,   0,   0,   5,   6,  26,   5,
+      6,  27,  27,   5,   6,   5,   6,  28,   5,   6,   0,   0,
+      5,   6,   0,  29,
+  },
+  {
+      0,   0,   0,   0,  30,  31,  32,  30,  31,  32,  30,  31,
+     32,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,
+      6,   5,   6,   5,   6,  33,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      0,  30,  31,  32,   5,   6,  34,  35,   5,   6,   5,   6,
+      5,   6,   5,   6,
+  },
+  {
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,  36,   0,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   0,   0,   0,   0,   0,   0,  37,   5,
+      6,  38,  39,  40,
+  },
+  {
+     40,   5,   6,  41,  42,  43,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,  44,  45,  46,  47,  48,   0,  49,  49,
+      0,  50,   0,  51,  52,   0,   0,   0,  49,  53,   0,  54,
+      0,  55,  56,   0,  57,  58,  56,  59,  60,   0,   0,  58,
+      0,  61,  62,   0,   0,  63,   0,   0,   0,   0,   0,   0,
+      0,  64,   0,   0,
+  },
+  {
+     65,   0,  66,  65,   0,   0,   0,  67,  65,  68,  69,  69,
+     70,   0,   0,   0,   0,   0,  71,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,  72,  73,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,
+  },
+  {
+      0,   0,   0,   0,   0,  74,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      5,   6,   5,   6,   0,   0,   5,   6,   0,   0,   0,  24,
+     24,  24,   0,  75,
+  },
+  {
+      0,   0,   0,   0,   0,   0,  76,   0,  77,  77,  77,   0,
+     78,   0,  79,  79,   0,   1,   1,   1,   1,   1,   1,   1,
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   0,   1,
+      1,   1,   1,   1,   1,   1,   1,   1,  80,  81,  81,  81,
+      0,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+      2,   2,   2,   2,
+  },
+  {
+      2,   2,  82,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+     83,  84,  84,  85,  86,  87,   0,   0,   0,  88,  89,  90,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+     91,  92,  93,  94,  95,  96,   0,   5,   6,  97,   5,   6,
+      0,  36,  36,  36,
+  },
+  {
+     98,  98,  98,  98,  98,  98,  98,  98,  98,  98,  98,  98,
+     98,  98,  98,  98,   1,   1,   1,   1,   1,   1,   1,   1,
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,
+      2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+      2,   2,   2,   2,
+  },
+  {
+      2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+      2,   2,   2,   2,  99,  99,  99,  99,  99,  99,  99,  99,
+     99,  99,  99,  99,  99,  99,  99,  99,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,
+  },
+  {
+      5,   6,   0,   0,   0,   0,   0,   0,   0,   0,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,
+  },
+  {
+    100,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,
+      6,   5,   6, 101,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,
+  },
+  {
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      0, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102,
+    102, 102, 102, 102,
+  },
+  {
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0, 103, 103, 103,
+    103, 103, 103, 103, 103, 103, 103, 103, 103, 103, 103, 103,
+    103, 103, 103, 103, 103, 103, 103, 103, 103, 103, 103, 103,
+    103, 103, 103, 103,
+  },
+  {
+    103, 103, 103, 103, 103, 103, 103,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,
+  },
+  {
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0, 104, 104, 104, 104,
+    104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    104, 104, 104, 104,
+  },
+  {
+    104, 104, 104, 104, 104, 104,   0, 104,   0,   0,   0,   0,
+      0, 104,   0,   0, 105, 105, 105, 105, 105, 105, 105, 105,
+    105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105,
+    105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105,
+    105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105,   0,
+      0, 105, 105, 105,
+  },
+  {
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0, 106, 106, 106, 106,
+    106, 106, 106, 106, 106, 106, 106, 106, 106, 106, 106, 106,
+    106, 106, 106, 106, 106, 106, 106, 106, 106, 106, 106, 106,
+    106, 106, 106, 106,
+  },
+  {
+    106, 106, 106, 106, 106, 106, 106, 106, 106, 106, 106, 106,
+    106, 106, 106, 106, 106, 106, 106, 106, 106, 106, 106, 106,
+    106, 106, 106, 106, 106, 106, 106, 106, 106, 106, 106, 106,
+    106, 106, 106, 106, 106, 106, 106, 106, 106, 106, 106, 106,
+    107, 107, 107, 107, 107, 107,   0,   0, 108, 108, 108, 108,
+    108, 108,   0,   0,
+  },
+  {
+    109, 110, 111, 112, 112, 113, 114, 115, 116,   0,   0,   0,
+      0,   0,   0,   0, 117, 117, 117, 117, 117, 117, 117, 117,
+    117, 117, 117, 117, 117, 117, 117, 117, 117, 117, 117, 117,
+    117, 117, 117, 117, 117, 117, 117, 117, 117, 117, 117, 117,
+    117, 117, 117, 117, 117, 117, 117, 117, 117, 117, 117,   0,
+      0, 117, 117, 117,
+  },
+  {
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0, 118,   0,   0,
+      0, 119,   0,   0,
+  },
+  {
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0, 120,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,
+  },
+  {
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,
+  },
+  {
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   0,   0,
+      0,   0,   0, 121,   0,   0, 122,   0,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,
+  },
+  {
+    123, 123, 123, 123, 123, 123, 123, 123, 124, 124, 124, 124,
+    124, 124, 124, 124, 123, 123, 123, 123, 123, 123,   0,   0,
+    124, 124, 124, 124, 124, 124,   0,   0, 123, 123, 123, 123,
+    123, 123, 123, 123, 124, 124, 124, 124, 124, 124, 124, 124,
+    123, 123, 123, 123, 123, 123, 123, 123, 124, 124, 124, 124,
+    124, 124, 124, 124,
+  },
+  {
+    123, 123, 123, 123, 123, 123,   0,   0, 124, 124, 124, 124,
+    124, 124,   0,   0,   0, 123,   0, 123,   0, 123,   0, 123,
+      0, 124,   0, 124,   0, 124,   0, 124, 123, 123, 123, 123,
+    123, 123, 123, 123, 124, 124, 124, 124, 124, 124, 124, 124,
+    125, 125, 126, 126, 126, 126, 127, 127, 128, 128, 129, 129,
+    130, 130,   0,   0,
+  },
+  {
+    123, 123, 123, 123, 123, 123, 123, 123, 124, 124, 124, 124,
+    124, 124, 124, 124, 123, 123, 123, 123, 123, 123, 123, 123,
+    124, 124, 124, 124, 124, 124, 124, 124, 123, 123, 123, 123,
+    123, 123, 123, 123, 124, 124, 124, 124, 124, 124, 124, 124,
+    123, 123,   0, 131,   0,   0,   0,   0, 124, 124, 132, 132,
+    133,   0, 134,   0,
+  },
+  {
+      0,   0,   0, 131,   0,   0,   0,   0, 135, 135, 135, 135,
+    133,   0,   0,   0, 123, 123,   0,   0,   0,   0,   0,   0,
+    124, 124, 136, 136,   0,   0,   0,   0, 123, 123,   0,   0,
+      0,  93,   0,   0, 124, 124, 137, 137,  97,   0,   0,   0,
+      0,   0,   0, 131,   0,   0,   0,   0, 138, 138, 139, 139,
+    133,   0,   0,   0,
+  },
+  {
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0, 140,   0,   0,   0, 141, 142,   0,   0,   0,   0,
+      0,   0, 143,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,
+  },
+  {
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0, 144,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0, 145, 145, 145, 145,
+    145, 145, 145, 145, 145, 145, 145, 145, 145, 145, 145, 145,
+    146, 146, 146, 146, 146, 146, 146, 146, 146, 146, 146, 146,
+    146, 146, 146, 146,
+  },
+  {
+      0,   0,   0,   5,   6,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,
+  },
+  {
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0, 147, 147, 147, 147, 147, 147,
+    147, 147, 147, 147,
+  },
+  {
+    147, 147, 147, 147, 147, 147, 147, 147, 147, 147, 147, 147,
+    147, 147, 147, 147, 148, 148, 148, 148, 148, 148, 148, 148,
+    148, 148, 148, 148, 148, 148, 148, 148, 148, 148, 148, 148,
+    148, 148, 148, 148, 148, 148,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,
+  },
+  {
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102,
+    103, 103, 103, 103, 103, 103, 103, 103, 103, 103, 103, 103,
+    103, 103, 103, 103,
+  },
+  {
+    103, 103, 103, 103, 103, 103, 103, 103, 103, 103, 103, 103,
+    103, 103, 103, 103, 103, 103, 103, 103, 103, 103, 103, 103,
+    103, 103, 103, 103, 103, 103, 103, 103,   5,   6, 149, 150,
+    151, 152, 153,   5,   6,   5,   6,   5,   6, 154, 155, 156,
+    157,   0,   5,   6,   0,   5,   6,   0,   0,   0,   0,   0,
+      0,   0, 158, 158,
+  },
+  {
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      0,   0,   0,   0,   0,   0,   0,   5,   6,   5,   6,   0,
+      0,   0,   5,   6,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,
+  },
+  {
+    159, 159, 159, 159, 159, 159, 159, 159, 159, 159, 159, 159,
+    159, 159, 159, 159, 159, 159, 159, 159, 159, 159, 159, 159,
+    159, 159, 159, 159, 159, 159, 159, 159, 159, 159, 159, 159,
+    159, 159,   0, 159,   0,   0,   0,   0,   0, 159,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,
+  },
+  {
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,
+  },
+  {
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,
+  },
+  {
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      0,   0,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,
+  },
+  {
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   5,   6,   5,
+      6, 160,   5,   6,
+  },
+  {
+      5,   6,   5,   6,   5,   6,   5,   6,   0,   0,   0,   5,
+      6, 161,   0,   0,   5,   6,   5,   6, 162,   0,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6, 163, 164, 165, 166, 163,   0,
+    167, 168, 169, 170,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,
+  },
+  {
+      5,   6,   5,   6, 171, 172, 173,   5,   6,   5,   6,   0,
+      0,   0,   0,   0,   5,   6,   0,   0,   0,   0,   5,   6,
+      5,   6,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   5,   6,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,
+  },
+  {
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0, 174,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    175, 175, 175, 175, 175, 175, 175, 175, 175, 175, 175, 175,
+    175, 175, 175, 175,
+  },
+  {
+    175, 175, 175, 175, 175, 175, 175, 175, 175, 175, 175, 175,
+    175, 175, 175, 175, 175, 175, 175, 175, 175, 175, 175, 175,
+    175, 175, 175, 175, 175, 175, 175, 175, 175, 175, 175, 175,
+    175, 175, 175, 175, 175, 175, 175, 175, 175, 175, 175, 175,
+    175, 175, 175, 175, 175, 175, 175, 175, 175, 175, 175, 175,
+    175, 175, 175, 175,
+  },
+  {
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   1,   1,   1,
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   0,
+      0,   0,   0,   0,
+  },
+  {
+      0,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+      2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+      2,   2,   2,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,
+  },
+  {
+    176, 176, 176, 176, 176, 176, 176, 176, 176, 176, 176, 176,
+    176, 176, 176, 176, 176, 176, 176, 176, 176, 176, 176, 176,
+    176, 176, 176, 176, 176, 176, 176, 176, 176, 176, 176, 176,
+    176, 176, 176, 176, 177, 177, 177, 177, 177, 177, 177, 177,
+    177, 177, 177, 177, 177, 177, 177, 177, 177, 177, 177, 177,
+    177, 177, 177, 177,
+  },
+  {
+    177, 177, 177, 177, 177, 177, 177, 177, 177, 177, 177, 177,
+    177, 177, 177, 177,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,
+  },
+  {
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    176, 176, 176, 176, 176, 176, 176, 176, 176, 176, 176, 176,
+    176, 176, 176, 176,
+  },
+  {
+    176, 176, 176, 176, 176, 176, 176, 176, 176, 176, 176, 176,
+    176, 176, 176, 176, 176, 176, 176, 176,   0,   0,   0,   0,
+    177, 177, 177, 177, 177, 177, 177, 177, 177, 177, 177, 177,
+    177, 177, 177, 177, 177, 177, 177, 177, 177, 177, 177, 177,
+    177, 177, 177, 177, 177, 177, 177, 177, 177, 177, 177, 177,
+      0,   0,   0,   0,
+  },
+  {
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    178, 178, 178, 178, 178, 178, 178, 178, 178, 178, 178,   0,
+    178, 178, 178, 178,
+  },
+  {
+    178, 178, 178, 178, 178, 178, 178, 178, 178, 178, 178,   0,
+    178, 178, 178, 178, 178, 178, 178,   0, 178, 178,   0, 179,
+    179, 179, 179, 179, 179, 179, 179, 179, 179, 179,   0, 179,
+    179, 179, 179, 179, 179, 179, 179, 179, 179, 179, 179, 179,
+    179, 179,   0, 179, 179, 179, 179, 179, 179, 179,   0, 179,
+    179,   0,   0,   0,
+  },
+  {
+     78,  78,  78,  78,  78,  78,  78,  78,  78,  78,  78,  78,
+     78,  78,  78,  78,  78,  78,  78,  78,  78,  78,  78,  78,
+     78,  78,  78,  78,  78,  78,  78,  78,  78,  78,  78,  78,
+     78,  78,  78,  78,  78,  78,  78,  78,  78,  78,  78,  78,
+     78,  78,  78,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,
+  },
+  {
+     83,  83,  83,  83,  83,  83,  83,  83,  83,  83,  83,  83,
+     83,  83,  83,  83,  83,  83,  83,  83,  83,  83,  83,  83,
+     83,  83,  83,  83,  83,  83,  83,  83,  83,  83,  83,  83,
+     83,  83,  83,  83,  83,  83,  83,  83,  83,  83,  83,  83,
+     83,  83,  83,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,
+  },
+  {
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   1,   1,   1,   1,
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,
+      1,   1,   1,   1,
+  },
+  {
+      2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+      2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+      2,   2,   2,   2,   2,   2,   2,   2,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,
+  },
+  {
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,
+      1,   1,   1,   1,   1,   1,   1,   1,   2,   2,   2,   2,
+      2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+      2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+      2,   2,   2,   2,
+  },
+  {
+    180, 180, 180, 180, 180, 180, 180, 180, 180, 180, 180, 180,
+    180, 180, 180, 180, 180, 180, 180, 180, 180, 180, 180, 180,
+    180, 180, 180, 180, 180, 180, 180, 180, 180, 180, 181, 181,
+    181, 181, 181, 181, 181, 181, 181, 181, 181, 181, 181, 181,
+    181, 181, 181, 181, 181, 181, 181, 181, 181, 181, 181, 181,
+    181, 181, 181, 181,
+  },
+  {
+    181, 181, 181, 181,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,
+  },
+};
+
+/* ***************************************************************  */
+} /* namespace socialmedia_signer  */
+
+#endif /* UCASETABLES_HPP__  */
@@ -0,0 +1,174 @@
+#!/usr/bin/env perl
+#
+# Socialmedia Signer, sign and verify social media posts.
+# Copyright (C) 2024  Dirk Lehmann
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published
+# by the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+# Generates the case mapping tables of socialmedia_signer::Ucase from
+# the Unicode Character Database of Perl, run
+#
+#   $ perl UcaseTables.pl > UcaseTables.hpp
+#
+# The mappings are the simple ones, i.e. one code point to one code
+# point, of UnicodeData.txt and the status C+S of CaseFolding.txt.
+
+use strict;
+use warnings;
+
+use Unicode::UCD qw(prop_invmap);
+
+# Code points per block of the second stage.
+my $BLOCK = 64;
+
+# Returns a hash CODE POINT -> MAPPED CODE POINT of all code points
+# which do not map to themselves.
+sub mapping {
+  my ($prop) = @_;
+  my ($list, $map, $format, $default) = prop_invmap($prop);
+  die "$prop: unexpected format '$format'" unless $format eq 'a';
+
+  my %result;
+  for my $i (0 .. $#$list) {
+    my $value = $map->[$i];
+    next if $value eq $default;
+
+    my $start = $list->[$i];
+    my $end = $i < $#$list? $list->[$i+1] - 1: 0x10ffff;
+    $result{$_} = $value + ($_ - $start) for $start .. $end;
+  }
+
+  return \%result;
+}
+
+my $lower = mapping('Simple_Lowercase_Mapping');
+my $upper = mapping('Simple_Uppercase_Mapping');
+my $fold  = mapping('Simple_Case_Folding');
+
+my $max = 0;
+for (keys %$lower, keys %$upper, keys %$fold) { $max = $_ if $_ > $max; }
+my $stage1_len = int($max / $BLOCK) + 1;
+
+# Deduplicate the delta records and the blocks.
+my (@records, %record_ids, @blocks, %block_ids, @stage1);
+for my $b (0 .. $stage1_len - 1) {
+  my @block;
+  for my $cp ($b * $BLOCK .. ($b+1) * $BLOCK - 1) {
+    my $record = sprintf "{%6d, %6d, %6d}",
+      ($lower->{$cp} // $cp) - $cp, ($upper->{$cp} // $cp) - $cp,
+      ($fold->{$cp} // $cp) - $cp;
+
+    unless (exists $record_ids{$record}) {
+      $record_ids{$record} = scalar @records;
+      push @records, $record;
+    }
+    push @block, $record_ids{$record};
+  }
+
+  my $key = join ',', @block;
+  unless (exists $block_ids{$key}) {
+    $block_ids{$key} = scalar @blocks;
+    push @blocks, \@block;
+  }
+  push @stage1, $block_ids{$key};
+}
+
+die "too many records" if @records > 256;
+die "too many blocks" if @blocks > 256;
+
+# Prints a list of numbers, 12 per line.
+sub print_list {
+  my ($fmt, @values) = @_;
+  while (my @line = splice @values, 0, 12) {
+    print '  ', join(', ', map { sprintf $fmt, $_ } @line), ",\n";
+  }
+}
+
+my $version = Unicode::UCD::UnicodeVersion();
+
+print <<"HEADER";
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/* Generated by UcaseTables.pl, do not edit!
+ *
+ * Simple case mapping of Unicode $version, included by Ucase.cpp only.
+ */
+
+#ifndef UCASETABLES_HPP__
+#define UCASETABLES_HPP__
+
+#include <cstdint>
+
+namespace socialmedia_signer {
+/* ***************************************************************  */
+
+static constexpr const char* UCASE_UNICODE_VERSION = "$version";
+
+/** Log2 of the code points per block of the second stage.  */
+static constexpr unsigned UCASE_BLOCK_SHIFT = @{[ log($BLOCK)/log(2) ]};
+
+/** Code points above do not change their case.  */
+static constexpr char32_t UCASE_MAX = 0x@{[ sprintf '%x', $max ]};
+
+/** Deltas to the lower case, upper case and case folded code point.  */
+struct UcaseRecord {
+  std::int32_t lower;
+  std::int32_t upper;
+  std::int32_t fold;
+};
+
+static constexpr UcaseRecord ucase_records[] = {
+HEADER
+
+print "  $_,\n" for @records;
+
+print "};\n\n";
+print "/** Block of ucase_stage2, per code point >> UCASE_BLOCK_SHIFT.  */\n";
+print "static constexpr std::uint8_t ucase_stage1[] = {\n";
+print_list('%3d', @stage1);
+print "};\n\n/** Index into ucase_records, per code point.  */\n";
+print "static constexpr std::uint8_t ucase_stage2[][$BLOCK] = {\n";
+for my $block (@blocks) {
+  print "  {\n";
+  my @values = @$block;
+  while (my @line = splice @values, 0, 12) {
+    print '    ', join(', ', map { sprintf '%3d', $_ } @line), ",\n";
+  }
+  print "  },\n";
+}
+print <<'FOOTER';
+};
+
+/* ***************************************************************  */
+} /* namespace socialmedia_signer  */
+
+#endif /* UCASETABLES_HPP__  */
+FOOTER
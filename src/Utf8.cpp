@@ -0,0 +1,447 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "Utf8.hpp"
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#  include <immintrin.h>
+#  define UTF8_X86
+#endif
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/** Smallest block of the SIMD kernels, shorter input is scalar.  */
+static constexpr std::size_t UTF8_ASCII_BLOCK = 16;
+
+#ifdef UTF8_X86
+
+/* The x86-64 baseline always has SSE2, AVX2 is selected at runtime,
+ * so no special compiler flags are needed.
+ */
+
+/* Each kernel converts whole blocks, but advances just over the
+ * leading ASCII of the last one.  The rest of that block is garbage
+ * which is overwritten afterwards, the callers guarantee enough space.
+ */
+
+static std::size_t
+_utf8_ascii_decode_sse2(char32_t* out, const char8_t* in,
+                        std::size_t len)
+{
+  const __m128i zero = _mm_setzero_si128();
+
+  std::size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    const __m128i bytes
+      = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+
+    const __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+    const __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+
+    __m128i* dst = reinterpret_cast<__m128i*>(out + i);
+    _mm_storeu_si128(dst + 0, _mm_unpacklo_epi16(lo, zero));
+    _mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(lo, zero));
+    _mm_storeu_si128(dst + 2, _mm_unpacklo_epi16(hi, zero));
+    _mm_storeu_si128(dst + 3, _mm_unpackhi_epi16(hi, zero));
+
+    const int non_ascii = _mm_movemask_epi8(bytes);
+    if (non_ascii != 0) return i + __builtin_ctz(non_ascii);
+  }
+
+  return i;
+}
+
+static std::size_t
+_utf8_ascii_encode_sse2(char8_t* out, const char32_t* in,
+                        std::size_t len)
+{
+  const __m128i non_ascii = _mm_set1_epi32(~0x7f);
+  const __m128i zero = _mm_setzero_si128();
+
+  std::size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    const __m128i* src = reinterpret_cast<const __m128i*>(in + i);
+    const __m128i a = _mm_loadu_si128(src + 0);
+    const __m128i b = _mm_loadu_si128(src + 1);
+    const __m128i c = _mm_loadu_si128(src + 2);
+    const __m128i d = _mm_loadu_si128(src + 3);
+
+    /* Exact for ASCII, the saturated rest is garbage.  */
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                     _mm_packus_epi16(_mm_packs_epi32(a, b),
+                                      _mm_packs_epi32(c, d)));
+
+    const __m128i all = _mm_or_si128(_mm_or_si128(a, b),
+                                     _mm_or_si128(c, d));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(
+          _mm_and_si128(all, non_ascii), zero)) == 0xffff) continue;
+
+    /* One byte 0xff per ASCII code point.  */
+    const __m128i ascii = _mm_packs_epi16(
+      _mm_packs_epi32(_mm_cmpeq_epi32(_mm_and_si128(a, non_ascii), zero),
+                      _mm_cmpeq_epi32(_mm_and_si128(b, non_ascii), zero)),
+      _mm_packs_epi32(_mm_cmpeq_epi32(_mm_and_si128(c, non_ascii), zero),
+                      _mm_cmpeq_epi32(_mm_and_si128(d, non_ascii), zero)));
+
+    return i + __builtin_ctz(~_mm_movemask_epi8(ascii));
+  }
+
+  return i;
+}
+
+static std::size_t
+_utf8_ascii_skip_sse2(const char8_t* in, std::size_t len)
+{
+  std::size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    const int non_ascii = _mm_movemask_epi8(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+    if (non_ascii != 0) return i + __builtin_ctz(non_ascii);
+  }
+
+  return i;
+}
+
+__attribute__((target("avx2"))) static std::size_t
+_utf8_ascii_decode_avx2(char32_t* out, const char8_t* in,
+                        std::size_t len)
+{
+  std::size_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    for (std::size_t k = 0; k < 32; k += 8) {
+      const __m128i part
+        = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + i + k));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + k),
+                          _mm256_cvtepu8_epi32(part));
+    }
+
+    const __m256i bytes
+      = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+    const unsigned non_ascii = _mm256_movemask_epi8(bytes);
+    if (non_ascii != 0) return i + __builtin_ctz(non_ascii);
+  }
+
+  return i + _utf8_ascii_decode_sse2(out + i, in + i, len - i);
+}
+
+__attribute__((target("avx2"))) static std::size_t
+_utf8_ascii_encode_avx2(char8_t* out, const char32_t* in,
+                        std::size_t len)
+{
+  const __m256i non_ascii = _mm256_set1_epi32(~0x7f);
+  const __m256i zero = _mm256_setzero_si256();
+  /* Undoes the lane interleaving of the 256 bit packs.  */
+  const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+  std::size_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    const __m256i* src = reinterpret_cast<const __m256i*>(in + i);
+    const __m256i a = _mm256_loadu_si256(src + 0);
+    const __m256i b = _mm256_loadu_si256(src + 1);
+    const __m256i c = _mm256_loadu_si256(src + 2);
+    const __m256i d = _mm256_loadu_si256(src + 3);
+
+    const __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(a, b),
+                                               _mm256_packs_epi32(c, d));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                        _mm256_permutevar8x32_epi32(packed, order));
+
+    const __m256i all = _mm256_or_si256(_mm256_or_si256(a, b),
+                                        _mm256_or_si256(c, d));
+    if (_mm256_testz_si256(all, non_ascii)) continue;
+
+    const __m256i ascii = _mm256_packs_epi16(
+      _mm256_packs_epi32(
+        _mm256_cmpeq_epi32(_mm256_and_si256(a, non_ascii), zero),
+        _mm256_cmpeq_epi32(_mm256_and_si256(b, non_ascii), zero)),
+      _mm256_packs_epi32(
+        _mm256_cmpeq_epi32(_mm256_and_si256(c, non_ascii), zero),
+        _mm256_cmpeq_epi32(_mm256_and_si256(d, non_ascii), zero)));
+
+    return i + __builtin_ctz(~static_cast<unsigned>(_mm256_movemask_epi8(
+      _mm256_permutevar8x32_epi32(ascii, order))));
+  }
+
+  return i + _utf8_ascii_encode_sse2(out + i, in + i, len - i);
+}
+
+__attribute__((target("avx2"))) static std::size_t
+_utf8_ascii_skip_avx2(const char8_t* in, std::size_t len)
+{
+  std::size_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    const unsigned non_ascii = _mm256_movemask_epi8(
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i)));
+    if (non_ascii != 0) return i + __builtin_ctz(non_ascii);
+  }
+
+  return i + _utf8_ascii_skip_sse2(in + i, len - i);
+}
+
+static bool
+_utf8_detect_avx2()
+{
+  /* May run before the CPU model of libgcc is initialized.  */
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+/* Zero, i.e. SSE2 only, until the dynamic initialization ran.  */
+static const bool
+_utf8_has_avx2 = _utf8_detect_avx2();
+
+#endif /* UTF8_X86  */
+
+/* ---------------------------------------------------------------  */
+
+/**
+ * Converts the leading ASCII of `in` block wise, returns the number
+ * of converted characters.  If `in` starts with ASCII and `len` is at
+ * least UTF8_ASCII_BLOCK then this is at least 1.  The remainder is
+ * up to the scalar loop.  Without `out` the ASCII is just skipped.
+ */
+static inline std::size_t
+_utf8_ascii_decode(char32_t* out, const char8_t* in, std::size_t len)
+{
+#ifdef UTF8_X86
+  if (out == nullptr) {
+    if (_utf8_has_avx2) return _utf8_ascii_skip_avx2(in, len);
+    return _utf8_ascii_skip_sse2(in, len);
+  }
+
+  if (_utf8_has_avx2) return _utf8_ascii_decode_avx2(out, in, len);
+  return _utf8_ascii_decode_sse2(out, in, len);
+#else
+  (void) out; (void) in; (void) len;
+  return 0;
+#endif
+}
+
+static inline std::size_t
+_utf8_ascii_encode(char8_t* out, const char32_t* in, std::size_t len)
+{
+#ifdef UTF8_X86
+  if (_utf8_has_avx2) return _utf8_ascii_encode_avx2(out, in, len);
+  return _utf8_ascii_encode_sse2(out, in, len);
+#else
+  (void) out; (void) in; (void) len;
+  return 0;
+#endif
+}
+
+static inline void
+_utf8_error(Utf8::Result& result, std::size_t offset)
+{
+  if (result.errors++ == 0) result.error_offset = offset;
+}
+
+/* ---------------------------------------------------------------  */
+
+template<bool STORE>
+static inline void
+_utf8_put(char32_t* out, std::size_t& o, char32_t cp)
+{
+  if constexpr (STORE) out[o] = cp;
+  o++;
+}
+
+/**
+ * Decodes to `out` or, if `STORE` is false, just counts the code
+ * points in Utf8::Result::written.
+ */
+template<bool STORE>
+static Utf8::Result
+_utf8_decode(char32_t* out, const char8_t* in, std::size_t len)
+{
+  using Result = Utf8::Result;
+  constexpr std::size_t npos = Utf8::npos;
+  constexpr char32_t REPLACEMENT = Utf8::REPLACEMENT;
+
+  Result result = {0, 0, npos};
+  std::size_t i = 0, o = 0;
+
+  while (i < len) {
+    const std::uint8_t lead = in[i];
+
+    if (lead < 0x80) {
+      /* Single ASCII, i.e. spaces between non-ASCII words.  */
+      if (len - i < UTF8_ASCII_BLOCK || in[i + 1] >= 0x80) {
+        _utf8_put<STORE>(out, o, lead); i++;
+        continue;
+      }
+
+      const std::size_t n = _utf8_ascii_decode(
+        STORE? out + o: nullptr, in + i, len - i);
+      i += n; o += n;
+      continue;
+    }
+
+    /* Fast paths for complete, well-formed sequences.  */
+    if (lead >= 0xc2 && lead <= 0xdf && i + 1 < len) {
+      const std::uint8_t b1 = in[i + 1];
+
+      if ((b1 & 0xc0) == 0x80) {
+        _utf8_put<STORE>(out, o, (lead & 0x1f) << 6 | (b1 & 0x3f));
+        i += 2;
+        continue;
+      }
+    } else if ((lead & 0xf0) == 0xe0 && i + 2 < len) {
+      const std::uint8_t b1 = in[i + 1], b2 = in[i + 2];
+      const char32_t cp
+        = (lead & 0x0f) << 12 | (b1 & 0x3f) << 6 | (b2 & 0x3f);
+
+      if (((b1 & 0xc0) | (b2 & 0xc0) << 8) == 0x8080 && cp >= 0x800
+          && (cp & 0xf800) != 0xd800) {
+        _utf8_put<STORE>(out, o, cp);
+        i += 3;
+        continue;
+      }
+    } else if (lead >= 0xf0 && lead <= 0xf4 && i + 3 < len) {
+      const std::uint8_t b1 = in[i + 1], b2 = in[i + 2], b3 = in[i + 3];
+      const char32_t cp = (lead & 0x07) << 18 | (b1 & 0x3f) << 12
+        | (b2 & 0x3f) << 6 | (b3 & 0x3f);
+
+      if (((b1 & 0xc0) | (b2 & 0xc0) << 8 | (b3 & 0xc0) << 16)
+          == 0x808080 && cp >= 0x10000 && cp <= 0x10ffff) {
+        _utf8_put<STORE>(out, o, cp);
+        i += 4;
+        continue;
+      }
+    }
+
+    /* Malformed or truncated, replace the maximal subpart of
+     * well-formed byte sequences, Unicode Standard table 3-7.  The
+     * second byte excludes overlongs, surrogates and values above
+     * U+10FFFF.
+     */
+    std::size_t trail;
+    std::uint8_t lo = 0x80, hi = 0xbf;
+    char32_t cp;
+    if (lead >= 0xc2 && lead <= 0xdf) {
+      trail = 1; cp = lead & 0x1f;
+    } else if (lead >= 0xe0 && lead <= 0xef) {
+      trail = 2; cp = lead & 0x0f;
+      if (lead == 0xe0) lo = 0xa0;
+      else if (lead == 0xed) hi = 0x9f;
+    } else if (lead >= 0xf0 && lead <= 0xf4) {
+      trail = 3; cp = lead & 0x07;
+      if (lead == 0xf0) lo = 0x90;
+      else if (lead == 0xf4) hi = 0x8f;
+    } else {
+      _utf8_error(result, i);
+      _utf8_put<STORE>(out, o, REPLACEMENT); i++;
+      continue;
+    }
+
+    std::size_t k = 1;
+    for (; k <= trail && i + k < len; k++) {
+      const std::uint8_t byte = in[i + k];
+      if (byte < lo || byte > hi) break;
+
+      cp = (cp << 6) | (byte & 0x3f);
+      lo = 0x80; hi = 0xbf;
+    }
+
+    if (k <= trail) {
+      /* Truncated, replace the maximal subpart read so far.  */
+      _utf8_error(result, i);
+      _utf8_put<STORE>(out, o, REPLACEMENT); i += k;
+      continue;
+    }
+
+    _utf8_put<STORE>(out, o, cp); i += k;
+  }
+
+  result.written = o;
+  return result;
+}
+
+} /* namespace socialmedia_signer  */
+
+/* ***************************************************************  */
+
+socialmedia_signer::Utf8::Result
+socialmedia_signer::Utf8::decode(char32_t* out, const char8_t* in,
+                                 std::size_t len)
+{
+  return _utf8_decode<true>(out, in, len);
+}
+
+socialmedia_signer::Utf8::Result
+socialmedia_signer::Utf8::validate(const char8_t* in, std::size_t len)
+{
+  return _utf8_decode<false>(nullptr, in, len);
+}
+
+socialmedia_signer::Utf8::Result
+socialmedia_signer::Utf8::encode(char8_t* out, const char32_t* in,
+                                 std::size_t len)
+{
+  Result result = {0, 0, npos};
+  std::size_t i = 0, o = 0;
+
+  while (i < len) {
+    char32_t cp = in[i];
+
+    if (cp < 0x80) {
+      if (len - i < UTF8_ASCII_BLOCK || in[i + 1] >= 0x80) {
+        out[o++] = static_cast<char8_t>(cp); i++;
+        continue;
+      }
+
+      const std::size_t n = _utf8_ascii_encode(out + o, in + i, len - i);
+      i += n; o += n;
+      continue;
+    }
+
+    if ((cp >= 0xd800 && cp <= 0xdfff) || cp > 0x10ffff) {
+      _utf8_error(result, i);
+      cp = REPLACEMENT;
+    }
+
+    if (cp < 0x800) {
+      out[o++] = static_cast<char8_t>(0xc0 | (cp >> 6));
+    } else if (cp < 0x10000) {
+      out[o++] = static_cast<char8_t>(0xe0 | (cp >> 12));
+      out[o++] = static_cast<char8_t>(0x80 | ((cp >> 6) & 0x3f));
+    } else {
+      out[o++] = static_cast<char8_t>(0xf0 | (cp >> 18));
+      out[o++] = static_cast<char8_t>(0x80 | ((cp >> 12) & 0x3f));
+      out[o++] = static_cast<char8_t>(0x80 | ((cp >> 6) & 0x3f));
+    }
+    out[o++] = static_cast<char8_t>(0x80 | (cp & 0x3f));
+    i++;
+  }
+
+  result.written = o;
+  return result;
+}
+
+const char*
+socialmedia_signer::Utf8::get_simd()
+{
+#ifdef UTF8_X86
+  return _utf8_has_avx2 ? "avx2" : "sse2";
+#else
+  return "none";
+#endif
+}
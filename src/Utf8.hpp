@@ -0,0 +1,106 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef UTF8_HPP__
+#define UTF8_HPP__
+
+#include <cstddef>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/**
+ * Abstract class which includes static methods for transcoding
+ * between UTF-8 and UTF-32, independent of any locale.
+ *
+ * Both directions validate their input.  Malformed sequences are
+ * replaced by Utf8::REPLACEMENT, one replacement per maximal subpart
+ * as recommended by the Unicode Standard (chapter 3.9), and the
+ * offset of the first one is returned in Utf8::Result.  Runs of
+ * ASCII are converted 16 (SSE2) or 32 (AVX2, if the CPU supports it)
+ * characters at once.
+ *
+ * Does not depend on static initialization, so it is safe to
+ * construct a `ustr` from UTF-8 during static initialization.
+ */
+class Utf8
+{
+public:
+  /* Abstract class  */
+  Utf8()            = delete;
+  Utf8(Utf8& other) = delete;
+  virtual ~Utf8()   = 0;
+
+  /* -------------------------------------------------------------  */
+
+  static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+  /** U+FFFD, replaces malformed sequences.  */
+  static constexpr char32_t REPLACEMENT = U'\xfffd';
+
+  /** Maximal number of UTF-8 bytes per code point.  */
+  static constexpr std::size_t MAX_LENGTH = 4;
+
+  struct Result {
+    /** Code units written to the output.  */
+    std::size_t written;
+
+    /** Malformed sequences, each replaced by Utf8::REPLACEMENT.  */
+    std::size_t errors;
+
+    /**
+     * Offset into the input of the first malformed sequence, in
+     * code units, or Utf8::npos if the input is well-formed.
+     */
+    std::size_t error_offset;
+  };
+
+  /* -------------------------------------------------------------  */
+
+  /**
+   * Decodes `len` bytes of UTF-8 from `in` to `out`, which has space
+   * for at least `len` code points.
+   */
+  static Result decode(char32_t* out, const char8_t* in,
+                       std::size_t len);
+
+  /**
+   * Checks `len` bytes of UTF-8 from `in` without decoding them.
+   * Utf8::Result::written is the number of code points Utf8::decode()
+   * would write.
+   */
+  static Result validate(const char8_t* in, std::size_t len);
+
+  /**
+   * Encodes `len` code points from `in` to `out`, which has space for
+   * at least `len * Utf8::MAX_LENGTH` bytes.  Surrogates and values
+   * above U+10FFFF are malformed.
+   */
+  static Result encode(char8_t* out, const char32_t* in,
+                       std::size_t len);
+
+  /** Name of the ASCII fast path in use, "avx2", "sse2" or "none".  */
+  static const char* get_simd();
+};
+
+}
+
+/* ***************************************************************  */
+
+#endif /* UTF8_HPP__  */
@@ -39,10 +39,18 @@
 /* ***************************************************************  */
 
 #include "ustr.hpp"
+#include "ustr8.hpp"
+#include "ustr_builder.hpp"
 
+#include "Alloc.hpp"
 #include "Log.hpp"
+#include "Metrics.hpp"
+#include "FlightRecorder.hpp"
+#include "Trace.hpp"
+#include "Profile.hpp"
 #include "Error.hpp"
 #include "Success.hpp"
+#include "Result.hpp"
 
 /* ***************************************************************  */
 
@@ -53,6 +61,17 @@
 #define COMMON_BUGTRACKING_URL \
   u8"https://github.com/YouDirk/socialmedia-signer/issues"
 
+/** Environment variable for Log::set_levels().  */
+#define COMMON_LOG_ENV             "SOCIALMEDIA_SIGNER_LOG"
+/** Environment variable for Log::open_binary().  */
+#define COMMON_BINLOG_ENV          "SOCIALMEDIA_SIGNER_BINLOG"
+/** Environment variable for Metrics::init().  */
+#define COMMON_METRICS_ENV         "SOCIALMEDIA_SIGNER_METRICS"
+/** Environment variable for Alloc::is_enabled().  */
+#define COMMON_ALLOC_ENV           "SOCIALMEDIA_SIGNER_ALLOC"
+/** Environment variable for FlightRecorder::init().  */
+#define COMMON_FLIGHT_ENV          "SOCIALMEDIA_SIGNER_FLIGHT"
+
 /* ***************************************************************  */
 
 #endif /* COMMON_HPP__  */
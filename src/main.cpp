@@ -19,6 +19,9 @@
 #include "Platforms.hpp"
 #include "Params.hpp"
 #include "Crypto.hpp"
+#include "QrCache.hpp"
+#include "BufferPool.hpp"
+#include "Ident.hpp"
 
 #ifdef CONFIG_GUI
 #  include "AppGui.hpp"
@@ -28,10 +31,40 @@
 
 #include "common.hpp"
 
+#include <new>
+
 /* ***************************************************************  */
 
 using namespace socialmedia_signer;
 
+/* -------------------------------------------------------------------
+ * Replaced here and not in Alloc.cpp, so the benchmarks can replace
+ * them on their own.  The array and `nothrow` variants call these.
+ */
+
+void*
+operator new(std::size_t size)
+{
+  void* result = Alloc::allocate(size);
+  if (result == nullptr) throw std::bad_alloc();
+
+  return result;
+}
+
+void
+operator delete(void* ptr) noexcept
+{
+  Alloc::deallocate(ptr);
+}
+
+void
+operator delete(void* ptr, [[maybe_unused]] std::size_t size) noexcept
+{
+  Alloc::deallocate(ptr);
+}
+
+/* ***************************************************************  */
+
 /**
  * Entry point for operating system using ISO C standard.
  */
@@ -42,11 +75,31 @@ main(int argc, const char** argv)
   App* app = nullptr;
 
   MTRACE();
+  Log::init();
+  /* First, so the levels hold for the lines of all other init().  */
+  Log::set_levels(std::getenv(COMMON_LOG_ENV));
+  FlightRecorder::init(std::getenv(COMMON_FLIGHT_ENV));
   try {
+    const auto time_start = Trace::clock::now();
 
     Platforms::init();
     Params::init(argc, argv);
+
+    const Params::Subargument& sarg_trace
+      = Params::get()->get_subargument(U't');
+    if (sarg_trace.set) Trace::init(sarg_trace.set_value, time_start);
+    if (Params::get()->get_subargument(U'p').set) Profile::init();
+    Trace::complete("parse params", "app", time_start);
+
+    Log::open_binary(std::getenv(COMMON_BINLOG_ENV));
+    Metrics::init(std::getenv(COMMON_METRICS_ENV));
     Crypto::init();
+#ifdef CONFIG_HUGETLB
+    BufferPool::init(true);
+#else
+    BufferPool::init(false);
+#endif
+    QrCache::init();
 
     /* -----------------------------------------------------------  */
 
@@ -73,9 +126,22 @@ main(int argc, const char** argv)
 
   /* -------------------------------------------------------------  */
 
+  /* First, to get the gauges before anything is released.  */
+  Metrics::release();
+  Trace::release();
+  Profile::release();
+  QrCache::release();
+  BufferPool::release();
   Crypto::release();
   Params::release();
   Platforms::release();
+  /* Last, everything above may hold identifiers.  */
+  Ident::release();
+  /* What is live now, is never freed by the program.  */
+  Alloc::release();
+  FlightRecorder::release();
+  Log::release();
+  Log::close_binary();
 
   MUNTRACE();
 
@@ -18,55 +18,61 @@
 
 #include "ustr.hpp"
 
-#include <locale>
-#include <cuchar>
-#include <cctype>
+#include "Utf8.hpp"
+#include "Ucase.hpp"
+#include "Alloc.hpp"
+
+#include <cstring>
 
 /* ***************************************************************  */
 
 namespace socialmedia_signer {
 
-  static const std::locale
-  ustr_locale_utf8 = std::locale("de_DE.UTF-8");
+/** See ustr::utf8_scratch().  */
+static thread_local std::string _ustr_scratch;
 
-  static const std::codecvt<char32_t, char8_t, std::mbstate_t>&
-  ustr_cvt_utf8 = std::use_facet<std::codecvt<char32_t,
-                  char8_t, std::mbstate_t>>(ustr_locale_utf8);
+/** Output of ustr::vformat(), before it is decoded.  */
+static thread_local std::string _ustr_format;
 
 } /* namespace socialmedia_signer  */
 
 /* ***************************************************************  */
 
-void
-socialmedia_signer::ustr::_cvt_in_utf8(const std::u8string& in)
+socialmedia_signer::ustr::size_type
+socialmedia_signer::ustr::_cvt_in_utf8(const char8_t* in, size_type len)
 {
-  std::mbstate_t mb {};
+  std::u32string::clear();
 
-  const char8_t* in_next;
-  char32_t* out_next;
+  return this->_cvt_append_utf8(in, len);
+}
+
+socialmedia_signer::ustr::size_type
+socialmedia_signer::ustr::_cvt_append_utf8(const char8_t* in,
+                                           size_type len)
+{
+  Alloc::Scope scope(Alloc::Tag::USTR);
 
-  std::u32string::resize(in.length(), U'\0');
+  const size_type pos = this->length();
+  std::u32string::resize(pos + len);
 
-  ustr_cvt_utf8.in(mb, &in[0], &in[in.length()], in_next,
-                   &(*this)[0], &(*this)[this->length()], out_next);
+  const Utf8::Result result = Utf8::decode(this->data() + pos, in, len);
 
-  std::u32string::resize(out_next - &(*this)[0]);
+  std::u32string::resize(pos + result.written);
+  return result.error_offset;
 }
 
-void
+socialmedia_signer::ustr::size_type
 socialmedia_signer::ustr::_cvt_out_utf8(std::u8string& out) const
 {
-  std::mbstate_t mb {};
+  Alloc::Scope scope(Alloc::Tag::USTR);
 
-  const char32_t* in_next;
-  char8_t* out_next;
+  out.resize(this->length() * Utf8::MAX_LENGTH);
 
-  out.resize(this->length() * ustr_cvt_utf8.max_length(), u8'\0');
+  const Utf8::Result result
+    = Utf8::encode(out.data(), this->data(), this->length());
 
-  ustr_cvt_utf8.out(mb, &(*this)[0], &(*this)[this->length()], in_next,
-                    &out[0], &out[out.length()], out_next);
-
-  out.resize(out_next - &out[0]);
+  out.resize(result.written);
+  return result.error_offset;
 }
 
 /* ***************************************************************  */
@@ -75,20 +81,32 @@ socialmedia_signer::ustr::ustr(): std::u32string() {}
 
 socialmedia_signer::ustr::ustr(const ustr& msg): std::u32string(msg) {}
 
+socialmedia_signer::ustr::ustr(ustr&& msg) noexcept
+  :std::u32string(std::move(msg))
+{}
+
 socialmedia_signer::ustr::ustr(const char8_t* msg): std::u32string()
 {
-  this->_cvt_in_utf8(msg);
+  this->in_utf8(msg);
 }
 
 socialmedia_signer::ustr::ustr(const std::u8string& msg): std::u32string()
 {
-  this->_cvt_in_utf8(msg);
+  this->in_utf8(msg);
 }
 
 socialmedia_signer::ustr::ustr(const char32_t* msg): std::u32string(msg) {}
 
 socialmedia_signer::ustr::ustr(const std::u32string& msg): std::u32string(msg) {}
 
+socialmedia_signer::ustr::ustr(std::u32string&& msg) noexcept
+  :std::u32string(std::move(msg))
+{}
+
+socialmedia_signer::ustr::ustr(ustr_view msg)
+  :std::u32string(msg)
+{}
+
 socialmedia_signer::ustr::ustr(const char32_t ch): std::u32string(&ch, 1) {}
 
 /* ---------------------------------------------------------------  */
@@ -100,17 +118,24 @@ socialmedia_signer::ustr::operator=(const ustr& msg)
   return *this;
 }
 
+socialmedia_signer::ustr&
+socialmedia_signer::ustr::operator=(ustr&& msg) noexcept
+{
+  std::u32string::assign(std::move(msg));
+  return *this;
+}
+
 socialmedia_signer::ustr&
 socialmedia_signer::ustr::operator=(const char8_t* msg)
 {
-  this->_cvt_in_utf8(msg);
+  this->in_utf8(msg);
   return *this;
 }
 
 socialmedia_signer::ustr&
 socialmedia_signer::ustr::operator=(const std::u8string& msg)
 {
-  this->_cvt_in_utf8(msg);
+  this->in_utf8(msg);
   return *this;
 }
 
@@ -128,6 +153,13 @@ socialmedia_signer::ustr::operator=(const std::u32string& msg)
   return *this;
 }
 
+socialmedia_signer::ustr&
+socialmedia_signer::ustr::operator=(std::u32string&& msg) noexcept
+{
+  std::u32string::assign(std::move(msg));
+  return *this;
+}
+
 socialmedia_signer::ustr&
 socialmedia_signer::ustr::operator=(const char32_t ch)
 {
@@ -137,18 +169,88 @@ socialmedia_signer::ustr::operator=(const char32_t ch)
 
 /* ---------------------------------------------------------------  */
 
+socialmedia_signer::ustr::size_type
+socialmedia_signer::ustr::in_utf8(const std::u8string& in)
+{
+  return this->_cvt_in_utf8(in.data(), in.length());
+}
+
+socialmedia_signer::ustr::size_type
+socialmedia_signer::ustr::in_utf8(const char8_t* in)
+{
+  return this->_cvt_in_utf8(
+    in, std::strlen(reinterpret_cast<const char*>(in)));
+}
+
 void
 socialmedia_signer::ustr::out_utf8(std::u8string& out) const
 {
   this->_cvt_out_utf8(out);
 }
 
+std::string_view
+socialmedia_signer::ustr::utf8_scratch() const
+{
+  return ustr::utf8_scratch(this->data(), this->length());
+}
+
+std::string_view
+socialmedia_signer::ustr::utf8_scratch(const char32_t* in, size_type len)
+{
+  /* Grows only, so there is no allocation after warm up.  */
+  if (_ustr_scratch.size() < len * Utf8::MAX_LENGTH)
+    _ustr_scratch.resize(len * Utf8::MAX_LENGTH);
+
+  const Utf8::Result result = Utf8::encode(
+    reinterpret_cast<char8_t*>(_ustr_scratch.data()), in, len);
+
+  return std::string_view(_ustr_scratch.data(), result.written);
+}
+
+socialmedia_signer::ustr
+socialmedia_signer::ustr::vformat(std::string_view fmt,
+                                  std::format_args args)
+{
+  Alloc::Scope scope(Alloc::Tag::USTR);
+
+  _ustr_format.clear();
+  std::vformat_to(std::back_inserter(_ustr_format), fmt, args);
+
+  ustr result;
+  result._cvt_in_utf8(
+    reinterpret_cast<const char8_t*>(_ustr_format.data()),
+    _ustr_format.length());
+
+  return result;
+}
+
+socialmedia_signer::ustr&
+socialmedia_signer::ustr::operator+=(const char8_t* in)
+{
+  this->_cvt_append_utf8(
+    in, std::strlen(reinterpret_cast<const char*>(in)));
+  return *this;
+}
+
+socialmedia_signer::ustr&
+socialmedia_signer::ustr::operator+=(const std::u8string& in)
+{
+  this->_cvt_append_utf8(in.data(), in.length());
+  return *this;
+}
+
 socialmedia_signer::ustr::size_type
-socialmedia_signer::ustr::find(const ustr& msg, size_type pos) const
+socialmedia_signer::ustr::find(ustr_view msg, size_type pos) const
 {
   return std::u32string::find(msg, pos);
 }
 
+socialmedia_signer::ustr::size_type
+socialmedia_signer::ustr::find(const char8_t* msg, size_type pos) const
+{
+  return this->find(ustr(msg), pos);
+}
+
 socialmedia_signer::ustr
 socialmedia_signer::ustr::substr(size_type pos, size_type count) const
 {
@@ -156,20 +258,33 @@ socialmedia_signer::ustr::substr(size_type pos, size_type count) const
 }
 
 int
-socialmedia_signer::ustr::compare(const ustr& str) const
+socialmedia_signer::ustr::compare(ustr_view str) const
 {
   return std::u32string::compare(str);
 }
 
+int
+socialmedia_signer::ustr::compare(const char8_t* str) const
+{
+  return this->compare(ustr(str));
+}
+
 int
 socialmedia_signer::ustr::compare(
-  size_type pos1, size_type count1, const ustr& str) const
+  size_type pos1, size_type count1, ustr_view str) const
 {
   return std::u32string::compare(pos1, count1, str);
 }
 
 int
-socialmedia_signer::ustr::compare(size_type pos1, size_type count1, const ustr& str,
+socialmedia_signer::ustr::compare(
+  size_type pos1, size_type count1, const char8_t* str) const
+{
+  return this->compare(pos1, count1, ustr(str));
+}
+
+int
+socialmedia_signer::ustr::compare(size_type pos1, size_type count1, ustr_view str,
                        size_type pos2, size_type count2) const
 {
   return std::u32string::compare(pos1, count1, str, pos2, count2);
@@ -178,15 +293,19 @@ socialmedia_signer::ustr::compare(size_type pos1, size_type count1, const ustr&
 void
 socialmedia_signer::ustr::tolower()
 {
-  for (char32_t* cur=&this->front(); cur <= &this->back(); cur++)
-    *cur = std::tolower(*cur);
+  Ucase::to_lower(this->data(), this->length());
 }
 
 void
 socialmedia_signer::ustr::toupper()
 {
-  for (char32_t* cur=&this->front(); cur <= &this->back(); cur++)
-    *cur = std::toupper(*cur);
+  Ucase::to_upper(this->data(), this->length());
+}
+
+void
+socialmedia_signer::ustr::casefold()
+{
+  Ucase::fold(this->data(), this->length());
 }
 
 /* ***************************************************************  */
@@ -194,21 +313,55 @@ socialmedia_signer::ustr::toupper()
 socialmedia_signer::ustr
 socialmedia_signer::operator+(const ustr& lhs, const char8_t* rhs)
 {
-  return lhs + (ustr) rhs;
+  ustr result = lhs;
+  result += rhs;
+
+  return result;
 }
 
 socialmedia_signer::ustr
 socialmedia_signer::operator+(const ustr& lhs, const std::u8string& rhs)
 {
-  return lhs + (ustr) rhs;
+  ustr result = lhs;
+  result += rhs;
+
+  return result;
 }
 
 socialmedia_signer::ustr
 socialmedia_signer::operator+(const ustr& lhs, const char32_t rhs)
 {
-  return lhs + (ustr) rhs;
+  ustr result = lhs;
+  result += rhs;
+
+  return result;
 }
 
+/* ---------------------------------------------------------------  */
+
+socialmedia_signer::ustr
+socialmedia_signer::operator+(ustr&& lhs, const char8_t* rhs)
+{
+  lhs += rhs;
+  return std::move(lhs);
+}
+
+socialmedia_signer::ustr
+socialmedia_signer::operator+(ustr&& lhs, const std::u8string& rhs)
+{
+  lhs += rhs;
+  return std::move(lhs);
+}
+
+socialmedia_signer::ustr
+socialmedia_signer::operator+(ustr&& lhs, const char32_t rhs)
+{
+  lhs += rhs;
+  return std::move(lhs);
+}
+
+/* ---------------------------------------------------------------  */
+
 socialmedia_signer::ustr
 socialmedia_signer::operator+(const char8_t* lhs, const ustr& rhs)
 {
@@ -19,14 +19,20 @@
 #ifndef USTR_HPP__
 #define USTR_HPP__
 
+#include "ustr_view.hpp"
+
 #include <string>
+#include <string_view>
 #include <format>
+#include <iterator>
 
 using namespace std::string_literals;
 
 namespace socialmedia_signer {
 /* ***************************************************************  */
 
+class ustr_builder;
+
 /**
  * Fully Unicode+UTF-8 supported string.  For UTF-8 input in the
  * sources use the string literals:
@@ -34,15 +40,15 @@ namespace socialmedia_signer {
  *   1.    const char8_t*           u8"💗 😀 Hello World! 😀 💗"
  *   2. or std::u8string            u8"💗 😀 Hello World! 😀 💗"s
  *
- * For static initialization of `ustr` use U"" string literal, as the
- * internally used CODECVT object may not be initialized, i.e.
- * ```cpp
- *   static ustr var =  U"💗 😀 Static World! 😀 💗";
- * ```
- * otherwise to save space, the default way is
+ * The transcoding is done by socialmedia_signer::Utf8, which does
+ * not depend on any locale or static initialization, so also static
+ * `ustr` may be initialized from UTF-8, i.e.
  * ```cpp
- *          ustr var = u8"💗 😀 Static World! 😀 💗";
+ *   static ustr var = u8"💗 😀 Static World! 😀 💗";
  * ```
+ * Malformed UTF-8 is replaced by U+FFFD, use `ustr::in_utf8()` if
+ * the input needs to be checked.
+ *
  * To concatenate strings you can use the operator `+`, such like
  * ```cpp
  *         ustr var2 = var + u8" is concatenated.";
@@ -51,6 +57,11 @@ namespace socialmedia_signer {
  * ```cpp
  *       ustr output = ustr::format("note: {} (level {})", var, 5);
  * ```
+ * Strings which are built piece by piece, i.e. in loops, should use
+ * socialmedia_signer::ustr_builder instead.
+ * If the result is just written out, format to UTF-8 directly using
+ * `ustr::format_utf8()` or the formatting overloads of
+ * socialmedia_signer::Log, which skip the conversion to UTF-32.
  * The socialmedia_signer::ustr then internally is working with UTF-32
  * characters.  Therefore, the access to an character using
  * operator[]() has nearly no time to run.
@@ -77,59 +88,120 @@ public:
 
   /* copy constructor  */
   ustr(const ustr& msg);
+  /* move constructor  */
+  ustr(ustr&& msg) noexcept;
 
   ustr(const char8_t* msg);
   ustr(const std::u8string& msg);
 
   ustr(const char32_t* msg);
   ustr(const std::u32string& msg);
+  ustr(std::u32string&& msg) noexcept;
+  explicit ustr(ustr_view msg);
   ustr(const char32_t ch);
 
   /* copy assignment  */
   ustr& operator=(const ustr& msg);
+  /* move assignment  */
+  ustr& operator=(ustr&& msg) noexcept;
 
   ustr& operator=(const char8_t* msg);
   ustr& operator=(const std::u8string& msg);
 
   ustr& operator=(const char32_t* msg);
   ustr& operator=(const std::u32string& msg);
+  ustr& operator=(std::u32string&& msg) noexcept;
   ustr& operator=(const char32_t ch);
 
+  /**
+   * Replaces the content by the decoded UTF-8 `in`.  Returns the
+   * offset in bytes of the first malformed sequence, which was
+   * replaced by U+FFFD, or ustr::npos if `in` is well-formed.
+   */
+  size_type in_utf8(const std::u8string& in);
+  size_type in_utf8(const char8_t* in);
+
   void out_utf8(std::u8string& out) const;
 
-  size_type find(const ustr& msg, size_type pos=0) const;
+  /**
+   * UTF-8 encoded content, written to a buffer of the calling thread
+   * which is reused by the next call, so no allocation is needed
+   * after warm up.  Use it for output or in std::formatter()´s, but
+   * do not keep the view.
+   */
+  std::string_view utf8_scratch() const;
+  static std::string_view utf8_scratch(const char32_t* in,
+                                       size_type len);
+
+  /** Appends the decoded UTF-8 `in`, in place.  */
+  using std::u32string::operator+=;
+  ustr& operator+=(const char8_t* in);
+  ustr& operator+=(const std::u8string& in);
+
+  /* Views and `U""` literals are searched and compared without
+   * allocation, UTF-8 literals are decoded first.
+   */
+  size_type find(ustr_view msg, size_type pos=0) const;
+  size_type find(const char8_t* msg, size_type pos=0) const;
   ustr substr(size_type pos = 0, size_type count = npos) const;
 
-  int compare(const ustr& str) const;
-  int compare(size_type pos1, size_type count1, const ustr& str) const;
-  int compare(size_type pos1, size_type count1, const ustr& str,
+  int compare(ustr_view str) const;
+  int compare(const char8_t* str) const;
+  int compare(size_type pos1, size_type count1, ustr_view str) const;
+  int compare(size_type pos1, size_type count1, const char8_t* str)
+    const;
+  int compare(size_type pos1, size_type count1, ustr_view str,
               size_type pos2, size_type count2 = npos) const;
 
+  /**
+   * Simple Unicode case mapping in place, see socialmedia_signer::Ucase.
+   * `casefold()` is for case-insensitive comparison.
+   */
   void tolower();
   void toupper();
+  void casefold();
 
   template<typename... Args> inline static ustr
     format(const std::format_string<Args...> fmt, Args&&... args)
   {
-    ustr result = (char8_t*)
-      std::vformat(fmt.get(), std::make_format_args(args...)).data();
+    return ustr::vformat(fmt.get(), std::make_format_args(args...));
+  }
+
+  /** Formats through a buffer of the calling thread.  */
+  static ustr vformat(std::string_view fmt, std::format_args args);
 
-    return result;
+  /** Appends the UTF-8 formatted output to `out`.  */
+  template<typename... Args> inline static void
+    format_utf8(std::u8string& out,
+                const std::format_string<Args...> fmt, Args&&... args)
+  {
+    std::vformat_to(std::back_inserter(out), fmt.get(),
+                    std::make_format_args(args...));
   }
 
 private:
-  void _cvt_in_utf8(const std::u8string& in);
-  void _cvt_out_utf8(std::u8string& out) const;
+  /* Appends UTF-8 in place.  */
+  friend class ustr_builder;
+
+  size_type _cvt_in_utf8(const char8_t* in, size_type len);
+  size_type _cvt_append_utf8(const char8_t* in, size_type len);
+  size_type _cvt_out_utf8(std::u8string& out) const;
 };
 
 /* -------------------------------------------------------------------
  * Cool concatenation of unicode socialmedia_signer::ustr strings.
+ * Temporaries on the left hand side are appended in place, so chains
+ * like `a + u8"b" + u8"c"` reuse one buffer.
  */
 
   ustr operator+(const ustr& lhs, const char8_t* rhs);
   ustr operator+(const ustr& lhs, const std::u8string& rhs);
   ustr operator+(const ustr& lhs, const char32_t rhs);
 
+  ustr operator+(ustr&& lhs, const char8_t* rhs);
+  ustr operator+(ustr&& lhs, const std::u8string& rhs);
+  ustr operator+(ustr&& lhs, const char32_t rhs);
+
   ustr operator+(const char8_t* lhs, const ustr& rhs);
   ustr operator+(const std::u8string& lhs, const ustr& rhs);
   ustr operator+(const char32_t lhs, const ustr& rhs);
@@ -138,30 +210,33 @@ private:
 } /* namespace socialmedia_signer  */
 
 /*
- * std::formatter()´s for socialmedia_signer::ustr::format().
+ * std::formatter()´s for socialmedia_signer::ustr::format().  All of
+ * them format a std::string_view, so the width counts characters and
+ * embedded NUL are kept.
  */
 
 template<>
 struct std::formatter<socialmedia_signer::ustr, char>
-  : public std::formatter<const char*, char>
+  : public std::formatter<std::string_view, char>
 {
-  /* Just call it from the base class.
-   */
-  /*
-  constexpr auto parse(std::format_parse_context& ctx)
+  auto format(const socialmedia_signer::ustr& str,
+              std::format_context& ctx) const
   {
-    return std::formatter<const char*, char>::parse(ctx);
+    return std::formatter<std::string_view, char>
+      ::format(str.utf8_scratch(), ctx);
   }
-  */
+};
 
-  auto format(const socialmedia_signer::ustr& str,
+template<>
+struct std::formatter<socialmedia_signer::ustr_view, char>
+  : public std::formatter<std::string_view, char>
+{
+  auto format(const socialmedia_signer::ustr_view& str,
               std::format_context& ctx) const
   {
-    std::u8string out;
-    str.out_utf8(out);
-
-    return std::formatter<const char*, char>
-      ::format(reinterpret_cast<const char*>(out.data()), ctx);
+    return std::formatter<std::string_view, char>::format(
+      socialmedia_signer::ustr::utf8_scratch(str.data(), str.length()),
+      ctx);
   }
 };
 
@@ -203,64 +278,47 @@ struct std::formatter<const char8_t*, char>
 
 template<>
 struct std::formatter<char32_t, char>
-  : public std::formatter<const char*, char>
+  : public std::formatter<std::string_view, char>
 {
   auto format(const char32_t str, std::format_context& ctx) const
   {
-    socialmedia_signer::ustr in = str;
-
-    std::u8string out;
-    in.out_utf8(out);
-
-    return std::formatter<const char*, char>
-      ::format(reinterpret_cast<const char*>(out.data()), ctx);
+    return std::formatter<std::string_view, char>::format(
+      socialmedia_signer::ustr::utf8_scratch(&str, 1), ctx);
   }
 };
 
 template<std::size_t size>
 struct std::formatter<char32_t[size], char>
-  : public std::formatter<const char*, char>
+  : public std::formatter<std::string_view, char>
 {
   auto format(const char32_t* str, std::format_context& ctx) const
   {
-    socialmedia_signer::ustr in = str;
-
-    std::u8string out;
-    in.out_utf8(out);
-
-    return std::formatter<const char*, char>
-      ::format(reinterpret_cast<const char*>(out.data()), ctx);
+    return std::formatter<std::string_view, char>::format(
+      socialmedia_signer::ustr::utf8_scratch(
+        str, std::char_traits<char32_t>::length(str)), ctx);
   }
 };
 
 template<>
 struct std::formatter<char32_t*, char>
-  : public std::formatter<const char*, char>
+  : public std::formatter<std::string_view, char>
 {
   auto format(const char32_t* str, std::format_context& ctx) const
   {
-    socialmedia_signer::ustr in = str;
-
-    std::u8string out;
-    in.out_utf8(out);
-
-    return std::formatter<const char*, char>
-      ::format(reinterpret_cast<const char*>(out.data()), ctx);
+    return std::formatter<std::string_view, char>::format(
+      socialmedia_signer::ustr::utf8_scratch(
+        str, std::char_traits<char32_t>::length(str)), ctx);
   }
 };
 template<>
 struct std::formatter<const char32_t*, char>
-  : public std::formatter<const char*, char>
+  : public std::formatter<std::string_view, char>
 {
   auto format(const char32_t* str, std::format_context& ctx) const
   {
-    socialmedia_signer::ustr in = str;
-
-    std::u8string out;
-    in.out_utf8(out);
-
-    return std::formatter<const char*, char>
-      ::format(reinterpret_cast<const char*>(out.data()), ctx);
+    return std::formatter<std::string_view, char>::format(
+      socialmedia_signer::ustr::utf8_scratch(
+        str, std::char_traits<char32_t>::length(str)), ctx);
   }
 };
 
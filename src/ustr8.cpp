@@ -0,0 +1,409 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "ustr8.hpp"
+
+#include "Utf8.hpp"
+#include "Alloc.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/** Length of the sequence starting with `lead`, which is valid.  */
+static inline std::size_t
+_ustr8_seq_len(char8_t lead)
+{
+  if (lead < 0x80) return 1;
+  if (lead < 0xe0) return 2;
+  if (lead < 0xf0) return 3;
+  return 4;
+}
+
+/** Output of ustr8::vformat(), before it is copied.  */
+static thread_local std::string _ustr8_format;
+
+static inline void
+_ustr8_check(std::size_t pos, std::size_t length, const char* what)
+{
+  if (pos > length) throw std::out_of_range(what);
+}
+
+} /* namespace socialmedia_signer  */
+
+/* ***************************************************************  */
+
+socialmedia_signer::ustr8::ustr8()
+  :utf8(), code_points(0), index()
+{}
+
+socialmedia_signer::ustr8::ustr8(const char8_t* msg)
+  :utf8(), code_points(0), index()
+{
+  this->assign_utf8(std::u8string(msg));
+}
+
+socialmedia_signer::ustr8::ustr8(const std::u8string& msg)
+  :utf8(), code_points(0), index()
+{
+  this->assign_utf8(std::u8string(msg));
+}
+
+socialmedia_signer::ustr8::ustr8(std::u8string&& msg)
+  :utf8(), code_points(0), index()
+{
+  this->assign_utf8(std::move(msg));
+}
+
+socialmedia_signer::ustr8::ustr8(const ustr& msg)
+  :utf8(), code_points(msg.length()), index()
+{
+  /* Invalid code points are replaced one by one, so the count holds.  */
+  msg.out_utf8(this->utf8);
+  this->update_index(0, 0);
+}
+
+socialmedia_signer::ustr8::ustr8(const char32_t ch)
+  :ustr8(ustr(ch))
+{}
+
+/* ---------------------------------------------------------------  */
+
+socialmedia_signer::ustr8&
+socialmedia_signer::ustr8::operator=(const char8_t* msg)
+{
+  this->assign_utf8(std::u8string(msg));
+  return *this;
+}
+
+socialmedia_signer::ustr8&
+socialmedia_signer::ustr8::operator=(const std::u8string& msg)
+{
+  this->assign_utf8(std::u8string(msg));
+  return *this;
+}
+
+socialmedia_signer::ustr8&
+socialmedia_signer::ustr8::operator=(std::u8string&& msg)
+{
+  this->assign_utf8(std::move(msg));
+  return *this;
+}
+
+socialmedia_signer::ustr8
+socialmedia_signer::ustr8::vformat(std::string_view fmt,
+                                   std::format_args args)
+{
+  Alloc::Scope scope(Alloc::Tag::USTR);
+
+  _ustr8_format.clear();
+  std::vformat_to(std::back_inserter(_ustr8_format), fmt, args);
+
+  return std::u8string(
+    reinterpret_cast<const char8_t*>(_ustr8_format.data()),
+    _ustr8_format.length());
+}
+
+/* ---------------------------------------------------------------  */
+
+socialmedia_signer::ustr
+socialmedia_signer::ustr8::to_ustr() const
+{
+  ustr result;
+  result.in_utf8(this->utf8);
+
+  return result;
+}
+
+const std::u8string&
+socialmedia_signer::ustr8::str() const noexcept
+{
+  return this->utf8;
+}
+
+const char8_t*
+socialmedia_signer::ustr8::c_str() const noexcept
+{
+  return this->utf8.c_str();
+}
+
+void
+socialmedia_signer::ustr8::out_utf8(std::u8string& out) const
+{
+  out = this->utf8;
+}
+
+socialmedia_signer::ustr8::size_type
+socialmedia_signer::ustr8::length() const noexcept
+{
+  return this->code_points;
+}
+
+socialmedia_signer::ustr8::size_type
+socialmedia_signer::ustr8::size_bytes() const noexcept
+{
+  return this->utf8.length();
+}
+
+bool
+socialmedia_signer::ustr8::empty() const noexcept
+{
+  return this->utf8.empty();
+}
+
+void
+socialmedia_signer::ustr8::clear() noexcept
+{
+  this->utf8.clear();
+  this->code_points = 0;
+  this->index.clear();
+}
+
+/* ---------------------------------------------------------------  */
+
+char32_t
+socialmedia_signer::ustr8::operator[](size_type pos) const
+{
+  const size_type offset = this->byte_offset(pos);
+  const char8_t* seq = this->utf8.data() + offset;
+
+  char32_t result;
+  Utf8::decode(&result, seq, _ustr8_seq_len(*seq));
+
+  return result;
+}
+
+socialmedia_signer::ustr8::size_type
+socialmedia_signer::ustr8::find(const ustr8& msg, size_type pos) const
+{
+  if (pos > this->code_points) return npos;
+
+  /* A match of valid UTF-8 always starts at a code point.  */
+  const size_type offset
+    = this->utf8.find(msg.utf8, this->byte_offset(pos));
+
+  return offset == npos? npos: this->code_point_pos(offset);
+}
+
+socialmedia_signer::ustr8
+socialmedia_signer::ustr8::substr(size_type pos, size_type count) const
+{
+  _ustr8_check(pos, this->code_points, "ustr8::substr");
+
+  count = std::min(count, this->code_points - pos);
+  const size_type begin = this->byte_offset(pos);
+  const size_type end = this->byte_offset(pos + count);
+
+  ustr8 result;
+  result.utf8.assign(this->utf8, begin, end - begin);
+  result.code_points = count;
+  result.update_index(0, 0);
+
+  return result;
+}
+
+int
+socialmedia_signer::ustr8::compare(const ustr8& str) const
+{
+  return this->utf8.compare(str.utf8);
+}
+
+int
+socialmedia_signer::ustr8::compare(
+  size_type pos1, size_type count1, const ustr8& str) const
+{
+  return this->compare(pos1, count1, str, 0, npos);
+}
+
+int
+socialmedia_signer::ustr8::compare(size_type pos1, size_type count1,
+  const ustr8& str, size_type pos2, size_type count2) const
+{
+  _ustr8_check(pos1, this->code_points, "ustr8::compare");
+  _ustr8_check(pos2, str.code_points, "ustr8::compare");
+
+  count1 = std::min(count1, this->code_points - pos1);
+  count2 = std::min(count2, str.code_points - pos2);
+
+  const size_type begin1 = this->byte_offset(pos1);
+  const size_type begin2 = str.byte_offset(pos2);
+
+  return this->utf8.compare(
+    begin1, this->byte_offset(pos1 + count1) - begin1,
+    str.utf8, begin2, str.byte_offset(pos2 + count2) - begin2);
+}
+
+/* ---------------------------------------------------------------  */
+
+socialmedia_signer::ustr8&
+socialmedia_signer::ustr8::operator+=(const ustr8& msg)
+{
+  const size_type pos = this->code_points;
+  const size_type offset = this->utf8.length();
+
+  this->utf8 += msg.utf8;
+  this->code_points += msg.code_points;
+  this->update_index(pos, offset);
+
+  return *this;
+}
+
+socialmedia_signer::ustr8&
+socialmedia_signer::ustr8::operator+=(const char8_t* msg)
+{
+  return *this += ustr8(msg);
+}
+
+socialmedia_signer::ustr8&
+socialmedia_signer::ustr8::operator+=(const char32_t ch)
+{
+  char8_t seq[Utf8::MAX_LENGTH];
+  const Utf8::Result result = Utf8::encode(seq, &ch, 1);
+  const size_type pos = this->code_points;
+  const size_type offset = this->utf8.length();
+
+  this->utf8.append(seq, result.written);
+  this->code_points++;
+  this->update_index(pos, offset);
+
+  return *this;
+}
+
+bool
+socialmedia_signer::ustr8::operator==(const ustr8& other) const noexcept
+{
+  return this->utf8 == other.utf8;
+}
+
+std::strong_ordering
+socialmedia_signer::ustr8::operator<=>(const ustr8& other) const noexcept
+{
+  return this->utf8 <=> other.utf8;
+}
+
+/* ***************************************************************  */
+
+void
+socialmedia_signer::ustr8::assign_utf8(std::u8string&& in)
+{
+  Alloc::Scope scope(Alloc::Tag::USTR);
+
+  const Utf8::Result result = Utf8::validate(in.data(), in.length());
+
+  if (result.errors == 0) {
+    this->utf8 = std::move(in);
+  } else {
+    ustr replaced;
+    replaced.in_utf8(in);
+    replaced.out_utf8(this->utf8);
+  }
+
+  this->code_points = result.written;
+  this->index.clear();
+  this->update_index(0, 0);
+}
+
+socialmedia_signer::ustr8::size_type
+socialmedia_signer::ustr8::byte_offset(size_type pos) const
+{
+  if (pos >= this->code_points) return this->utf8.length();
+
+  /* ASCII only, positions are offsets.  */
+  if (this->code_points == this->utf8.length()) return pos;
+
+  size_type offset = this->index[pos / INDEX_STRIDE];
+  for (size_type n = pos % INDEX_STRIDE; n > 0; n--)
+    offset += _ustr8_seq_len(this->utf8[offset]);
+
+  return offset;
+}
+
+socialmedia_signer::ustr8::size_type
+socialmedia_signer::ustr8::code_point_pos(size_type offset) const
+{
+  if (offset >= this->utf8.length()) return this->code_points;
+  if (this->code_points == this->utf8.length()) return offset;
+
+  const size_type entry = std::upper_bound(this->index.begin(),
+    this->index.end(), offset) - this->index.begin() - 1;
+
+  size_type pos = entry * INDEX_STRIDE;
+  for (size_type cur = this->index[entry]; cur < offset; pos++)
+    cur += _ustr8_seq_len(this->utf8[cur]);
+
+  return pos;
+}
+
+void
+socialmedia_signer::ustr8::update_index(size_type pos, size_type offset)
+{
+  if (this->code_points == this->utf8.length()) {
+    this->index.clear();
+    return;
+  }
+
+  if (this->index.empty()) {
+    pos = offset = 0;
+    this->index.reserve(this->code_points / INDEX_STRIDE + 1);
+  }
+
+  for (; pos < this->code_points; pos++) {
+    if (pos % INDEX_STRIDE == 0)
+      this->index.push_back(static_cast<std::uint32_t>(offset));
+
+    offset += _ustr8_seq_len(this->utf8[offset]);
+  }
+}
+
+/* ***************************************************************  */
+
+socialmedia_signer::ustr8
+socialmedia_signer::operator+(const ustr8& lhs, const ustr8& rhs)
+{
+  ustr8 result = lhs;
+  result += rhs;
+
+  return result;
+}
+
+socialmedia_signer::ustr8
+socialmedia_signer::operator+(const ustr8& lhs, const char8_t* rhs)
+{
+  ustr8 result = lhs;
+  result += rhs;
+
+  return result;
+}
+
+socialmedia_signer::ustr8
+socialmedia_signer::operator+(ustr8&& lhs, const ustr8& rhs)
+{
+  lhs += rhs;
+  return std::move(lhs);
+}
+
+socialmedia_signer::ustr8
+socialmedia_signer::operator+(ustr8&& lhs, const char8_t* rhs)
+{
+  lhs += rhs;
+  return std::move(lhs);
+}
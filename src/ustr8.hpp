@@ -0,0 +1,184 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef USTR8_HPP__
+#define USTR8_HPP__
+
+#include "ustr.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <format>
+#include <compare>
+#include <cstdint>
+
+namespace socialmedia_signer {
+/* ***************************************************************  */
+
+/**
+ * Compact alternative to socialmedia_signer::ustr, which stores the
+ * string UTF-8 encoded.  Mostly ASCII text such as posts, IDs and
+ * file names takes a quarter of the memory of `ustr`, and the output
+ * to console or file needs no conversion at all.
+ *
+ * The API is the one of `ustr`, positions and lengths are counted in
+ * code points:
+ *
+ * ```cpp
+ *   ustr8 str = u8"💗 😀 Hello World! 😀 💗";
+ *
+ *   str.length();                 // 20 code points
+ *   str.size_bytes();             // 32 bytes
+ *   str[4];                       // U'H'
+ *   str.substr(4, 5);             // u8"Hello"
+ *   ustr8::format("{}!", str);
+ * ```
+ *
+ * The content is always valid UTF-8, malformed input is replaced by
+ * U+FFFD like in `ustr`.  Access by code point position uses a sparse
+ * index of every ustr8::INDEX_STRIDE-th code point, which is built on
+ * assignment and extended on append, so random access is O(1).  ASCII
+ * only strings need no index.  `const` methods never modify the
+ * object, so concurrent reads need no locking, like for `ustr`.
+ *
+ * Opt in where strings are stored in bulk or just passed through to
+ * the output, and convert with `ustr8::to_ustr()` where heavy
+ * character processing is needed.
+ */
+class ustr8
+{
+public:
+  using size_type = std::size_t;
+
+  static constexpr size_type npos = static_cast<size_type>(-1);
+
+  /** Code points between two entries of the sparse index.  */
+  static constexpr size_type INDEX_STRIDE = 32;
+
+  ustr8();
+
+  ustr8(const char8_t* msg);
+  ustr8(const std::u8string& msg);
+  ustr8(std::u8string&& msg);
+  explicit ustr8(const ustr& msg);
+  explicit ustr8(const char32_t ch);
+
+  ustr8& operator=(const char8_t* msg);
+  ustr8& operator=(const std::u8string& msg);
+  ustr8& operator=(std::u8string&& msg);
+
+  /** Decodes to a UTF-32 `ustr`.  */
+  ustr to_ustr() const;
+
+  /** The UTF-8 encoded content.  */
+  const std::u8string& str() const noexcept;
+  const char8_t* c_str() const noexcept;
+  void out_utf8(std::u8string& out) const;
+
+  /** Number of code points.  */
+  size_type length() const noexcept;
+  size_type size_bytes() const noexcept;
+  bool empty() const noexcept;
+  void clear() noexcept;
+
+  /** Code point at code point position `pos`, not range checked.  */
+  char32_t operator[](size_type pos) const;
+
+  size_type find(const ustr8& msg, size_type pos=0) const;
+  ustr8 substr(size_type pos = 0, size_type count = npos) const;
+
+  /* UTF-8 sorts the same as UTF-32, so bytes are compared.  */
+  int compare(const ustr8& str) const;
+  int compare(size_type pos1, size_type count1, const ustr8& str) const;
+  int compare(size_type pos1, size_type count1, const ustr8& str,
+              size_type pos2, size_type count2 = npos) const;
+
+  ustr8& operator+=(const ustr8& msg);
+  ustr8& operator+=(const char8_t* msg);
+  ustr8& operator+=(const char32_t ch);
+
+  bool operator==(const ustr8& other) const noexcept;
+  std::strong_ordering operator<=>(const ustr8& other) const noexcept;
+
+  template<typename... Args> inline static ustr8
+    format(const std::format_string<Args...> fmt, Args&&... args)
+  {
+    return ustr8::vformat(fmt.get(), std::make_format_args(args...));
+  }
+
+  /**
+   * Formats through a buffer of the calling thread, the result is
+   * allocated once with its exact size.
+   */
+  static ustr8 vformat(std::string_view fmt, std::format_args args);
+
+private:
+  /** Sets `utf8`, replaces malformed sequences.  */
+  void assign_utf8(std::u8string&& in);
+
+  /** Byte offset of code point position `pos`, may be size_bytes().  */
+  size_type byte_offset(size_type pos) const;
+  /** Code point position of the code point starting at byte `offset`.  */
+  size_type code_point_pos(size_type offset) const;
+
+  /**
+   * Extends the index from code point position `pos` at byte `offset`
+   * up to the end.  Drops the index if the content is ASCII only, and
+   * rebuilds it from the start if it is empty.
+   */
+  void update_index(size_type pos, size_type offset);
+
+  std::u8string utf8;
+  size_type code_points;
+
+  /** Byte offsets of code points 0, INDEX_STRIDE, 2*INDEX_STRIDE...  */
+  std::vector<std::uint32_t> index;
+};
+
+/* -------------------------------------------------------------------
+ * Concatenation, like for socialmedia_signer::ustr.
+ */
+
+  ustr8 operator+(const ustr8& lhs, const ustr8& rhs);
+  ustr8 operator+(const ustr8& lhs, const char8_t* rhs);
+  ustr8 operator+(ustr8&& lhs, const ustr8& rhs);
+  ustr8 operator+(ustr8&& lhs, const char8_t* rhs);
+
+/* ***************************************************************  */
+} /* namespace socialmedia_signer  */
+
+/*
+ * std::formatter() for socialmedia_signer::ustr8, writes the bytes
+ * as they are.
+ */
+
+template<>
+struct std::formatter<socialmedia_signer::ustr8, char>
+  : public std::formatter<std::string_view, char>
+{
+  auto format(const socialmedia_signer::ustr8& str,
+              std::format_context& ctx) const
+  {
+    return std::formatter<std::string_view, char>::format(
+      std::string_view(reinterpret_cast<const char*>(str.c_str()),
+                       str.size_bytes()), ctx);
+  }
+};
+
+#endif /* USTR8_HPP__  */
@@ -0,0 +1,140 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "ustr_builder.hpp"
+
+#include <cstring>
+#include <iterator>
+
+/* ***************************************************************  */
+
+namespace socialmedia_signer {
+
+/** Output of ustr_builder::vappend_format(), before it is decoded.  */
+static thread_local std::string _ustr_builder_format;
+
+} /* namespace socialmedia_signer  */
+
+/* ***************************************************************  */
+
+socialmedia_signer::ustr_builder::ustr_builder(size_type size_hint)
+  :buf()
+{
+  this->buf.reserve(size_hint);
+}
+
+void
+socialmedia_signer::ustr_builder::reserve(size_type size_hint)
+{
+  this->buf.reserve(size_hint);
+}
+
+void
+socialmedia_signer::ustr_builder::clear() noexcept
+{
+  this->buf.clear();
+}
+
+socialmedia_signer::ustr_builder::size_type
+socialmedia_signer::ustr_builder::length() const noexcept
+{
+  return this->buf.length();
+}
+
+bool
+socialmedia_signer::ustr_builder::empty() const noexcept
+{
+  return this->buf.empty();
+}
+
+socialmedia_signer::ustr_view
+socialmedia_signer::ustr_builder::view() const noexcept
+{
+  return ustr_view(this->buf);
+}
+
+/* ---------------------------------------------------------------  */
+
+socialmedia_signer::ustr_builder&
+socialmedia_signer::ustr_builder::operator+=(ustr_view msg)
+{
+  this->buf.append(msg);
+  return *this;
+}
+
+socialmedia_signer::ustr_builder&
+socialmedia_signer::ustr_builder::operator+=(const char32_t* msg)
+{
+  this->buf.append(msg);
+  return *this;
+}
+
+socialmedia_signer::ustr_builder&
+socialmedia_signer::ustr_builder::operator+=(const char8_t* msg)
+{
+  this->buf._cvt_append_utf8(
+    msg, std::strlen(reinterpret_cast<const char*>(msg)));
+  return *this;
+}
+
+socialmedia_signer::ustr_builder&
+socialmedia_signer::ustr_builder::operator+=(const std::u8string& msg)
+{
+  this->buf._cvt_append_utf8(msg.data(), msg.length());
+  return *this;
+}
+
+socialmedia_signer::ustr_builder&
+socialmedia_signer::ustr_builder::operator+=(const char32_t ch)
+{
+  this->buf.push_back(ch);
+  return *this;
+}
+
+socialmedia_signer::ustr_builder&
+socialmedia_signer::ustr_builder::append(size_type count,
+                                         const char32_t ch)
+{
+  this->buf.append(count, ch);
+  return *this;
+}
+
+socialmedia_signer::ustr_builder&
+socialmedia_signer::ustr_builder::vappend_format(std::string_view fmt,
+                                                 std::format_args args)
+{
+  _ustr_builder_format.clear();
+  std::vformat_to(std::back_inserter(_ustr_builder_format), fmt, args);
+
+  this->buf._cvt_append_utf8(
+    reinterpret_cast<const char8_t*>(_ustr_builder_format.data()),
+    _ustr_builder_format.length());
+
+  return *this;
+}
+
+/* ---------------------------------------------------------------  */
+
+socialmedia_signer::ustr
+socialmedia_signer::ustr_builder::finish()
+{
+  ustr result = std::move(this->buf);
+  this->buf.clear();
+
+  return result;
+}
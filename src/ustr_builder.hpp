@@ -0,0 +1,106 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef USTR_BUILDER_HPP__
+#define USTR_BUILDER_HPP__
+
+#include "ustr.hpp"
+
+#include <string_view>
+#include <format>
+
+namespace socialmedia_signer {
+/* ***************************************************************  */
+
+/**
+ * Builds a socialmedia_signer::ustr piece by piece.  Appending is
+ * amortized O(1) and happens in place, instead of
+ *
+ * ```cpp
+ *   out = ustr::format("{} {}", out, next);   // copies `out` again
+ * ```
+ *
+ * which copies everything built so far on each step.  Reserve from a
+ * size hint if the length is known roughly, and take the result once
+ * with `ustr_builder::finish()`:
+ *
+ * ```cpp
+ *   ustr_builder out(reason.length() + 32);
+ *
+ *   out += u8"command-line: ";
+ *   out += reason;
+ *   out.append_format(" (code {})", code);
+ *
+ *   throw Error(out.finish());
+ * ```
+ *
+ * `ustr` and `U""` pieces are copied as they are, UTF-8 pieces and
+ * formatted output are decoded directly into the buffer.  A builder
+ * may be reused after `ustr_builder::clear()`, which keeps the
+ * capacity.
+ */
+class ustr_builder
+{
+public:
+  using size_type = ustr::size_type;
+
+  /** Reserves `size_hint` characters.  */
+  explicit ustr_builder(size_type size_hint = 0);
+
+  ustr_builder(const ustr_builder& other) = delete;
+
+  void reserve(size_type size_hint);
+  void clear() noexcept;
+
+  size_type length() const noexcept;
+  bool empty() const noexcept;
+
+  /** The content built so far, valid until the next append.  */
+  ustr_view view() const noexcept;
+
+  ustr_builder& operator+=(ustr_view msg);
+  ustr_builder& operator+=(const char32_t* msg);
+  ustr_builder& operator+=(const char8_t* msg);
+  ustr_builder& operator+=(const std::u8string& msg);
+  ustr_builder& operator+=(const char32_t ch);
+
+  /** Appends `ch` `count` times, i.e. for padding.  */
+  ustr_builder& append(size_type count, const char32_t ch);
+
+  template<typename... Args> inline ustr_builder&
+    append_format(const std::format_string<Args...> fmt, Args&&... args)
+  {
+    return this->vappend_format(fmt.get(),
+                                std::make_format_args(args...));
+  }
+
+  /** Formats through a buffer of the calling thread.  */
+  ustr_builder& vappend_format(std::string_view fmt,
+                               std::format_args args);
+
+  /** Moves the result out, the builder is empty afterwards.  */
+  ustr finish();
+
+private:
+  ustr buf;
+};
+
+/* ***************************************************************  */
+} /* namespace socialmedia_signer  */
+
+#endif /* USTR_BUILDER_HPP__  */
@@ -0,0 +1,116 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef USTR_VIEW_HPP__
+#define USTR_VIEW_HPP__
+
+#include <string>
+#include <string_view>
+#include <functional>
+
+namespace socialmedia_signer {
+/* ***************************************************************  */
+
+/**
+ * Non-owning view of UTF-32 characters, the counterpart of
+ * socialmedia_signer::ustr as std::u32string_view is of
+ * std::u32string.  It is constructed from a `ustr` or a `U""`
+ * literal without allocation:
+ *
+ * ```cpp
+ *   ustr str = u8"💗 😀 Hello World! 😀 💗";
+ *
+ *   ustr_view hello = ustr_view(str).substr(4, 5);   // U"Hello"
+ *   str.find(U"World");
+ * ```
+ *
+ * The viewed characters need to outlive the view.  Use it for
+ * parameters which are just compared or searched, and for lookups in
+ * containers keyed by `ustr` using socialmedia_signer::ustr_less or
+ * socialmedia_signer::ustr_hash and socialmedia_signer::ustr_equal.
+ */
+class ustr_view: public std::u32string_view
+{
+public:
+  constexpr ustr_view() noexcept
+    :std::u32string_view()
+  {}
+
+  constexpr ustr_view(const char32_t* msg)
+    :std::u32string_view(msg)
+  {}
+  constexpr ustr_view(const char32_t* msg, size_type len)
+    :std::u32string_view(msg, len)
+  {}
+  constexpr ustr_view(std::u32string_view msg) noexcept
+    :std::u32string_view(msg)
+  {}
+
+  /* Also takes socialmedia_signer::ustr, which derives from it.  */
+  ustr_view(const std::u32string& msg) noexcept
+    :std::u32string_view(msg)
+  {}
+
+  constexpr ustr_view substr(size_type pos = 0, size_type count = npos)
+    const
+  {
+    return std::u32string_view::substr(pos, count);
+  }
+};
+
+/* -------------------------------------------------------------------
+ * Transparent function objects, so `find()` on containers keyed by
+ * `ustr` takes views and `U""` literals without constructing a key.
+ *
+ * ```cpp
+ *   std::map<ustr, Platform&, ustr_less> map;
+ *   map.find(U"xcom");
+ * ```
+ */
+
+  struct ustr_less {
+    using is_transparent = void;
+
+    bool operator()(ustr_view lhs, ustr_view rhs) const noexcept
+    {
+      return lhs < rhs;
+    }
+  };
+
+  struct ustr_equal {
+    using is_transparent = void;
+
+    bool operator()(ustr_view lhs, ustr_view rhs) const noexcept
+    {
+      return lhs == rhs;
+    }
+  };
+
+  struct ustr_hash {
+    using is_transparent = void;
+
+    std::size_t operator()(ustr_view str) const noexcept
+    {
+      return std::hash<std::u32string_view>()(str);
+    }
+  };
+
+/* ***************************************************************  */
+} /* namespace socialmedia_signer  */
+
+#endif /* USTR_VIEW_HPP__  */
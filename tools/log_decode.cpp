@@ -0,0 +1,446 @@
+/* Socialmedia Signer, sign and verify social media posts.
+ * Copyright (C) 2024  Dirk Lehmann
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "../src/LogBinary.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <unordered_map>
+#include <format>
+#include <thread>
+#include <chrono>
+#include <ctime>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+
+/* ***************************************************************  */
+
+/**
+ * Decodes the binary log of Log::open_binary() to text lines, or to
+ * one JSON object per line with `--ndjson`.  With `--follow` it waits
+ * for new records like `tail -f`.
+ *
+ * ```shell
+ *   $> SOCIALMEDIA_SIGNER_BINLOG=run.blog ./socialmedia-signer ...
+ *   $> ./log-decode --ndjson run.blog
+ * ```
+ */
+
+namespace socialmedia_signer {
+
+using decode_value
+  = std::variant<bool, std::int64_t, std::uint64_t, double, std::string>;
+
+struct decode_format {
+  std::uint8_t level;
+  std::uint8_t subsystem;
+  std::string fmt;
+};
+
+struct decode_state {
+  bool is_ndjson;
+
+  LogBinary::Session session;
+  std::unordered_map<std::uint32_t, decode_format> formats;
+
+  /* Buffers, reused by every line.  */
+  std::vector<decode_value> args;
+  std::string message;
+  std::string line;
+};
+
+template<typename T>
+static T
+_decode_read(const unsigned char* in)
+{
+  T result;
+  std::memcpy(&result, in, sizeof(result));
+
+  return result;
+}
+
+static std::string_view
+_decode_name(const std::string_view* names, std::size_t count,
+             std::uint8_t index)
+{
+  return index < count? names[index]: "?";
+}
+
+/**
+ * Reads the arguments of an Event record from `in` to `end`, returns
+ * false if they are malformed.
+ */
+static bool
+_decode_args(std::vector<decode_value>& args, const unsigned char* in,
+             const unsigned char* end)
+{
+  using Arg = LogBinary::Arg;
+
+  args.clear();
+  while (in < end) {
+    const Arg tag = static_cast<Arg>(*in++);
+    const std::size_t size
+      = tag == Arg::BOOL? 1
+      : tag == Arg::STRING? sizeof(std::uint32_t): sizeof(std::uint64_t);
+    if (static_cast<std::size_t>(end - in) < size) return false;
+
+    switch (tag) {
+    case Arg::BOOL:   args.emplace_back(*in != 0); break;
+    case Arg::INT:    args.emplace_back(_decode_read<std::int64_t>(in));
+                      break;
+    case Arg::UINT:   args.emplace_back(_decode_read<std::uint64_t>(in));
+                      break;
+    case Arg::FLOAT:  args.emplace_back(_decode_read<double>(in)); break;
+    case Arg::STRING: {
+      const std::uint32_t len = _decode_read<std::uint32_t>(in);
+      if (static_cast<std::size_t>(end - in) - size < len) return false;
+
+      args.emplace_back(std::string(
+        reinterpret_cast<const char*>(in + size), len));
+      in += len;
+      break; }
+    default:
+      return false;
+    }
+    in += size;
+  }
+
+  return true;
+}
+
+/** Formats one value with the format spec of its replacement field.  */
+static void
+_decode_field(std::string& out, const decode_value& value,
+              std::string_view spec)
+{
+  const std::string fmt = std::string("{:") += std::string(spec) += '}';
+
+  std::visit([&](const auto& v) {
+    try {
+      std::vformat_to(std::back_inserter(out), fmt,
+                      std::make_format_args(v));
+    } catch (const std::format_error&) {
+      std::format_to(std::back_inserter(out), "{}", v);
+    }
+  }, value);
+}
+
+/**
+ * Does the job of std::vformat() for a format string, which is known
+ * at runtime only, and arguments, which are known by their type tags.
+ * Missing arguments are rendered as "{?}".
+ */
+static void
+_decode_message(std::string& out, std::string_view fmt,
+                const std::vector<decode_value>& args)
+{
+  std::size_t next = 0;
+
+  for (std::size_t i=0; i < fmt.length(); i++) {
+    const char c = fmt[i];
+
+    if ((c == '{' || c == '}') && i + 1 < fmt.length()
+        && fmt[i + 1] == c) {
+      out += c;
+      i++;
+      continue;
+    }
+    if (c != '{') {
+      out += c;
+      continue;
+    }
+
+    const std::size_t close = fmt.find('}', i);
+    if (close == std::string_view::npos) {
+      out += fmt.substr(i);
+      break;
+    }
+
+    std::string_view field = fmt.substr(i + 1, close - i - 1);
+    std::string_view spec;
+    const std::size_t colon = field.find(':');
+    if (colon != std::string_view::npos) {
+      spec = field.substr(colon + 1);
+      field = field.substr(0, colon);
+    }
+
+    const std::size_t index = field.empty()
+      ? next++: std::strtoul(std::string(field).c_str(), nullptr, 10);
+    if (index < args.size()) _decode_field(out, args[index], spec);
+    else out += "{?}";
+
+    i = close;
+  }
+}
+
+/** "2024-06-01T12:00:00.123456789Z"  */
+static void
+_decode_time(std::string& out, std::int64_t realtime_ns)
+{
+  const std::time_t seconds = realtime_ns / 1000000000;
+  std::tm tm;
+  gmtime_r(&seconds, &tm);
+
+  char buf[32];
+  std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+  std::format_to(std::back_inserter(out), "{}.{:09}Z", buf,
+                 realtime_ns % 1000000000);
+}
+
+static void
+_decode_json(std::string& out, std::string_view str)
+{
+  out += '"';
+  for (const char c: str) {
+    switch (c) {
+    case '"':  out += "\\\""; break;
+    case '\\': out += "\\\\"; break;
+    case '\n': out += "\\n"; break;
+    case '\r': out += "\\r"; break;
+    case '\t': out += "\\t"; break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20)
+        std::format_to(std::back_inserter(out), "\\u{:04x}",
+                       static_cast<unsigned>(c));
+      else
+        out += c;
+    }
+  }
+  out += '"';
+}
+
+static void
+_decode_json_value(std::string& out, const decode_value& value)
+{
+  std::visit([&](const auto& v) {
+    using T = std::decay_t<decltype(v)>;
+
+    if constexpr (std::is_same_v<T, std::string>)
+      _decode_json(out, v);
+    else if constexpr (std::is_same_v<T, bool>)
+      out += v? "true": "false";
+    else
+      std::format_to(std::back_inserter(out), "{}", v);
+  }, value);
+}
+
+static void
+_decode_event(decode_state& state, const LogBinary::Event& event,
+              const unsigned char* in, const unsigned char* end)
+{
+  const auto format = state.formats.find(event.id);
+  if (format == state.formats.end()) {
+    std::fprintf(stderr, "log-decode: unknown format id %u, skipped\n",
+                 event.id);
+    return;
+  }
+  if (!_decode_args(state.args, in, end)) {
+    std::fprintf(stderr, "log-decode: malformed arguments, skipped\n");
+    return;
+  }
+
+  const decode_format& f = format->second;
+  const std::string_view level = _decode_name(
+    LogBinary::LEVEL_NAMES, std::size(LogBinary::LEVEL_NAMES), f.level);
+  const std::string_view subsystem = _decode_name(
+    LogBinary::SUBSYSTEM_NAMES, std::size(LogBinary::SUBSYSTEM_NAMES),
+    f.subsystem);
+
+  state.message.clear();
+  _decode_message(state.message, f.fmt, state.args);
+
+  std::string& out = state.line;
+  out.clear();
+
+  if (!state.is_ndjson) {
+    _decode_time(out, state.session.realtime_ns + event.time_ns);
+    std::format_to(std::back_inserter(out), " {}/T{} {} {}: {}\n",
+                   state.session.pid, event.thread, level, subsystem,
+                   state.message);
+  } else {
+    out += "{\"time\":\"";
+    _decode_time(out, state.session.realtime_ns + event.time_ns);
+    std::format_to(std::back_inserter(out),
+                   "\",\"t_ns\":{},\"pid\":{},\"thread\":{},"
+                   "\"level\":\"{}\",\"subsystem\":\"{}\",\"format\":",
+                   event.time_ns, state.session.pid, event.thread,
+                   level, subsystem);
+    _decode_json(out, f.fmt);
+    out += ",\"args\":[";
+    for (std::size_t i=0; i < state.args.size(); i++) {
+      if (i > 0) out += ',';
+      _decode_json_value(out, state.args[i]);
+    }
+    out += "],\"message\":";
+    _decode_json(out, state.message);
+    out += "}\n";
+  }
+
+  std::fwrite(out.data(), 1, out.length(), stdout);
+}
+
+/**
+ * Decodes the complete records of `data` starting at `pos`, returns
+ * the offset of the first incomplete one.
+ */
+static std::size_t
+_decode_records(decode_state& state, const unsigned char* data,
+                std::size_t size, std::size_t pos)
+{
+  using Type = LogBinary::Type;
+
+  while (size - pos >= sizeof(LogBinary::Record)) {
+    const auto record = _decode_read<LogBinary::Record>(data + pos);
+    if (record.size < sizeof(LogBinary::Record)) {
+      std::fprintf(stderr, "log-decode: malformed record at %zu\n", pos);
+      std::exit(EXIT_FAILURE);
+    }
+
+    const std::size_t padded = (record.size + LogBinary::ALIGN - 1)
+      / LogBinary::ALIGN * LogBinary::ALIGN;
+    if (size - pos < padded) break;
+
+    const unsigned char* in = data + pos + sizeof(LogBinary::Record);
+    const unsigned char* end = data + pos + record.size;
+    const std::size_t length = end - in;
+
+    if (record.type == Type::SESSION
+        && length >= sizeof(LogBinary::Session)) {
+      state.session = _decode_read<LogBinary::Session>(in);
+      state.formats.clear();
+    } else if (record.type == Type::FORMAT
+               && length >= sizeof(LogBinary::Format)) {
+      const auto format = _decode_read<LogBinary::Format>(in);
+      in += sizeof(format);
+
+      state.formats[format.id] = {format.level, format.subsystem,
+        std::string(reinterpret_cast<const char*>(in), end - in)};
+    } else if (record.type == Type::EVENT
+               && length >= sizeof(LogBinary::Event)) {
+      _decode_event(state, _decode_read<LogBinary::Event>(in),
+                    in + sizeof(LogBinary::Event), end);
+    }
+    /* Unknown types are skipped, for later versions.  */
+
+    pos += padded;
+  }
+
+  return pos;
+}
+
+static const char*
+_decode_arg(const char* arg, const char* name)
+{
+  return std::strcmp(arg, name) == 0? arg: nullptr;
+}
+
+} /* namespace socialmedia_signer  */
+
+/* ***************************************************************  */
+
+using namespace socialmedia_signer;
+
+int
+main(int argc, const char** argv)
+{
+  decode_state state = {};
+  bool is_follow = false;
+  const char* path = nullptr;
+
+  for (int i=1; i < argc; i++) {
+    if (_decode_arg(argv[i], "--ndjson") != nullptr) {
+      state.is_ndjson = true;
+    } else if (_decode_arg(argv[i], "--follow") != nullptr) {
+      is_follow = true;
+    } else if (argv[i][0] != '-' && path == nullptr) {
+      path = argv[i];
+    } else {
+      path = nullptr;
+      break;
+    }
+  }
+  if (path == nullptr) {
+    std::fprintf(stderr, "usage: %s [--ndjson] [--follow] <file>\n",
+                 argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    std::fprintf(stderr, "log-decode: %s: %s\n", path,
+                 std::strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  std::size_t pos = 0;
+  for (;;) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      std::fprintf(stderr, "log-decode: %s: %s\n", path,
+                   std::strerror(errno));
+      return EXIT_FAILURE;
+    }
+
+    const std::size_t size = st.st_size;
+    if (size > pos) {
+      void* map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+      if (map == MAP_FAILED) {
+        std::fprintf(stderr, "log-decode: %s: %s\n", path,
+                     std::strerror(errno));
+        return EXIT_FAILURE;
+      }
+      const auto* data = static_cast<const unsigned char*>(map);
+
+      if (pos == 0 && size >= sizeof(LogBinary::Header)) {
+        const auto header = _decode_read<LogBinary::Header>(data);
+        if (std::memcmp(header.magic, LogBinary::MAGIC,
+                        sizeof(header.magic)) != 0
+            || header.version != LogBinary::VERSION) {
+          std::fprintf(stderr, "log-decode: %s: not a binary log of"
+                       " version %u\n", path, LogBinary::VERSION);
+          return EXIT_FAILURE;
+        }
+        pos = sizeof(LogBinary::Header);
+      }
+      if (pos > 0) pos = _decode_records(state, data, size, pos);
+
+      munmap(map, size);
+      std::fflush(stdout);
+    }
+
+    if (!is_follow) break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  }
+
+  if (pos < sizeof(LogBinary::Header)) {
+    std::fprintf(stderr, "log-decode: %s: no binary log\n", path);
+    return EXIT_FAILURE;
+  }
+
+  close(fd);
+  return EXIT_SUCCESS;
+}